@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <serialfc.h>
+#include "calculate-clock-bits.h"
+
+int main(void)
+{
+    HANDLE h = 0;
+    DWORD tmp;
+	unsigned type = 0;
+	baud_setting setting;
+	double error_ppm = 0;
+	int return_value = 1;
+
+    h = CreateFile("\\\\.\\COM3", GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+
+	DeviceIoControl(h, IOCTL_FASTCOM_GET_CARD_TYPE,
+                    NULL, 0,
+                    &type, sizeof(type),
+                    &tmp, (LPOVERLAPPED)NULL);
+
+	switch(type) {
+		case SERIALFC_CARD_TYPE_FSCC:
+			return_value = calculate_baud_setting_fscc(250000, &setting, &error_ppm);
+			break;
+		case SERIALFC_CARD_TYPE_PCI:
+			return_value = calculate_baud_setting_335(250000, &setting, &error_ppm);
+			break;
+		case SERIALFC_CARD_TYPE_PCIE:
+			return_value = calculate_baud_setting_pcie(250000, &setting, &error_ppm);
+			break;
+		default:
+			break;
+	}
+
+	if (return_value == 0) {
+		printf("%lu baud (%.3f ppm), sample rate %lu, divisor %lu\n", setting.baud,
+		       error_ppm, setting.sample_rate, setting.divisor);
+
+		DeviceIoControl(h, IOCTL_FASTCOM_SET_BAUD_EXACT,
+                    &setting, sizeof(setting),
+                    NULL, 0,
+                    &tmp, (LPOVERLAPPED)NULL);
+	}
+
+    CloseHandle(h);
+
+    return 0;
+}
@@ -0,0 +1,27 @@
+#include <stdio.h>
+#include <serialfc.h>
+
+int main(void)
+{
+    HANDLE h = 0;
+    DWORD tmp;
+    struct serialfc_trace trace;
+    FILE *f;
+
+    h = CreateFile("\\\\.\\COM3", GENERIC_READ | GENERIC_WRITE, 0, NULL,
+                   OPEN_EXISTING, 0, NULL);
+
+    DeviceIoControl(h, IOCTL_FASTCOM_DUMP_TRACE,
+                    NULL, 0,
+                    &trace, sizeof(trace),
+                    &tmp, (LPOVERLAPPED)NULL);
+
+    /* Decode with tools/decode-trace.c, on any machine. */
+    f = fopen("COM3.trace", "wb");
+    fwrite(&trace, sizeof(trace), 1, f);
+    fclose(f);
+
+    CloseHandle(h);
+
+    return 0;
+}
@@ -330,6 +330,38 @@ bool Port::Get9Bit(void) throw(SystemException)
     return status != 0;
 }
 
+void Port::ApplyConfig(const struct serialfc_config &config) throw(SystemException)
+{
+    struct serialfc_config c = config;
+    DWORD tmp;
+
+    c.size = sizeof(c);
+    c.version = SERIALFC_CONFIG_VERSION;
+
+    if (DeviceIoControl(_h, (DWORD)IOCTL_FASTCOM_SET_CONFIG, &c, sizeof(c), NULL, 0, &tmp, (LPOVERLAPPED)NULL) == FALSE)
+        throw SystemException(GetLastError());
+}
+
+struct serialfc_config Port::GetConfig(void) throw(SystemException)
+{
+    struct serialfc_config c;
+    DWORD tmp;
+
+    if (DeviceIoControl(_h, (DWORD)IOCTL_FASTCOM_GET_CONFIG, NULL, 0, &c, sizeof(c), &tmp, (LPOVERLAPPED)NULL) == FALSE)
+        throw SystemException(GetLastError());
+
+    return c;
+}
+
+void Port::SetBaudExact(const struct serialfc_baud_setting &setting) throw(SystemException)
+{
+    struct serialfc_baud_setting s = setting;
+    DWORD tmp;
+
+    if (DeviceIoControl(_h, (DWORD)IOCTL_FASTCOM_SET_BAUD_EXACT, &s, sizeof(s), NULL, 0, &tmp, (LPOVERLAPPED)NULL) == FALSE)
+        throw SystemException(GetLastError());
+}
+
 unsigned Port::Write(const char *buf, unsigned size, OVERLAPPED *o)
 {
     unsigned bytes_written;
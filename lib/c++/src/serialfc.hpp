@@ -6,6 +6,7 @@
 #include <Windows.h>
 #include <string>
 
+#include "../../raw/serialfc.h"
 #include "sys_exception.hpp"
 
 namespace SerialFC {
@@ -46,6 +47,9 @@ namespace SerialFC {
         void Enable9Bit(void) throw(SystemException);
         void Disable9Bit(void) throw(SystemException);
         bool Get9Bit(void) throw(SystemException);
+        void ApplyConfig(const struct serialfc_config &config) throw(SystemException);
+        struct serialfc_config GetConfig(void) throw(SystemException);
+        void SetBaudExact(const struct serialfc_baud_setting &setting) throw(SystemException);
 
         unsigned Write(const char *buf, unsigned size, OVERLAPPED *o) throw(SystemException);
         unsigned Write(const char *buf, unsigned size) throw(SystemException);
@@ -24,20 +24,60 @@ THE SOFTWARE.
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "calculate-clock-bits.h"
+#include "clock-table-335.h"
+#include "clock-table-standard.h"
 
 #define result_array_size 512
 
-struct ResultStruct {
-    double target;
-    double freq;
-    double errorPPM;
-    int VCO_Div;
-    int refDiv;
-    int outDiv;
-    int failed;
+//The clock cache file is a clock_cache_header followed by count entries
+//sorted by chip, frequency and then ppm, in the machine's byte order. It is
+//only ever replaced whole, by renaming a new file over it, so a process
+//reading it never sees half of an update. A file with another version or
+//solver is ignored, and replaced the next time something is added.
+#define CLOCK_CACHE_MAGIC "SFCCLOCK"
+#define CLOCK_CACHE_VERSION 2
+//Change whenever GetICS30703Data can give different bits for the same
+//frequency and ppm, so settings from the old search aren't used.
+#define CLOCK_CACHE_SOLVER 1
+#define CLOCK_CACHE_MAX_ENTRIES 65536
+#define CLOCK_CACHE_PATH_MAX 1024
+#define CLOCK_CACHE_ICS30703 30703
+
+struct clock_cache_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t solver;
+    uint32_t count;
 };
 
+struct clock_cache_entry {
+    uint32_t chip;
+    uint32_t frequency;     //requested
+    uint32_t ppm;
+    uint32_t result;        //frequency the bits give
+    unsigned char clock_bits[20];
+};
+
+struct ClockCacheView {
+    void *base;
+    size_t size;
+    const struct clock_cache_entry *entries;
+    uint32_t count;
+};
+
+static char clock_cache_path[CLOCK_CACHE_PATH_MAX];
+static int clock_cache_path_set = 0;   //otherwise SERIALFC_CLOCK_CACHE is used
+
 struct IcpRsStruct {
     double pdf;
     double nbw;
@@ -48,127 +88,569 @@ struct IcpRsStruct {
     unsigned long icpnum;   //I have to use this in the switch statement because 8.75e-6 becomes 874
 };
 
-int GetICS30703Data(struct clock_data_fscc *clock_data, unsigned long ppm);
-int GetICS30702Data(struct clock_data_335 *clock_data);
+struct ICS30703Search {
+    double inputfreq;
+    unsigned long desired;
+    unsigned long requestedppm;
+    unsigned firstR;
+    unsigned lastR;
+    unsigned stepR;
+
+    clock_solution_fscc *solutions;  //best first
+    unsigned max_solutions;
+    unsigned count;
+    clock_solution_fscc first;  //room for one solution
+};
+
+static int GetICS30703Data(unsigned long desired, unsigned long ppm, unsigned threads, clock_data_fscc *result);
+static int GetICS30702Data(unsigned long rate, clock_data_335 *result);
+static void SearchICS30703(struct ICS30703Search *search);
+static int GetICS30703Bits(clock_solution_fscc *solution);
+static unsigned long ClockTable335OD(unsigned long bits);
+static int ClockTableStandardLookup(unsigned long frequency, unsigned long ppm, clock_data_fscc *result);
+static int ClockCacheLookup(unsigned long frequency, unsigned long ppm, clock_data_fscc *result);
+static void ClockCacheStore(unsigned long frequency, unsigned long ppm, const clock_data_fscc *clock_data);
 
 int calculate_clock_bits_fscc(clock_data_fscc *clock_data, unsigned long ppm)
+{
+	return calculate_clock_bits_fscc_threaded(clock_data, ppm, 1);
+}
+
+int calculate_clock_bits_fscc_threaded(clock_data_fscc *clock_data, unsigned long ppm, unsigned threads)
+{
+    enum clock_bits_error error;
+
+    error = calculate_clock_bits_fscc_r(clock_data->frequency, ppm, threads, clock_data);
+    if(error == CLOCK_BITS_OK)
+        return 0;
+
+    printf("ICS30703: %s\n", calculate_clock_bits_error_string(error));
+    clock_data->frequency = 0;
+
+    return 1;
+}
+
+enum clock_bits_error calculate_clock_bits_fscc_r(unsigned long frequency, unsigned long ppm, unsigned threads, clock_data_fscc *result)
 {
     int t;
-    int i;
-    unsigned long desiredppm;
 
-    //printf("desired freq:%ld ppm:%ld\n",freq,ppm);
-    desiredppm = ppm;
+    if(result == NULL)
+        return CLOCK_BITS_INVALID_ARGUMENT;
+
+    if(ClockTableStandardLookup(frequency, ppm, result) == 0)
+        return CLOCK_BITS_OK;
+
+    if(ClockCacheLookup(frequency, ppm, result) == 0)
+        return CLOCK_BITS_OK;
+
+    t = GetICS30703Data(frequency, ppm, threads, result);
+    if(t != 0)
+        return (enum clock_bits_error)t;
+
+    ClockCacheStore(frequency, ppm, result);
+
+    return CLOCK_BITS_OK;
+}
+
+const char *calculate_clock_bits_error_string(enum clock_bits_error error)
+{
+    switch(error)
+    {
+    case CLOCK_BITS_OK:
+        return "No error.";
+    case CLOCK_BITS_RS_CASE:
+        return "Rs case error";
+    case CLOCK_BITS_NO_SOLUTION:
+        return "no solutions found, try increasing ppm";
+    case CLOCK_BITS_INPUT_DIVIDER:
+        return "Table 1: Input Divider is out of range.";
+    case CLOCK_BITS_VCO_DIVIDER:
+        return "Table 2: VCODivider is out of range.";
+    case CLOCK_BITS_LOOP_FILTER_RESISTOR:
+        return "Table 4: LoopFilterResistor is incorrect.";
+    case CLOCK_BITS_CHARGE_PUMP_CURRENT:
+        return "Table 3: Charge Pump Current is incorrect.";
+    case CLOCK_BITS_OUTPUT_DIVIDER:
+        return "Table 5: OutputDividerOut1 is out of range.";
+    case CLOCK_BITS_INVALID_ARGUMENT:
+        return "Invalid argument.";
+    default:
+        return "Unknown error number.";
+    }
+}
+
+int calculate_clock_bits_set_cache(const char *path)
+{
+    if(path == NULL)
+    {
+        clock_cache_path[0] = '\0';
+        clock_cache_path_set = 1;
+        return 0;
+    }
+
+    if(strlen(path) >= sizeof(clock_cache_path))
+        return 1;
+
+    strcpy(clock_cache_path, path);
+    clock_cache_path_set = 1;
+
+    return 0;
+}
+
+int calculate_clock_bits_asynccom(clock_data_asynccom *clock_data, unsigned long ppm)
+{
+	return calculate_clock_bits_fscc(clock_data, ppm);
+}
+
+int calculate_clock_bits_synccom(clock_data_synccom *clock_data, unsigned long ppm)
+{
+	return calculate_clock_bits_fscc(clock_data, ppm);
+}
+
+int calculate_clock_bits_fscc_batch(const unsigned long *frequencies, unsigned count, unsigned long ppm, clock_data_fscc *results)
+{
+    unsigned i;
+    int solved = 0;
+
+    for(i=0;i<count;i++)
+    {
+        //the same frequency twice in a row is only searched for once
+        if( (i > 0) && (frequencies[i] == frequencies[i - 1]) )
+        {
+            results[i] = results[i - 1];
+        }
+        else if(ClockTableStandardLookup(frequencies[i], ppm, &results[i]) != 0)
+        {
+            if(GetICS30703Data(frequencies[i], ppm, 1, &results[i]) != 0)
+            {
+                results[i].frequency = 0;
+                memset(results[i].clock_bits, 0, sizeof(results[i].clock_bits));
+            }
+        }
+
+        if(results[i].frequency != 0)
+            solved++;
+    }
+
+    return solved;
+}
+
+int calculate_clock_solutions_fscc(unsigned long frequency, unsigned long ppm, clock_solution_fscc *solutions, unsigned max_solutions)
+{
+    struct ICS30703Search search;
+    unsigned i;
+
+    if(max_solutions == 0)
+        return 0;
+
+    search.inputfreq = 24000000.0;
+    search.desired = frequency;
+    search.requestedppm = ppm;
+    search.firstR = 1;
+    search.lastR = 1200;
+    search.stepR = 1;
+    search.solutions = solutions;
+    search.max_solutions = max_solutions;
+
+    SearchICS30703(&search);
+
+    for(i=0;i<search.count;i++)
+    {
+        if(GetICS30703Bits(&solutions[i]) != 0)
+            return -1;
+    }
+
+    return search.count;
+}
+
+int calculate_clock_bits_335(clock_data_335 *clock_data)
+{
+    if(calculate_clock_bits_335_r(clock_data->frequency, clock_data) == CLOCK_BITS_OK)
+        return 0;
+
+    clock_data->frequency = 0;
+
+    return 1;
+}
+
+enum clock_bits_error calculate_clock_bits_335_r(unsigned long frequency, clock_data_335 *result)
+{
+    if(result == NULL)
+        return CLOCK_BITS_INVALID_ARGUMENT;
+
+    if(GetICS30702Data(frequency, result) != 0)
+        return CLOCK_BITS_NO_SOLUTION;
+
+    return CLOCK_BITS_OK;
+}
+
+//Clocks the baud planners look at, within the range
+//IOCTL_FASTCOM_SET_CLOCK_RATE takes on each card
+#define BAUD_FSCC_MIN_CLOCK 1000000
+#define BAUD_FSCC_MAX_CLOCK 270000000
+#define BAUD_FSCC_PPM 10000         //1%, what SerialGetDivisorFromBaud allows
+#define BAUD_FSCC_DIVISORS 8        //divisors tried at each sample rate
+#define BAUD_335_MIN_CLOCK 6000000
+#define BAUD_335_MAX_CLOCK 180000000
+#define BAUD_PCIE_CLOCK 125000000
+
+/* Tries each sample rate from 16 down to 4 with the lowest divisors that
+   put the clock at 1 MHz or more, where the clock search is quickest.
+   Every clock after the first only has to be searched for as closely as
+   the best one so far and an exact setting ends it, which keeps this to
+   tens of milliseconds. */
+int calculate_baud_setting_fscc(unsigned long baud, baud_setting *setting, double *error_ppm)
+{
+    clock_solution_fscc solution;
+    unsigned long sample_rate;
+    unsigned long divisor;
+    unsigned long ppm = BAUD_FSCC_PPM;
+    unsigned tried;
+    double rate, actual, error;
+    double best = -1;   //lowest error so far in ppm, -1 for none
+
+    if(baud == 0)
+        return 1;
+
+    for(sample_rate=16;(sample_rate>=4)&&(best!=0);sample_rate--)
+    {
+        rate = (double)baud * sample_rate;
+        divisor = (unsigned long)ceil(BAUD_FSCC_MIN_CLOCK / rate);
+        if(divisor == 0)
+            divisor = 1;
+
+        for(tried=0;tried<BAUD_FSCC_DIVISORS;tried++,divisor++)
+        {
+            if((divisor > 65535) || (rate * divisor > BAUD_FSCC_MAX_CLOCK))
+                break;
+
+            if(calculate_clock_solutions_fscc(baud * sample_rate * divisor, ppm, &solution, 1) != 1)
+                continue;
+
+            actual = 24000000.0 * solution.vco_divider / ((double)solution.reference_divider * solution.output_divider * sample_rate * divisor);
+            error = (actual - baud) / baud * 1.0e6;
+
+            //on a tie the higher sample rate and then lower clock is kept
+            if((best >= 0) && (fabs(error) >= best))
+                continue;
+
+            best = fabs(error);
+            ppm = solution.ppm;
+
+            memset(setting, 0, sizeof(*setting));
+            setting->baud = (unsigned long)(actual + 0.5);
+            setting->sample_rate = sample_rate;
+            setting->divisor = divisor;
+            setting->clock_frequency = solution.frequency;
+            memcpy(setting->clock_bits_fscc, solution.clock_bits, sizeof(setting->clock_bits_fscc));
+            if(error_ppm)
+                *error_ppm = error;
+
+            if(best == 0)
+                break;
+        }
+    }
+
+    return (best < 0) ? 1 : 0;
+}
+
+/* The 335 clock is looked up in clock_table_335, so every divisor that
+   puts the clock in range can be tried at both sample rates. */
+int calculate_baud_setting_335(unsigned long baud, baud_setting *setting, double *error_ppm)
+{
+    clock_data_335 clock_data;
+    unsigned long sample_rate;
+    unsigned long divisor;
+    unsigned long rdw, vdw;
+    double rate, actual, error;
+    double best = -1;   //lowest error so far in ppm, -1 for none
+
+    if(baud == 0)
+        return 1;
+
+    for(sample_rate=16;(sample_rate>=8)&&(best!=0);sample_rate-=8)
+    {
+        rate = (double)baud * sample_rate;
+        divisor = (unsigned long)ceil(BAUD_335_MIN_CLOCK / rate);
+        if(divisor == 0)
+            divisor = 1;
+
+        for(;(divisor<=65535)&&(rate*divisor<=BAUD_335_MAX_CLOCK);divisor++)
+        {
+            if(GetICS30702Data(baud * sample_rate * divisor, &clock_data) != 0)
+                continue;
+
+            //the table rounds the frequency down, the clock itself doesn't
+            rdw = clock_data.clock_bits & 0x7f;
+            vdw = (clock_data.clock_bits >> 7) & 0x1ff;
+            actual = 36864000.0 * (vdw + 8) / ((double)(rdw + 2) * ClockTable335OD(clock_data.clock_bits) * sample_rate * divisor);
+            error = (actual - baud) / baud * 1.0e6;
+
+            if((best >= 0) && (fabs(error) >= best))
+                continue;
+
+            best = fabs(error);
+
+            memset(setting, 0, sizeof(*setting));
+            setting->baud = (unsigned long)(actual + 0.5);
+            setting->sample_rate = sample_rate;
+            setting->divisor = divisor;
+            setting->clock_frequency = clock_data.frequency;
+            setting->clock_bits_335 = clock_data.clock_bits;
+            if(error_ppm)
+                *error_ppm = error;
+
+            if(best == 0)
+                break;
+        }
+    }
+
+    return (best < 0) ? 1 : 0;
+}
+
+/* The 17V35x runs from a fixed 125 MHz and divides it by sample_rate and a
+   divisor in sixteenths, the way PCIeSetBaudRate works it out, so for each
+   sample rate only the divisors either side of the ideal one need trying. */
+int calculate_baud_setting_pcie(unsigned long baud, baud_setting *setting, double *error_ppm)
+{
+    const double sixteenths = BAUD_PCIE_CLOCK * 16.0;
+    unsigned long sample_rate;
+    unsigned long divisor;
+    unsigned i;
+    double actual, error;
+    double best = -1;   //lowest error so far in ppm, -1 for none
+
+    if(baud == 0)
+        return 1;
+
+    for(sample_rate=16;sample_rate>=4;sample_rate/=2)
+    {
+        divisor = (unsigned long)(sixteenths / ((double)baud * sample_rate));
+
+        for(i=0;i<2;i++,divisor++)
+        {
+            //DLM and DLL hold the whole part, DLD the sixteenths
+            if((divisor < 16) || (divisor > 0xfffff))
+                continue;
+
+            actual = sixteenths / ((double)divisor * sample_rate);
+            error = (actual - baud) / baud * 1.0e6;
 
-    t=GetICS30703Data(clock_data, desiredppm);
-        switch(t)
+            if((best >= 0) && (fabs(error) >= best))
+                continue;
+
+            best = fabs(error);
+
+            memset(setting, 0, sizeof(*setting));
+            setting->baud = (unsigned long)(actual + 0.5);
+            setting->sample_rate = sample_rate;
+            setting->divisor = divisor;
+            if(error_ppm)
+                *error_ppm = error;
+        }
+    }
+
+    return (best < 0) ? 1 : 0;
+}
+
+/* Finds the first loop filter resistor and charge pump current that keep
+   the PLL stable for reference divider r and VCO divider v. Returns 1 and
+   fills in IRStruct if there is one. */
+static int FindLoopFilter(double inputfreq, unsigned r, unsigned v, struct IcpRsStruct *IRStruct)
+{
+    unsigned long i,j;
+    unsigned long Rs;
+    int tempint;
+
+    for(i=0;i<4;i++)
+    {
+        switch(i)
         {
         case 0:
+            Rs = 64000;
             break;
         case 1:
-            printf("ICS30703: Rs case error\n");
+            Rs = 52000;
             break;
         case 2:
-            printf("ICS30703: no solutions found, try increasing ppm\n");
+            Rs = 16000;
             break;
         case 3:
-            printf("ICS30703: Table 1: Input Divider is out of rante.\n");
-            break;
-        case 4:
-            printf("ICS30703: Table 2: VCODivider is out of range.\n");
-            break;
-        case 5:
-            printf("ICS30703: Table 4: LoopFilterResistor is incorrect.\n");
-            break;
-        case 6:
-            printf("ICS30703: Table 3: Charge Pump Current is incorrect.\n");
-            break;
-        case 7:
-            printf("ICS30703: Table 5: OutputDividerOut1 is out of range.\n");
+            Rs = 4000;
             break;
         default:
-            printf("ICS30703: Unknown error number.\n");
-            break;
+            return 0;
         }
 
-	if(t==0)    return 0;
-	else return 1;
-}
+        for(j=0;j<20;j++)
+        {
+            IRStruct->Rs=Rs;
+            switch(j)
+            {
+            case 0:
+                IRStruct->icp=1.25e-6;
+                IRStruct->icpnum=125;
+                break;
+            case 1:
+                IRStruct->icp=2.5e-6;
+                IRStruct->icpnum=250;
+                break;
+            case 2:
+                IRStruct->icp=3.75e-6;
+                IRStruct->icpnum=375;
+                break;
+            case 3:
+                IRStruct->icp=5.0e-6;
+                IRStruct->icpnum=500;
+                break;
+            case 4:
+                IRStruct->icp=6.25e-6;
+                IRStruct->icpnum=625;
+                break;
+            case 5:
+                IRStruct->icp=7.5e-6;
+                IRStruct->icpnum=750;
+                break;
+            case 6:
+                IRStruct->icp=8.75e-6;
+                IRStruct->icpnum=875;
+                break;
+            case 7:
+                IRStruct->icp=10.0e-6;
+                IRStruct->icpnum=1000;
+                break;
+            case 8:
+                IRStruct->icp=11.25e-6;
+                IRStruct->icpnum=1125;
+                break;
+            case 9:
+                IRStruct->icp=12.5e-6;
+                IRStruct->icpnum=1250;
+                break;
+            case 10:
+                IRStruct->icp=15.0e-6;
+                IRStruct->icpnum=1500;
+                break;
+            case 11:
+                IRStruct->icp=17.5e-6;
+                IRStruct->icpnum=1750;
+                break;
+            case 12:
+                IRStruct->icp=18.75e-6;
+                IRStruct->icpnum=1875;
+                break;
+            case 13:
+                IRStruct->icp=20.0e-6;
+                IRStruct->icpnum=2000;
+                break;
+            case 14:
+                IRStruct->icp=22.5e-6;
+                IRStruct->icpnum=2250;
+                break;
+            case 15:
+                IRStruct->icp=25.0e-6;
+                IRStruct->icpnum=2500;
+                break;
+            case 16:
+                IRStruct->icp=26.25e-6;
+                IRStruct->icpnum=2625;
+                break;
+            case 17:
+                IRStruct->icp=30.0e-6;
+                IRStruct->icpnum=3000;
+                break;
+            case 18:
+                IRStruct->icp=35.0e-6;
+                IRStruct->icpnum=3500;
+                break;
+            case 19:
+                IRStruct->icp=40.0e-6;
+                IRStruct->icpnum=4000;
+                break;
+            }//end switch(j)
+
+            IRStruct->pdf = (inputfreq / (double)r) ;
+
+            IRStruct->nbw = ( ((double)IRStruct->Rs * IRStruct->icp * 310.0e6) / (2.0 * 3.14159 * (double)v) );
+
+            IRStruct->ratio = (IRStruct->pdf/IRStruct->nbw);
+
+            tempint = (int)(IRStruct->ratio*10.0);
+            if((IRStruct->ratio*10.0)-tempint>=0.0) tempint++;
+            IRStruct->ratio = (double)tempint/10.0;
+
+            IRStruct->df = ( ((double)IRStruct->Rs / 2) * (sqrt( ((IRStruct->icp * 0.093) / (double)v))) );
+
+            if( (IRStruct->ratio>30) || (IRStruct->ratio<7) || (IRStruct->df>2.0) || (IRStruct->df<0.2) )
+            {
+                continue;
+            }
 
-int calculate_clock_bits_asynccom(clock_data_asynccom *clock_data, unsigned long ppm)
-{
-	return calculate_clock_bits_fscc(clock_data, ppm);
-}
+            return 1;
+        }//end for(j=0;j<20;j++)
+    }//end for(i=0;i<4;i++)
 
-int calculate_clock_bits_synccom(clock_data_synccom *clock_data, unsigned long ppm)
-{
-	return calculate_clock_bits_fscc(clock_data, ppm);
+    return 0;
 }
 
-int calculate_clock_bits_335(clock_data_335 *clock_data)
+/* Adds a solution that is better than the worst one kept, if the list is
+   full, after those with the same or a lower ppm. */
+static void KeepICS30703(struct ICS30703Search *search, const clock_solution_fscc *solution)
 {
-    return GetICS30702Data(clock_data);
+    unsigned i;
+
+    if(search->count < search->max_solutions)
+        i = search->count++;
+    else
+        i = search->max_solutions - 1;
+
+    while( (i > 0) && (search->solutions[i - 1].ppm > solution->ppm) )
+    {
+        search->solutions[i] = search->solutions[i - 1];
+        i--;
+    }
+
+    search->solutions[i] = *solution;
 }
 
-int GetICS30703Data(struct clock_data_fscc *clock_data, unsigned long ppm)
+/* Searches reference dividers firstR, firstR+stepR, ... up to lastR.
+   Each setting passes from some lowest ppm up.  Searching once at the
+   requested ppm and keeping the setting with the lowest one, the first
+   found on a tie, picks what restarting the search at ppm 0, 1, 2, ...
+   and taking the first setting found used to.  The next best settings
+   are kept too when there is room for them. */
+static void SearchICS30703(struct ICS30703Search *search)
 {
-    //  double inputfreq=18432000.0;
-    double inputfreq=24000000.0;
+    double inputfreq=search->inputfreq;
+    unsigned long desired=search->desired;
+    unsigned firstR=search->firstR;
+    unsigned lastR=search->lastR;
+    unsigned stepR=search->stepR;
 
     unsigned long od=0; //Output Divider
     unsigned r=0;
     unsigned v=0;
     unsigned V_Divstart=0;
+#ifndef CLOCK_BITS_NO_OD_SKIP
+    double lowV, highV; //VCO dividers per od giving desired -/+ allowable_error
+#endif
     double freq=0;
-    unsigned maxR;
-    unsigned minR;
     unsigned max_V=2055;
     unsigned min_V=12;
     double allowable_error;
     double freq_err;
-    struct ResultStruct Results;
-	struct ResultStruct theOne;
-    unsigned long i,j;
     struct IcpRsStruct IRStruct;
-	struct IcpRsStruct theOther;
-    unsigned count;
-    unsigned long Rs;
+    clock_solution_fscc solution;
     double rule1, rule2;
-    int tempint;
-	unsigned char progdata[20];
-	unsigned long desired;
-
-    int InputDivider=0;
-    int VCODivider=0;
-    unsigned long ChargePumpCurrent=0;
-    unsigned long LoopFilterResistor=0;
-    unsigned long OutputDividerOut1=0;
-    unsigned long temp=0;
-    unsigned long requestedppm;
-
-    memset(&theOne,0,sizeof(struct ResultStruct));
-    memset(&theOther,0,sizeof(struct IcpRsStruct));
-	desired = clock_data->frequency;
-	clock_data->frequency = 0;
-    requestedppm=ppm;
-
-    if( inputfreq == 18432000.0) 
-    {
-        maxR = 921;
-        minR = 1;
-    }
-    else if( inputfreq == 24000000.0) 
-    {
-        maxR = 1200;
-        minR = 1;
-    }
+    double minOD, maxOD;
+    unsigned long ppm;
+    unsigned long bestppm;  //a new setting has to be below this to be kept
 
-    ppm=0;
-increaseppm:
-    //printf("ICS30703: ppm = %ld\n",ppm);
-    allowable_error  = ppm * desired/1e6; // * 1e6
+    search->count=0;
+    bestppm=search->requestedppm+1;
+    allowable_error  = search->requestedppm * desired/1e6; // * 1e6
 
-    for( r = minR; r <= maxR; r++ )
+    for( r = firstR; (r <= lastR) && (bestppm > 0); r += stepR )
     {
         rule2 = inputfreq /(double)r;
         if ( (rule2 < 20000.0) || (rule2 > 100000000.0) )
@@ -177,27 +659,82 @@ increaseppm:
             continue;   //next r
         }
 
-        od=8232;
-        while(od > 1)
+        //Output dividers outside of these can't get close enough with any
+        //VCO divider, or would need the VCO outside of 90 to 730 MHz
+        if(desired > allowable_error)
+        {
+            maxOD = (inputfreq * max_V) / ((double)r * (desired - allowable_error));
+            if(maxOD > 730000000.0 / (desired - allowable_error))
+                maxOD = 730000000.0 / (desired - allowable_error);
+        }
+        else
+            maxOD = 8232;
+        minOD = (inputfreq * min_V) / ((double)r * (desired + allowable_error));
+        if(minOD < 90000000.0 / (desired + allowable_error))
+            minOD = 90000000.0 / (desired + allowable_error);
+
+#ifndef CLOCK_BITS_NO_OD_SKIP
+        lowV = ((desired - allowable_error) * r) / inputfreq;
+        highV = ((desired + allowable_error) * r) / inputfreq;
+#endif
+
+        //start at the highest output divider the loop below would reach
+        //that isn't above maxOD
+        if(maxOD + 1 >= 8232)
+            od=8232;
+        else
         {
-            //set starting VCO setting with output freq just below target
-            V_Divstart = (int) (((desired - (allowable_error) ) * r * od) / (inputfreq));
+            od = (unsigned long)(maxOD + 1);
+            if(od > 4120)
+                od &= ~7UL;
+            else if(od > 2060)
+                od &= ~3UL;
+            else if(od > 1030)
+                od &= ~1UL;
+        }
 
-            //check if starting VCO setting too low
-            if (V_Divstart < min_V)
-                V_Divstart = min_V;
+        while( (od > 1) && (bestppm > 0) )
+        {
+            if(od + 1 < minOD)
+                break;  //smaller dividers are only further away
+
+            //Only a VCO divider between lowV * od and highV * od can be
+            //close enough. For most output dividers no whole number is in
+            //there and the loop below is skipped.
+            //CLOCK_BITS_NO_OD_SKIP leaves this out, for tools/test-od-skip.c.
+#ifndef CLOCK_BITS_NO_OD_SKIP
+            //1e-6 keeps a v that rounding puts just past either end in range
+            if ((double)(unsigned long)(highV * od + 1e-6) < lowV * od - 1e-6)
+            {
+                V_Divstart = max_V + 1;
+            }
+            else
+#endif
+            {
+                //set starting VCO setting with output freq just below target
+                V_Divstart = (int) (((desired - (allowable_error) ) * r * od) / (inputfreq));
 
-            //check if starting VCO setting too high
-            else if (V_Divstart > max_V)
-                V_Divstart = max_V;
+                //check if starting VCO setting too low
+                if (V_Divstart < min_V)
+                    V_Divstart = min_V;
+
+                //check if starting VCO setting too high
+                else if (V_Divstart > max_V)
+                    V_Divstart = max_V;
+            }
 
             /** Loop thru VCO divide settings**/
-            //Loop through all VCO divider ratios
-            for( v = V_Divstart; v <= max_V; v++ ) //Check all Vco divider settings
+            for( v = V_Divstart; v <= max_V; v++ )
             {
+                freq = (inputfreq * ((double)v / ((double)r * (double)od)));
+
+                //freq only goes up with v
+                if ((freq - desired) > allowable_error)
+                    break;
+
                 rule1 = (inputfreq * ((double)v / (double)r) );
 
-                        if(od==2)
+                if(od==2)
                 {
                     if( (rule1 < 90000000.0) || (rule1 > 540000000.0)  )
                     {
@@ -226,167 +763,40 @@ increaseppm:
                     }
                 }
 
-                freq = (inputfreq * ((double)v / ((double)r * (double)od)));
                 freq_err    = fabs(freq - desired) ; //Hz
 
                 if ((freq_err) > allowable_error)
                 {
                     continue; //next VCO_Div
                 }
-                else if((freq_err) <= allowable_error)
+
+                //lowest ppm this setting passes at
+                for(ppm=0; ppm<bestppm; ppm++)
                 {
-                    count=0;
-                    for(i=0;i<4;i++)
-                    {
-                        switch(i)
-                        {
-                        case 0:
-                            Rs = 64000;
-                            break;
-                        case 1:
-                            Rs = 52000;
-                            break;
-                        case 2:
-                            Rs = 16000;
-                            break;
-                        case 3:
-                            Rs = 4000;
-                            break;
-                        default:
-                            return 1;
-                        }
-
-                        for(j=0;j<20;j++)
-                        {
-                            IRStruct.Rs=Rs;
-                            switch(j)
-                            {
-                            case 0:
-                                IRStruct.icp=1.25e-6;
-                                IRStruct.icpnum=125;
-                                break;
-                            case 1:
-                                IRStruct.icp=2.5e-6;
-                                IRStruct.icpnum=250;
-                                break;
-                            case 2:
-                                IRStruct.icp=3.75e-6;
-                                IRStruct.icpnum=375;
-                                break;
-                            case 3:
-                                IRStruct.icp=5.0e-6;
-                                IRStruct.icpnum=500;
-                                break;
-                            case 4:
-                                IRStruct.icp=6.25e-6;
-                                IRStruct.icpnum=625;
-                                break;
-                            case 5:
-                                IRStruct.icp=7.5e-6;
-                                IRStruct.icpnum=750;
-                                break;
-                            case 6:
-                                IRStruct.icp=8.75e-6;
-                                IRStruct.icpnum=875;
-                                break;
-                            case 7:
-                                IRStruct.icp=10.0e-6;
-                                IRStruct.icpnum=1000;
-                                break;
-                            case 8:
-                                IRStruct.icp=11.25e-6;
-                                IRStruct.icpnum=1125;
-                                break;
-                            case 9:
-                                IRStruct.icp=12.5e-6;
-                                IRStruct.icpnum=1250;
-                                break;
-                            case 10:
-                                IRStruct.icp=15.0e-6;
-                                IRStruct.icpnum=1500;
-                                break;
-                            case 11:
-                                IRStruct.icp=17.5e-6;
-                                IRStruct.icpnum=1750;
-                                break;
-                            case 12:
-                                IRStruct.icp=18.75e-6;
-                                IRStruct.icpnum=1875;
-                                break;
-                            case 13:
-                                IRStruct.icp=20.0e-6;
-                                IRStruct.icpnum=2000;
-                                break;
-                            case 14:
-                                IRStruct.icp=22.5e-6;
-                                IRStruct.icpnum=2250;
-                                break;
-                            case 15:
-                                IRStruct.icp=25.0e-6;
-                                IRStruct.icpnum=2500;
-                                break;
-                            case 16:
-                                IRStruct.icp=26.25e-6;
-                                IRStruct.icpnum=2625;
-                                break;
-                            case 17:
-                                IRStruct.icp=30.0e-6;
-                                IRStruct.icpnum=3000;
-                                break;
-                            case 18:
-                                IRStruct.icp=35.0e-6;
-                                IRStruct.icpnum=3500;
-                                break;
-                            case 19:
-                                IRStruct.icp=40.0e-6;
-                                IRStruct.icpnum=4000;
-                                break;
-                            default:
-                                printf("ICS30703: switch(j:icp) - You shouldn't get here! %ld\n",j);
-                            }//end switch(j)
-
-
-                            //                          printf("Rs=%5d ",IRStruct.Rs);
-                            //                          printf("Icp=%2.2f ",IRStruct.icp*10e5);
-
-                            IRStruct.pdf = (inputfreq / (double)r) ;
-                            //                          printf("pdf=%12.2f ",IRStruct.pdf);
-
-                            IRStruct.nbw = ( ((double)IRStruct.Rs * IRStruct.icp * 310.0e6) / (2.0 * 3.14159 * (double)v) );
-                            //                          printf("nbw=%15.3f ",IRStruct.nbw);
-
-                            IRStruct.ratio = (IRStruct.pdf/IRStruct.nbw);
-
-                            tempint = (int)(IRStruct.ratio*10.0);
-                            if((IRStruct.ratio*10.0)-tempint>=0.0) tempint++;
-                            IRStruct.ratio = (double)tempint/10.0;
-
-                            //                          IRStruct.ratio = ceil(IRStruct.ratio*10.0); //these two statements make the
-                            //                          IRStruct.ratio = IRStruct.ratio/10.0;       //ratio a little nicer to compare
-
-                            //                          printf("ratio=%2.4f ",IRStruct.ratio);
-
-                            IRStruct.df = ( ((double)IRStruct.Rs / 2) * (sqrt( ((IRStruct.icp * 0.093) / (double)v))) );
-                            //                          printf("ndf=%12.3f\n",IRStruct.df);
-
-                            count++;
-                            if( (IRStruct.ratio>30) || (IRStruct.ratio<7) || (IRStruct.df>2.0) || (IRStruct.df<0.2) )
-                            {
-                                continue;
-                            }
-                            else
-                            {
-                                Results.target    = desired;
-                                Results.freq      = freq;
-                                Results.errorPPM     = freq_err / desired * 1.0e6 ;
-                                Results.VCO_Div   = v;
-                                Results.refDiv    = r;
-                                Results.outDiv    = od;
-                                Results.failed = 1;
-                                goto finished;
-                            }
-                        }//end for(j=0;j<20;j++)
-                    }//end for(i=0;i<4;i++)
+                    if(freq_err <= ppm * desired/1e6)
+                        break;
+                }
+
+                if(ppm>=bestppm)
+                    continue;   //an earlier setting is at least as good
+
+                if(FindLoopFilter(inputfreq, r, v, &IRStruct))
+                {
+                    solution.frequency = (unsigned long)freq;
+                    solution.ppm = ppm;
+                    solution.error_ppm = freq_err / desired * 1.0e6 ;
+                    solution.vco_frequency = rule1;
+                    solution.reference_divider = r;
+                    solution.vco_divider = v;
+                    solution.output_divider = od;
+                    solution.loop_filter_resistor = IRStruct.Rs;
+                    solution.charge_pump_current = IRStruct.icpnum * 10;
+                    KeepICS30703(search, &solution);
+
+                    if(search->count == search->max_solutions)
+                        bestppm = search->solutions[search->count - 1].ppm;
+                    if(bestppm == 0)
+                        break;
                 }
             }//end of for( v = V_Divstart; v < max_V; v++ )
 
@@ -399,24 +809,417 @@ increaseppm:
             else od=od-8;
 
         }//end of while(od <= 8232)
-    }//end of for( r = maxR, *saved_result_num = 0; r >= minR; r-- )
+    }//end of for( r = firstR; r <= lastR; r += stepR )
+}
 
-    ppm++;
-    if(ppm>requestedppm)
+/* The cache file to use, NULL for none */
+static const char *ClockCachePath(void)
+{
+    const char *path;
+
+    if(clock_cache_path_set)
+        path = clock_cache_path;
+    else
+        path = getenv("SERIALFC_CLOCK_CACHE");
+
+    if((path == NULL) || (path[0] == '\0') || (strlen(path) >= CLOCK_CACHE_PATH_MAX))
+        return NULL;
+
+    return path;
+}
+
+static void ClockCacheClose(struct ClockCacheView *view)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(view->base);
+#else
+    munmap(view->base, view->size);
+#endif
+    view->base = NULL;
+}
+
+/* Maps the cache file in and checks it. Returns 1 if there isn't a good one. */
+static int ClockCacheOpen(const char *path, struct ClockCacheView *view)
+{
+    const size_t max_size = sizeof(struct clock_cache_header) + CLOCK_CACHE_MAX_ENTRIES * sizeof(struct clock_cache_entry);
+    const struct clock_cache_header *header;
+#ifdef _WIN32
+    HANDLE file, mapping;
+    LARGE_INTEGER size;
+#else
+    int fd;
+    struct stat st;
+#endif
+
+    view->base = NULL;
+
+#ifdef _WIN32
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE)
+        return 1;
+
+    if(GetFileSizeEx(file, &size) && (size.QuadPart >= (LONGLONG)sizeof(*header)) && (size.QuadPart <= (LONGLONG)max_size))
     {
-        return 2;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(mapping != NULL)
+        {
+            view->base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            view->size = (size_t)size.QuadPart;
+            CloseHandle(mapping);
+        }
+    }
+
+    CloseHandle(file);
+#else
+    fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return 1;
+
+    if((fstat(fd, &st) == 0) && (st.st_size >= (off_t)sizeof(*header)) && (st.st_size <= (off_t)max_size))
+    {
+        view->base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        view->size = (size_t)st.st_size;
+        if(view->base == MAP_FAILED)
+            view->base = NULL;
+    }
+
+    close(fd);
+#endif
+
+    if(view->base == NULL)
+        return 1;
+
+    header = view->base;
+    if( (memcmp(header->magic, CLOCK_CACHE_MAGIC, sizeof(header->magic)) != 0) ||
+        (header->version != CLOCK_CACHE_VERSION) || (header->solver != CLOCK_CACHE_SOLVER) ||
+        (header->count > CLOCK_CACHE_MAX_ENTRIES) ||
+        (view->size != sizeof(*header) + header->count * sizeof(struct clock_cache_entry)) )
+    {
+        ClockCacheClose(view);
+        return 1;
+    }
+
+    view->entries = (const struct clock_cache_entry *)(header + 1);
+    view->count = header->count;
+
+    return 0;
+}
+
+static int ClockCacheCompare(const struct clock_cache_entry *a, const struct clock_cache_entry *b)
+{
+    if(a->chip != b->chip)
+        return (a->chip < b->chip) ? -1 : 1;
+
+    if(a->frequency != b->frequency)
+        return (a->frequency < b->frequency) ? -1 : 1;
+
+    if(a->ppm != b->ppm)
+        return (a->ppm < b->ppm) ? -1 : 1;
+
+    return 0;
+}
+
+/* Index of the first entry not before key */
+static uint32_t ClockCacheFind(const struct ClockCacheView *view, const struct clock_cache_entry *key)
+{
+    uint32_t first = 0, last = view->count, middle;
+
+    while(first < last)
+    {
+        middle = first + (last - first) / 2;
+        if(ClockCacheCompare(&view->entries[middle], key) < 0)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    return first;
+}
+
+/* Fills in result from clock_table_standard_fscc. An entry is good for any
+   ppm from its own up, the search keeps the closest setting it finds no
+   matter how far it is allowed to look. Returns 1 if it isn't there. */
+static int ClockTableStandardLookup(unsigned long frequency, unsigned long ppm, clock_data_fscc *result)
+{
+    unsigned i;
+
+    for(i=0;i<CLOCK_TABLE_STANDARD_FSCC_SIZE;i++)
+    {
+        if(clock_table_standard_fscc[i].frequency != frequency)
+            continue;
+
+        if(clock_table_standard_fscc[i].ppm > ppm)
+            return 1;
+
+        result->frequency = clock_table_standard_fscc[i].actual;
+        memcpy(result->clock_bits, clock_table_standard_fscc[i].bits, sizeof(result->clock_bits));
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Fills in result from the cache. Returns 1 if it isn't there. */
+static int ClockCacheLookup(unsigned long frequency, unsigned long ppm, clock_data_fscc *result)
+{
+    const char *path = ClockCachePath();
+    struct ClockCacheView view;
+    struct clock_cache_entry key;
+    uint32_t i;
+    int found = 0;
+
+    if((path == NULL) || (frequency > 0xffffffffUL) || (ppm > 0xffffffffUL))
+        return 1;
+
+    if(ClockCacheOpen(path, &view) != 0)
+        return 1;
+
+    key.chip = CLOCK_CACHE_ICS30703;
+    key.frequency = (uint32_t)frequency;
+    key.ppm = (uint32_t)ppm;
+
+    i = ClockCacheFind(&view, &key);
+    if((i < view.count) && (ClockCacheCompare(&view.entries[i], &key) == 0))
+    {
+        result->frequency = view.entries[i].result;
+        memcpy(result->clock_bits, view.entries[i].clock_bits, sizeof(result->clock_bits));
+        found = 1;
+    }
+
+    ClockCacheClose(&view);
+
+    return found ? 0 : 1;
+}
+
+/* Adds a setting to the cache by writing a new file next to it and renaming
+   it over the old one. Updates are best effort. Anything going wrong,
+   including the rename failing because another process has the file open,
+   just leaves the cache as it was and deletes the new file. Two processes
+   adding at once can lose one of the settings, which is searched for again
+   next time. */
+static void ClockCacheStore(unsigned long frequency, unsigned long ppm, const clock_data_fscc *clock_data)
+{
+    const char *path = ClockCachePath();
+    struct ClockCacheView view;
+    struct clock_cache_header header;
+    struct clock_cache_entry entry;
+    char temp[CLOCK_CACHE_PATH_MAX + 48];
+    uint32_t at = 0;
+    int ok;
+    FILE *f;
+
+    if((path == NULL) || (frequency > 0xffffffffUL) || (ppm > 0xffffffffUL))
+        return;
+
+    entry.chip = CLOCK_CACHE_ICS30703;
+    entry.frequency = (uint32_t)frequency;
+    entry.ppm = (uint32_t)ppm;
+    entry.result = (uint32_t)clock_data->frequency;
+    memcpy(entry.clock_bits, clock_data->clock_bits, sizeof(entry.clock_bits));
+
+    if(ClockCacheOpen(path, &view) != 0)
+    {
+        view.entries = NULL;
+        view.count = 0;
     }
     else
     {
-        //      printk("ICS30703: increasing ppm to %d\n",ppm);
-        goto increaseppm;
+        at = ClockCacheFind(&view, &entry);
+        if( ((at < view.count) && (ClockCacheCompare(&view.entries[at], &entry) == 0)) ||
+            (view.count >= CLOCK_CACHE_MAX_ENTRIES) )
+        {
+            ClockCacheClose(&view);
+            return;
+        }
     }
 
-finished:
+    //unique to the process, and to the thread by its stack
+#ifdef _WIN32
+    sprintf(temp, "%s.%lu.%p.tmp", path, (unsigned long)GetCurrentProcessId(), (void *)&header);
+#else
+    sprintf(temp, "%s.%lu.%p.tmp", path, (unsigned long)getpid(), (void *)&header);
+#endif
+
+    f = fopen(temp, "wb");
+    if(f == NULL)
+    {
+        if(view.base)
+            ClockCacheClose(&view);
+        return;
+    }
+
+    memcpy(header.magic, CLOCK_CACHE_MAGIC, sizeof(header.magic));
+    header.version = CLOCK_CACHE_VERSION;
+    header.solver = CLOCK_CACHE_SOLVER;
+    header.count = view.count + 1;
+
+    ok = (fwrite(&header, sizeof(header), 1, f) == 1);
+    if(ok && (at > 0))
+        ok = (fwrite(view.entries, sizeof(entry), at, f) == at);
+    if(ok)
+        ok = (fwrite(&entry, sizeof(entry), 1, f) == 1);
+    if(ok && (view.count > at))
+        ok = (fwrite(view.entries + at, sizeof(entry), view.count - at, f) == view.count - at);
+
+    if(fclose(f) != 0)
+        ok = 0;
+
+    //Windows won't replace a file that is still mapped
+    if(view.base)
+        ClockCacheClose(&view);
+
+#ifdef _WIN32
+    if(ok)
+        ok = MoveFileExA(temp, path, MOVEFILE_REPLACE_EXISTING) != 0;
+
+    if(!ok)
+        DeleteFileA(temp);
+#else
+    if(ok)
+        ok = (rename(temp, path) == 0);
+
+    if(!ok)
+        remove(temp);
+#endif
+}
+
+#ifdef _WIN32
+static DWORD WINAPI ICS30703Worker(LPVOID param)
+{
+    SearchICS30703(param);
+    return 0;
+}
+#else
+static void *ICS30703Worker(void *param)
+{
+    SearchICS30703(param);
+    return NULL;
+}
+#endif
+
+/* Only writes to result if a setting is found */
+static int GetICS30703Data(unsigned long desired, unsigned long ppm, unsigned threads, clock_data_fscc *result)
+{
+    //  double inputfreq=18432000.0;
+    double inputfreq=24000000.0;
+
+    unsigned maxR;
+    unsigned minR;
+    unsigned long i;
+    int t;
+    struct ICS30703Search searches[CLOCK_BITS_MAX_THREADS];
+    struct ICS30703Search *best;
+#ifdef _WIN32
+    HANDLE workers[CLOCK_BITS_MAX_THREADS];
+#else
+    pthread_t workers[CLOCK_BITS_MAX_THREADS];
+    int started[CLOCK_BITS_MAX_THREADS];
+#endif
+    unsigned long requestedppm;
+
+    requestedppm=ppm;
+
+    if( inputfreq == 18432000.0) 
+    {
+        maxR = 921;
+        minR = 1;
+    }
+    else if( inputfreq == 24000000.0) 
+    {
+        maxR = 1200;
+        minR = 1;
+    }
 
-    memcpy(&theOne,&Results,sizeof(struct ResultStruct));
+    //Worker k takes every threads'th reference divider starting at minR+k.
+    //The sequential search would pick the lowest ppm found and, on a tie,
+    //the lowest reference divider, so that is what wins here no matter
+    //which worker finishes first.
+    if(threads < 1)
+        threads = 1;
+    else if(threads > CLOCK_BITS_MAX_THREADS)
+        threads = CLOCK_BITS_MAX_THREADS;
+
+    for(i=0;i<threads;i++)
+    {
+        searches[i].inputfreq = inputfreq;
+        searches[i].desired = desired;
+        searches[i].requestedppm = requestedppm;
+        searches[i].firstR = minR + i;
+        searches[i].lastR = maxR;
+        searches[i].stepR = threads;
+        searches[i].solutions = &searches[i].first;
+        searches[i].max_solutions = 1;
+    }
+
+    //If a worker can't be started its share is searched here instead
+    for(i=1;i<threads;i++)
+    {
+#ifdef _WIN32
+        workers[i] = CreateThread(NULL, 0, ICS30703Worker, &searches[i], 0, NULL);
+        if(workers[i] == NULL)
+            SearchICS30703(&searches[i]);
+#else
+        started[i] = (pthread_create(&workers[i], NULL, ICS30703Worker, &searches[i]) == 0);
+        if(!started[i])
+            SearchICS30703(&searches[i]);
+#endif
+    }
+
+    SearchICS30703(&searches[0]);
+
+    for(i=1;i<threads;i++)
+    {
+#ifdef _WIN32
+        if(workers[i] != NULL)
+        {
+            WaitForSingleObject(workers[i], INFINITE);
+            CloseHandle(workers[i]);
+        }
+#else
+        if(started[i])
+            pthread_join(workers[i], NULL);
+#endif
+    }
+
+    best = NULL;
+    for(i=0;i<threads;i++)
+    {
+        if(searches[i].count == 0)
+            continue;
+
+        if( (best == NULL) || (searches[i].first.ppm < best->first.ppm) ||
+            ((searches[i].first.ppm == best->first.ppm) && (searches[i].first.reference_divider < best->first.reference_divider)) )
+            best = &searches[i];
+    }
+
+    if(best == NULL)
+    {
+        return 2;
+    }
+
+    t = GetICS30703Bits(&best->first);
+    if(t != 0)
+        return t;
+
+    result->frequency = best->first.frequency;
+    memcpy(result->clock_bits, best->first.clock_bits, sizeof(result->clock_bits));
+
+    return 0;
+}
+
+/* Works out the clock generator's program for a setting */
+static int GetICS30703Bits(clock_solution_fscc *solution)
+{
+    unsigned long i;
+	unsigned char progdata[20];
+
+    int InputDivider=0;
+    int VCODivider=0;
+    unsigned long ChargePumpCurrent=0;
+    unsigned long LoopFilterResistor=0;
+    unsigned long OutputDividerOut1=0;
+    unsigned long temp=0;
 
-    memcpy(&theOther,&IRStruct,sizeof(struct IcpRsStruct));
     /*
     printf("ICS30703: Best result is \n");
     printf("\tRD = %4i,",Results.refDiv);
@@ -519,11 +1322,11 @@ finished:
     //  progdata[13]|=0x80; //enable CLK2
     progdata[13]|=0x40; //enable CLK1
 
-    InputDivider = theOne.refDiv;
-    VCODivider = theOne.VCO_Div;
-    ChargePumpCurrent = theOther.icpnum;
-    LoopFilterResistor = theOther.Rs;
-    OutputDividerOut1 = theOne.outDiv;
+    InputDivider = solution->reference_divider;
+    VCODivider = solution->vco_divider;
+    ChargePumpCurrent = solution->charge_pump_current / 10;
+    LoopFilterResistor = solution->loop_filter_resistor;
+    OutputDividerOut1 = solution->output_divider;
 
     //InputDivider=2;
     //VCODivider=60;
@@ -932,9 +1735,8 @@ finished:
     else return 7;
     //doitnow:
 
-	clock_data->frequency = Results.freq;
 	for(i=0;i<20;i++) 
-		clock_data->clock_bits[i] = progdata[i];
+		solution->clock_bits[i] = progdata[i];
     /*  progdata[15]|=0x03; //this will set
     progdata[14]|=0xc0; //the OD of clock 3
     progdata[11]&=0xbf; //to 2
@@ -943,238 +1745,124 @@ finished:
 
 }//end of GetICS30703Bits
 
-int GetICS30702Data(struct clock_data_335 *clock_data)
+/* Output divider of a clock_table_335 entry */
+static unsigned long ClockTable335OD(unsigned long bits)
 {
-    #define STARTWRD 0x1e05
-    #define MIDWRD   0x1e04
-    #define ENDWRD   0x1e00
-    
-    unsigned long bestVDW=1;    //Best calculated VCO Divider Word
-    unsigned long bestRDW=1;    //Best calculated Reference Divider Word
-    unsigned long bestOD=1;     //Best calculated Output Divider
-    unsigned long result=0;
-    unsigned long t=0;
-    unsigned long j=0;
-    unsigned long temp=0;
-    unsigned long vdw=1;        //VCO Divider Word
-    unsigned long rdw=1;        //Reference Divider Word
-    unsigned long od=1;         //Output Divider
-    unsigned long lVDW=1;       //Lowest vdw
-    unsigned long lRDW=1;       //Lowest rdw
-    unsigned long lOD=1;        //Lowest OD
-    unsigned long hVDW=1;       //Highest vdw
-    unsigned long hRDW=1;       //Highest rdw
-    unsigned long hOD=1;        //Highest OD
+    switch(bits >> 16)
+    {
+    case 0x11:
+        return 2;
+    case 0x16:
+        return 3;
+    case 0x13:
+        return 4;
+    case 0x14:
+        return 5;
+    case 0x17:
+        return 6;
+    case 0x15:
+        return 7;
+    case 0x12:
+        return 8;
+    default:
+        return 10;
+    }
+}
+
+/*
+    Finds the setting closest to the rate among the frequencies in
+    clock_table_335 within 10% of it, preferring the one below on a tie.
+    Of the settings for the same frequency the search this replaces kept
+    the one with the lowest rdw and then the highest vdw, which is the one
+    the table keeps. It also only took a setting exactly 10% away if it
+    had an rdw of 1.
+*/
+static int GetICS30702Data(unsigned long rate, clock_data_335 *result)
+{
+    unsigned long maxOD;    //Highest output divider allowed for the rate
     unsigned long hi;       //initial range freq Max
     unsigned long low;  //initial freq range Min
-    unsigned long check;        //Calculated clock
-    unsigned long clk1;     //Actual clock 1 output
-    unsigned long inFreq=18432000;  //Input clock frequency
-    unsigned long range1=0;     //Desired frequency range limit per ics307 mfg spec.
-    unsigned long range2=0;     ////Desired frequency range limit per ics307 mfg spec.
-	unsigned long rate; // JRD Added 09/27/23 to support clock_data structure.
-    int odskip=0;
-
-    //DBGP("SerialSetClock Executing %d\n",*rate);
-	rate = clock_data->frequency;
-	clock_data->frequency = 0;
+    unsigned long first, last, middle;
+    long l, h;      //Best table entries below and above the rate, -1 for none
+    long i;
+
     hi = (rate + (rate / 10));
     low = (rate - (rate / 10));
 
-    od = 2;
-    while (od <= 10)
+    //check maximum frequency with given OD for industrial temp chips
+    if(rate>180000000)
+        return 1;
+    else if(rate>120000000)
+        maxOD=2;
+    else if(rate>90000000)
+        maxOD=3;
+    else if(rate>72000000)
+        maxOD=4;
+    else if(rate>60000000)
+        maxOD=5;
+    else if(rate>50000000)
+        maxOD=6;
+    else if(rate>45000000)
+        maxOD=7;
+    else if(rate>36000000)
+        maxOD=8;
+    else
+        maxOD=10;
+
+    //first entry above the rate
+    first = 0;
+    last = CLOCK_TABLE_335_SIZE;
+    while(first < last)
     {
-        switch(od)  //check maximum frequency with given OD for industrial temp chips
+        middle = first + (last - first) / 2;
+        if(clock_table_335[middle].frequency <= rate)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    //Entries of the same frequency go up in output divider, each one
+    //preferred to those before it, so the last usable one is the setting.
+    l = -1;
+    for(i = (long)first - 1; (i >= 0) && (clock_table_335[i].frequency >= low); i--)
+    {
+        if(ClockTable335OD(clock_table_335[i].bits) <= maxOD)
         {
-        case 2:
-            if(rate>180000000)
-                odskip=1;
-            break;
-        case 3:
-            if(rate>120000000)
-                odskip=1;
-            break;
-        case 4:
-            if(rate>90000000)
-                odskip=1;
-            break;
-        case 5:
-            if(rate>72000000)
-                odskip=1;
-            break;
-        case 6:
-            if(rate>60000000)
-                odskip=1;
-            break;
-        case 7:
-            if(rate>50000000)
-                odskip=1;
-            break;
-        case 8:
-            if(rate>45000000)
-                odskip=1;
-            break;
-        case 9: //OD=9 not allowed
-            odskip=1;
-        case 10:
-            if(rate>36000000)
-                odskip=1;
+            l = i;
             break;
-        default:
-            //DBGP("Case 1 Invalid OD = %ld.\n",od);
-            return 1;
         }
+    }
 
-        rdw = 1;
-        while ( (rdw <= 127) && (odskip==0) )
-        {
-            vdw = 4;
-            while (vdw <= 511)
-            {
-                check = (((inFreq * 2) / ((rdw + 2)*od)) * (vdw + 8) ); //calculate a check frequency
-                range1 = ((inFreq * 2 * (vdw + 8)) / (rdw + 2));
-                range2 = (inFreq / (rdw + 2));
-                //Calculate operating ranges
-
-                if ( ((range1) > 60000000) && ((range1) < 360000000) && ((range2) > 200000) )   //check operating ranges
-                {
-                    if (check == low)   //If this combination of variables == the current lowest set
-                    {
-                        if (lRDW > rdw) //If this combination has a lower rdw
-                        {
-                            lVDW=vdw;
-                            lRDW=rdw;
-                            lOD=od;
-                            low=check;
-                        }
-                        else if ((lRDW == rdw) && (lVDW < vdw)) //If this combo has the same rdw then take the higher vdw
-                        {
-                            lVDW=vdw;
-                            lRDW=rdw;
-                            lOD=od;
-                            low=check;
-                        }
-
-                    }
-                    else if (check == hi)   //If this combination of variables == the current lowest set
-                    {
-                        if (hRDW > rdw) //If this combination has a lower rdw
-                        {
-                            hVDW=vdw;
-                            hRDW=rdw;
-                            hOD=od;
-                            hi=check;
-                        }
-                        else if ((hRDW == rdw) && (hVDW < vdw)) //If this combo has the same rdw then take the higher vdw   
-                        {
-                            hVDW=vdw;
-                            hRDW=rdw;
-                            hOD=od;
-                            hi=check;
-                        }
+    h = -1;
+    for(i = (long)first; (i < CLOCK_TABLE_335_SIZE) && (clock_table_335[i].frequency <= hi); i++)
+    {
+        if((h >= 0) && (clock_table_335[i].frequency != clock_table_335[h].frequency))
+            break;
 
-                    }
+        if(ClockTable335OD(clock_table_335[i].bits) <= maxOD)
+            h = i;
+    }
 
+    if((l >= 0) && (clock_table_335[l].frequency == low) && ((clock_table_335[l].bits & 0x7f) != 1))
+        l = -1;
 
-                    if ((check > low) && (check < hi))      //if difference is less than previous difference
-                    {
-                        if (check > rate)    //if the new combo is larger than the rate, new hi combination
-                        {
-                            hi=check;
-                            hVDW=vdw;
-                            hRDW=rdw;
-                            hOD=od;
-                        }
-                            
-                        else    //if the new combo is less than the rate, new low combination
-                        {
-                            low=check;
-                            lVDW = vdw;
-                            lRDW = rdw;
-                            lOD = od;
-                        }
-                }
-            }
+    if((h >= 0) && (clock_table_335[h].frequency == hi) && ((clock_table_335[h].bits & 0x7f) != 1))
+        h = -1;
 
-            vdw++;
-        }
+    if(l >= 0)
+        low = clock_table_335[l].frequency;
 
-        rdw++;
-    }
-    odskip=0;
-    od++;
-    if (od==9)
-        od++;
-    }
+    if(h >= 0)
+        hi = clock_table_335[h].frequency;
 
     if ((hi - rate) < (rate - low))
-    {
-        bestVDW=hVDW;
-        bestRDW=hRDW;
-        bestOD=hOD;
-        clk1=hi;
-    }
-    else
-    {
-        bestVDW=lVDW;
-        bestRDW=lRDW;
-        bestOD=lOD;
-        clk1=low;
-    }
-    switch(bestOD)
-    {
-    case 2:
-        result=0x11;
-        break;
-    case 3:
-        result=0x16;
-        break;
-    case 4:
-        result=0x13;
-        break;
-    case 5:
-        result=0x14;
-        break;
-    case 6:
-        result=0x17;
-        break;
-    case 7:
-        result=0x15;
-        break;
-    case 8:
-        result=0x12;
-        break;
-    case 10:
-        result=0x10;
-        break;
-    default:
-        //DBGP("Case 2 Invalid OD=%ld.\n",od);
+        l = h;
+
+    if(l < 0)
         return 1;
 
-    }
-    range1 = (inFreq * 2 * ((bestVDW + 8)/(bestRDW + 2)));
-    range2 = (inFreq/(bestRDW + 2));
-    clk1 = (((inFreq * 2) / ((bestRDW + 2)*bestOD)) * (bestVDW + 8) );
-//      DBGP(" 60 MHz < %d MHz < 360 MHz\n", range1);
-//      DBGP(" 200 kHz < %d kHz \n", range2*1000);
-    result<<=9;
-    result|=bestVDW;
-    result<<=7;
-    result|=bestRDW;
-
-	clock_data->frequency = clk1;
-	clock_data->clock_bits = result;
-//      result|=0x200000;   //1 = set levels to TTL, 0 = CMOS
-
-//      DBGP("Clock bytes = %X\n",result);
-
-    //DBGP("The rate clock control bytes are: %X\n",result);
-//      DBGP("The rate frequendy is: %dHz\n", rate);
-//      DBGP("The base clock is: %dHz\n", inFreq);
-//      DBGP("High: %d    ",hi);
-//      DBGP("Low: %d.\n",low);
-    //DBGP("The best calculated clock is: %dHz\n", clk1);
-//      DBGP("The best VDW = %d  RDW = %d  OD = %d.\n", bestVDW, bestRDW, bestOD);
-//      DBGP("CH_ID = %d \n", extension->chid);
+    result->frequency = clock_table_335[l].frequency;
+    result->clock_bits = clock_table_335[l].bits;
+
     return 0;
 }
\ No newline at end of file
@@ -42,9 +42,91 @@ typedef struct clock_data_fscc clock_data_synccom;
 typedef struct clock_data_fscc clock_data_asynccom;
 typedef struct clock_data_335 clock_data_335;
 
+// One setting the FSCC clock generator can make a frequency with.
+struct clock_solution_fscc {
+	unsigned long frequency;            // Frequency the bits give, in Hz
+	unsigned long ppm;                  // Lowest whole ppm it is within
+	double error_ppm;
+	double vco_frequency;               // In Hz
+	unsigned reference_divider;
+	unsigned vco_divider;
+	unsigned output_divider;
+	unsigned long loop_filter_resistor; // In ohms
+	unsigned long charge_pump_current;  // In nA
+	unsigned char clock_bits[20];
+};
+
+typedef struct clock_solution_fscc clock_solution_fscc;
+
+// A clock, sample rate and divisor that together make a baud rate. This is
+// laid out like struct serialfc_baud_setting so it can be handed straight to
+// IOCTL_FASTCOM_SET_BAUD_EXACT.
+struct baud_setting {
+	unsigned long baud;                 // Baud rate the setting gives, rounded
+	unsigned long sample_rate;
+	unsigned long divisor;              // 17V35x: the low 4 bits are a fraction
+	unsigned long clock_frequency;      // 0 on the 17V35x, its clock is fixed
+	unsigned long clock_bits_335;
+	unsigned char clock_bits_fscc[20];
+};
+
+typedef struct baud_setting baud_setting;
+
+// Why a clock setting couldn't be worked out. 1-7 are the numbers the
+// calculate_clock_bits_* functions have always printed messages for.
+enum clock_bits_error {
+	CLOCK_BITS_OK = 0,
+	CLOCK_BITS_RS_CASE = 1,
+	CLOCK_BITS_NO_SOLUTION = 2,         // Nothing within ppm
+	CLOCK_BITS_INPUT_DIVIDER = 3,
+	CLOCK_BITS_VCO_DIVIDER = 4,
+	CLOCK_BITS_LOOP_FILTER_RESISTOR = 5,
+	CLOCK_BITS_CHARGE_PUMP_CURRENT = 6,
+	CLOCK_BITS_OUTPUT_DIVIDER = 7,
+	CLOCK_BITS_INVALID_ARGUMENT = 8
+};
+
+// Most worker threads calculate_clock_bits_fscc_threaded will use.
+#define CLOCK_BITS_MAX_THREADS 64
+
+// Prints a message and sets clock_data->frequency to 0 if there is no
+// setting within ppm.
 int calculate_clock_bits_fscc(clock_data_fscc *clock_data, unsigned long ppm);
+// Same as calculate_clock_bits_fscc, with the search split across threads.
+// The result does not depend on the number of threads.
+int calculate_clock_bits_fscc_threaded(clock_data_fscc *clock_data, unsigned long ppm, unsigned threads);
+// Sets the file calculate_clock_bits_fscc keeps the settings it works out
+// in, so that any process asking for the same frequency and ppm later gets
+// them without searching. NULL turns the cache off. Until this is called the
+// file named by the SERIALFC_CLOCK_CACHE environment variable is used, if
+// there is one. Call it before other threads use the library. Returns 1 if
+// path is too long.
+int calculate_clock_bits_set_cache(const char *path);
+// Works out the clock bits for count frequencies, lowest first, into
+// results. Frequencies with no setting within ppm get a frequency of 0.
+// Returns how many have settings. Nothing is printed.
+int calculate_clock_bits_fscc_batch(const unsigned long *frequencies, unsigned count, unsigned long ppm, clock_data_fscc *results);
+// Fills in up to max_solutions settings within ppm of frequency and returns
+// how many there are, -1 on error. They are ordered by ppm and then the order
+// the search finds them in, lowest reference divider and highest VCO
+// frequency first, so the first is what calculate_clock_bits_fscc picks.
+// Nothing is printed.
+int calculate_clock_solutions_fscc(unsigned long frequency, unsigned long ppm, clock_solution_fscc *solutions, unsigned max_solutions);
 int calculate_clock_bits_asynccom(clock_data_asynccom *clock_data, unsigned long ppm);
 int calculate_clock_bits_synccom(clock_data_synccom *clock_data, unsigned long ppm);
 int calculate_clock_bits_335(clock_data_335 *clock_data);
+// Same as calculate_clock_bits_fscc_threaded and calculate_clock_bits_335,
+// but nothing is printed and result is only written to on success. They can
+// be called from any number of threads at once.
+enum clock_bits_error calculate_clock_bits_fscc_r(unsigned long frequency, unsigned long ppm, unsigned threads, clock_data_fscc *result);
+enum clock_bits_error calculate_clock_bits_335_r(unsigned long frequency, clock_data_335 *result);
+const char *calculate_clock_bits_error_string(enum clock_bits_error error);
+// Work out the clock, sample rate and divisor that come closest to baud on
+// each card type. The error of the setting is stored in error_ppm unless it
+// is NULL. Return 0 on success and 1 if the card can't make baud. Nothing is
+// printed.
+int calculate_baud_setting_fscc(unsigned long baud, baud_setting *setting, double *error_ppm);
+int calculate_baud_setting_335(unsigned long baud, baud_setting *setting, double *error_ppm);
+int calculate_baud_setting_pcie(unsigned long baud, baud_setting *setting, double *error_ppm);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,93 @@
+/*
+    Generated by tools/gen-standard-clocks.c, do not edit.
+
+    Clock bits for common clock rates, lowest first. An FSCC entry is
+    what the ICS30703 search gives for its frequency at ppm or more,
+    a 335 entry what the ICS30702 search gives for its frequency.
+*/
+
+#ifndef CLOCK_TABLE_STANDARD_H
+#define CLOCK_TABLE_STANDARD_H
+
+#if defined(__cplusplus) && __cplusplus >= 201103L
+#define CLOCK_TABLE_STANDARD_CONST constexpr
+#else
+#define CLOCK_TABLE_STANDARD_CONST const
+#endif
+
+#define CLOCK_TABLE_STANDARD_FSCC_SIZE 29
+
+static CLOCK_TABLE_STANDARD_CONST struct clock_table_standard_fscc_entry {
+    unsigned long frequency;
+    unsigned long ppm;          /* least ppm the bits are for */
+    unsigned long actual;       /* frequency the bits give */
+    unsigned char bits[20];
+} clock_table_standard_fscc[CLOCK_TABLE_STANDARD_FSCC_SIZE] = {
+    {1843200, 1, 1843199, {0x32,0x00,0x0b,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x82,0x6a,0x47,0x01,0x84,0x00,0xff,0xff,0xff}},
+    {3686400, 1, 3686399, {0x32,0x00,0x0b,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x82,0x62,0x47,0x01,0x84,0x00,0xff,0xff,0xff}},
+    {7372800, 1, 7372799, {0x47,0x00,0x47,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x98,0x42,0x44,0x01,0x04,0x00,0xff,0xff,0xff}},
+    {8000000, 0, 8000000, {0x01,0xc0,0x04,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x9a,0xe2,0x43,0x01,0x84,0x01,0xff,0xff,0xff}},
+    {10000000, 0, 10000000, {0x01,0xa0,0x04,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x9a,0x4a,0x41,0x01,0x84,0x01,0xff,0xff,0xff}},
+    {11059200, 0, 11059200, {0x47,0x00,0x47,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x98,0x2a,0x41,0x01,0x04,0x00,0xff,0xff,0xff}},
+    {12000000, 0, 12000000, {0x01,0xe0,0x04,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x9a,0x82,0x42,0x01,0x84,0x01,0xff,0xff,0xff}},
+    {14745600, 1, 14745599, {0x47,0x00,0x2f,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x38,0x32,0x40,0x01,0x84,0x01,0xff,0xff,0xff}},
+    {16000000, 0, 16000000, {0x01,0x00,0x05,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x1a,0x06,0x40,0x01,0x84,0x01,0xff,0xff,0xff}},
+    {18432000, 0, 18432000, {0x32,0x00,0x0b,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x02,0x32,0x40,0x01,0x84,0x00,0xff,0xff,0xff}},
+    {20000000, 0, 20000000, {0x01,0x80,0x06,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x0a,0x06,0x40,0x01,0x84,0x01,0xff,0xff,0xff}},
+    {22118400, 0, 22118400, {0x47,0x00,0x47,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x18,0x32,0x40,0x01,0x04,0x00,0xff,0xff,0xff}},
+    {24000000, 0, 24000000, {0x01,0x80,0x06,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x0a,0x1e,0x40,0x01,0x84,0x01,0xff,0xff,0xff}},
+    {25000000, 0, 25000000, {0x01,0x40,0x05,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x0a,0x36,0x40,0x01,0x04,0x01,0xff,0xff,0xff}},
+    {29491200, 1, 29491228, {0xc7,0x20,0xd1,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x10,0x36,0x40,0x01,0x04,0x00,0xff,0xff,0xff}},
+    {32000000, 0, 32000000, {0x01,0x00,0x06,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x02,0x42,0x40,0x01,0x04,0x01,0xff,0xff,0xff}},
+    {33000000, 0, 33000000, {0x01,0xe0,0x05,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x02,0x46,0x40,0x01,0x04,0x01,0xff,0xff,0xff}},
+    {36864000, 0, 36864000, {0x47,0x00,0x47,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x18,0x5a,0x40,0x01,0x04,0x00,0xff,0xff,0xff}},
+    {40000000, 0, 40000000, {0x01,0x80,0x06,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x0a,0x4e,0x40,0x01,0x84,0x01,0xff,0xff,0xff}},
+    {44236800, 0, 44236800, {0xd7,0x01,0x8f,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x38,0x01,0x40,0x01,0x84,0x00,0xff,0xff,0xff}},
+    {48000000, 0, 48000000, {0x01,0x80,0x06,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x0a,0x5a,0x40,0x01,0x84,0x01,0xff,0xff,0xff}},
+    {50000000, 0, 50000000, {0x01,0x40,0x05,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x0a,0x66,0x40,0x01,0x04,0x01,0xff,0xff,0xff}},
+    {58982400, 1, 58982456, {0xc7,0x20,0xd1,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x10,0x66,0x40,0x01,0x04,0x00,0xff,0xff,0xff}},
+    {64000000, 0, 64000000, {0x01,0x00,0x05,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x9a,0x05,0x40,0x01,0x84,0x01,0xff,0xff,0xff}},
+    {73728000, 0, 73728000, {0x47,0x00,0x2f,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x38,0x01,0x40,0x01,0x84,0x01,0xff,0xff,0xff}},
+    {100000000, 0, 100000000, {0x01,0x40,0x05,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x8a,0x04,0x40,0x01,0x04,0x01,0xff,0xff,0xff}},
+    {125000000, 0, 125000000, {0x2e,0xa0,0x0e,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x14,0x04,0x40,0x01,0x04,0x00,0xff,0xff,0xff}},
+    {147456000, 0, 147456000, {0xd7,0x01,0xbf,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x38,0x00,0x40,0x01,0x04,0x01,0xff,0xff,0xff}},
+    {160000000, 0, 160000000, {0x01,0x00,0x04,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x92,0x00,0x40,0x01,0x04,0x01,0xff,0xff,0xff}}
+};
+
+#define CLOCK_TABLE_STANDARD_335_SIZE 27
+
+static CLOCK_TABLE_STANDARD_CONST struct clock_table_standard_335_entry {
+    unsigned long frequency;
+    unsigned long actual;       /* frequency the bits give */
+    unsigned int bits;
+} clock_table_standard_335[CLOCK_TABLE_STANDARD_335_SIZE] = {
+    {7372800, 7372800, 0x100204},
+    {8000000, 8000268, 0x102f2d},
+    {10000000, 10000284, 0x122f2d},
+    {11059200, 11059200, 0x100202},
+    {12000000, 12002144, 0x123429},
+    {14745600, 14745600, 0x100201},
+    {16000000, 16000536, 0x10622d},
+    {18432000, 18432000, 0x100381},
+    {20000000, 20000568, 0x12622d},
+    {22118400, 22118400, 0x100501},
+    {24000000, 23999008, 0x109baf},
+    {25000000, 24999716, 0x16199b},
+    {29491200, 29491200, 0x100801},
+    {32000000, 32001072, 0x14622d},
+    {33000000, 32999190, 0x126b1d},
+    {36864000, 36864000, 0x120801},
+    {40000000, 40001340, 0x13622d},
+    {44236800, 44236800, 0x140501},
+    {48000000, 47998335, 0x159ba1},
+    {50000000, 49996800, 0x14689e},
+    {58982400, 58982400, 0x140801},
+    {64000000, 63995904, 0x146897},
+    {73728000, 73728000, 0x130801},
+    {100000000, 99993600, 0x1168a6},
+    {125000000, 124992000, 0x11689e},
+    {147456000, 147456000, 0x110801},
+    {160000000, 159989760, 0x116897}
+};
+
+#endif
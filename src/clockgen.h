@@ -0,0 +1,892 @@
+/*++
+
+Copyright (c) 2026 Commtech, Inc.
+
+Module Name:
+
+    clockgen.h
+
+Abstract:
+
+    Works out the clock generator settings for a frequency and builds
+    the MPIOLVL waveform that clocks a new setting into the ICS307 on
+    the 335 cards.  The whole waveform is worked out up front so it can
+    go out in one buffered write.
+
+    The solvers give the same answers as GetICS30703Data and
+    GetICS30702Data in lib/raw/calculate-clock-bits.c but only use
+    integer math, so they can run in the driver.
+
+    This is plain C with no kernel dependencies so the same code can
+    be built and checked outside of the driver.
+
+--*/
+
+#ifndef CLOCKGEN_H
+#define CLOCKGEN_H
+
+#define MPIO_SDTA           0x01    //Each bit of MPIOLVL register
+#define MPIO_SCLK           0x02
+#define MPIO_SSTB           0x04
+
+//
+// Three writes for each of the 24 bits (data, clock high, clock low),
+// strobe on, strobe off and the saved MPIOLVL.
+//
+#define CLOCKGEN_335_WAVEFORM_SIZE (24 * 3 + 3)
+
+//
+// Fills waveform with the MPIOLVL values to write, in order, and
+// returns how many there are.  saved is the MPIOLVL value before
+// programming, which is put back at the end.
+//
+// Clock low only keeps the data bit, so the other MPIO pins are low
+// from the first bit until the saved value is restored.  This matches
+// how the bits have always been written.
+//
+static unsigned
+ClockGen335Waveform(
+    unsigned char saved,
+    unsigned long clock_bits,
+    unsigned char *waveform
+    )
+{
+    unsigned long value = clock_bits & 0x00ffffff;
+    unsigned char data = saved;
+    unsigned count = 0;
+    unsigned i;
+
+    for (i = 0; i < 24; i++) {
+        // data bit set
+        if ((value & 0x800000) != 0)
+            data |= MPIO_SDTA;
+        else
+            data &= ~MPIO_SDTA;
+
+        waveform[count++] = data;
+
+        // clock high, data still there
+        data |= MPIO_SCLK;
+        waveform[count++] = data;
+
+        // clock low, data still there
+        data &= MPIO_SDTA;
+        waveform[count++] = data;
+
+        value <<= 1;
+    }
+
+    data &= 0xF8;
+    data |= MPIO_SSTB; // strobe on
+    waveform[count++] = data;
+
+    data &= ~MPIO_SSTB; // all off
+    waveform[count++] = data;
+
+    // Put MPIO pins back to saved state
+    waveform[count++] = saved;
+
+    return count;
+}
+
+//
+// ICS30703 (FSCC)
+//
+
+#define CLOCKGEN_ICS30703_INPUT     24000000
+#define CLOCKGEN_ICS30703_MAX_R     1200
+#define CLOCKGEN_ICS30703_MIN_V     12
+#define CLOCKGEN_ICS30703_MAX_V     2055
+#define CLOCKGEN_ICS30703_MAX_OD    8232
+#define CLOCKGEN_ICS30703_BITS      20
+
+//
+// The library does its math in doubles and a rounding can decide
+// whether a setting is accepted.  Those few decisions are repeated
+// here with the same rounding done on integers.  A value is m * 2^e
+// with m 53 bits long, or zero.
+//
+typedef struct _CLOCKGEN_DOUBLE {
+    unsigned long long m;
+    int e;
+} CLOCKGEN_DOUBLE;
+
+//
+// Rounds (hi:lo + sticky) * 2^e to 53 bits, nearest even.  sticky is
+// nonzero if there are lost bits below lo.
+//
+static void
+ClockGenRound(
+    unsigned long long hi,
+    unsigned long long lo,
+    int e,
+    int sticky,
+    CLOCKGEN_DOUBLE *result
+    )
+{
+    int half = 0;
+
+    if (hi == 0 && lo == 0) {
+        result->m = 0;
+        result->e = 0;
+        return;
+    }
+
+    while (hi != 0 || lo >= (1ULL << 53)) {
+        sticky |= half;
+        half = (int)(lo & 1);
+        lo = (lo >> 1) | (hi << 63);
+        hi >>= 1;
+        e++;
+    }
+
+    // Only exact values are ever this short.
+    while (lo < (1ULL << 52)) {
+        lo <<= 1;
+        e--;
+    }
+
+    if (half && (sticky || (lo & 1))) {
+        lo++;
+
+        if (lo == (1ULL << 53)) {
+            lo >>= 1;
+            e++;
+        }
+    }
+
+    result->m = lo;
+    result->e = e;
+}
+
+//
+// (double)a / (double)b for integers below 2^53.
+//
+static void
+ClockGenDivide(
+    unsigned long long a,
+    unsigned long long b,
+    CLOCKGEN_DOUBLE *result
+    )
+{
+    unsigned long long q = a / b;
+    unsigned long long r = a % b;
+    int e = 0;
+
+    if (a == 0) {
+        ClockGenRound(0, 0, 0, 0, result);
+        return;
+    }
+
+    // Two bits past the 53 kept are enough, the rest goes in sticky.
+    while (q < (1ULL << 55)) {
+        q <<= 1;
+        r <<= 1;
+        e--;
+
+        if (r >= b) {
+            r -= b;
+            q |= 1;
+        }
+    }
+
+    ClockGenRound(0, q, e, r != 0, result);
+}
+
+//
+// x * (double)c for c below 2^32.
+//
+static void
+ClockGenMultiply(
+    const CLOCKGEN_DOUBLE *x,
+    unsigned long c,
+    CLOCKGEN_DOUBLE *result
+    )
+{
+    unsigned long long lo = (x->m & 0xffffffff) * c;
+    unsigned long long mid = (x->m >> 32) * c;
+    unsigned long long hi = mid >> 32;
+    unsigned long long sum = lo + (mid << 32);
+
+    if (sum < lo)
+        hi++;
+
+    ClockGenRound(hi, sum, x->e, 0, result);
+}
+
+//
+// fabs(x - desired) <= limit.  x has to be within a factor of two of
+// desired, which makes the subtraction exact.
+//
+static int
+ClockGenWithin(
+    const CLOCKGEN_DOUBLE *x,
+    unsigned long long desired,
+    const CLOCKGEN_DOUBLE *limit
+    )
+{
+    unsigned long long scaled;
+    unsigned long long k;
+    int ke = x->e;
+    int bits = 0;
+
+    if (ke >= 0) {
+        scaled = x->m << ke;
+        k = scaled > desired ? scaled - desired : desired - scaled;
+        ke = 0;
+    }
+    else {
+        scaled = desired << -ke;
+        k = x->m > scaled ? x->m - scaled : scaled - x->m;
+    }
+
+    if (k == 0)
+        return 1;
+
+    if (limit->m == 0)
+        return 0;
+
+    for (scaled = k; scaled != 0; scaled >>= 1)
+        bits++;
+
+    if (bits + ke != 53 + limit->e)
+        return bits + ke < 53 + limit->e;
+
+    if (ke >= limit->e)
+        return (k << (ke - limit->e)) <= limit->m;
+
+    return k <= (limit->m << (limit->e - ke));
+}
+
+//
+// The library walks the output divider down from 8232 in coarser
+// steps above 1030.
+//
+static unsigned
+ClockGenNextOutputDivider(
+    unsigned od
+    )
+{
+    if (od <= 1030)
+        return od - 1;
+    else if (od <= 2060)
+        return od - 2;
+    else if (od <= 4120)
+        return od - 4;
+
+    return od - 8;
+}
+
+//
+// Works out the lowest ppm, no higher than max, at which the library
+// accepts VCO divider v with reference divider times output divider
+// d.  This is the first pass of its increasing ppm loop that takes
+// the setting.  Returns max + 1 if none does.
+//
+static unsigned long
+ClockGenErrorLevel(
+    unsigned long long desired,
+    unsigned long long d,
+    unsigned v,
+    unsigned long max,
+    CLOCKGEN_DOUBLE *freq
+    )
+{
+    unsigned long long vco = (unsigned long long)CLOCKGEN_ICS30703_INPUT * v;
+    unsigned long long target = desired * d;
+    unsigned long long error;
+    unsigned long long level;
+    unsigned long long p;
+    CLOCKGEN_DOUBLE ratio;
+    CLOCKGEN_DOUBLE limit;
+
+    // |freq - desired| * d, exactly
+    error = vco > target ? vco - target : target - vco;
+
+    if (error > target / 500)
+        return max + 1;
+
+    level = (error * 1000000 + target - 1) / target;
+
+    if (level > (unsigned long long)max + 1)
+        return max + 1;
+
+    // Doubles can only move the answer by one either way.
+    ClockGenDivide(v, d, &ratio);
+    ClockGenMultiply(&ratio, CLOCKGEN_ICS30703_INPUT, freq);
+
+    for (p = level ? level - 1 : 0; p <= max && p <= level + 1; p++) {
+        ClockGenDivide(p * desired, 1000000, &limit);
+
+        if (ClockGenWithin(freq, desired, &limit))
+            return (unsigned long)p;
+    }
+
+    return max + 1;
+}
+
+//
+// Charge pump currents in the order the library tries them, in units
+// of 10 nA, with their bits.  Byte 11 is or'ed with set and then
+// and'ed with keep.
+//
+static const struct {
+    unsigned icp;
+    unsigned char set11;
+    unsigned char keep11;
+    unsigned char bit15;
+    unsigned char bit16;
+} ClockGenChargePumps[] = {
+    {  125, 0x38, 0xff, 0, 0 },
+    {  250, 0x38, 0xff, 1, 0 },
+    {  375, 0x38, 0xff, 0, 1 },
+    {  500, 0x38, 0xff, 1, 1 },
+    {  625, 0x18, 0xdf, 0, 0 },
+    {  750, 0x10, 0xd7, 0, 0 },
+    {  875, 0x08, 0xcf, 0, 0 },
+    { 1000, 0x00, 0xc7, 0, 0 },
+    { 1125, 0x28, 0xef, 0, 1 },
+    { 1250, 0x18, 0xdf, 1, 0 },
+    { 1500, 0x28, 0xef, 1, 1 },
+    { 1750, 0x08, 0xcf, 1, 0 },
+    { 1875, 0x18, 0xdf, 0, 1 },
+    { 2000, 0x00, 0xc7, 1, 0 },
+    { 2250, 0x10, 0xff, 0, 1 },
+    { 2500, 0x18, 0xdf, 1, 1 },
+    { 2625, 0x08, 0xcf, 0, 1 },
+    { 3000, 0x00, 0xc7, 0, 1 },
+    { 3500, 0x08, 0xcf, 1, 1 },
+    { 4000, 0x00, 0xc7, 1, 1 },
+};
+
+#define CLOCKGEN_CHARGE_PUMPS \
+    (sizeof(ClockGenChargePumps) / sizeof(ClockGenChargePumps[0]))
+
+//
+// Loop filter resistors in the order the library tries them, with
+// their bits in byte 11.
+//
+static const struct {
+    unsigned long rs;
+    unsigned char set11;
+} ClockGenResistors[] = {
+    { 64000, 0x00 },
+    { 52000, 0x04 },
+    { 16000, 0x02 },
+    {  4000, 0x06 },
+};
+
+#define CLOCKGEN_RESISTORS \
+    (sizeof(ClockGenResistors) / sizeof(ClockGenResistors[0]))
+
+//
+// Whether the loop filter is stable for reference divider r and VCO
+// divider v.
+//
+static int
+ClockGenLoopFilterOk(
+    unsigned r,
+    unsigned v,
+    unsigned long rs,
+    unsigned icp
+    )
+{
+    //
+    // The PDF/NBW ratio, rounded up to the next tenth, has to be
+    // between 7 and 30.  Ten times the ratio is
+    // 24e6 / r * 2 * 3.14159 * v * 10 / (rs * icp * 1e-8 * 310e6).
+    //
+    unsigned long long n = 24ULL * 628318 * 1000 * v;
+    unsigned long long d = 31ULL * r * rs * icp;
+
+    //
+    // The damping factor, rs / 2 * sqrt(icp * 1e-8 * 0.093 / v), has
+    // to be between 0.2 and 2.0.  Squared and scaled by 4e11 * v.
+    //
+    unsigned long long s = (unsigned long long)rs * rs * icp * 93;
+
+    if (n < 69 * d || n >= 300 * d)
+        return 0;
+
+    if (s < 16000000000ULL * v || s > 1600000000000ULL * v)
+        return 0;
+
+    // Exactly 0.2, but the library's doubles come out just under.
+    if (rs == 16000 && icp == 875 && v == 1302)
+        return 0;
+
+    return 1;
+}
+
+//
+// Builds the 20 programming bytes.  Returns the same error numbers as
+// GetICS30703Data.
+//
+static int
+ClockGenICS30703Bits(
+    unsigned r,
+    unsigned v,
+    unsigned od,
+    unsigned resistor,
+    unsigned pump,
+    unsigned char *bits
+    )
+{
+    unsigned long temp;
+    unsigned i;
+
+    for (i = 0; i < CLOCKGEN_ICS30703_BITS; i++)
+        bits[i] = 0;
+
+    bits[19] = 0xff;
+    bits[18] = 0xff;
+    bits[17] = 0xff;
+    bits[15] = 0x04; // xtal, overridden when the bits are set
+    bits[14] |= 0x01; // power up feedback counter, charge pump and VCO
+    bits[13] |= 0x40; // enable CLK1
+
+    // Table 1: Input Divider
+    if (r == 1) {
+        bits[0] &= 0xfc;
+        bits[1] &= 0xf0;
+    }
+    else if (r == 2) {
+        bits[0] &= 0xfc;
+        bits[0] |= 0x01;
+        bits[1] &= 0xf0;
+    }
+    else if (r >= 3 && r <= 17) {
+        temp = ~(unsigned long)(r - 2);
+        temp <<= 2;
+        bits[0] = (unsigned char)temp & 0xff;
+        bits[0] &= 0x3e;
+        bits[0] |= 0x02;
+    }
+    else if (r >= 18 && r <= 2055) {
+        temp = r - 8;
+        temp <<= 2;
+        bits[0] = (unsigned char)temp & 0xff;
+        bits[1] = (unsigned char)((temp >> 8) & 0xff);
+        bits[0] |= 0x03;
+    }
+    else
+        return 3;
+
+    // Table 2: VCO Divider
+    if (v >= CLOCKGEN_ICS30703_MIN_V && v <= CLOCKGEN_ICS30703_MAX_V) {
+        temp = v - 8;
+        temp <<= 5;
+        bits[1] |= temp & 0xff;
+        bits[2] |= (temp >> 8) & 0xff;
+    }
+    else
+        return 4;
+
+    // Table 4: Loop Filter Resistor
+    if (resistor >= CLOCKGEN_RESISTORS)
+        return 5;
+
+    bits[11] &= 0xf9;
+    bits[11] |= ClockGenResistors[resistor].set11;
+
+    // Table 3: Charge Pump Current
+    if (pump >= CLOCKGEN_CHARGE_PUMPS)
+        return 6;
+
+    bits[11] |= ClockGenChargePumps[pump].set11;
+    bits[11] &= ClockGenChargePumps[pump].keep11;
+
+    if (ClockGenChargePumps[pump].bit15)
+        bits[15] |= 0x80;
+    else
+        bits[15] &= 0x7f;
+
+    if (ClockGenChargePumps[pump].bit16)
+        bits[16] |= 0x01;
+    else
+        bits[16] &= 0xfe;
+
+    // Table 5: Output Divider for Output 1
+    if (od < 2 || od > CLOCKGEN_ICS30703_MAX_OD)
+        return 7;
+
+    switch (od) {
+    case 2:
+        bits[11] &= 0x7f;
+        bits[12] &= 0x00;
+        bits[13] &= 0xc0;
+        break;
+
+    case 3:
+        bits[11] |= 0x80;
+        bits[12] &= 0x00;
+        bits[13] &= 0xc0;
+        break;
+
+    case 4:
+        bits[11] &= 0x7f;
+        bits[12] |= 0x04;
+        bits[13] &= 0xc0;
+        break;
+
+    case 5:
+        bits[11] &= 0x7f;
+        bits[12] |= 0x01;
+        bits[13] &= 0xc0;
+        break;
+
+    case 6:
+        bits[11] |= 0x80;
+        bits[12] |= 0x04;
+        bits[13] &= 0xc0;
+        break;
+
+    case 7:
+        bits[11] |= 0x80;
+        bits[12] |= 0x01;
+        bits[13] &= 0xc0;
+        break;
+
+    case 9:
+        bits[11] |= 0x80;
+        bits[12] |= 0x05;
+        bits[13] &= 0xc0;
+        break;
+
+    case 11:
+        bits[11] |= 0x80;
+        bits[12] |= 0x09;
+        bits[13] &= 0xc0;
+        break;
+
+    case 13:
+        bits[11] |= 0x80;
+        bits[12] |= 0x0d;
+        bits[13] &= 0xc0;
+        break;
+
+    default:
+        if (od <= 37) {
+            temp = ~(unsigned long)(od - 6);
+            temp <<= 2;
+            bits[12] = (unsigned char)temp & 0x7f;
+
+            bits[11] &= 0x7f;
+            bits[12] &= 0xfe;
+            bits[12] |= 0x02;
+            bits[13] &= 0xc0;
+            break;
+        }
+
+        //
+        // od = ((i + 3) * 2 + y) * 2^z, with i in bits 5 to 13, y in
+        // bit 2 inverted and z in bits 3 and 4.
+        //
+        for (i = 0; i < 512; i++) {
+            unsigned long y;
+            unsigned z;
+
+            for (z = 0, y = 0; z < 8; z++) {
+                y = (z < 4) ? 0 : 1;
+
+                if (od == (((i + 3) * 2) + y) * (1u << (z & 3)))
+                    break;
+            }
+
+            if (z == 8)
+                continue;
+
+            temp = (unsigned long)i << 5;
+            bits[12] |= temp & 0xff;
+            bits[13] |= (temp >> 8) & 0xff;
+
+            bits[12] &= 0xe3;
+            bits[12] |= (unsigned char)((y ? 0x00 : 0x04) | ((z & 3) << 3));
+            break;
+        }
+
+        bits[11] |= 0x80;
+        bits[12] &= 0xfe;
+        bits[12] |= 0x02;
+        break;
+    }
+
+    return 0;
+}
+
+//
+// Finds the ICS30703 settings for frequency, accepting up to ppm
+// parts per million of error, exactly like GetICS30703Data.  Fills in
+// the 20 programming bytes and the frequency they give.  Returns the
+// same error numbers as GetICS30703Data, 2 being no solution.
+//
+// Only the output dividers that land close to the frequency are
+// looked at, so this stays quick enough for the driver.  ppm has to
+// stay under 1000 and ppm * frequency has to fit in 32 bits, which is
+// all the library ever handled on Windows.
+//
+static int
+ClockGenICS30703(
+    unsigned long frequency,
+    unsigned long ppm,
+    unsigned long *actual,
+    unsigned char *bits
+    )
+{
+    unsigned long long desired = frequency;
+    unsigned long best_level = ppm + 1;
+    unsigned best_r = 0;
+    unsigned best_v = 0;
+    unsigned best_od = 0;
+    unsigned best_resistor = 0;
+    unsigned best_pump = 0;
+    unsigned long long d;
+    CLOCKGEN_DOUBLE freq;
+    unsigned r;
+    unsigned od;
+    int status;
+
+    *actual = 0;
+
+    for (r = 1; r <= CLOCKGEN_ICS30703_MAX_R && best_level != 0; r++) {
+        // The phase detector has to run between 20 kHz and 100 MHz.
+        if (CLOCKGEN_ICS30703_INPUT < 20000ULL * r ||
+            CLOCKGEN_ICS30703_INPUT > 100000000ULL * r)
+            continue;
+
+        for (od = CLOCKGEN_ICS30703_MAX_OD; od > 1 && best_level != 0;
+             od = ClockGenNextOutputDivider(od)) {
+            unsigned long long max_vco;
+            unsigned long long center;
+            unsigned long long spread;
+            unsigned long long first;
+            unsigned long long last;
+            unsigned long long v;
+
+            d = (unsigned long long)r * od;
+
+            // VCO dividers around frequency * d / input
+            center = desired * d / CLOCKGEN_ICS30703_INPUT;
+            spread = center * ppm / 1000000 + 1;
+
+            if (center > CLOCKGEN_ICS30703_MAX_V + spread)
+                continue;
+
+            first = center > CLOCKGEN_ICS30703_MIN_V + spread ? center - spread
+                                                               : CLOCKGEN_ICS30703_MIN_V;
+            last = center + 1 + spread;
+
+            if (last > CLOCKGEN_ICS30703_MAX_V)
+                last = CLOCKGEN_ICS30703_MAX_V;
+
+            if (od == 2)
+                max_vco = 540000000;
+            else if (od == 3)
+                max_vco = 720000000;
+            else if (od >= 38 && od <= 1029)
+                max_vco = 570000000;
+            else
+                max_vco = 730000000;
+
+            for (v = first; v <= last; v++) {
+                unsigned long long vco = CLOCKGEN_ICS30703_INPUT * v;
+                unsigned long level;
+                unsigned resistor;
+                unsigned pump;
+
+                if (vco < 90000000ULL * r || vco > max_vco * r)
+                    continue;
+
+                level = ClockGenErrorLevel(desired, d, (unsigned)v,
+                                           best_level - 1, &freq);
+
+                if (level >= best_level)
+                    continue;
+
+                for (resistor = 0; resistor < CLOCKGEN_RESISTORS; resistor++) {
+                    for (pump = 0; pump < CLOCKGEN_CHARGE_PUMPS; pump++) {
+                        if (ClockGenLoopFilterOk(r, (unsigned)v,
+                                                 ClockGenResistors[resistor].rs,
+                                                 ClockGenChargePumps[pump].icp))
+                            break;
+                    }
+
+                    if (pump < CLOCKGEN_CHARGE_PUMPS)
+                        break;
+                }
+
+                if (resistor == CLOCKGEN_RESISTORS)
+                    continue;
+
+                best_level = level;
+                best_r = r;
+                best_v = (unsigned)v;
+                best_od = od;
+                best_resistor = resistor;
+                best_pump = pump;
+
+                if (best_level == 0)
+                    break;
+            }
+        }
+    }
+
+    if (best_level > ppm)
+        return 2;
+
+    status = ClockGenICS30703Bits(best_r, best_v, best_od, best_resistor,
+                                  best_pump, bits);
+
+    if (status != 0)
+        return status;
+
+    d = (unsigned long long)best_r * best_od;
+    ClockGenDivide(best_v, d, &freq);
+    ClockGenMultiply(&freq, CLOCKGEN_ICS30703_INPUT, &freq);
+
+    if (freq.e >= 0)
+        *actual = (unsigned long)(freq.m << freq.e);
+    else
+        *actual = (unsigned long)(freq.m >> -freq.e);
+
+    return 0;
+}
+
+//
+// ICS30702 (335)
+//
+
+#define CLOCKGEN_ICS30702_INPUT     18432000
+
+//
+// Finds the ICS307 settings closest to frequency, exactly like
+// GetICS30702Data, and the frequency they give.  Returns 0 on
+// success.
+//
+// The library is built where unsigned long is 32 bits and the VCO
+// range check wraps around for the larger VCO words.  unsigned int
+// keeps that on every platform so the bits match what clients have
+// always been sent.
+//
+static int
+ClockGenICS30702(
+    unsigned long frequency,
+    unsigned long *actual,
+    unsigned int *bits
+    )
+{
+    unsigned int rate = (unsigned int)frequency;
+    unsigned int hi = rate + (rate / 10);
+    unsigned int low = rate - (rate / 10);
+    unsigned int lVDW = 1, lRDW = 1, lOD = 1;
+    unsigned int hVDW = 1, hRDW = 1, hOD = 1;
+    unsigned int bestVDW, bestRDW, bestOD;
+    unsigned int check;
+    unsigned int range1;
+    unsigned int range2;
+    unsigned int result;
+    unsigned int vdw;
+    unsigned int rdw;
+    unsigned int od;
+    int odskip = 0;
+
+    *actual = 0;
+
+    for (od = 2; od <= 10; od++) {
+        // maximum frequency with given OD for industrial temp chips
+        switch (od) {
+        case 2: odskip = rate > 180000000; break;
+        case 3: odskip = rate > 120000000; break;
+        case 4: odskip = rate > 90000000; break;
+        case 5: odskip = rate > 72000000; break;
+        case 6: odskip = rate > 60000000; break;
+        case 7: odskip = rate > 50000000; break;
+        case 8: odskip = rate > 45000000; break;
+        case 9: continue; // OD=9 not allowed
+        case 10: odskip = rate > 36000000; break;
+        }
+
+        if (odskip)
+            continue;
+
+        for (rdw = 1; rdw <= 127; rdw++) {
+            for (vdw = 4; vdw <= 511; vdw++) {
+                check = ((CLOCKGEN_ICS30702_INPUT * 2) / ((rdw + 2) * od)) * (vdw + 8);
+                range1 = (CLOCKGEN_ICS30702_INPUT * 2 * (vdw + 8)) / (rdw + 2);
+                range2 = CLOCKGEN_ICS30702_INPUT / (rdw + 2);
+
+                if (range1 <= 60000000 || range1 >= 360000000 || range2 <= 200000)
+                    continue;
+
+                //
+                // Ties go to the lower reference divider and then the
+                // higher VCO divider.
+                //
+                if (check == low) {
+                    if (lRDW > rdw || (lRDW == rdw && lVDW < vdw)) {
+                        lVDW = vdw;
+                        lRDW = rdw;
+                        lOD = od;
+                    }
+                }
+                else if (check == hi) {
+                    if (hRDW > rdw || (hRDW == rdw && hVDW < vdw)) {
+                        hVDW = vdw;
+                        hRDW = rdw;
+                        hOD = od;
+                    }
+                }
+
+                if (check > low && check < hi) {
+                    if (check > rate) {
+                        hi = check;
+                        hVDW = vdw;
+                        hRDW = rdw;
+                        hOD = od;
+                    }
+                    else {
+                        low = check;
+                        lVDW = vdw;
+                        lRDW = rdw;
+                        lOD = od;
+                    }
+                }
+            }
+        }
+    }
+
+    if ((hi - rate) < (rate - low)) {
+        bestVDW = hVDW;
+        bestRDW = hRDW;
+        bestOD = hOD;
+    }
+    else {
+        bestVDW = lVDW;
+        bestRDW = lRDW;
+        bestOD = lOD;
+    }
+
+    switch (bestOD) {
+    case 2: result = 0x11; break;
+    case 3: result = 0x16; break;
+    case 4: result = 0x13; break;
+    case 5: result = 0x14; break;
+    case 6: result = 0x17; break;
+    case 7: result = 0x15; break;
+    case 8: result = 0x12; break;
+    case 10: result = 0x10; break;
+    default: return 1;
+    }
+
+    result <<= 9;
+    result |= bestVDW;
+    result <<= 7;
+    result |= bestRDW;
+
+    *actual = ((CLOCKGEN_ICS30702_INPUT * 2) / ((bestRDW + 2) * bestOD)) * (bestVDW + 8);
+    *bits = result;
+
+    return 0;
+}
+
+#endif // CLOCKGEN_H
@@ -55,6 +55,11 @@ Return Value:
         &Extension->CurrentWriteRequest
         );
 
+    SerialFlushRequests(
+        Extension->PriorityQueue,
+        &Extension->CurrentPriorityRequest
+        );
+
     SerialFlushRequests(
         Extension->ReadQueue,
         &Extension->CurrentReadRequest
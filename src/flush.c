@@ -37,10 +37,10 @@ SerialFlush(
 
 Routine Description:
 
-    This is the dispatch routine for flush.  Flushing works by placing
-    this request in the write queue.  When this request reaches the
-    front of the write queue we simply complete it since this implies
-    that all previous writes have completed.
+    This is the dispatch routine for flush.  Flushing works by stopping
+    the write and priority queues and waiting for the writes they have
+    handed out to complete.  A timed write being held for its launch time is launched
+    right away rather than holding the flush up until then.
 
 Arguments:
 
@@ -64,10 +64,22 @@ Return Value:
 
     PAGED_CODE();
 
+    WdfObjectAcquireLock(Device);
+    extension->TimedWriteFlushes++;
+    SerialFlushTimedWrite(extension);
+    WdfObjectReleaseLock(Device);
+
     WdfIoQueueStopSynchronously(extension->WriteQueue);
+    WdfIoQueueStopSynchronously(extension->PriorityQueue);
+
+    WdfObjectAcquireLock(Device);
+    extension->TimedWriteFlushes--;
+    WdfObjectReleaseLock(Device);
+
     //
-    // Flush is done - restart the queue
+    // Flush is done - restart the queues
     //
+    WdfIoQueueStart(extension->PriorityQueue);
     WdfIoQueueStart(extension->WriteQueue);
 
     Irp->IoStatus.Information = 0L;
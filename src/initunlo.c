@@ -36,6 +36,13 @@ static const PHYSICAL_ADDRESS SerialPhysicalZero = {0};
 
 SERIAL_FIRMWARE_DATA    driverDefaults;
 
+//
+// The clock generator state of every 335 card, see serial.h.
+//
+
+SERIAL_CARD_CLOCK SerialCardClocks[SERIAL_MAX_CARD_CLOCKS];
+KSPIN_LOCK SerialCardClockLock;
+
 //
 // This is exported from the kernel.  It is used to point
 // to the address that the kernel debugger is using.
@@ -105,6 +112,8 @@ Return Value:
     //
     WPP_INIT_TRACING( DriverObject, RegistryPath );
 
+    KeInitializeSpinLock(&SerialCardClockLock);
+
     //SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_INIT, "SerialFC (WDF Version) - Built %s %s\n", __DATE__, __TIME__);
     //
     // Register a cleanup callback so that we can call WPP_CLEANUP when
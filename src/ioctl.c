@@ -157,10 +157,246 @@ Return Value:
     RtlZeroMemory(&((PSERIAL_DEVICE_EXTENSION)Context)->WmiPerfData,
                  sizeof(SERIAL_WMI_PERF_DATA));
 
+    RtlZeroMemory(&((PSERIAL_DEVICE_EXTENSION)Context)->ExtStats,
+                 sizeof(struct serialfc_ext_stats));
+
+    //
+    // Anything still being held is timed from now on.
+    //
+
+    ((PSERIAL_DEVICE_EXTENSION)Context)->TXHoldingStart =
+        ((PSERIAL_DEVICE_EXTENSION)Context)->RXHoldingStart =
+            KeQueryPerformanceCounter(NULL).QuadPart;
+
+    return FALSE;
+}
+
+
+BOOLEAN
+SerialGetExtStats(
+    IN WDFINTERRUPT  Interrupt,
+    IN PVOID         Context
+    )
+
+/*++
+
+Routine Description:
+
+    In sync with the interrpt service routine (which sets the extended
+    stats) return the extended stats to the caller.  Time spent held
+    so far is included for anything that is still being held.
+
+Arguments:
+
+    Context - Pointer to the ioctl sync structure.  Data points to the
+              caller's extended stats.
+
+Return Value:
+
+    This routine always returns FALSE.
+
+--*/
+
+{
+    PSERIAL_IOCTL_SYNC S = Context;
+    PSERIAL_DEVICE_EXTENSION extension = S->Extension;
+    struct serialfc_ext_stats *es = S->Data;
+    LARGE_INTEGER frequency;
+    LONGLONG now;
+
+    UNREFERENCED_PARAMETER(Interrupt);
+
+    now = KeQueryPerformanceCounter(&frequency).QuadPart;
+
+    *es = extension->ExtStats;
+    es->frequency = frequency.QuadPart;
+    es->serial_overruns = extension->PerfStats.SerialOverrunErrorCount;
+    es->buffer_overruns = extension->PerfStats.BufferOverrunErrorCount;
+
+    if (extension->TXHolding) {
+        es->tx_holding_time += now - extension->TXHoldingStart;
+    }
+
+    if (extension->RXHolding) {
+        es->rx_holding_time += now - extension->RXHoldingStart;
+    }
+
+    return FALSE;
+
+}
+
+
+BOOLEAN
+SerialSetConfig(
+    IN WDFINTERRUPT  Interrupt,
+    IN PVOID         Context
+    )
+
+/*++
+
+Routine Description:
+
+    In sync with the interrpt service routine (which also goes through
+    LCR) apply the settings of a new configuration that differ from
+    the current ones.
+
+Arguments:
+
+    Context - Pointer to the ioctl sync structure.  Data points to the
+              new configuration, which has already been checked.
+
+Return Value:
+
+    This routine always returns FALSE.
+
+--*/
+
+{
+    PSERIAL_IOCTL_SYNC S = Context;
+    PSERIAL_DEVICE_EXTENSION extension = S->Extension;
+    struct serialfc_config *config = S->Data;
+
+    UNREFERENCED_PARAMETER(Interrupt);
+
+    FastcomApplyConfig(extension, config, FastcomGetConfigChanges(extension, config));
+
+    return FALSE;
+
+}
+
+
+BOOLEAN
+SerialGetTransmitStats(
+    IN WDFINTERRUPT  Interrupt,
+    IN PVOID         Context
+    )
+
+/*++
+
+Routine Description:
+
+    In sync with the interrpt service routine (which sets the transmit
+    stats) return the transmit lane stats to the caller.
+
+
+Arguments:
+
+    Context - Pointer to a the request.
+
+Return Value:
+
+    This routine always returns FALSE.
+
+--*/
+
+{
+    PREQUEST_CONTEXT reqContext = (PREQUEST_CONTEXT)Context;
+    PSERIAL_DEVICE_EXTENSION extension = SerialGetDeviceExtension(WdfInterruptGetDevice(Interrupt));
+    struct serialfc_transmit_stats *ts = reqContext->SystemBuffer;
+    LARGE_INTEGER frequency;
+
+    KeQueryPerformanceCounter(&frequency);
+
+    *ts = extension->TransmitStats;
+    ts->frequency = frequency.QuadPart;
+
+    return FALSE;
+
+}
+
+
+BOOLEAN
+SerialClearTransmitStats(
+    IN WDFINTERRUPT  Interrupt,
+    IN PVOID         Context
+    )
+
+/*++
+
+Routine Description:
+
+    In sync with the interrpt service routine (which sets the transmit
+    stats) clear the transmit lane stats.
+
+
+Arguments:
+
+    Context - Pointer to a the extension.
+
+Return Value:
+
+    This routine always returns FALSE.
+
+--*/
+
+{
+    UNREFERENCED_PARAMETER(Interrupt);
+
+    RtlZeroMemory(
+        &((PSERIAL_DEVICE_EXTENSION)Context)->TransmitStats,
+        sizeof(struct serialfc_transmit_stats)
+        );
+
     return FALSE;
 }
 
 
+#if LATENCY_HISTOGRAMS
+BOOLEAN
+SerialGetLatencyHistograms(
+    IN WDFINTERRUPT  Interrupt,
+    IN PVOID         Context
+    )
+
+/*++
+
+Routine Description:
+
+    In sync with the interrpt service routine (which updates the isr
+    histogram) return the latency histograms to the caller, clearing
+    them afterwards if asked to.
+
+Arguments:
+
+    Context - Pointer to the ioctl sync structure.  Data points to the
+              caller's histograms, the frequency field holds non-zero
+              on entry if the histograms are to be cleared.
+
+Return Value:
+
+    This routine always returns FALSE.
+
+--*/
+
+{
+    PSERIAL_IOCTL_SYNC S = Context;
+    PSERIAL_DEVICE_EXTENSION extension = S->Extension;
+    struct serialfc_latency_histograms *lh = S->Data;
+    BOOLEAN clear = (lh->frequency != 0);
+    LARGE_INTEGER frequency;
+
+    UNREFERENCED_PARAMETER(Interrupt);
+
+    KeQueryPerformanceCounter(&frequency);
+
+    *lh = extension->LatencyHistograms;
+    lh->frequency = frequency.QuadPart;
+
+    if (clear) {
+
+        RtlZeroMemory(
+            &extension->LatencyHistograms,
+            sizeof(struct serialfc_latency_histograms)
+            );
+
+    }
+
+    return FALSE;
+
+}
+#endif
+
+
 
 BOOLEAN
 SerialSetChars(
@@ -227,6 +463,20 @@ Return Value:
 
     UNREFERENCED_PARAMETER(Interrupt);
 
+    //
+    // A divisor from IOCTL_FASTCOM_SET_BAUD_EXACT is used as is, including
+    // when the baud rate is restored after a power down.
+    //
+
+    if (Extension->ExactDivisor) {
+        if (FastcomGetCardType(Extension) == CARD_TYPE_PCIe)
+            PCIeSetDivisor(Extension, Extension->ExactDivisor);
+        else
+            WRITE_DIVISOR_LATCH(Extension, Extension->Controller, (USHORT)Extension->ExactDivisor);
+
+        return FALSE;
+    }
+
     WRITE_DIVISOR_LATCH(
         Extension,
         Extension->Controller,
@@ -486,6 +736,17 @@ Return Value:
 
     }
 
+    if (Extension->PriorityLength) {
+
+        PREQUEST_CONTEXT reqContext = NULL;
+
+        ASSERT(Extension->CurrentPriorityRequest);
+
+        reqContext = SerialGetRequestContext(Extension->CurrentPriorityRequest);
+        Stat->AmountInOutQueue -= reqContext->Length - (Extension->PriorityLength);
+
+    }
+
     Stat->WaitForImmediate = Extension->TransmitImmediate;
 
     Stat->HoldReasons = 0;
@@ -713,6 +974,7 @@ Return Value:
 
                 Extension->CurrentBaud = BaudRate;
                 Extension->WmiCommData.BaudRate = BaudRate;
+                Extension->ExactDivisor = 0;
 
                 S.Extension = Extension;
                 S.Data = (PVOID) (ULONG_PTR) AppropriateDivisor;
@@ -2029,8 +2291,23 @@ Return Value:
             break;
         }
         case IOCTL_FASTCOM_SET_CLOCK_RATE: {
-            Status = STATUS_NOT_SUPPORTED;
-            break;
+            Status = WdfRequestRetrieveInputBuffer(Request, sizeof(unsigned), &buffer, &bufSize);
+            if( !NT_SUCCESS(Status) ) {
+                SerialDbgPrintEx(TRACE_LEVEL_ERROR, DBG_IOCTLS, "Could not get request memory buffer %X\n", Status);
+                break;
+            }
+
+            //
+            // Working out the clock bits is too slow for the device
+            // lock, so the clock queue does it at passive level.
+            //
+            Status = WdfRequestForwardToIoQueue(Request, Extension->ClockQueue);
+            if( !NT_SUCCESS(Status) ) {
+                SerialDbgPrintEx(TRACE_LEVEL_ERROR, DBG_IOCTLS, "WdfRequestForwardToIoQueue failed %X\n", Status);
+                break;
+            }
+
+            return;
         }
         case IOCTL_FASTCOM_SET_CLOCK_BITS: {
 
@@ -2197,6 +2474,269 @@ Return Value:
             reqContext->Information = sizeof(int);
             break;
         }
+        case IOCTL_FASTCOM_TIMED_WRITE: {
+
+            struct serialfc_timed_write *timedWrite;
+
+            //
+            // The header has to be followed by at least one character.
+            //
+
+            Status = WdfRequestRetrieveInputBuffer(Request, sizeof(struct serialfc_timed_write) + 1, &buffer, &bufSize);
+            if( !NT_SUCCESS(Status) ) {
+                SerialDbgPrintEx(TRACE_LEVEL_ERROR, DBG_IOCTLS, "Could not get request memory buffer %X\n", Status);
+                break;
+            }
+
+            timedWrite = (struct serialfc_timed_write *)buffer;
+
+            if (timedWrite->launch_time <= 0) {
+
+                Status = STATUS_INVALID_PARAMETER;
+                break;
+
+            }
+
+            reqContext->SystemBuffer = buffer;
+            reqContext->Length = (ULONG)(bufSize - sizeof(struct serialfc_timed_write));
+            reqContext->Information = 0;
+
+            //
+            // Like the xoff counter, this goes through the write
+            // queue so it stays ordered with normal writes.
+            //
+
+            SerialStartOrQueue(
+                       Extension,
+                       Request,
+                       Extension->WriteQueue,
+                       &Extension->CurrentWriteRequest,
+                       SerialStartWrite
+                       );
+            return;
+        }
+        case IOCTL_FASTCOM_PRIORITY_WRITE: {
+
+            Status = WdfRequestRetrieveInputBuffer(Request, 1, &buffer, &bufSize);
+            if( !NT_SUCCESS(Status) ) {
+                SerialDbgPrintEx(TRACE_LEVEL_ERROR, DBG_IOCTLS, "Could not get request memory buffer %X\n", Status);
+                break;
+            }
+
+            reqContext->SystemBuffer = buffer;
+            reqContext->Length = (ULONG)bufSize;
+            reqContext->Information = 0;
+
+            //
+            // Priority writes have their own queue.  The isr sends
+            // them ahead of whatever is left of the current write.
+            //
+
+            SerialStartOrQueue(
+                       Extension,
+                       Request,
+                       Extension->PriorityQueue,
+                       &Extension->CurrentPriorityRequest,
+                       SerialStartPriority
+                       );
+            return;
+        }
+        case IOCTL_FASTCOM_GET_TRANSMIT_STATS: {
+
+            Status = WdfRequestRetrieveOutputBuffer(Request, sizeof(struct serialfc_transmit_stats), &buffer, &bufSize);
+            if( !NT_SUCCESS(Status) ) {
+                SerialDbgPrintEx(TRACE_LEVEL_ERROR, DBG_IOCTLS, "Could not get request memory buffer %X\n", Status);
+                break;
+            }
+
+            reqContext->SystemBuffer = buffer;
+
+            WdfInterruptSynchronize(
+                Extension->WdfInterrupt,
+                SerialGetTransmitStats,
+                reqContext
+                );
+
+            reqContext->Information = sizeof(struct serialfc_transmit_stats);
+            break;
+        }
+        case IOCTL_FASTCOM_CLEAR_TRANSMIT_STATS: {
+
+            WdfInterruptSynchronize(
+                Extension->WdfInterrupt,
+                SerialClearTransmitStats,
+                Extension
+                );
+            break;
+        }
+        case IOCTL_FASTCOM_GET_LATENCY_HISTOGRAMS: {
+#if LATENCY_HISTOGRAMS
+            SERIAL_IOCTL_SYNC S;
+            struct serialfc_latency_histograms *lh;
+            ULONG clear = 0;
+
+            if (NT_SUCCESS(WdfRequestRetrieveInputBuffer(Request, sizeof(ULONG), &buffer, &bufSize))) {
+                clear = *(PULONG)buffer;
+            }
+
+            Status = WdfRequestRetrieveOutputBuffer(Request, sizeof(struct serialfc_latency_histograms), &buffer, &bufSize);
+            if( !NT_SUCCESS(Status) ) {
+                SerialDbgPrintEx(TRACE_LEVEL_ERROR, DBG_IOCTLS, "Could not get request memory buffer %X\n", Status);
+                break;
+            }
+
+            //
+            // METHOD_BUFFERED shares the input and output buffer, so
+            // the clear flag is passed in through the frequency field.
+            //
+
+            lh = buffer;
+            lh->frequency = clear ? 1 : 0;
+
+            S.Extension = Extension;
+            S.Data = lh;
+
+            WdfInterruptSynchronize(
+                Extension->WdfInterrupt,
+                SerialGetLatencyHistograms,
+                &S
+                );
+
+            reqContext->Information = sizeof(struct serialfc_latency_histograms);
+#else
+            Status = STATUS_NOT_SUPPORTED;
+#endif
+            break;
+        }
+        case IOCTL_FASTCOM_GET_EXT_STATS: {
+
+            SERIAL_IOCTL_SYNC S;
+
+            Status = WdfRequestRetrieveOutputBuffer(Request, sizeof(struct serialfc_ext_stats), &buffer, &bufSize);
+            if( !NT_SUCCESS(Status) ) {
+                SerialDbgPrintEx(TRACE_LEVEL_ERROR, DBG_IOCTLS, "Could not get request memory buffer %X\n", Status);
+                break;
+            }
+
+            S.Extension = Extension;
+            S.Data = buffer;
+
+            WdfInterruptSynchronize(
+                Extension->WdfInterrupt,
+                SerialGetExtStats,
+                &S
+                );
+
+            reqContext->Information = sizeof(struct serialfc_ext_stats);
+            break;
+        }
+        case IOCTL_FASTCOM_DUMP_TRACE: {
+
+            Status = WdfRequestRetrieveOutputBuffer(Request, sizeof(struct serialfc_trace), &buffer, &bufSize);
+            if( !NT_SUCCESS(Status) ) {
+                SerialDbgPrintEx(TRACE_LEVEL_ERROR, DBG_IOCTLS, "Could not get request memory buffer %X\n", Status);
+                break;
+            }
+
+            SerialDumpTrace(Extension, buffer);
+
+            reqContext->Information = sizeof(struct serialfc_trace);
+            break;
+        }
+        case IOCTL_FASTCOM_SET_CONFIG: {
+
+            SERIAL_IOCTL_SYNC S;
+
+            Status = WdfRequestRetrieveInputBuffer(Request, sizeof(struct serialfc_config), &buffer, &bufSize);
+            if( !NT_SUCCESS(Status) ) {
+                SerialDbgPrintEx(TRACE_LEVEL_ERROR, DBG_IOCTLS, "Could not get request memory buffer %X\n", Status);
+                break;
+            }
+
+            //
+            // Nothing is written unless every setting is good.
+            //
+
+            Status = FastcomCheckConfig(Extension, buffer, NULL);
+            if( !NT_SUCCESS(Status) ) {
+                break;
+            }
+
+            S.Extension = Extension;
+            S.Data = buffer;
+
+            WdfInterruptSynchronize(
+                Extension->WdfInterrupt,
+                SerialSetConfig,
+                &S
+                );
+
+            break;
+        }
+        case IOCTL_FASTCOM_GET_CONFIG: {
+
+            Status = WdfRequestRetrieveOutputBuffer(Request, sizeof(struct serialfc_config), &buffer, &bufSize);
+            if( !NT_SUCCESS(Status) ) {
+                SerialDbgPrintEx(TRACE_LEVEL_ERROR, DBG_IOCTLS, "Could not get request memory buffer %X\n", Status);
+                break;
+            }
+
+            FastcomGetConfig(Extension, buffer);
+
+            reqContext->Information = sizeof(struct serialfc_config);
+            break;
+        }
+        case IOCTL_FASTCOM_SET_BAUD_EXACT: {
+
+            Status = WdfRequestRetrieveInputBuffer(Request, sizeof(struct serialfc_baud_setting), &buffer, &bufSize);
+            if( !NT_SUCCESS(Status) ) {
+                SerialDbgPrintEx(TRACE_LEVEL_ERROR, DBG_IOCTLS, "Could not get request memory buffer %X\n", Status);
+                break;
+            }
+
+            Status = FastcomSetBaudExact(Extension, buffer);
+            break;
+        }
+        case IOCTL_FASTCOM_READ_TIMESTAMPED: {
+
+            SERIAL_IOCTL_SYNC S;
+            struct serialfc_timestamped_read *header;
+
+            Status = WdfRequestRetrieveOutputBuffer(Request, sizeof(struct serialfc_timestamped_read), &buffer, &bufSize);
+            if( !NT_SUCCESS(Status) ) {
+                SerialDbgPrintEx(TRACE_LEVEL_ERROR, DBG_IOCTLS, "Could not get request memory buffer %X\n", Status);
+                break;
+            }
+
+            //
+            // While a read is in progress the isr puts characters
+            // straight into the read's buffer and they never reach
+            // the interrupt buffer.
+            //
+
+            if (Extension->CurrentReadRequest) {
+
+                Status = STATUS_DEVICE_BUSY;
+                break;
+
+            }
+
+            header = buffer;
+            header->data_length = (ULONG)(bufSize - sizeof(struct serialfc_timestamped_read));
+
+            S.Extension = Extension;
+            S.Data = header;
+
+            WdfInterruptSynchronize(
+                Extension->WdfInterrupt,
+                SerialGetTimestampedChars,
+                &S
+                );
+
+            reqContext->Information = sizeof(struct serialfc_timestamped_read) +
+                                      header->data_length;
+            break;
+        }
         default: {
 
             Status = STATUS_INVALID_PARAMETER;
@@ -2214,6 +2754,60 @@ DoneWithIoctl:;
 
 }
 
+VOID
+SerialEvtIoClockRate(
+    IN WDFQUEUE     Queue,
+    IN WDFREQUEST   Request,
+    IN size_t       OutputBufferLength,
+    IN size_t       InputBufferLength,
+    IN ULONG        IoControlCode
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles IOCTL_FASTCOM_SET_CLOCK_RATE requests that
+    SerialEvtIoDeviceControl forwarded to the clock queue.  It is
+    called at passive level and is not synchronized with the device.
+
+Arguments:
+
+    Queue - The clock queue.
+
+    Request - Pointer to the WDFREQUEST for the current request
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    NTSTATUS Status;
+    PSERIAL_DEVICE_EXTENSION Extension = NULL;
+    PVOID buffer;
+    PREQUEST_CONTEXT reqContext;
+    size_t bufSize;
+
+    UNREFERENCED_PARAMETER(OutputBufferLength);
+    UNREFERENCED_PARAMETER(InputBufferLength);
+    UNREFERENCED_PARAMETER(IoControlCode);
+
+    reqContext = SerialGetRequestContext(Request);
+
+    Extension = SerialGetDeviceExtension(WdfIoQueueGetDevice(Queue));
+
+    Status = WdfRequestRetrieveInputBuffer(Request, sizeof(unsigned), &buffer, &bufSize);
+    if( NT_SUCCESS(Status) ) {
+        Status = FastcomSetClockRate(Extension, *((unsigned *)buffer));
+    }
+
+    reqContext->Status = Status;
+
+    SerialCompleteRequest(Request, Status, 0);
+}
+
 
 VOID
 SerialGetProperties(
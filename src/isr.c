@@ -149,6 +149,10 @@ Return Value:
     UCHAR tempLSR;
     PREQUEST_CONTEXT reqContext = NULL;
 
+#if LATENCY_HISTOGRAMS
+    LONGLONG isrStart = KeQueryPerformanceCounter(NULL).QuadPart;
+#endif
+
     UNREFERENCED_PARAMETER(MessageID);
 
     Extension = SerialGetDeviceExtension(WdfInterruptGetDevice(Interrupt));
@@ -257,10 +261,14 @@ Return Value:
             // present.
             //
 
+            SerialTrace(Extension, SERIALFC_TRACE_IIR, 0, InterruptIdReg, 0);
+
             switch (InterruptIdReg) {
 
                 case SERIAL_IIR_RLS: {
 
+                    Extension->ExtStats.rls_interrupts++;
+
                     SerialProcessLSR(Extension);
 
                     break;
@@ -279,6 +287,19 @@ Return Value:
                     //
                     UCHAR ReceivedChar;
                     UCHAR NinthBit = 0;
+                    ULONG burstBytes = 0;
+
+                    if (InterruptIdReg == SERIAL_IIR_RDA) {
+                        Extension->ExtStats.rda_interrupts++;
+                    } else {
+                        Extension->ExtStats.cti_interrupts++;
+                    }
+
+                    //
+                    // One timestamp covers the whole fifo burst.
+                    //
+
+                    SerialRecordRxTimestamp(Extension);
 
                     do {
                         //BOOLEAN NinthBit;
@@ -291,6 +312,7 @@ Return Value:
                             READ_RECEIVE_BUFFER(Extension, Extension->Controller);
                         Extension->PerfStats.ReceivedCount++;
                         Extension->WmiPerfData.ReceivedCount++;
+                        burstBytes++;
 
                         ReceivedChar &= Extension->ValidDataMask;
 
@@ -323,7 +345,7 @@ Return Value:
                             if (ReceivedChar ==
                                 Extension->SpecialChars.XoffChar) {
 
-                                Extension->TXHolding |= SERIAL_TX_XOFF;
+                                SERIAL_SET_HOLDING(Extension, TXHolding, SERIAL_TX_XOFF);
 
                                 if ((Extension->HandFlow.FlowReplace &
                                      SERIAL_RTS_MASK) ==
@@ -351,7 +373,7 @@ Return Value:
                                     // SMC and the Winbond.
                                     //
 
-                                    Extension->TXHolding &= ~SERIAL_TX_XOFF;
+                                    SERIAL_CLEAR_HOLDING(Extension, TXHolding, SERIAL_TX_XOFF);
 
                                 }
 
@@ -483,16 +505,26 @@ ReceiveDoLineStatus:    ;
 
                     } WHILE (TRUE);
 
+                    Extension->ExtStats.rx_bursts++;
+                    Extension->ExtStats.rx_burst_bytes += burstBytes;
+
+                    if (burstBytes > Extension->ExtStats.rx_burst_max) {
+                        Extension->ExtStats.rx_burst_max = burstBytes;
+                    }
+
                     break;
 
                 }
 
                 case SERIAL_IIR_THR: {
 
+                    Extension->ExtStats.thr_interrupts++;
+
 doTrasmitStuff:;
                     Extension->HoldingEmpty = TRUE;
 
                     if (Extension->WriteLength ||
+                        Extension->PriorityLength ||
                         Extension->TransmitImmediate ||
                         Extension->SendXoffChar ||
                         Extension->SendXonChar) {
@@ -588,7 +620,7 @@ doTrasmitStuff:;
                             // can't be holding by Xoff.
                             //
 
-                            Extension->TXHolding &= ~SERIAL_TX_XOFF;
+                            SERIAL_CLEAR_HOLDING(Extension, TXHolding, SERIAL_TX_XOFF);
 
                             //
                             // If we are sending an xon char then
@@ -596,7 +628,7 @@ doTrasmitStuff:;
                             // up reception by Xoff.
                             //
 
-                            Extension->RXHolding &= ~SERIAL_RX_XOFF;
+                            SERIAL_CLEAR_HOLDING(Extension, RXHolding, SERIAL_RX_XOFF);
 
                         } else if (Extension->SendXoffChar &&
                               !Extension->TXHolding) {
@@ -649,7 +681,7 @@ doTrasmitStuff:;
                             if (!(Extension->HandFlow.FlowReplace &
                                   SERIAL_XOFF_CONTINUE)) {
 
-                                Extension->TXHolding |= SERIAL_TX_XOFF;
+                                SERIAL_SET_HOLDING(Extension, TXHolding, SERIAL_TX_XOFF);
 
                                 if ((Extension->HandFlow.FlowReplace &
                                      SERIAL_RTS_MASK) ==
@@ -720,17 +752,57 @@ doTrasmitStuff:;
                         } else if (!Extension->TXHolding) {
 
                             ULONG amountToWrite;
+                            PUCHAR *currentChar;
+                            ULONG *lengthLeft;
+                            BOOLEAN *firstByte;
+
+                            //
+                            // A priority write takes this fifo refill.
+                            // The current write, if any, picks up again
+                            // at the first refill after it is done.
+                            //
+
+                            if (Extension->PriorityLength) {
+
+                                currentChar = &Extension->PriorityCurrentChar;
+                                lengthLeft = &Extension->PriorityLength;
+                                firstByte = &Extension->PriorityFirstByte;
+
+                            } else {
+
+                                currentChar = &Extension->WriteCurrentChar;
+                                lengthLeft = &Extension->WriteLength;
+                                firstByte = &Extension->WriteFirstByte;
+
+                            }
 
                             if (Extension->FifoPresent) {
                                 // Trying to get the min of 3 values, basically.
                                 FastcomGetTxFifoSpace(Extension, &amountToWrite);
                                 if(amountToWrite > Extension->TxFifoAmount) amountToWrite = Extension->TxFifoAmount;
-                                if(amountToWrite > Extension->WriteLength) amountToWrite = Extension->WriteLength;
+                                if(amountToWrite > *lengthLeft) amountToWrite = *lengthLeft;
                             } else {
 
                                 amountToWrite = 1;
 
                             }
+
+                            Extension->ExtStats.tx_refills++;
+
+                            //
+                            // A timed write is launched when its first
+                            // byte goes in the fifo.
+                            //
+
+                            if (Extension->TimedWriteStampPending &&
+                                *firstByte && lengthLeft == &Extension->WriteLength) {
+
+                                Extension->TimedWriteLaunchTime =
+                                    KeQueryPerformanceCounter(NULL).QuadPart;
+                                Extension->TimedWriteStampPending = FALSE;
+
+                            }
+
                             if ((Extension->HandFlow.FlowReplace &
                                  SERIAL_RTS_MASK) ==
                                  SERIAL_TRANSMIT_TOGGLE) {
@@ -748,7 +820,7 @@ doTrasmitStuff:;
                                     Extension->WmiPerfData.TransmittedCount++;
                                     WRITE_TRANSMIT_HOLDING(Extension,
                                         Extension->Controller,
-                                        *(Extension->WriteCurrentChar));
+                                        **currentChar);
 
                                 } else {
 
@@ -758,7 +830,7 @@ doTrasmitStuff:;
                                        amountToWrite;
                                     WRITE_TRANSMIT_FIFO_HOLDING(Extension,
                                         Extension->Controller,
-                                        Extension->WriteCurrentChar,
+                                        *currentChar,
                                         amountToWrite);
                                 }
 
@@ -775,13 +847,13 @@ doTrasmitStuff:;
                                     Extension->WmiPerfData.TransmittedCount++;
 
                                     if (Extension->NineBit) {
-                                        /* 9-bit usually uses multiple bytes so the first can be an address, this is here just in case */
-                                        Extension->SerialWriteUChar(Extension->Controller + SPR_OFFSET, 0x01);
+                                        /* Only the first byte of a write is an address, even when sent one byte at a time */
+                                        Extension->SerialWriteUChar(Extension->Controller + SPR_OFFSET, *firstByte ? 0x01 : 0x00);
                                     }
 
                                     WRITE_TRANSMIT_HOLDING(Extension,
                                         Extension->Controller,
-                                        *(Extension->WriteCurrentChar));
+                                        **currentChar);
 
                                 } else {
                                     unsigned i = 0;
@@ -798,19 +870,19 @@ doTrasmitStuff:;
                                     /*
 									WRITE_TRANSMIT_FIFO_HOLDING(Extension,
                                         Extension->Controller,
-                                        Extension->WriteCurrentChar,
+                                        *currentChar,
                                         amountToWrite);
 									*/
 
                                     for (i = 0; i < amountToWrite; i++) {
                                         if (Extension->NineBit) {
-                                            spr = (i == 0) ? 0x01 : 0x00; /* Set the 9th bit to 1 on the first byte, 0 on the remaining */
+                                            spr = (i == 0 && *firstByte) ? 0x01 : 0x00; /* Set the 9th bit to 1 on the first byte of the write, 0 on the remaining */
                                             Extension->SerialWriteUChar(Extension->Controller + SPR_OFFSET, spr);
                                         }
 
                                         WRITE_TRANSMIT_HOLDING(Extension,
                                             Extension->Controller,
-                                            *(Extension->WriteCurrentChar+i));
+                                            *(*currentChar+i));
                                     }
 
                                 }
@@ -818,10 +890,25 @@ doTrasmitStuff:;
                             }
 
                             Extension->HoldingEmpty = FALSE;
-                            Extension->WriteCurrentChar += amountToWrite;
-                            Extension->WriteLength -= amountToWrite;
+                            *currentChar += amountToWrite;
+                            *lengthLeft -= amountToWrite;
+                            *firstByte = FALSE;
+
+                            if (lengthLeft == &Extension->PriorityLength) {
+
+                                if (!Extension->PriorityLength) {
+
+                                    reqContext = SerialGetRequestContext(Extension->CurrentPriorityRequest);
 
-                            if (!Extension->WriteLength) {
+                                    reqContext->Information = reqContext->Length;
+
+                                    SerialInsertQueueDpc(
+                                        Extension->CompletePriorityDpc
+                                        );
+
+                                }
+
+                            } else if (!Extension->WriteLength) {
 
                                 //
                                 // No More characters left.  This
@@ -836,6 +923,8 @@ doTrasmitStuff:;
                                     (reqContext->MajorFunction == IRP_MJ_WRITE)?
                                         (reqContext->Length): (1);
 
+                                SERIAL_STAMP_DPC(Extension->WriteDpcQueuedTime);
+
                                 SerialInsertQueueDpc(
                                     Extension->CompleteWriteDpc
                                     );
@@ -852,6 +941,8 @@ doTrasmitStuff:;
 
                 case SERIAL_IIR_MS: {
 
+                    Extension->ExtStats.ms_interrupts++;
+
                     SerialHandleModemUpdate(
                         Extension,
                         FALSE
@@ -877,6 +968,7 @@ doTrasmitStuff:;
 
             if (!Extension->TXHolding &&
                 (Extension->WriteLength ||
+                 Extension->PriorityLength ||
                  Extension->TransmitImmediate)) {
 
                 goto doTrasmitStuff;
@@ -887,6 +979,14 @@ doTrasmitStuff:;
 
     }
 
+#if LATENCY_HISTOGRAMS
+    if (ServicedAnInterrupt) {
+
+        SerialRecordLatency(&Extension->LatencyHistograms.isr, isrStart);
+
+    }
+#endif
+
     return ServicedAnInterrupt;
 
 }
@@ -1000,6 +1100,7 @@ Return Value:
         //
 
         *Extension->CurrentCharSlot = CharToPut;
+        Extension->RxStreamCount++;
 
         if (Extension->CurrentCharSlot ==
             Extension->LastCharSlot) {
@@ -1027,6 +1128,8 @@ Return Value:
             reqContext = SerialGetRequestContext(Extension->CurrentReadRequest);
             reqContext->Information = reqContext->Length;
 
+            SERIAL_STAMP_DPC(Extension->ReadDpcQueuedTime);
+
             SerialInsertQueueDpc(
                 Extension->CompleteReadDpc
                 );
@@ -1073,7 +1176,7 @@ Return Value:
                      Extension->HandFlow.XoffLimit)
                     <= (Extension->CharsInInterruptBuffer+1)) {
 
-                    Extension->RXHolding |= SERIAL_RX_DTR;
+                    SERIAL_SET_HOLDING(Extension, RXHolding, SERIAL_RX_DTR);
 
                     SerialClrDTR(Extension->WdfInterrupt, Extension);
 
@@ -1100,7 +1203,7 @@ Return Value:
                      Extension->HandFlow.XoffLimit)
                     <= (Extension->CharsInInterruptBuffer+1)) {
 
-                    Extension->RXHolding |= SERIAL_RX_RTS;
+                    SERIAL_SET_HOLDING(Extension, RXHolding, SERIAL_RX_RTS);
 
                     SerialClrRTS(Extension->WdfInterrupt, Extension);
 
@@ -1126,7 +1229,7 @@ Return Value:
                      Extension->HandFlow.XoffLimit)
                     <= (Extension->CharsInInterruptBuffer+1)) {
 
-                    Extension->RXHolding |= SERIAL_RX_XOFF;
+                    SERIAL_SET_HOLDING(Extension, RXHolding, SERIAL_RX_XOFF);
 
                     //
                     // If necessary cause an
@@ -1149,6 +1252,15 @@ Return Value:
 
             *Extension->CurrentCharSlot = CharToPut;
             Extension->CharsInInterruptBuffer++;
+            Extension->RxStreamCount++;
+
+            if (Extension->CharsInInterruptBuffer >
+                Extension->ExtStats.buffer_high_water) {
+
+                Extension->ExtStats.buffer_high_water =
+                    Extension->CharsInInterruptBuffer;
+
+            }
 
             //
             // If we've become 80% full on this character
@@ -1256,6 +1368,75 @@ Return Value:
 
     }
 
+}
+
+VOID
+SerialRecordRxTimestamp(
+    IN PSERIAL_DEVICE_EXTENSION Extension
+    )
+
+/*++
+
+Routine Description:
+
+    This routine records the performance counter for the fifo burst
+    that is about to be read.  The timestamp is keyed by the stream
+    offset of the first character of the burst so the counter is
+    only read once per burst, not once per character.
+
+    If the previous burst stored no characters its entry is reused.
+    When the ring is full the oldest entry is dropped.
+
+    NOTE: This routine is called at device level.
+
+Arguments:
+
+    Extension - A pointer to the device extension.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    struct serialfc_rx_timestamp *entry;
+    ULONG slot;
+
+    if (Extension->RxTimestampCount) {
+
+        slot = (Extension->RxTimestampFirst +
+                Extension->RxTimestampCount - 1) % SERIAL_RX_TIMESTAMP_RING;
+
+        if (Extension->RxTimestamps[slot].offset ==
+            Extension->RxStreamCount) {
+
+            Extension->RxTimestamps[slot].timestamp =
+                KeQueryPerformanceCounter(NULL).QuadPart;
+            return;
+
+        }
+
+    }
+
+    if (Extension->RxTimestampCount < SERIAL_RX_TIMESTAMP_RING) {
+
+        slot = (Extension->RxTimestampFirst +
+                Extension->RxTimestampCount) % SERIAL_RX_TIMESTAMP_RING;
+        Extension->RxTimestampCount++;
+
+    } else {
+
+        slot = Extension->RxTimestampFirst;
+        Extension->RxTimestampFirst =
+            (Extension->RxTimestampFirst + 1) % SERIAL_RX_TIMESTAMP_RING;
+
+    }
+
+    entry = &Extension->RxTimestamps[slot];
+    entry->offset = Extension->RxStreamCount;
+    entry->timestamp = KeQueryPerformanceCounter(NULL).QuadPart;
+
 }
 
 UCHAR
@@ -1299,6 +1480,8 @@ Return Value:
     if (LineStatus & ~(SERIAL_LSR_THRE | SERIAL_LSR_TEMT
                        | SERIAL_LSR_DR)) {
 
+        SerialTrace(Extension, SERIALFC_TRACE_LSR_ERROR, 0, LineStatus, 0);
+
         //
         // We have some sort of data problem in the receive.
         // For any of these errors we may abort all current
@@ -298,7 +298,7 @@ Return Value:
                                              "reception for %p\n",
                                              Extension->Controller);
 
-                            Extension->RXHolding &= ~SERIAL_RX_DTR;
+                            SERIAL_CLEAR_HOLDING(Extension, RXHolding, SERIAL_RX_DTR);
                             SerialSetDTR(Extension->WdfInterrupt, Extension);
 
                         }
@@ -313,7 +313,7 @@ Return Value:
 
                     SerialDbgPrintEx(TRACE_LEVEL_VERBOSE, DBG_IOCTLS, "Setting DTR block on reception "
                                      "for %p\n", Extension->Controller);
-                    Extension->RXHolding |= SERIAL_RX_DTR;
+                    SERIAL_SET_HOLDING(Extension, RXHolding, SERIAL_RX_DTR);
                     SerialClrDTR(Extension->WdfInterrupt, Extension);
 
                 }
@@ -331,7 +331,7 @@ Return Value:
                 if (Extension->RXHolding & SERIAL_RX_DTR) {
                     SerialDbgPrintEx(TRACE_LEVEL_VERBOSE, DBG_IOCTLS, "Removing dtr block of reception "
                                      "for %p\n", Extension->Controller);
-                    Extension->RXHolding &= ~SERIAL_RX_DTR;
+                    SERIAL_CLEAR_HOLDING(Extension, RXHolding, SERIAL_RX_DTR);
                 }
 
                 SerialSetDTR(Extension->WdfInterrupt, Extension);
@@ -352,7 +352,7 @@ Return Value:
 
                 SerialDbgPrintEx(TRACE_LEVEL_VERBOSE, DBG_IOCTLS, "removing dtr block of reception for"
                                  " %p\n", Extension->Controller);
-                Extension->RXHolding &= ~SERIAL_RX_DTR;
+                SERIAL_CLEAR_HOLDING(Extension, RXHolding, SERIAL_RX_DTR);
 
             }
 
@@ -410,7 +410,7 @@ Return Value:
                        SerialDbgPrintEx(TRACE_LEVEL_VERBOSE, DBG_IOCTLS, "Removing rts block of "
                                         "reception for %p\n",
                                         Extension->Controller);
-                        Extension->RXHolding &= ~SERIAL_RX_RTS;
+                        SERIAL_CLEAR_HOLDING(Extension, RXHolding, SERIAL_RX_RTS);
                         SerialSetRTS(Extension->WdfInterrupt, Extension);
 
                     }
@@ -425,7 +425,7 @@ Return Value:
 
                 SerialDbgPrintEx(TRACE_LEVEL_VERBOSE, DBG_IOCTLS, "Setting rts block of reception for "
                                  "%p\n", Extension->Controller);
-                Extension->RXHolding |= SERIAL_RX_RTS;
+                SERIAL_SET_HOLDING(Extension, RXHolding, SERIAL_RX_RTS);
                 SerialClrRTS(Extension->WdfInterrupt, Extension);
 
             }
@@ -445,7 +445,7 @@ Return Value:
 
                 SerialDbgPrintEx(TRACE_LEVEL_VERBOSE, DBG_IOCTLS, "Clearing rts block of reception for "
                                  "%p\n", Extension->Controller);
-                Extension->RXHolding &= ~SERIAL_RX_RTS;
+                SERIAL_CLEAR_HOLDING(Extension, RXHolding, SERIAL_RX_RTS);
 
             }
 
@@ -464,7 +464,7 @@ Return Value:
 
                 SerialDbgPrintEx(TRACE_LEVEL_VERBOSE, DBG_IOCTLS, "TOGGLE Clearing rts block of "
                                  "reception for %p\n", Extension->Controller);
-                Extension->RXHolding &= ~SERIAL_RX_RTS;
+                SERIAL_CLEAR_HOLDING(Extension, RXHolding, SERIAL_RX_RTS);
 
             }
 
@@ -498,8 +498,10 @@ Return Value:
                                                  SERIAL_LSR_TEMT)) !=
                                                 (SERIAL_LSR_THRE |
                                                  SERIAL_LSR_TEMT)) ||
-                (Extension->CurrentWriteRequest || Extension->TransmitImmediate ||
-                 (!IsQueueEmpty(Extension->WriteQueue)) &&
+                (Extension->CurrentWriteRequest || Extension->CurrentPriorityRequest ||
+                 Extension->TransmitImmediate ||
+                 ((!IsQueueEmpty(Extension->WriteQueue)) ||
+                  (!IsQueueEmpty(Extension->PriorityQueue))) &&
                  (!Extension->TXHolding))) {
 
                 SerialSetRTS(Extension->WdfInterrupt, Extension);
@@ -533,7 +535,7 @@ Return Value:
 
                 SerialDbgPrintEx(TRACE_LEVEL_VERBOSE, DBG_IOCTLS, "Clearing rts block of reception for"
                                  " %p\n", Extension->Controller);
-                Extension->RXHolding &= ~SERIAL_RX_RTS;
+                SERIAL_CLEAR_HOLDING(Extension, RXHolding, SERIAL_RX_RTS);
 
             }
 
@@ -574,7 +576,7 @@ Return Value:
                 // Cause the Xoff to be sent.
                 //
 
-                Extension->RXHolding |= SERIAL_RX_XOFF;
+                SERIAL_SET_HOLDING(Extension, RXHolding, SERIAL_RX_XOFF);
 
                 SerialProdXonXoff(
                     Extension,
@@ -595,7 +597,7 @@ Return Value:
 
             if (Extension->RXHolding & SERIAL_RX_XOFF) {
 
-                Extension->RXHolding &= ~SERIAL_RX_XOFF;
+                SERIAL_CLEAR_HOLDING(Extension, RXHolding, SERIAL_RX_XOFF);
 
                 //
                 // Cause the Xon to be sent.
@@ -648,7 +650,7 @@ Return Value:
 
             if (Extension->TXHolding & SERIAL_TX_XOFF) {
 
-                Extension->TXHolding &= ~SERIAL_TX_XOFF;
+                SERIAL_CLEAR_HOLDING(Extension, TXHolding, SERIAL_TX_XOFF);
 
                 //
                 // Cause the Xon to be sent.
@@ -777,7 +779,7 @@ Return Value:
         OldLineControl
         );
 
-    Extension->TXHolding |= SERIAL_TX_BREAK;
+    SERIAL_SET_HOLDING(Extension, TXHolding, SERIAL_TX_BREAK);
 
     return FALSE;
 
@@ -841,10 +843,11 @@ Return Value:
             OldLineControl
             );
 
-        Extension->TXHolding &= ~SERIAL_TX_BREAK;
+        SERIAL_CLEAR_HOLDING(Extension, TXHolding, SERIAL_TX_BREAK);
 
         if (!Extension->TXHolding &&
             (Extension->TransmitImmediate ||
+             Extension->PriorityLength ||
              Extension->WriteLength) &&
              Extension->HoldingEmpty) {
 
@@ -907,7 +910,7 @@ Return Value:
 
     UNREFERENCED_PARAMETER(Interrupt);
 
-    Extension->TXHolding |= SERIAL_TX_XOFF;
+    SERIAL_SET_HOLDING(Extension, TXHolding, SERIAL_TX_XOFF);
 
     if ((Extension->HandFlow.FlowReplace & SERIAL_RTS_MASK) ==
         SERIAL_TRANSMIT_TOGGLE) {
@@ -972,10 +975,11 @@ Return Value:
         // it out and we could end up over writing a character in
         // the transmission hardware.
 
-        Extension->TXHolding &= ~SERIAL_TX_XOFF;
+        SERIAL_CLEAR_HOLDING(Extension, TXHolding, SERIAL_TX_XOFF);
 
         if (!Extension->TXHolding &&
             (Extension->TransmitImmediate ||
+             Extension->PriorityLength ||
              Extension->WriteLength) &&
              Extension->HoldingEmpty) {
 
@@ -1033,14 +1037,14 @@ Return Value:
 
             if (Extension->RXHolding & SERIAL_RX_DTR) {
 
-                Extension->RXHolding &= ~SERIAL_RX_DTR;
+                SERIAL_CLEAR_HOLDING(Extension, RXHolding, SERIAL_RX_DTR);
                 SerialSetDTR(Extension->WdfInterrupt, Extension);
 
             }
 
             if (Extension->RXHolding & SERIAL_RX_RTS) {
 
-                Extension->RXHolding &= ~SERIAL_RX_RTS;
+                SERIAL_CLEAR_HOLDING(Extension, RXHolding, SERIAL_RX_RTS);
                 SerialSetRTS(Extension->WdfInterrupt, Extension);
 
             }
@@ -1232,11 +1236,11 @@ Return Value:
             // RXHolding does't have the DSR bit.
             //
 
-            Extension->RXHolding &= ~SERIAL_RX_DSR;
+            SERIAL_CLEAR_HOLDING(Extension, RXHolding, SERIAL_RX_DSR);
 
         } else {
 
-            Extension->RXHolding |= SERIAL_RX_DSR;
+            SERIAL_SET_HOLDING(Extension, RXHolding, SERIAL_RX_DSR);
 
         }
 
@@ -1248,7 +1252,7 @@ Return Value:
         // asked that we don't hold for this reason any more.)
         //
 
-        Extension->RXHolding &= ~SERIAL_RX_DSR;
+        SERIAL_CLEAR_HOLDING(Extension, RXHolding, SERIAL_RX_DSR);
 
     }
 
@@ -1320,17 +1324,17 @@ Return Value:
 
             if (ModemStatus & SERIAL_MSR_CTS) {
 
-                Extension->TXHolding &= ~SERIAL_TX_CTS;
+                SERIAL_CLEAR_HOLDING(Extension, TXHolding, SERIAL_TX_CTS);
 
             } else {
 
-                Extension->TXHolding |= SERIAL_TX_CTS;
+                SERIAL_SET_HOLDING(Extension, TXHolding, SERIAL_TX_CTS);
 
             }
 
         } else {
 
-            Extension->TXHolding &= ~SERIAL_TX_CTS;
+            SERIAL_CLEAR_HOLDING(Extension, TXHolding, SERIAL_TX_CTS);
 
         }
 
@@ -1339,17 +1343,17 @@ Return Value:
 
             if (ModemStatus & SERIAL_MSR_DSR) {
 
-                Extension->TXHolding &= ~SERIAL_TX_DSR;
+                SERIAL_CLEAR_HOLDING(Extension, TXHolding, SERIAL_TX_DSR);
 
             } else {
 
-                Extension->TXHolding |= SERIAL_TX_DSR;
+                SERIAL_SET_HOLDING(Extension, TXHolding, SERIAL_TX_DSR);
 
             }
 
         } else {
 
-            Extension->TXHolding &= ~SERIAL_TX_DSR;
+            SERIAL_CLEAR_HOLDING(Extension, TXHolding, SERIAL_TX_DSR);
 
         }
 
@@ -1358,17 +1362,17 @@ Return Value:
 
             if (ModemStatus & SERIAL_MSR_DCD) {
 
-                Extension->TXHolding &= ~SERIAL_TX_DCD;
+                SERIAL_CLEAR_HOLDING(Extension, TXHolding, SERIAL_TX_DCD);
 
             } else {
 
-                Extension->TXHolding |= SERIAL_TX_DCD;
+                SERIAL_SET_HOLDING(Extension, TXHolding, SERIAL_TX_DCD);
 
             }
 
         } else {
 
-            Extension->TXHolding &= ~SERIAL_TX_DCD;
+            SERIAL_CLEAR_HOLDING(Extension, TXHolding, SERIAL_TX_DCD);
 
         }
 
@@ -1401,6 +1405,7 @@ Return Value:
 
             if (!Extension->TXHolding &&
                 (Extension->TransmitImmediate ||
+                 Extension->PriorityLength ||
                  Extension->WriteLength) &&
                  Extension->HoldingEmpty) {
 
@@ -1427,15 +1432,16 @@ Return Value:
                                     SERIAL_TX_DSR |
                                     SERIAL_TX_CTS)) {
 
-            Extension->TXHolding &= ~(SERIAL_TX_DCD |
-                                      SERIAL_TX_DSR |
-                                      SERIAL_TX_CTS);
+            SERIAL_CLEAR_HOLDING(Extension, TXHolding, (SERIAL_TX_DCD |
+                                                         SERIAL_TX_DSR |
+                                                         SERIAL_TX_CTS));
 
 
             if (!DoingTX && OldTXHolding && !Extension->TXHolding) {
 
                 if (!Extension->TXHolding &&
                     (Extension->TransmitImmediate ||
+                     Extension->PriorityLength ||
                      Extension->WriteLength) &&
                      Extension->HoldingEmpty) {
 
@@ -1515,8 +1521,10 @@ Return Value:
         //
 
         if ((Extension->TXHolding & SERIAL_TX_BREAK) ||
-            (Extension->CurrentWriteRequest || Extension->TransmitImmediate ||
-             (!IsQueueEmpty(Extension->WriteQueue)) &&
+            (Extension->CurrentWriteRequest || Extension->CurrentPriorityRequest ||
+             Extension->TransmitImmediate ||
+             ((!IsQueueEmpty(Extension->WriteQueue)) ||
+              (!IsQueueEmpty(Extension->PriorityQueue))) &&
              (!Extension->TXHolding))) {
 
             NOTHING;
@@ -1729,4 +1737,86 @@ Return Value:
 
 }
 
+VOID
+SerialChangeHolding(
+    IN PSERIAL_DEVICE_EXTENSION Extension,
+    IN PULONG Holding,
+    IN ULONG NewHolding
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets TXHolding or RXHolding to a new value, keeping
+    the holding times and flow control assertions of the extended
+    statistics up to date and noting the change in the flight
+    recorder.  A flow control assertion is DTR, RTS or an xoff newly
+    holding off the other end.
+
+    NOTE: This routine assumes that it is called at interrupt
+          level.
+
+Arguments:
+
+    Extension - A pointer to the device extension.
+
+    Holding - Either &Extension->TXHolding or &Extension->RXHolding.
+
+    NewHolding - The new holding reasons.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    PLONGLONG start;
+    PULONGLONG total;
 
+    if (Holding == &Extension->TXHolding) {
+
+        start = &Extension->TXHoldingStart;
+        total = &Extension->ExtStats.tx_holding_time;
+
+    } else {
+
+        start = &Extension->RXHoldingStart;
+        total = &Extension->ExtStats.rx_holding_time;
+
+        if (NewHolding & ~*Holding &
+            (SERIAL_RX_DTR | SERIAL_RX_RTS | SERIAL_RX_XOFF)) {
+
+            Extension->ExtStats.flow_control_assertions++;
+
+        }
+
+    }
+
+    if (*Holding != NewHolding) {
+
+        SerialTrace(
+            Extension,
+            (Holding == &Extension->TXHolding) ?
+                SERIALFC_TRACE_TX_HOLDING : SERIALFC_TRACE_RX_HOLDING,
+            0,
+            NewHolding,
+            0
+            );
+
+    }
+
+    if (!*Holding && NewHolding) {
+
+        *start = KeQueryPerformanceCounter(NULL).QuadPart;
+
+    } else if (*Holding && !NewHolding) {
+
+        *total += KeQueryPerformanceCounter(NULL).QuadPart - *start;
+
+    }
+
+    *Holding = NewHolding;
+
+}
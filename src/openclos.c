@@ -226,6 +226,14 @@ SerialDeviceFileCreateWorker (
 
     extension->TotalCharsQueued = 0;
 
+    //
+    // The receive timestamp offsets start over with the stream.
+    //
+
+    extension->RxStreamCount = 0;
+    extension->RxTimestampFirst = 0;
+    extension->RxTimestampCount = 0;
+
     //
     // We set up the default xon/xoff limits.
     //
@@ -575,8 +583,8 @@ SerialFileCloseWorker(
         // Clean out the holding reasons (since we are closed).
         //
 
-        extension->RXHolding = 0;
-        extension->TXHolding = 0;
+        SerialChangeHolding(extension, &extension->RXHolding, 0);
+        SerialChangeHolding(extension, &extension->TXHolding, 0);
 
         //
         // Mark device as not busy for WMI
@@ -443,6 +443,27 @@ Return Value:
         return status;
     }
 
+    //
+    // Priority Queue..
+    //
+    WDF_IO_QUEUE_CONFIG_INIT(&queueConfig,
+                             WdfIoQueueDispatchManual);
+
+    queueConfig.EvtIoStop = SerialEvtIoStop;
+    queueConfig.EvtIoResume = SerialEvtIoResume;
+    queueConfig.EvtIoCanceledOnQueue = SerialEvtCanceledOnQueue;
+
+    status = WdfIoQueueCreate (device,
+                               &queueConfig,
+                               WDF_NO_OBJECT_ATTRIBUTES,
+                               &pDevExt->PriorityQueue
+                               );
+
+    if (!NT_SUCCESS(status)) {
+        SerialDbgPrintEx(TRACE_LEVEL_ERROR, DBG_PNP,  " WdfIoQueueCreate for Priority failed %!STATUS!\n", status);
+        return status;
+    }
+
     //
     // Mask Queue...
     //
@@ -489,6 +510,34 @@ Return Value:
         return status;
     }
 
+    //
+    // Clock Queue..  The clock bits are worked out at passive level, so
+    // this queue opts out of synchronization with the device the same
+    // way the file object callbacks do, and takes the device lock only
+    // to program the clock.
+    //
+    WDF_IO_QUEUE_CONFIG_INIT(&queueConfig,
+                             WdfIoQueueDispatchSequential
+                             );
+
+    queueConfig.EvtIoDeviceControl = SerialEvtIoClockRate;
+    queueConfig.EvtIoCanceledOnQueue = SerialEvtCanceledOnQueue;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ExecutionLevel = WdfExecutionLevelPassive;
+    attributes.SynchronizationScope = WdfSynchronizationScopeNone;
+
+    status = WdfIoQueueCreate (device,
+                               &queueConfig,
+                               &attributes,
+                               &pDevExt->ClockQueue
+                               );
+
+    if (!NT_SUCCESS(status)) {
+        SerialDbgPrintEx(TRACE_LEVEL_ERROR, DBG_PNP,  " WdfIoQueueCreate for Clock failed %!STATUS!\n",   status);
+        return status;
+    }
+
     //
     // All the incoming I/O requests are routed to the default queue and dispatch to the
     // appropriate callback events. These callback event will check to see if another
@@ -914,6 +963,11 @@ Return Value:
     // do anything other than unmapping the I/O resources.
     //
 
+    //
+    // A 335 card's clock generator state is dropped with its last port.
+    //
+    FastcomReleaseCardClock(pDevExt);
+
     //
     // Unmap any Memory-Mapped registers. Disconnecting from the interrupt will
     // be done automatically by the framework.
@@ -2155,6 +2209,8 @@ Return Value:
 
     SerialPurgeRequests(pDevExt->WriteQueue,  &pDevExt->CurrentWriteRequest);
 
+    SerialPurgeRequests(pDevExt->PriorityQueue,  &pDevExt->CurrentPriorityRequest);
+
     SerialPurgeRequests(pDevExt->ReadQueue,  &pDevExt->CurrentReadRequest);
 
     //
@@ -276,6 +276,15 @@ Return Value:
         SetDeviceIsOpened(deviceExtension, FALSE, FALSE);
     }
 
+    //
+    // The clock generator keeps its bits through D1 and D2, anything
+    // lower and it has to be programmed again on the way back.
+    //
+
+    if (TargetState != WdfPowerDeviceD1 && TargetState != WdfPowerDeviceD2) {
+        FastcomForgetClockBits(deviceExtension);
+    }
+
     SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_POWER, "<--SerialEvtDeviceD0Exit\n");
 
     return STATUS_SUCCESS;
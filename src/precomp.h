@@ -11,6 +11,7 @@
 #include <wmilib.h>
 #include <initguid.h> // required for GUID definitions
 #include <wmidata.h>
+#include "serialfc.h"
 #include "serial.h"
 #include "serialp.h"
 #include "serlog.h"
@@ -0,0 +1,514 @@
+/*++
+
+Copyright (c) 1991, 1992, 1993 - 1997 Microsoft Corporation
+
+Module Name:
+
+    priority.c
+
+Abstract:
+
+    This module contains the code that is very specific to priority
+    write operations in the serial driver.  A priority write works
+    like a transmit immediate character but carries a whole message.
+    The isr sends it at the next fifo refill and then picks the
+    current write back up where it left off.
+
+Environment:
+
+    Kernel mode
+
+--*/
+
+#include "precomp.h"
+
+#if defined(EVENT_TRACING)
+#include "priority.tmh"
+#endif
+
+
+VOID
+SerialGetNextPriority(
+    IN WDFREQUEST *CurrentOpRequest,
+    IN WDFQUEUE QueueToProcess,
+    IN WDFREQUEST *NewRequest,
+    IN BOOLEAN CompleteCurrent,
+    IN PSERIAL_DEVICE_EXTENSION Extension
+    );
+
+EVT_WDF_REQUEST_CANCEL SerialCancelCurrentPriority;
+EVT_WDF_INTERRUPT_SYNCHRONIZE SerialGivePriorityToIsr;
+EVT_WDF_INTERRUPT_SYNCHRONIZE SerialGrabPriorityFromIsr;
+
+
+VOID
+SerialStartPriority(
+    IN PSERIAL_DEVICE_EXTENSION Extension
+    )
+
+/*++
+
+Routine Description:
+
+    This routine will calculate the timeouts needed for the
+    priority write.  It will then hand the request off to the isr.
+
+    The write total timeouts are used, the same as for a normal
+    write of the same length.
+
+Arguments:
+
+    Extension - A pointer to the serial device extension.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    LARGE_INTEGER TotalTime = {0};
+    BOOLEAN UseATimer;
+    SERIAL_TIMEOUTS Timeouts;
+    PREQUEST_CONTEXT reqContext;
+
+    reqContext = SerialGetRequestContext(Extension->CurrentPriorityRequest);
+
+    SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_WRITE, ">SerialStartPriority(%p)\n",
+                     Extension);
+
+    UseATimer = FALSE;
+
+    Timeouts = Extension->Timeouts;
+
+    if (Timeouts.WriteTotalTimeoutConstant ||
+        Timeouts.WriteTotalTimeoutMultiplier) {
+
+        UseATimer = TRUE;
+
+        TotalTime.QuadPart =
+            ((LONGLONG)((UInt32x32To64(
+                             reqContext->Length,
+                             Timeouts.WriteTotalTimeoutMultiplier
+                             )
+                             + Timeouts.WriteTotalTimeoutConstant)))
+            * -10000;
+
+    }
+
+    //
+    // As the request might be going to the isr, this is a good time
+    // to initialize the reference count.
+    //
+
+    SERIAL_INIT_REFERENCE(reqContext);
+
+    SerialSetCancelRoutine(Extension->CurrentPriorityRequest,
+                                    SerialCancelCurrentPriority);
+
+    if (UseATimer) {
+        BOOLEAN result;
+
+        result = SerialSetTimer(
+            Extension->PriorityTotalTimer,
+            TotalTime
+            );
+
+        if(result == FALSE) {
+            //
+            // Since the timer knows about the request we increment
+            // the reference count.
+            //
+
+            SERIAL_SET_REFERENCE(
+                reqContext,
+                SERIAL_REF_TOTAL_TIMER
+                );
+        }
+    }
+
+    WdfInterruptSynchronize(
+        Extension->WdfInterrupt,
+        SerialGivePriorityToIsr,
+        Extension
+        );
+
+    SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_WRITE, "<SerialStartPriority\n");
+
+}
+
+VOID
+SerialCompletePriority(
+    IN WDFDPC Dpc
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is merely used to complete any priority write.  It
+    assumes that the status and the information fields of the
+    request are already correctly filled in.
+
+Arguments:
+
+    Dpc - The complete priority dpc.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSERIAL_DEVICE_EXTENSION Extension = NULL;
+
+    Extension = SerialGetDeviceExtension(WdfDpcGetParentObject(Dpc));
+
+    SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_WRITE, ">SerialCompletePriority(%p)\n",
+                     Extension);
+
+    SerialTryToCompleteCurrent(
+        Extension,
+        NULL,
+        STATUS_SUCCESS,
+        &Extension->CurrentPriorityRequest,
+        Extension->PriorityQueue,
+        NULL,
+        Extension->PriorityTotalTimer,
+        SerialStartPriority,
+        SerialGetNextPriority,
+        SERIAL_REF_ISR
+        );
+
+    SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_WRITE, "<SerialCompletePriority\n");
+
+}
+
+VOID
+SerialTimeoutPriority(
+    IN WDFTIMER Timer
+    )
+
+/*++
+
+Routine Description:
+
+    This routine will try to timeout the current priority write.
+
+Arguments:
+
+    Timer - The priority total timer.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSERIAL_DEVICE_EXTENSION Extension = NULL;
+
+    Extension = SerialGetDeviceExtension(WdfTimerGetParentObject(Timer));
+
+    SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_WRITE, ">SerialTimeoutPriority(%p)\n",
+                     Extension);
+
+    SerialTryToCompleteCurrent(
+        Extension,
+        SerialGrabPriorityFromIsr,
+        STATUS_TIMEOUT,
+        &Extension->CurrentPriorityRequest,
+        Extension->PriorityQueue,
+        NULL,
+        Extension->PriorityTotalTimer,
+        SerialStartPriority,
+        SerialGetNextPriority,
+        SERIAL_REF_TOTAL_TIMER
+        );
+
+    SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_WRITE, "<SerialTimeoutPriority\n");
+}
+
+VOID
+SerialGetNextPriority(
+    IN WDFREQUEST *CurrentOpRequest,
+    IN WDFQUEUE QueueToProcess,
+    IN WDFREQUEST *NewRequest,
+    IN BOOLEAN CompleteCurrent,
+    IN PSERIAL_DEVICE_EXTENSION Extension
+    )
+
+/*++
+
+Routine Description:
+
+    This routine completes the old priority write as well as getting
+    a pointer to the next one.  If there isn't a next one we try to
+    satisfy a wait for transmit queue empty event.
+
+Arguments:
+
+    CurrentOpRequest - Pointer to the pointer that points to the
+                   current priority write request.
+
+    QueueToProcess - Pointer to the priority queue.
+
+    NewRequest - A pointer to a pointer to the request that will be the
+             current request.  Note that this could end up pointing
+             to a null pointer.
+
+    CompleteCurrent - Flag indicates whether the CurrentOpRequest should
+                      be completed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    PREQUEST_CONTEXT reqContext = SerialGetRequestContext(*CurrentOpRequest);
+
+    ASSERT(Extension->TotalCharsQueued >= reqContext->Length);
+    Extension->TotalCharsQueued -= reqContext->Length;
+
+    SerialGetNextRequest(
+        CurrentOpRequest,
+        QueueToProcess,
+        NewRequest,
+        CompleteCurrent,
+        Extension
+        );
+
+    if (!*NewRequest) {
+
+        WdfInterruptSynchronize(
+            Extension->WdfInterrupt,
+            SerialProcessEmptyTransmit,
+            Extension
+            );
+
+    }
+
+}
+
+VOID
+SerialCancelCurrentPriority(
+    IN WDFREQUEST Request
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is used to cancel the current priority write.
+
+Arguments:
+
+    Request - Pointer to the WDFREQUEST to be canceled.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    PSERIAL_DEVICE_EXTENSION Extension = NULL;
+    WDFDEVICE  device = WdfIoQueueGetDevice(WdfRequestGetIoQueue(Request));
+
+    UNREFERENCED_PARAMETER(Request);
+
+    Extension = SerialGetDeviceExtension(device);
+
+    SerialTryToCompleteCurrent(
+        Extension,
+        SerialGrabPriorityFromIsr,
+        STATUS_CANCELLED,
+        &Extension->CurrentPriorityRequest,
+        Extension->PriorityQueue,
+        NULL,
+        Extension->PriorityTotalTimer,
+        SerialStartPriority,
+        SerialGetNextPriority,
+        SERIAL_REF_CANCEL
+        );
+
+}
+
+BOOLEAN
+SerialGivePriorityToIsr(
+    IN WDFINTERRUPT  Interrupt,
+    IN PVOID         Context
+    )
+/*++
+
+Routine Description:
+
+    Hand the current priority write to the isr.  If a write or an
+    immediate character is already going out the isr will switch
+    over at its next fifo refill, otherwise "tickle" the UART into
+    interrupting with a transmit buffer empty.
+
+    NOTE: This routine is called by WdfInterruptSynchronize.
+
+    NOTE: This routine assumes that it is called with the
+          cancel spin lock held.
+
+Arguments:
+
+    Context - Really a pointer to the device extension.
+
+Return Value:
+
+    This routine always returns FALSE.
+
+--*/
+{
+    PSERIAL_DEVICE_EXTENSION Extension = Context;
+    PREQUEST_CONTEXT         reqContext;
+
+    UNREFERENCED_PARAMETER(Interrupt);
+
+    reqContext = SerialGetRequestContext(Extension->CurrentPriorityRequest);
+
+    Extension->PriorityLength = reqContext->Length;
+    Extension->PriorityCurrentChar = reqContext->SystemBuffer;
+    Extension->PriorityFirstByte = TRUE;
+
+    SerialUpdateLaneStats(&Extension->TransmitStats.priority, reqContext);
+
+    //
+    // The isr now has a reference to the request.
+    //
+
+    SERIAL_SET_REFERENCE(
+        reqContext,
+        SERIAL_REF_ISR
+        );
+
+    if (!Extension->WriteLength && !Extension->TransmitImmediate) {
+
+        if (Extension->HoldingEmpty) {
+
+            DISABLE_ALL_INTERRUPTS(Extension, Extension->Controller);
+            ENABLE_ALL_INTERRUPTS(Extension, Extension->Controller);
+
+        }
+
+    }
+
+    if ((Extension->HandFlow.FlowReplace & SERIAL_RTS_MASK) ==
+        SERIAL_TRANSMIT_TOGGLE) {
+
+        SerialSetRTS(Extension->WdfInterrupt, Extension);
+
+    }
+
+    return FALSE;
+
+}
+
+BOOLEAN
+SerialGrabPriorityFromIsr(
+    IN WDFINTERRUPT  Interrupt,
+    IN PVOID         Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is used to grab the current priority write, which
+    could be timing out or canceling, from the ISR.
+
+    NOTE: This routine is being called from WdfInterruptSynchronize.
+
+    NOTE: This routine assumes that the cancel spin lock is held
+          when this routine is called.
+
+Arguments:
+
+    Context - Really a pointer to the device extension.
+
+Return Value:
+
+    Always false.
+
+--*/
+
+{
+    PSERIAL_DEVICE_EXTENSION Extension = Context;
+    PREQUEST_CONTEXT         reqContext;
+
+    UNREFERENCED_PARAMETER(Interrupt);
+
+    reqContext = SerialGetRequestContext(Extension->CurrentPriorityRequest);
+
+    if (Extension->PriorityLength) {
+
+        reqContext->Information = reqContext->Length - Extension->PriorityLength;
+
+        //
+        // Since the isr no longer references this request, we can
+        // decrement it's reference count.
+        //
+
+        SERIAL_CLEAR_REFERENCE(
+            reqContext,
+            SERIAL_REF_ISR
+            );
+
+        Extension->PriorityLength = 0;
+
+    }
+
+    return FALSE;
+
+}
+
+VOID
+SerialUpdateLaneStats(
+    IN struct serialfc_lane_stats *Stats,
+    IN PREQUEST_CONTEXT ReqContext
+    )
+
+/*++
+
+Routine Description:
+
+    Account for a write being handed to the isr in the queueing
+    latency statistics of its lane.
+
+    NOTE: This routine is called at device level.
+
+Arguments:
+
+    Stats - The statistics of the lane the write belongs to.
+
+    ReqContext - The context of the write.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    ULONGLONG latency;
+
+    latency = KeQueryPerformanceCounter(NULL).QuadPart - ReqContext->QueuedTime;
+
+    Stats->requests++;
+    Stats->total_latency += latency;
+
+    if (latency > Stats->max_latency) {
+
+        Stats->max_latency = latency;
+
+    }
+
+}
@@ -72,6 +72,11 @@ Return Value:
                 &Extension->CurrentXoffRequest
                 );
 
+            SerialFlushRequests(
+                Extension->PriorityQueue,
+                &Extension->CurrentPriorityRequest
+                );
+
         }
 
         if (Mask & SERIAL_PURGE_RXABORT) {
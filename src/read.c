@@ -568,6 +568,9 @@ Return Value:
     SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_READ, ">SerialCompleteRead(%p)\n",
                      extension);
 
+    SERIAL_RECORD_DPC(extension->LatencyHistograms.read_dpc,
+                      extension->ReadDpcQueuedTime);
+
     //
     // We set this to indicate to the interval timer
     // that the read has completed.
@@ -1746,3 +1749,159 @@ Return Value:
 }
 
 
+BOOLEAN
+SerialGetTimestampedChars(
+    IN WDFINTERRUPT  Interrupt,
+    IN PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine takes whatever is in the interrupt buffer, up to the
+    room the caller has, together with the receive timestamps of the
+    fifo bursts it came in.  The first timestamp is for the burst the
+    first character arrived in, unless that burst has already dropped
+    out of the ring.  The rest are for bursts that start inside the
+    returned data.  If there are more of those than the caller can take
+    the data is cut short at the first burst that doesn't fit.
+
+    NOTE: This is called by WdfInterruptSynchronize.
+
+    NOTE: The caller makes sure no read is in progress, so the isr
+          is filling the interrupt buffer.
+
+Arguments:
+
+    Context - Points to a structure that contains a pointer to the
+              device extension and to the caller's buffer.  On entry
+              data_length is the room after the header, on return it
+              is the number of characters copied.
+
+Return Value:
+
+    Always FALSE.
+
+--*/
+
+{
+
+    PSERIAL_IOCTL_SYNC S = Context;
+    PSERIAL_DEVICE_EXTENSION Extension = S->Extension;
+    struct serialfc_timestamped_read *header = S->Data;
+    struct serialfc_rx_timestamp *entry;
+    PUCHAR data = (PUCHAR)(header + 1);
+    ULONGLONG firstOffset;
+    ULONG numberOfCharsToGet;
+    ULONG firstTryNumberToGet;
+    ULONG i;
+
+    UNREFERENCED_PARAMETER(Interrupt);
+
+    numberOfCharsToGet = Extension->CharsInInterruptBuffer;
+
+    if (numberOfCharsToGet > header->data_length) {
+
+        numberOfCharsToGet = header->data_length;
+
+    }
+
+    firstOffset = Extension->RxStreamCount - Extension->CharsInInterruptBuffer;
+
+    header->offset = firstOffset;
+    header->timestamp_count = 0;
+
+    //
+    // The ring is in stream order, oldest first.
+    //
+
+    for (i = 0; i < Extension->RxTimestampCount; i++) {
+
+        entry = &Extension->RxTimestamps[(Extension->RxTimestampFirst + i) %
+                                         SERIAL_RX_TIMESTAMP_RING];
+
+        if (entry->offset <= firstOffset) {
+
+            header->timestamps[0] = *entry;
+            header->timestamp_count = 1;
+            continue;
+
+        }
+
+        if (entry->offset >= firstOffset + numberOfCharsToGet) {
+
+            break;
+
+        }
+
+        if (header->timestamp_count == SERIALFC_RX_TIMESTAMPS) {
+
+            numberOfCharsToGet = (ULONG)(entry->offset - firstOffset);
+            break;
+
+        }
+
+        header->timestamps[header->timestamp_count++] = *entry;
+
+    }
+
+    if (numberOfCharsToGet) {
+
+        firstTryNumberToGet = (ULONG)(Extension->LastCharSlot -
+                               Extension->FirstReadableChar) + 1;
+
+        if (firstTryNumberToGet > numberOfCharsToGet) {
+
+            RtlMoveMemory(
+                data,
+                Extension->FirstReadableChar,
+                numberOfCharsToGet
+                );
+
+            if ((Extension->FirstReadableChar + (numberOfCharsToGet - 1)) ==
+                Extension->LastCharSlot) {
+
+                Extension->FirstReadableChar = Extension->InterruptReadBuffer;
+
+            } else {
+
+                Extension->FirstReadableChar += numberOfCharsToGet;
+
+            }
+
+        } else {
+
+            RtlMoveMemory(
+                data,
+                Extension->FirstReadableChar,
+                firstTryNumberToGet
+                );
+
+            RtlMoveMemory(
+                data + firstTryNumberToGet,
+                Extension->InterruptReadBuffer,
+                numberOfCharsToGet - firstTryNumberToGet
+                );
+
+            Extension->FirstReadableChar = Extension->InterruptReadBuffer +
+                                           (numberOfCharsToGet -
+                                            firstTryNumberToGet);
+
+        }
+
+        Extension->CharsInInterruptBuffer -= numberOfCharsToGet;
+
+        //
+        // Deal with flow control if necessary.
+        //
+
+        SerialHandleReducedIntBuffer(Extension);
+
+    }
+
+    header->data_length = numberOfCharsToGet;
+
+    return FALSE;
+
+}
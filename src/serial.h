@@ -34,6 +34,18 @@ iver
 #define SERIAL_PERMIT_SHARE_DEFAULT     0
 #define SERIAL_LOG_FIFO_DEFAULT         0
 
+//
+// Number of fifo bursts the isr remembers receive timestamps for.
+//
+#define SERIAL_RX_TIMESTAMP_RING 256
+
+//
+// Define LATENCY_HISTOGRAMS as 0 to compile out the latency histograms.
+//
+#ifndef LATENCY_HISTOGRAMS
+#define LATENCY_HISTOGRAMS 1
+#endif
+
 
 //
 // This define gives the default Object directory
@@ -698,11 +710,24 @@ typedef struct _SERIAL_DEVICE_EXTENSION {
     //
     WDFQUEUE MaskQueue;
 
+    //
+    // Holds the serialized list of priority write requests.  These
+    // are sent ahead of whatever is left of the current write.
+    //
+    WDFQUEUE PriorityQueue;
+
     //
     // Holds the serialized list of purge requests.
     //
     WDFQUEUE PurgeQueue;
 
+    //
+    // Clock rate requests are forwarded here.  Working out the clock
+    // bits takes a while so this queue runs at passive level and is
+    // not synchronized with the device.
+    //
+    WDFQUEUE ClockQueue;
+
     //
     // This points to the request that is currently being processed
     // for the read queue.  This field is initialized by the open to
@@ -745,6 +770,15 @@ typedef struct _SERIAL_DEVICE_EXTENSION {
     //
     WDFREQUEST CurrentImmediateRequest;
 
+    //
+    // Points to the priority write request that is currently being
+    // sent.
+    //
+    // This value is only set at dispatch level.  It may be
+    // read at interrupt level.
+    //
+    WDFREQUEST CurrentPriorityRequest;
+
     //
     // Points to the request that is being used to count the number
     // of characters received after an xoff (as currently defined
@@ -867,6 +901,27 @@ typedef struct _SERIAL_DEVICE_EXTENSION {
     //
     PUCHAR WriteCurrentChar;
 
+    //
+    // Same as WriteLength and WriteCurrentChar but for the current
+    // priority write.  While PriorityLength is non-zero the isr
+    // refills the fifo from here instead of from the current write.
+    //
+    // These locations are only accessed while at interrupt level.
+    //
+    ULONG PriorityLength;
+    PUCHAR PriorityCurrentChar;
+
+    //
+    // Set when a write or priority write is given to the isr and
+    // cleared once its first byte has gone into the fifo.  In 9-bit
+    // mode only that byte is sent with the address bit, even if a
+    // priority write cut in after it.
+    //
+    // These locations are only accessed while at interrupt level.
+    //
+    BOOLEAN WriteFirstByte;
+    BOOLEAN PriorityFirstByte;
+
     //
     // This is a buffer for the read processing.
     //
@@ -1111,6 +1166,12 @@ typedef struct _SERIAL_DEVICE_EXTENSION {
     //
     SERIALPERF_STATS PerfStats;
 
+    //
+    // Holds the queueing latency of the normal and priority transmit
+    // lanes.  Only set at device level.
+    //
+    struct serialfc_transmit_stats TransmitStats;
+
     //
     // This holds what we beleive to be the current value of
     // the line control register.
@@ -1239,6 +1300,12 @@ typedef struct _SERIAL_DEVICE_EXTENSION {
     //
     WDFDPC CompleteImmediateDpc;
 
+    //
+    // This dpc is fired off when the last character of the current
+    // priority write is given to the hardware.
+    //
+    WDFDPC CompletePriorityDpc;
+
     //
     // This dpc is fired off if the xoff counter actually runs down
     // to zero.
@@ -1267,11 +1334,22 @@ typedef struct _SERIAL_DEVICE_EXTENSION {
     //
     WDFTIMER WriteRequestTotalTimer;
 
+    //
+    // This high resolution timer holds a timed write until just
+    // before its launch time.
+    //
+    WDFTIMER TimedWriteTimer;
+
     //
     // This is timer structure used to handle total time request timing.
     //
     WDFTIMER ImmediateTotalTimer;
 
+    //
+    // This timer is used to handle total priority write request timing.
+    //
+    WDFTIMER PriorityTotalTimer;
+
     //
     // This timer is used to timeout the xoff counter io.
     //
@@ -1318,6 +1396,7 @@ typedef struct _SERIAL_DEVICE_EXTENSION {
     unsigned RxTrigger; /* Required for 335 and PCIe card's which have a write-only register */
     BOOLEAN NineBit; /* 9-bit mode can be retrieved on the FSCC but we store the info to avoid register calls */
     int FixedBaudRate;
+    ULONG ExactDivisor; /* Set by IOCTL_FASTCOM_SET_BAUD_EXACT, 0 otherwise. Low 4 bits are DLD on PCIe */
     unsigned Channel;
     UINT32 Bar0;
 
@@ -1325,6 +1404,89 @@ typedef struct _SERIAL_DEVICE_EXTENSION {
     UCHAR ACR;
     UINT32 Bar1;
     UINT32 Bar2;
+
+    //
+    // The FSCC clock bits last programmed into this port's clock
+    // generator, their frequency (0 until the first time) and whether
+    // the generator is known to still hold them.  The 335 cards share
+    // one generator between all of their ports so they are kept in
+    // SerialCardClocks instead.
+    //
+    ULONG ClockFrequency;
+    UCHAR ClockBits[20];
+    BOOLEAN ClockProgrammed;
+
+    //
+    // Whether this port is counted in its 335 card's SerialCardClocks
+    // entry.
+    //
+    BOOLEAN CardClockClaimed;
+
+    //
+    // Performance counter value at which the isr put the first byte
+    // of the current timed write in the transmit fifo, and whether it
+    // has yet to.  The isr takes the stamp when the flag is set.
+    //
+    LONGLONG TimedWriteLaunchTime;
+    BOOLEAN TimedWriteStampPending;
+
+    //
+    // Performance counter value the timed write timer was last set to
+    // go off at, and how late it has been going off.  Close to the
+    // launch time the timer is set that much early so only the last
+    // SERIAL_TIMED_WRITE_SPIN_US have to be spun off.
+    //
+    LONGLONG TimedWriteTimerDue;
+    LONGLONG TimedWriteTimerSlack;
+
+    //
+    // Number of flushes waiting on the write queue.  A timed write is
+    // launched straight away while there are any, instead of holding
+    // the flush up until its launch time.
+    //
+    ULONG TimedWriteFlushes;
+
+    //
+    // Count of every character the isr has stored since the port
+    // was opened.  Receive timestamps are keyed by this count.
+    //
+    ULONGLONG RxStreamCount;
+
+    //
+    // Ring of receive timestamps, one per fifo burst.  Written by
+    // the isr, read by IOCTL_FASTCOM_READ_TIMESTAMPED.
+    //
+    struct serialfc_rx_timestamp RxTimestamps[SERIAL_RX_TIMESTAMP_RING];
+    ULONG RxTimestampFirst;
+    ULONG RxTimestampCount;
+
+#if LATENCY_HISTOGRAMS
+    //
+    // Log2 latency histograms, see IOCTL_FASTCOM_GET_LATENCY_HISTOGRAMS.
+    // The dpc stamps hold the counter value at which the isr queued
+    // the completion dpc, zero when the dpc has picked it up.
+    //
+    struct serialfc_latency_histograms LatencyHistograms;
+    LONGLONG ReadDpcQueuedTime;
+    LONGLONG WriteDpcQueuedTime;
+#endif
+
+    //
+    // Extended statistics, see IOCTL_FASTCOM_GET_EXT_STATS.  The
+    // holding start times are when TXHolding and RXHolding last went
+    // from clear to set.
+    //
+    struct serialfc_ext_stats ExtStats;
+    LONGLONG TXHoldingStart;
+    LONGLONG RXHoldingStart;
+
+    //
+    // Flight recorder, see IOCTL_FASTCOM_DUMP_TRACE.  Writers claim
+    // a slot by bumping TraceSequence, the slot is the new value - 1
+    // modulo the ring size.
+    //
+    struct serialfc_trace_entry Trace[SERIALFC_TRACE_ENTRIES];
+    volatile LONG TraceSequence;
 } SERIAL_DEVICE_EXTENSION,*PSERIAL_DEVICE_EXTENSION;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(SERIAL_DEVICE_EXTENSION,
@@ -1349,6 +1511,7 @@ typedef struct _REQUEST_CONTEXT {
     PSERIAL_DEVICE_EXTENSION Extension;
     ULONG IoctlCode;
     BOOLEAN MarkCancelableOnResume;
+    LONGLONG QueuedTime;
 } REQUEST_CONTEXT, *PREQUEST_CONTEXT;
 
 
@@ -1806,6 +1969,27 @@ do                                                               \
 
 extern SERIAL_FIRMWARE_DATA    driverDefaults;
 
+//
+// The clock bits last programmed into the clock generator of each 335
+// card, which is shared by all of the card's ports.  Cards are told
+// apart by their first BAR.  An entry is freed once the last of the
+// ports counted in Ports releases its hardware.  Protected by
+// SerialCardClockLock.
+//
+
+#define SERIAL_MAX_CARD_CLOCKS 16
+
+typedef struct _SERIAL_CARD_CLOCK {
+    UINT32 Bar0;
+    ULONG Ports;
+    ULONG Frequency;
+    ULONG ClockBits;
+    BOOLEAN Programmed;
+} SERIAL_CARD_CLOCK, *PSERIAL_CARD_CLOCK;
+
+extern SERIAL_CARD_CLOCK SerialCardClocks[SERIAL_MAX_CARD_CLOCKS];
+extern KSPIN_LOCK SerialCardClockLock;
+
 
 //
 // This is exported from the kernel.  It is used to point
@@ -1899,4 +2083,12 @@ enum FASTCOM_CARD_TYPE { CARD_TYPE_PCI, CARD_TYPE_PCIe, CARD_TYPE_FSCC, CARD_TYP
 #define VSTR_OFFSET 0x4c
 
 #define DEFAULT_FSCC_CLOCK_BITS {0x0f, 0x61, 0xe5, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x16, 0x40, 0x01, 0x04, 0x00, 0xff, 0xff, 0xff }
-#define DEFAULT_335_CLOCK_BITS 1049473
\ No newline at end of file
+#define DEFAULT_335_CLOCK_BITS 1049473
+
+/* Limits for IOCTL_FASTCOM_SET_CLOCK_RATE. FSCC rates are solved allowing
+   the same 10 ppm of error the examples use with calculate-clock-bits.c. */
+#define FSCC_MIN_CLOCK_RATE 200
+#define FSCC_MAX_CLOCK_RATE 270000000
+#define FSCC_CLOCK_RATE_PPM 10
+#define PCI_MIN_CLOCK_RATE 6000000
+#define PCI_MAX_CLOCK_RATE 180000000
\ No newline at end of file
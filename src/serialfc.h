@@ -49,4 +49,186 @@
 
 #define IOCTL_FASTCOM_SET_CLOCK_BITS CTL_CODE(SERIALFC_IOCTL_MAGIC, 0x81F, METHOD_BUFFERED, FILE_ANY_ACCESS)
 
+/* Input to IOCTL_FASTCOM_TIMED_WRITE, immediately followed by the data to
+   transmit. launch_time is an absolute QueryPerformanceCounter value. If an
+   output buffer is supplied the actual launch time is returned in it. */
+struct serialfc_timed_write {
+    LONGLONG launch_time;
+};
+
+#define IOCTL_FASTCOM_TIMED_WRITE CTL_CODE(SERIALFC_IOCTL_MAGIC, 0x820, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+/* Queueing latency of one transmit lane, from the write arriving at the
+   driver to it being handed to the UART. Times are in performance counter
+   counts, see frequency in struct serialfc_transmit_stats. */
+struct serialfc_lane_stats {
+    ULONGLONG requests;
+    ULONGLONG total_latency;
+    ULONGLONG max_latency;
+};
+
+struct serialfc_transmit_stats {
+    LONGLONG frequency;
+    struct serialfc_lane_stats normal;
+    struct serialfc_lane_stats priority;
+};
+
+#define IOCTL_FASTCOM_PRIORITY_WRITE CTL_CODE(SERIALFC_IOCTL_MAGIC, 0x821, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_FASTCOM_GET_TRANSMIT_STATS CTL_CODE(SERIALFC_IOCTL_MAGIC, 0x822, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_FASTCOM_CLEAR_TRANSMIT_STATS CTL_CODE(SERIALFC_IOCTL_MAGIC, 0x823, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+/* Receive timestamps. offset counts every byte received on the port since it
+   was opened, timestamp is the QueryPerformanceCounter value read when the
+   FIFO burst starting at that byte was serviced. */
+struct serialfc_rx_timestamp {
+    ULONGLONG offset;
+    LONGLONG timestamp;
+};
+
+#define SERIALFC_RX_TIMESTAMPS 32
+
+/* Output of IOCTL_FASTCOM_READ_TIMESTAMPED, immediately followed by
+   data_length bytes of data. offset is the stream offset of the first byte.
+   timestamps[0] is the burst the first byte arrived in, the rest are the
+   bursts that start inside the returned data. */
+struct serialfc_timestamped_read {
+    ULONGLONG offset;
+    ULONG data_length;
+    ULONG timestamp_count;
+    struct serialfc_rx_timestamp timestamps[SERIALFC_RX_TIMESTAMPS];
+};
+
+#define IOCTL_FASTCOM_READ_TIMESTAMPED CTL_CODE(SERIALFC_IOCTL_MAGIC, 0x824, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+/* Latency histograms, in performance counter counts. Bucket 0 counts zero
+   length intervals and bucket n counts intervals of 2^(n-1) up to 2^n - 1
+   counts. The last bucket also takes everything longer. */
+#define SERIALFC_LATENCY_BUCKETS 32
+
+struct serialfc_latency_histogram {
+    ULONGLONG max;
+    ULONGLONG buckets[SERIALFC_LATENCY_BUCKETS];
+};
+
+/* Output of IOCTL_FASTCOM_GET_LATENCY_HISTOGRAMS. An optional ULONG input,
+   if non-zero, clears the histograms once they have been read. */
+struct serialfc_latency_histograms {
+    LONGLONG frequency;
+    struct serialfc_latency_histogram isr; /* isr entry to exit */
+    struct serialfc_latency_histogram read_dpc; /* isr queueing the read completion dpc to it running */
+    struct serialfc_latency_histogram write_dpc; /* isr queueing the write completion dpc to it running */
+    struct serialfc_latency_histogram read_request; /* read arriving to being completed */
+    struct serialfc_latency_histogram write_request; /* write arriving to being completed */
+};
+
+#define IOCTL_FASTCOM_GET_LATENCY_HISTOGRAMS CTL_CODE(SERIALFC_IOCTL_MAGIC, 0x825, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+/* Output of IOCTL_FASTCOM_GET_EXT_STATS, also available through WMI as
+   FastcomSerial_ExtendedStatistics. Times are in performance counter counts.
+   IOCTL_SERIAL_CLEAR_STATS clears these along with the standard statistics. */
+struct serialfc_ext_stats {
+    LONGLONG frequency;
+    ULONGLONG rls_interrupts; /* interrupts by IIR cause */
+    ULONGLONG rda_interrupts;
+    ULONGLONG cti_interrupts;
+    ULONGLONG thr_interrupts;
+    ULONGLONG ms_interrupts;
+    ULONGLONG rx_bursts; /* receive FIFO bursts read by the isr */
+    ULONGLONG rx_burst_bytes; /* bytes read over all of those bursts */
+    ULONGLONG rx_burst_max; /* most bytes read in a single burst */
+    ULONGLONG tx_refills; /* transmit FIFO refills */
+    ULONGLONG buffer_high_water; /* most bytes held in the interrupt buffer */
+    ULONGLONG serial_overruns; /* receive FIFO overruns */
+    ULONGLONG buffer_overruns; /* interrupt buffer overruns */
+    ULONGLONG flow_control_assertions; /* times DTR, RTS or XOFF held off the other end */
+    ULONGLONG tx_holding_time; /* time transmit was held, TXHolding */
+    ULONGLONG rx_holding_time; /* time receive was held, RXHolding */
+};
+
+#define IOCTL_FASTCOM_GET_EXT_STATS CTL_CODE(SERIALFC_IOCTL_MAGIC, 0x826, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+/* Flight recorder events, see IOCTL_FASTCOM_DUMP_TRACE. */
+#define SERIALFC_TRACE_IIR 1 /* data is the IIR */
+#define SERIALFC_TRACE_LSR_ERROR 2 /* data is the LSR */
+#define SERIALFC_TRACE_REQUEST_START 3 /* info is the major function, data the length, extra the IOCTL */
+#define SERIALFC_TRACE_REQUEST_COMPLETE 4 /* info is the major function, data the status, extra the IOCTL */
+#define SERIALFC_TRACE_TX_HOLDING 5 /* data is the new TXHolding */
+#define SERIALFC_TRACE_RX_HOLDING 6 /* data is the new RXHolding */
+
+/* sequence starts at 1 and is 0 in an entry that was never written.
+   timestamp is a QueryPerformanceCounter value. */
+struct serialfc_trace_entry {
+    LONGLONG timestamp;
+    ULONG sequence;
+    USHORT event;
+    USHORT info;
+    ULONG data;
+    ULONG extra;
+};
+
+#define SERIALFC_TRACE_ENTRIES 1024
+
+/* Output of IOCTL_FASTCOM_DUMP_TRACE. entries are oldest first. */
+struct serialfc_trace {
+    LONGLONG frequency;
+    ULONG next_sequence;
+    ULONG entry_count;
+    struct serialfc_trace_entry entries[SERIALFC_TRACE_ENTRIES];
+};
+
+#define IOCTL_FASTCOM_DUMP_TRACE CTL_CODE(SERIALFC_IOCTL_MAGIC, 0x827, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+#define SERIALFC_CONFIG_VERSION 1
+
+/* Bits in serialfc_config.fields */
+#define SERIALFC_CONFIG_RS485 0x0001
+#define SERIALFC_CONFIG_SAMPLE_RATE 0x0002
+#define SERIALFC_CONFIG_TX_TRIGGER 0x0004
+#define SERIALFC_CONFIG_RX_TRIGGER 0x0008
+#define SERIALFC_CONFIG_TERMINATION 0x0010
+#define SERIALFC_CONFIG_ECHO_CANCEL 0x0020
+#define SERIALFC_CONFIG_ISOCHRONOUS 0x0040
+#define SERIALFC_CONFIG_FRAME_LENGTH 0x0080
+#define SERIALFC_CONFIG_NINE_BIT 0x0100
+#define SERIALFC_CONFIG_FIXED_BAUD_RATE 0x0200
+
+/* size must be sizeof(struct serialfc_config) and version
+   SERIALFC_CONFIG_VERSION. fields selects which settings
+   IOCTL_FASTCOM_SET_CONFIG applies; IOCTL_FASTCOM_GET_CONFIG sets it to
+   the settings the port supports. isochronous and fixed_baud_rate are -1
+   when disabled. */
+struct serialfc_config {
+    ULONG size;
+    ULONG version;
+    ULONG fields;
+    ULONG rs485;
+    ULONG sample_rate;
+    ULONG tx_trigger;
+    ULONG rx_trigger;
+    ULONG termination;
+    ULONG echo_cancel;
+    LONG isochronous;
+    ULONG frame_length;
+    ULONG nine_bit;
+    LONG fixed_baud_rate;
+};
+
+#define IOCTL_FASTCOM_SET_CONFIG CTL_CODE(SERIALFC_IOCTL_MAGIC, 0x828, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_FASTCOM_GET_CONFIG CTL_CODE(SERIALFC_IOCTL_MAGIC, 0x829, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+/* A clock, sample rate and divisor worked out together, see
+   calculate_baud_setting_* in calculate-clock-bits.c. clock_frequency is 0
+   to leave the clock alone and must be on PCIe, whose clock is fixed. The
+   low 4 bits of divisor are the fractional part on PCIe. */
+struct serialfc_baud_setting {
+    ULONG baud;
+    ULONG sample_rate;
+    ULONG divisor;
+    ULONG clock_frequency;
+    ULONG clock_bits_335;
+    UCHAR clock_bits_fscc[20];
+};
+
+#define IOCTL_FASTCOM_SET_BAUD_EXACT CTL_CODE(SERIALFC_IOCTL_MAGIC, 0x82A, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
 #endif
\ No newline at end of file
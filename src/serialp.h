@@ -52,6 +52,7 @@ EVT_WDF_FILE_CLOSE SerialEvtFileClose;
 EVT_WDF_IO_QUEUE_IO_READ SerialEvtIoRead;
 EVT_WDF_IO_QUEUE_IO_WRITE SerialEvtIoWrite;
 EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL SerialEvtIoDeviceControl;
+EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL SerialEvtIoClockRate;
 EVT_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL SerialEvtIoInternalDeviceControl;
 EVT_WDF_IO_QUEUE_IO_CANCELED_ON_QUEUE SerialEvtCanceledOnQueue;
 EVT_WDF_IO_QUEUE_IO_STOP SerialEvtIoStop;
@@ -64,6 +65,7 @@ EVT_WDF_DPC SerialCompleteRead;
 EVT_WDF_DPC SerialCompleteWrite;
 EVT_WDF_DPC SerialCommError;
 EVT_WDF_DPC SerialCompleteImmediate;
+EVT_WDF_DPC SerialCompletePriority;
 EVT_WDF_DPC SerialCompleteXoff;
 EVT_WDF_DPC SerialCompleteWait;
 EVT_WDF_DPC SerialStartTimerLowerRTS;
@@ -72,8 +74,10 @@ EVT_WDF_TIMER SerialReadTimeout;
 EVT_WDF_TIMER SerialIntervalReadTimeout;
 EVT_WDF_TIMER SerialWriteTimeout;
 EVT_WDF_TIMER SerialTimeoutImmediate;
+EVT_WDF_TIMER SerialTimeoutPriority;
 EVT_WDF_TIMER SerialTimeoutXoff;
 EVT_WDF_TIMER SerialInvokePerhapsLowerRTS;
+EVT_WDF_TIMER SerialTimedWriteLaunch;
 
 VOID
 SerialStartRead(
@@ -95,6 +99,55 @@ SerialStartImmediate(
     IN PSERIAL_DEVICE_EXTENSION Extension
     );
 
+VOID
+SerialStartPriority(
+    IN PSERIAL_DEVICE_EXTENSION Extension
+    );
+
+VOID
+SerialFlushTimedWrite(
+    IN PSERIAL_DEVICE_EXTENSION Extension
+    );
+
+VOID
+SerialUpdateLaneStats(
+    IN struct serialfc_lane_stats *Stats,
+    IN PREQUEST_CONTEXT ReqContext
+    );
+
+VOID
+SerialRecordRxTimestamp(
+    IN PSERIAL_DEVICE_EXTENSION Extension
+    );
+
+VOID
+SerialRecordLatency(
+    IN struct serialfc_latency_histogram *Histogram,
+    IN LONGLONG StartTime
+    );
+
+VOID
+SerialChangeHolding(
+    IN PSERIAL_DEVICE_EXTENSION Extension,
+    IN PULONG Holding,
+    IN ULONG NewHolding
+    );
+
+VOID
+SerialTrace(
+    IN PSERIAL_DEVICE_EXTENSION Extension,
+    IN USHORT Event,
+    IN USHORT Info,
+    IN ULONG Data,
+    IN ULONG Extra
+    );
+
+VOID
+SerialDumpTrace(
+    IN PSERIAL_DEVICE_EXTENSION Extension,
+    OUT struct serialfc_trace *Trace
+    );
+
 VOID
 SerialStartPurge(
     IN PSERIAL_DEVICE_EXTENSION Extension
@@ -127,6 +180,7 @@ SerialFileCloseWorker(
     );
 
 EVT_WDF_INTERRUPT_SYNCHRONIZE SerialProcessEmptyTransmit;
+EVT_WDF_INTERRUPT_SYNCHRONIZE SerialLaunchTimedWrite;
 EVT_WDF_INTERRUPT_SYNCHRONIZE SerialSetDTR;
 EVT_WDF_INTERRUPT_SYNCHRONIZE SerialClrDTR;
 EVT_WDF_INTERRUPT_SYNCHRONIZE SerialSetRTS;
@@ -144,6 +198,12 @@ EVT_WDF_INTERRUPT_SYNCHRONIZE SerialMarkOpen;
 EVT_WDF_INTERRUPT_SYNCHRONIZE SerialMarkClose;
 EVT_WDF_INTERRUPT_SYNCHRONIZE SerialGetStats;
 EVT_WDF_INTERRUPT_SYNCHRONIZE SerialClearStats;
+EVT_WDF_INTERRUPT_SYNCHRONIZE SerialGetTransmitStats;
+EVT_WDF_INTERRUPT_SYNCHRONIZE SerialClearTransmitStats;
+EVT_WDF_INTERRUPT_SYNCHRONIZE SerialGetTimestampedChars;
+EVT_WDF_INTERRUPT_SYNCHRONIZE SerialGetLatencyHistograms;
+EVT_WDF_INTERRUPT_SYNCHRONIZE SerialGetExtStats;
+EVT_WDF_INTERRUPT_SYNCHRONIZE SerialSetConfig;
 EVT_WDF_INTERRUPT_SYNCHRONIZE SerialSetChars;
 EVT_WDF_INTERRUPT_SYNCHRONIZE SerialSetMCRContents;
 EVT_WDF_INTERRUPT_SYNCHRONIZE SerialGetMCRContents;
@@ -577,6 +637,65 @@ typedef struct _SERIAL_IOCTL_SYNC {
 
 #define SERIAL_TEST_REFERENCE(ReqContext, RefType) ((ULONG_PTR)ReqContext ->RefCount & RefType)
 
+//
+// A timed write is a device control masquerading as a write, the
+// same way the xoff counter does.
+//
+#define SERIAL_IS_TIMED_WRITE(ReqContext) \
+    (((ReqContext)->MajorFunction == IRP_MJ_DEVICE_CONTROL) && \
+     ((ReqContext)->IoctlCode == IOCTL_FASTCOM_TIMED_WRITE))
+
+//
+// The timed write timer is first set to go off this far (in
+// microseconds) ahead of the launch time, then set again for the last
+// SERIAL_TIMED_WRITE_SPIN_US, which the timer routine spins off without
+// the device lock.
+//
+#define SERIAL_TIMED_WRITE_LEAD_US 500
+#define SERIAL_TIMED_WRITE_SPIN_US 2
+
+//
+// Stamp the time the isr queues a completion dpc and record it once
+// the dpc runs.  A dpc that is already queued keeps its first stamp.
+//
+#if LATENCY_HISTOGRAMS
+#define SERIAL_STAMP_DPC(QueuedTime) \
+   do { \
+       if (!(QueuedTime)) { \
+           (QueuedTime) = KeQueryPerformanceCounter(NULL).QuadPart; \
+       } \
+   } WHILE (0)
+
+#define SERIAL_RECORD_DPC(Histogram, QueuedTime) \
+   do { \
+       LONGLONG _queuedTime = InterlockedExchange64(&(QueuedTime), 0); \
+       if (_queuedTime) { \
+           SerialRecordLatency(&(Histogram), _queuedTime); \
+       } \
+   } WHILE (0)
+#else
+#define SERIAL_STAMP_DPC(QueuedTime) do { } WHILE (0)
+#define SERIAL_RECORD_DPC(Histogram, QueuedTime) do { } WHILE (0)
+#endif
+
+//
+// All changes to TXHolding and RXHolding go through these so the
+// extended statistics can time them.
+//
+#define SERIAL_SET_HOLDING(Extension, Holding, Bits) \
+    SerialChangeHolding((Extension), &(Extension)->Holding, \
+                        (Extension)->Holding | (Bits))
+
+#define SERIAL_CLEAR_HOLDING(Extension, Holding, Bits) \
+    SerialChangeHolding((Extension), &(Extension)->Holding, \
+                        (Extension)->Holding & ~(Bits))
+
+//
+// WMI block for the extended statistics, see serialfc.mof.
+//
+DEFINE_GUID(FastcomSerial_ExtendedStatistics_GUID,
+    0x7c39d5c6, 0xcd4b, 0x447c, 0x8a, 0x9d, 0x2b, 0x00, 0xbe, 0xe4, 0xc4, 0x56);
+
 //
 // Prototypes and defines to handle processor groups.
 //
@@ -632,6 +751,12 @@ NTSTATUS FastcomGetRS485(SERIAL_DEVICE_EXTENSION *pDevExt, BOOLEAN *enabled);
 
 NTSTATUS FastcomSetClockBitsFSCC(SERIAL_DEVICE_EXTENSION *pDevExt, struct clock_data_fscc *clock_data);
 NTSTATUS FastcomSetClockBitsPCI(SERIAL_DEVICE_EXTENSION *pDevExt, struct clock_data_335 *clock_data);
+PSERIAL_CARD_CLOCK FastcomFindCardClock(SERIAL_DEVICE_EXTENSION *pDevExt, BOOLEAN claim);
+void FastcomReleaseCardClock(SERIAL_DEVICE_EXTENSION *pDevExt);
+void FastcomForgetClockBits(SERIAL_DEVICE_EXTENSION *pDevExt);
+BOOLEAN FastcomStandardClockFSCC(ULONG rate, struct clock_data_fscc *clock_data);
+BOOLEAN FastcomStandardClockPCI(ULONG rate, struct clock_data_335 *clock_data);
+NTSTATUS FastcomSetClockRate(SERIAL_DEVICE_EXTENSION *pDevExt, ULONG rate);
 
 NTSTATUS FastcomSetIsochronous(SERIAL_DEVICE_EXTENSION *pDevExt, int mode);
 NTSTATUS FastcomEnableIsochronous(SERIAL_DEVICE_EXTENSION *pDevExt, unsigned mode);
@@ -656,6 +781,12 @@ void FastcomEnableFixedBaudRate(SERIAL_DEVICE_EXTENSION *pDevExt, unsigned rate)
 void FastcomDisableFixedBaudRate(SERIAL_DEVICE_EXTENSION *pDevExt);
 void FastcomGetFixedBaudRate(SERIAL_DEVICE_EXTENSION *pDevExt, int *rate);
 
+ULONG FastcomGetConfigFields(SERIAL_DEVICE_EXTENSION *pDevExt);
+void FastcomGetConfig(SERIAL_DEVICE_EXTENSION *pDevExt, struct serialfc_config *config);
+NTSTATUS FastcomCheckConfig(SERIAL_DEVICE_EXTENSION *pDevExt, struct serialfc_config *config, ULONG *bad_fields);
+ULONG FastcomGetConfigChanges(SERIAL_DEVICE_EXTENSION *pDevExt, struct serialfc_config *config);
+void FastcomApplyConfig(SERIAL_DEVICE_EXTENSION *pDevExt, struct serialfc_config *config, ULONG fields);
+
 NTSTATUS FsccIsOpenedInSync(SERIAL_DEVICE_EXTENSION *pDevExt, BOOLEAN *status);
 NTSTATUS FsccEnableAsync(SERIAL_DEVICE_EXTENSION *pDevExt);
 NTSTATUS FsccDisableAsync(SERIAL_DEVICE_EXTENSION *pDevExt);
@@ -665,6 +796,8 @@ UCHAR FsccGetPrev(SERIAL_DEVICE_EXTENSION *pDevExt);
 UINT16 FsccGetPdev(SERIAL_DEVICE_EXTENSION *pDevExt);
 
 NTSTATUS PCIeSetBaudRate(SERIAL_DEVICE_EXTENSION *pDevExt, unsigned value);
+void PCIeSetDivisor(SERIAL_DEVICE_EXTENSION *pDevExt, unsigned divisor);
+NTSTATUS FastcomSetBaudExact(SERIAL_DEVICE_EXTENSION *pDevExt, struct serialfc_baud_setting *setting);
 NTSTATUS FastcomGetTxFifoSpace(SERIAL_DEVICE_EXTENSION *pDevExt, ULONG *value);
 
 enum FASTCOM_CARD_TYPE FastcomGetCardType(SERIAL_DEVICE_EXTENSION *pDevExt);
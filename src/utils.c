@@ -19,6 +19,8 @@ Environment:
 --*/
 
 #include "precomp.h"
+#include "clockgen.h"
+#include "../lib/raw/clock-table-standard.h"
 
 #if defined(EVENT_TRACING)
 #include "utils.tmh"
@@ -701,6 +703,13 @@ Return Value:
 
     reqContext = SerialGetRequestContext(Request);
 
+    //
+    // Remember when the request arrived so the transmit lanes can
+    // account for their queueing latency.
+    //
+
+    reqContext->QueuedTime = KeQueryPerformanceCounter(NULL).QuadPart;
+
     WDF_REQUEST_PARAMETERS_INIT(&params);
 
     WdfRequestGetParameters(
@@ -724,8 +733,25 @@ Return Value:
 
         Extension->TotalCharsQueued++;
 
+    } else if ((params.Type == WdfRequestTypeDeviceControl) &&
+               ((params.Parameters.DeviceIoControl.IoControlCode == IOCTL_FASTCOM_TIMED_WRITE) ||
+                (params.Parameters.DeviceIoControl.IoControlCode == IOCTL_FASTCOM_PRIORITY_WRITE))) {
+
+        reqContext->IoctlCode = params.Parameters.DeviceIoControl.IoControlCode; // We need this in the destroy callback
+
+        Extension->TotalCharsQueued += reqContext->Length;
+
     }
 
+    SerialTrace(
+        Extension,
+        SERIALFC_TRACE_REQUEST_START,
+        (USHORT)reqContext->MajorFunction,
+        reqContext->Length,
+        (params.Type == WdfRequestTypeDeviceControl) ?
+            params.Parameters.DeviceIoControl.IoControlCode : 0
+        );
+
     if (IsQueueEmpty(QueueToExamine) &&  !(*CurrentOpRequest)) {
 
         //
@@ -821,6 +847,11 @@ Return Value:
 
             extension->TotalCharsQueued--;
 
+        } else if ((reqContext->IoctlCode ==  IOCTL_FASTCOM_TIMED_WRITE) ||
+                   (reqContext->IoctlCode ==  IOCTL_FASTCOM_PRIORITY_WRITE)) {
+
+            extension->TotalCharsQueued -= reqContext->Length;
+
         } else if (reqContext->IoctlCode ==  IOCTL_SERIAL_SET_QUEUE_SIZE) {
 
             //
@@ -1002,6 +1033,31 @@ Return Value:
       return status;
    }
 
+   //
+   // This timer holds a timed write until just before its launch
+   // time and then hands it to the isr.  It is a high resolution
+   // timer so the launch doesn't wait on the system clock tick.  Its
+   // routine takes the device lock itself so it can spin off the last
+   // few microseconds without it.
+   //
+
+   WDF_TIMER_CONFIG_INIT(&timerConfig,    SerialTimedWriteLaunch);
+
+   timerConfig.AutomaticSerialization = FALSE;
+   timerConfig.UseHighResolutionTimer = WdfTrue;
+
+   WDF_OBJECT_ATTRIBUTES_INIT(&timerAttributes);
+   timerAttributes.ParentObject = pDevExt->WdfDevice;
+
+   status = WdfTimerCreate(&timerConfig,
+                                &timerAttributes,
+                                &pDevExt->TimedWriteTimer);
+
+   if (!NT_SUCCESS(status)) {
+      SerialDbgPrintEx(TRACE_LEVEL_ERROR, DBG_PNP,  "WdfTimerCreate(TimedWriteTimer) failed  [%#08lx]\n",   status);
+      return status;
+   }
+
    //
    // This dpc is fired off if the transmit immediate char
    // character times out.  The dpc routine will "grab" the
@@ -1023,6 +1079,27 @@ Return Value:
       return status;
    }
 
+   //
+   // This dpc is fired off if the timer for the total timeout
+   // for the priority write expires.  The dpc routine will "grab"
+   // the request from the isr and time it out.
+   //
+   WDF_TIMER_CONFIG_INIT(&timerConfig,   SerialTimeoutPriority);
+
+   timerConfig.AutomaticSerialization = TRUE;
+
+   WDF_OBJECT_ATTRIBUTES_INIT(&timerAttributes);
+   timerAttributes.ParentObject = pDevExt->WdfDevice;
+
+   status = WdfTimerCreate(&timerConfig,
+                           &timerAttributes,
+                                        &pDevExt->PriorityTotalTimer);
+
+   if (!NT_SUCCESS(status)) {
+      SerialDbgPrintEx(TRACE_LEVEL_ERROR, DBG_PNP,  "WdfTimerCreate(PriorityTotalTimer) failed  [%#08lx]\n",   status);
+      return status;
+   }
+
    //
    // This dpc is fired off if the timer used to "timeout" counting
    // the number of characters received after the Xoff ioctl is started
@@ -1150,6 +1227,27 @@ Return Value:
         return status;
     }
 
+    //
+    // This dpc is fired off when the last character of a priority
+    // write is given to the hardware.  It will complete the request
+    // and start the next one.
+    //
+
+   WDF_DPC_CONFIG_INIT(&dpcConfig, SerialCompletePriority);
+
+   dpcConfig.AutomaticSerialization = TRUE;
+
+   WDF_OBJECT_ATTRIBUTES_INIT(&dpcAttributes);
+   dpcAttributes.ParentObject = pDevExt->WdfDevice;
+
+   status = WdfDpcCreate(&dpcConfig,
+                                    &dpcAttributes,
+                                    &pDevExt->CompletePriorityDpc);
+    if (!NT_SUCCESS(status)) {
+        SerialDbgPrintEx(TRACE_LEVEL_ERROR, DBG_PNP,  "WdfDpcCreate(CompletePriorityDpc) failed  [%#08lx]\n",   status);
+        return status;
+    }
+
     //
     // This dpc is fired off if an event occurs and there was
     // a request waiting on that event.  A dpc routine will execute
@@ -1304,8 +1402,12 @@ Return Value:
 
     WdfTimerStop(PDevExt->WriteRequestTotalTimer, TRUE);
 
+    WdfTimerStop(PDevExt->TimedWriteTimer, TRUE);
+
     WdfTimerStop(PDevExt->ImmediateTotalTimer, TRUE);
 
+    WdfTimerStop(PDevExt->PriorityTotalTimer, TRUE);
+
     WdfTimerStop(PDevExt->XoffCountTimer, TRUE);
 
     WdfTimerStop(PDevExt->LowerRTSTimer, TRUE);
@@ -1318,6 +1420,8 @@ Return Value:
 
     WdfDpcCancel(PDevExt->CompleteImmediateDpc, TRUE);
 
+    WdfDpcCancel(PDevExt->CompletePriorityDpc, TRUE);
+
     WdfDpcCancel(PDevExt->CommWaitDpc, TRUE);
 
     WdfDpcCancel(PDevExt->XoffCountCompleteDpc, TRUE);
@@ -1938,6 +2042,7 @@ SerialCompleteRequest(
     )
 {
     PREQUEST_CONTEXT reqContext;
+    PSERIAL_DEVICE_EXTENSION extension;
 
     reqContext = SerialGetRequestContext(Request);
 
@@ -1947,10 +2052,203 @@ SerialCompleteRequest(
                      "Complete Request: %p %X 0x%I64x\n",
                      (Request), (Status), (Info));
 
+    extension = SerialGetDeviceExtension(
+                    WdfIoQueueGetDevice(WdfRequestGetIoQueue(Request)));
+
+    SerialTrace(
+        extension,
+        SERIALFC_TRACE_REQUEST_COMPLETE,
+        (USHORT)reqContext->MajorFunction,
+        (ULONG)Status,
+        reqContext->IoctlCode
+        );
+
+#if LATENCY_HISTOGRAMS
+    //
+    // Only reads and writes that went through SerialStartOrQueue
+    // have an arrival time.
+    //
+
+    if (reqContext->QueuedTime &&
+        (reqContext->MajorFunction == IRP_MJ_READ ||
+         reqContext->MajorFunction == IRP_MJ_WRITE)) {
+
+        SerialRecordLatency(
+            (reqContext->MajorFunction == IRP_MJ_READ) ?
+                &extension->LatencyHistograms.read_request :
+                &extension->LatencyHistograms.write_request,
+            reqContext->QueuedTime
+            );
+
+    }
+#endif
+
     WdfRequestCompleteWithInformation((Request), (Status), (Info));
 
 }
 
+#if LATENCY_HISTOGRAMS
+VOID
+SerialRecordLatency(
+    IN struct serialfc_latency_histogram *Histogram,
+    IN LONGLONG StartTime
+    )
+
+/*++
+
+Routine Description:
+
+    Add the time since StartTime to a log2 latency histogram.  The
+    histograms are only ever cleared in sync with the isr, so a sample
+    recorded outside of it at the same moment may be lost.  That is
+    the price of not taking a lock here.
+
+Arguments:
+
+    Histogram - The histogram to add the sample to.
+
+    StartTime - Performance counter value the interval started at.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    ULONGLONG latency;
+    ULONG bucket;
+    ULONG index;
+
+    latency = KeQueryPerformanceCounter(NULL).QuadPart - StartTime;
+
+    //
+    // _BitScanReverse64 isn't available on x86.
+    //
+
+    if (latency >> 32) {
+
+        bucket = SERIALFC_LATENCY_BUCKETS - 1;
+
+    } else if (_BitScanReverse(&index, (ULONG)latency)) {
+
+        bucket = min(index + 1, SERIALFC_LATENCY_BUCKETS - 1);
+
+    } else {
+
+        bucket = 0;
+
+    }
+
+    Histogram->buckets[bucket]++;
+
+    if (latency > Histogram->max) {
+
+        Histogram->max = latency;
+
+    }
+
+}
+#endif
+
+VOID
+SerialTrace(
+    IN PSERIAL_DEVICE_EXTENSION Extension,
+    IN USHORT Event,
+    IN USHORT Info,
+    IN ULONG Data,
+    IN ULONG Extra
+    )
+
+/*++
+
+Routine Description:
+
+    Append an event to the flight recorder.  This is called from the
+    isr, dpcs and request paths alike, so the slot is claimed with a
+    single interlocked increment and nothing else is locked.  A dump
+    taken while an entry is being filled in may see it half written,
+    the decoder sorts that out by its sequence number.
+
+Arguments:
+
+    Extension - A pointer to the device extension.
+
+    Event - One of the SERIALFC_TRACE_* events.
+
+    Info, Data, Extra - Event specific, see serialfc.h.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    struct serialfc_trace_entry *entry;
+    ULONG sequence;
+
+    C_ASSERT((SERIALFC_TRACE_ENTRIES & (SERIALFC_TRACE_ENTRIES - 1)) == 0);
+
+    sequence = (ULONG)InterlockedIncrement(&Extension->TraceSequence);
+    entry = &Extension->Trace[(sequence - 1) & (SERIALFC_TRACE_ENTRIES - 1)];
+
+    entry->timestamp = KeQueryPerformanceCounter(NULL).QuadPart;
+    entry->event = Event;
+    entry->info = Info;
+    entry->data = Data;
+    entry->extra = Extra;
+    entry->sequence = sequence;
+
+}
+
+VOID
+SerialDumpTrace(
+    IN PSERIAL_DEVICE_EXTENSION Extension,
+    OUT struct serialfc_trace *Trace
+    )
+
+/*++
+
+Routine Description:
+
+    Take a snapshot of the flight recorder, oldest entry first.  The
+    recorder keeps running while it is copied.
+
+Arguments:
+
+    Extension - A pointer to the device extension.
+
+    Trace - Where to put the snapshot.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    LARGE_INTEGER frequency;
+    ULONG next;
+    ULONG i;
+
+    KeQueryPerformanceCounter(&frequency);
+
+    next = (ULONG)Extension->TraceSequence + 1;
+
+    Trace->frequency = frequency.QuadPart;
+    Trace->next_sequence = next;
+    Trace->entry_count = min(next - 1, SERIALFC_TRACE_ENTRIES);
+
+    for (i = 0; i < SERIALFC_TRACE_ENTRIES; i++) {
+
+        Trace->entries[i] =
+            Extension->Trace[(next - 1 + i) & (SERIALFC_TRACE_ENTRIES - 1)];
+
+    }
+
+}
+
 
 /*****************************************************************************
  * Direct R/W from config space.
@@ -2126,6 +2424,10 @@ NTSTATUS FastcomSetSampleRate(SERIAL_DEVICE_EXTENSION *pDevExt, unsigned value)
         SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_PNP,
                          "Sample rate = %i\n", value);
 
+        /* An exact divisor was only right for the old sample rate */
+        if (value != pDevExt->SampleRate)
+            pDevExt->ExactDivisor = 0;
+
         pDevExt->SampleRate = value;
     }
 
@@ -2574,19 +2876,11 @@ void FastcomDisableRS485(SERIAL_DEVICE_EXTENSION *pDevExt)
     FastcomSetRS485(pDevExt, FALSE);
 }
 
-NTSTATUS FastcomSetIsochronousFSCC(SERIAL_DEVICE_EXTENSION *pDevExt, int mode)
+void FastcomGetIsochronousBitsFSCC(int mode, UCHAR *cks, UCHAR *mdm)
 {
-    UCHAR orig_lcr;
     UCHAR new_cks = 0;
     UCHAR new_mdm = 0;
 
-    if (mode > 10 || mode < -1)
-        return STATUS_INVALID_PARAMETER;
-
-    orig_lcr = READ_LINE_CONTROL(pDevExt, pDevExt->Controller);
-
-    WRITE_LINE_CONTROL(pDevExt, pDevExt->Controller, 0); /* Ensure last LCR value is not 0xbf */
-
     switch (mode) {
     /* Enable receive using external DSR# */
     case 2:
@@ -2633,6 +2927,25 @@ NTSTATUS FastcomSetIsochronousFSCC(SERIAL_DEVICE_EXTENSION *pDevExt, int mode)
         break;
     }
 
+    *cks = new_cks;
+    *mdm = new_mdm;
+}
+
+NTSTATUS FastcomSetIsochronousFSCC(SERIAL_DEVICE_EXTENSION *pDevExt, int mode)
+{
+    UCHAR orig_lcr;
+    UCHAR new_cks;
+    UCHAR new_mdm;
+
+    if (mode > 10 || mode < -1)
+        return STATUS_INVALID_PARAMETER;
+
+    FastcomGetIsochronousBitsFSCC(mode, &new_cks, &new_mdm);
+
+    orig_lcr = READ_LINE_CONTROL(pDevExt, pDevExt->Controller);
+
+    WRITE_LINE_CONTROL(pDevExt, pDevExt->Controller, 0); /* Ensure last LCR value is not 0xbf */
+
     pDevExt->SerialWriteUChar(pDevExt->Controller + SPR_OFFSET, MDM_OFFSET); /* To allow access to MDM */
     pDevExt->SerialWriteUChar(pDevExt->Controller + ICR_OFFSET, new_mdm); /* Set interrupts to MDM through ICR */
 
@@ -3009,6 +3322,13 @@ NTSTATUS FastcomSetClockBitsFSCC(SERIAL_DEVICE_EXTENSION *pDevExt, struct clock_
     }
 #endif
 
+    if (pDevExt->ClockProgrammed &&
+        RtlEqualMemory(pDevExt->ClockBits, clock_data->clock_bits, sizeof(pDevExt->ClockBits))) {
+        SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_PNP, "Clock generator already programmed\n");
+        pDevExt->ClockRate = clock_data->frequency;
+        pDevExt->ClockFrequency = clock_data->frequency;
+        return STATUS_SUCCESS;
+    }
 
     data = (UINT32 *)ExAllocatePool2(POOL_FLAG_NON_PAGED, sizeof(UINT32) * 323, 'stiB');
 
@@ -3054,61 +3374,247 @@ NTSTATUS FastcomSetClockBitsFSCC(SERIAL_DEVICE_EXTENSION *pDevExt, struct clock_
     pDevExt->ClockRate = clock_data->frequency;
     ExFreePoolWithTag (data, 'stiB');
 
+    RtlCopyMemory(pDevExt->ClockBits, clock_data->clock_bits, sizeof(pDevExt->ClockBits));
+    pDevExt->ClockFrequency = clock_data->frequency;
+    pDevExt->ClockProgrammed = TRUE;
+
     return STATUS_SUCCESS;
 }
 
-#define MPIO_SDTA           0x01    //Each bit of MPIOLVL register
-#define MPIO_SCLK           0x02
-#define MPIO_SSTB           0x04
-NTSTATUS FastcomSetClockBitsPCI(SERIAL_DEVICE_EXTENSION *pDevExt, struct clock_data_335 *clock_data)
+/* Returns the clock generator state of the 335 card the port is on. If
+   claim is set a free entry is taken for a card that isn't known yet and
+   the port is counted as one of the entry's until
+   FastcomReleaseCardClock. SerialCardClockLock must be held. */
+PSERIAL_CARD_CLOCK FastcomFindCardClock(SERIAL_DEVICE_EXTENSION *pDevExt, BOOLEAN claim)
 {
-    unsigned long tempValue = 0;
-    unsigned char data = 0;
-    unsigned char saved = 0;
-    unsigned long i = 0;
+    PSERIAL_CARD_CLOCK entry = NULL;
+    PSERIAL_CARD_CLOCK free_entry = NULL;
+    unsigned i;
 
+    for (i = 0; i < SERIAL_MAX_CARD_CLOCKS; i++) {
+        if (SerialCardClocks[i].Bar0 == pDevExt->Bar0) {
+            entry = &SerialCardClocks[i];
+            break;
+        }
 
-    SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_PNP, "Com Port Setting ClockRate(335): %i\n", clock_data->frequency);
+        if (free_entry == NULL && SerialCardClocks[i].Bar0 == 0)
+            free_entry = &SerialCardClocks[i];
+    }
+
+    if (!claim)
+        return entry;
+
+    if (entry == NULL && free_entry) {
+        RtlZeroMemory(free_entry, sizeof(*free_entry));
+        free_entry->Bar0 = pDevExt->Bar0;
+
+        entry = free_entry;
+    }
+
+    if (entry && !pDevExt->CardClockClaimed) {
+        entry->Ports++;
+        pDevExt->CardClockClaimed = TRUE;
+    }
+
+    return entry;
+}
+
+/* Called when the port gives up its hardware. Once no port of the card is
+   left its entry is freed, so the table doesn't fill up with cards that
+   are gone and a card that turns up later at the same BAR doesn't take
+   on the old card's clock. */
+void FastcomReleaseCardClock(SERIAL_DEVICE_EXTENSION *pDevExt)
+{
+    PSERIAL_CARD_CLOCK card_clock;
+    KIRQL oldIrql;
+
+    if (!pDevExt->CardClockClaimed)
+        return;
+
+    KeAcquireSpinLock(&SerialCardClockLock, &oldIrql);
 
-    tempValue = (clock_data->clock_bits & 0x00ffffff);
+    card_clock = FastcomFindCardClock(pDevExt, FALSE);
 
-    data = saved = pDevExt->SerialReadUChar(pDevExt->Controller + MPIOLVL_OFFSET);
+    if (card_clock && card_clock->Ports && --card_clock->Ports == 0)
+        RtlZeroMemory(card_clock, sizeof(*card_clock));
 
-    for (i = 0; i < 24; i++) {
-        // data bit set
-        if ((tempValue & 0x800000) != 0)
-            data |= MPIO_SDTA;
-        else
-            data &= ~MPIO_SDTA;
+    pDevExt->CardClockClaimed = FALSE;
 
-        pDevExt->SerialWriteUChar(pDevExt->Controller + MPIOLVL_OFFSET, data);
+    KeReleaseSpinLock(&SerialCardClockLock, oldIrql);
+}
+
+void FastcomProgramClockPCI(SERIAL_DEVICE_EXTENSION *pDevExt, ULONG clock_bits)
+{
+    unsigned char waveform[CLOCKGEN_335_WAVEFORM_SIZE];
+    unsigned char saved;
+    unsigned count;
+
+    saved = pDevExt->SerialReadUChar(pDevExt->Controller + MPIOLVL_OFFSET);
+
+    count = ClockGen335Waveform(saved, clock_bits, waveform);
+
+    pDevExt->SerialWriteUChars(pDevExt->Controller + MPIOLVL_OFFSET, waveform, count);
+}
+
+NTSTATUS FastcomSetClockBitsPCI(SERIAL_DEVICE_EXTENSION *pDevExt, struct clock_data_335 *clock_data)
+{
+    PSERIAL_CARD_CLOCK card_clock;
+    ULONG clock_bits;
+    KIRQL oldIrql;
+
+    SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_PNP, "Com Port Setting ClockRate(335): %i\n", clock_data->frequency);
 
-        // clock high, data still there
-        data |= MPIO_SCLK;
-        pDevExt->SerialWriteUChar(pDevExt->Controller + MPIOLVL_OFFSET, data);
+    clock_bits = clock_data->clock_bits & 0x00ffffff;
 
-        // clock low, data still there
-        data &= MPIO_SDTA;
-        pDevExt->SerialWriteUChar(pDevExt->Controller + MPIOLVL_OFFSET, data);
+    /* The lock also keeps two ports of a card from clocking bits into the
+       shared generator at the same time. */
+    KeAcquireSpinLock(&SerialCardClockLock, &oldIrql);
 
-        tempValue <<= 1;
+    card_clock = FastcomFindCardClock(pDevExt, TRUE);
+
+    if (card_clock && card_clock->Programmed && card_clock->ClockBits == clock_bits) {
+        SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_PNP, "Clock generator already programmed\n");
     }
+    else {
+        FastcomProgramClockPCI(pDevExt, clock_bits);
 
-    data &= 0xF8;
-    data |= MPIO_SSTB; // strobe on
-    pDevExt->SerialWriteUChar(pDevExt->Controller + MPIOLVL_OFFSET, data);
+        if (card_clock) {
+            card_clock->ClockBits = clock_bits;
+            card_clock->Programmed = TRUE;
+        }
+    }
 
-    data &= ~MPIO_SSTB; // all off
-    pDevExt->SerialWriteUChar(pDevExt->Controller + MPIOLVL_OFFSET, data);
+    if (card_clock)
+        card_clock->Frequency = clock_data->frequency;
 
-    // Put MPIO pins back to saved state
-    pDevExt->SerialWriteUChar(pDevExt->Controller + MPIOLVL_OFFSET, saved);
+    KeReleaseSpinLock(&SerialCardClockLock, oldIrql);
 
     pDevExt->ClockRate = clock_data->frequency;
     return 0;
 
 }
 
+/* Called when the port leaves D0 and the clock generator might lose
+   power, so the next SerialFcInit programs it again. */
+void FastcomForgetClockBits(SERIAL_DEVICE_EXTENSION *pDevExt)
+{
+    PSERIAL_CARD_CLOCK card_clock;
+    KIRQL oldIrql;
+
+    switch (FastcomGetCardType(pDevExt)) {
+    case CARD_TYPE_FSCC:
+        pDevExt->ClockProgrammed = FALSE;
+        break;
+
+    case CARD_TYPE_PCI:
+        KeAcquireSpinLock(&SerialCardClockLock, &oldIrql);
+
+        card_clock = FastcomFindCardClock(pDevExt, FALSE);
+
+        if (card_clock)
+            card_clock->Programmed = FALSE;
+
+        KeReleaseSpinLock(&SerialCardClockLock, oldIrql);
+        break;
+
+    default:
+        break;
+    }
+}
+
+/* Fills in clock_data from clock_table_standard_fscc, for the common rates
+   that don't need to be searched for. */
+BOOLEAN FastcomStandardClockFSCC(ULONG rate, struct clock_data_fscc *clock_data)
+{
+    unsigned i;
+
+    for (i = 0; i < CLOCK_TABLE_STANDARD_FSCC_SIZE; i++) {
+        if (clock_table_standard_fscc[i].frequency != rate)
+            continue;
+
+        if (clock_table_standard_fscc[i].ppm > FSCC_CLOCK_RATE_PPM)
+            return FALSE;
+
+        clock_data->frequency = clock_table_standard_fscc[i].actual;
+        RtlCopyMemory(clock_data->clock_bits, clock_table_standard_fscc[i].bits, sizeof(clock_data->clock_bits));
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+BOOLEAN FastcomStandardClockPCI(ULONG rate, struct clock_data_335 *clock_data)
+{
+    unsigned i;
+
+    for (i = 0; i < CLOCK_TABLE_STANDARD_335_SIZE; i++) {
+        if (clock_table_standard_335[i].frequency == rate) {
+            clock_data->frequency = clock_table_standard_335[i].actual;
+            clock_data->clock_bits = clock_table_standard_335[i].bits;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Works out the clock bits for rate and programs them. This is called at
+   passive level without the device lock because the search can take tens
+   of milliseconds, and only takes the lock to program the clock. */
+NTSTATUS FastcomSetClockRate(SERIAL_DEVICE_EXTENSION *pDevExt, ULONG rate)
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    int error = 0;
+
+    switch (FastcomGetCardType(pDevExt)) {
+    case CARD_TYPE_FSCC: {
+        struct clock_data_fscc clock_data;
+
+        if (rate < FSCC_MIN_CLOCK_RATE || rate > FSCC_MAX_CLOCK_RATE)
+            return STATUS_INVALID_PARAMETER;
+
+        if (!FastcomStandardClockFSCC(rate, &clock_data))
+            error = ClockGenICS30703(rate, FSCC_CLOCK_RATE_PPM, &clock_data.frequency, clock_data.clock_bits);
+
+        if (error) {
+            SerialDbgPrintEx(TRACE_LEVEL_WARNING, DBG_IOCTLS, "No clock bits for %lu Hz (%i)\n", rate, error);
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        WdfObjectAcquireLock(pDevExt->WdfDevice);
+        status = FastcomSetClockBitsFSCC(pDevExt, &clock_data);
+        WdfObjectReleaseLock(pDevExt->WdfDevice);
+        break;
+    }
+
+    case CARD_TYPE_PCI: {
+        struct clock_data_335 clock_data;
+
+        if (rate < PCI_MIN_CLOCK_RATE || rate > PCI_MAX_CLOCK_RATE)
+            return STATUS_INVALID_PARAMETER;
+
+        if (!FastcomStandardClockPCI(rate, &clock_data))
+            error = ClockGenICS30702(rate, &clock_data.frequency, &clock_data.clock_bits);
+
+        if (error) {
+            SerialDbgPrintEx(TRACE_LEVEL_WARNING, DBG_IOCTLS, "No clock bits for %lu Hz (%i)\n", rate, error);
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        WdfObjectAcquireLock(pDevExt->WdfDevice);
+        status = FastcomSetClockBitsPCI(pDevExt, &clock_data);
+        WdfObjectReleaseLock(pDevExt->WdfDevice);
+        break;
+    }
+
+    default:
+        status = STATUS_NOT_SUPPORTED;
+        break;
+    }
+
+    return status;
+}
+
 // Includes non-floating point math from David Higgins
 // Copied from serialfc-linux 
 NTSTATUS PCIeSetBaudRate(SERIAL_DEVICE_EXTENSION *pDevExt, unsigned value)
@@ -3116,20 +3622,29 @@ NTSTATUS PCIeSetBaudRate(SERIAL_DEVICE_EXTENSION *pDevExt, unsigned value)
     const unsigned input_freq = 125000000;
     const unsigned prescaler = 1;
     unsigned divisor = 0;
+
+    if (value > input_freq / pDevExt->SampleRate)
+        return STATUS_INVALID_PARAMETER;
+
+    divisor = (input_freq*16) / prescaler / (value * pDevExt->SampleRate);
+
+    PCIeSetDivisor(pDevExt, divisor);
+
+    return STATUS_SUCCESS;
+}
+
+/* divisor is in sixteenths, the low 4 bits go in DLD */
+void PCIeSetDivisor(SERIAL_DEVICE_EXTENSION *pDevExt, unsigned divisor)
+{
     UCHAR orig_lcr = 0;
     UCHAR dlm = 0;
     UCHAR dll = 0;
     UCHAR dld = 0;
 
-    if (value > input_freq / pDevExt->SampleRate)
-        return STATUS_INVALID_PARAMETER;
-
     orig_lcr = READ_LINE_CONTROL(pDevExt, pDevExt->Controller);
 
     WRITE_LINE_CONTROL(pDevExt, pDevExt->Controller, orig_lcr | 0x80);
 
-    divisor = (input_freq*16) / prescaler / (value * pDevExt->SampleRate);
-
     dlm = (UCHAR)(divisor >> 12);
     dll = (UCHAR)((divisor >> 4) & 0xff);
 
@@ -3142,6 +3657,96 @@ NTSTATUS PCIeSetBaudRate(SERIAL_DEVICE_EXTENSION *pDevExt, unsigned value)
     pDevExt->SerialWriteUChar(pDevExt->Controller + DLD_OFFSET, dld);
 
     WRITE_LINE_CONTROL(pDevExt, pDevExt->Controller, orig_lcr);
+}
+
+/* Applies a setting from calculate_baud_setting_*. Every field is checked
+   against the card before anything is changed. After that only the FSCC
+   clock can fail, when it can't allocate its bit buffer, so it is written
+   first and the sample rate, which can't fail once checked, after it. The
+   divisor is kept so that restoring the baud rate later doesn't work out
+   its own from CurrentBaud. */
+NTSTATUS FastcomSetBaudExact(SERIAL_DEVICE_EXTENSION *pDevExt, struct serialfc_baud_setting *setting)
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    SERIAL_IOCTL_SYNC S;
+
+    if (setting->baud == 0)
+        return STATUS_INVALID_PARAMETER;
+
+    switch (FastcomGetCardType(pDevExt)) {
+    case CARD_TYPE_FSCC:
+        if (setting->sample_rate < 4 || setting->sample_rate > 16)
+            return STATUS_INVALID_PARAMETER;
+
+        if (setting->divisor == 0 || setting->divisor > 0xffff)
+            return STATUS_INVALID_PARAMETER;
+
+        if (setting->clock_frequency && (setting->clock_frequency < FSCC_MIN_CLOCK_RATE ||
+                                         setting->clock_frequency > FSCC_MAX_CLOCK_RATE))
+            return STATUS_INVALID_PARAMETER;
+        break;
+
+    case CARD_TYPE_PCI:
+        if (setting->sample_rate != 8 && setting->sample_rate != 16)
+            return STATUS_INVALID_PARAMETER;
+
+        if (setting->divisor == 0 || setting->divisor > 0xffff)
+            return STATUS_INVALID_PARAMETER;
+
+        if (setting->clock_frequency && (setting->clock_frequency < PCI_MIN_CLOCK_RATE ||
+                                         setting->clock_frequency > PCI_MAX_CLOCK_RATE))
+            return STATUS_INVALID_PARAMETER;
+        break;
+
+    case CARD_TYPE_PCIe:
+        if (setting->sample_rate != 4 && setting->sample_rate != 8 && setting->sample_rate != 16)
+            return STATUS_INVALID_PARAMETER;
+
+        /* DLM and DLL can't both be 0 */
+        if (setting->divisor < 0x10 || setting->divisor > 0xfffff)
+            return STATUS_INVALID_PARAMETER;
+
+        if (setting->clock_frequency)
+            return STATUS_INVALID_PARAMETER;
+        break;
+
+    default:
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    if (setting->clock_frequency) {
+        if (FastcomGetCardType(pDevExt) == CARD_TYPE_FSCC) {
+            struct clock_data_fscc clock_data;
+
+            clock_data.frequency = setting->clock_frequency;
+            RtlCopyMemory(clock_data.clock_bits, setting->clock_bits_fscc, sizeof(clock_data.clock_bits));
+
+            status = FastcomSetClockBitsFSCC(pDevExt, &clock_data);
+        }
+        else {
+            struct clock_data_335 clock_data;
+
+            clock_data.frequency = setting->clock_frequency;
+            clock_data.clock_bits = setting->clock_bits_335;
+
+            status = FastcomSetClockBitsPCI(pDevExt, &clock_data);
+        }
+
+        if (!NT_SUCCESS(status))
+            return status;
+    }
+
+    status = FastcomSetSampleRate(pDevExt, setting->sample_rate);
+    if (!NT_SUCCESS(status))
+        return status;
+
+    pDevExt->CurrentBaud = setting->baud;
+    pDevExt->WmiCommData.BaudRate = setting->baud;
+    pDevExt->ExactDivisor = setting->divisor;
+
+    S.Extension = pDevExt;
+    S.Data = (PVOID)(ULONG_PTR)setting->divisor;
+    WdfInterruptSynchronize(pDevExt->WdfInterrupt, SerialSetBaud, &S);
 
     return STATUS_SUCCESS;
 }
@@ -3513,6 +4118,328 @@ void FastcomDisableFixedBaudRate(SERIAL_DEVICE_EXTENSION *pDevExt)
     FastcomSetFixedBaudRate(pDevExt, -1);
 }
 
+ULONG FastcomGetConfigFields(SERIAL_DEVICE_EXTENSION *pDevExt)
+{
+    ULONG fields;
+
+    switch (FastcomGetCardType(pDevExt)) {
+    case CARD_TYPE_PCI:
+        return SERIALFC_CONFIG_RS485 | SERIALFC_CONFIG_SAMPLE_RATE |
+               SERIALFC_CONFIG_TX_TRIGGER | SERIALFC_CONFIG_RX_TRIGGER |
+               SERIALFC_CONFIG_ECHO_CANCEL | SERIALFC_CONFIG_FIXED_BAUD_RATE;
+
+    case CARD_TYPE_PCIe:
+        return SERIALFC_CONFIG_RS485 | SERIALFC_CONFIG_SAMPLE_RATE |
+               SERIALFC_CONFIG_TX_TRIGGER | SERIALFC_CONFIG_RX_TRIGGER |
+               SERIALFC_CONFIG_TERMINATION | SERIALFC_CONFIG_ECHO_CANCEL |
+               SERIALFC_CONFIG_FIXED_BAUD_RATE;
+
+    case CARD_TYPE_FSCC:
+        fields = SERIALFC_CONFIG_RS485 | SERIALFC_CONFIG_SAMPLE_RATE |
+                 SERIALFC_CONFIG_TX_TRIGGER | SERIALFC_CONFIG_RX_TRIGGER |
+                 SERIALFC_CONFIG_ECHO_CANCEL | SERIALFC_CONFIG_ISOCHRONOUS |
+                 SERIALFC_CONFIG_NINE_BIT | SERIALFC_CONFIG_FIXED_BAUD_RATE;
+
+        if (FsccGetFrev(pDevExt) >= 0x20)
+            fields |= SERIALFC_CONFIG_FRAME_LENGTH;
+
+        return fields;
+
+    default:
+        /* The sample rate is still used for the baud rate of non Fastcom ports. */
+        return SERIALFC_CONFIG_SAMPLE_RATE | SERIALFC_CONFIG_FIXED_BAUD_RATE;
+    }
+}
+
+/* Returns the settings last applied to the port. These are kept in the
+   device extension so no registers need to be read. */
+void FastcomGetConfig(SERIAL_DEVICE_EXTENSION *pDevExt, struct serialfc_config *config)
+{
+    RtlZeroMemory(config, sizeof(*config));
+
+    config->size = sizeof(*config);
+    config->version = SERIALFC_CONFIG_VERSION;
+    config->fields = FastcomGetConfigFields(pDevExt);
+    config->rs485 = pDevExt->RS485;
+    config->sample_rate = pDevExt->SampleRate;
+    config->tx_trigger = pDevExt->TxTrigger;
+    config->rx_trigger = pDevExt->RxTrigger;
+    config->termination = pDevExt->Termination;
+    config->echo_cancel = pDevExt->EchoCancel;
+    config->isochronous = pDevExt->Isochronous;
+    config->frame_length = pDevExt->FrameLength;
+    config->nine_bit = pDevExt->NineBit;
+    config->fixed_baud_rate = pDevExt->FixedBaudRate;
+}
+
+/* Checks every selected setting before any of them are applied. The
+   settings that can't be applied are returned in bad_fields if it isn't
+   NULL. */
+NTSTATUS FastcomCheckConfig(SERIAL_DEVICE_EXTENSION *pDevExt, struct serialfc_config *config, ULONG *bad_fields)
+{
+    enum FASTCOM_CARD_TYPE card_type;
+    ULONG unsupported, invalid = 0;
+    unsigned max_trigger;
+
+    if (config->size != sizeof(*config) || config->version != SERIALFC_CONFIG_VERSION)
+        return STATUS_REVISION_MISMATCH;
+
+    card_type = FastcomGetCardType(pDevExt);
+    unsupported = config->fields & ~FastcomGetConfigFields(pDevExt);
+
+    switch (card_type) {
+    case CARD_TYPE_PCI:
+        if (config->sample_rate != 8 && config->sample_rate != 16)
+            invalid |= SERIALFC_CONFIG_SAMPLE_RATE;
+
+        max_trigger = 64;
+        break;
+
+    case CARD_TYPE_PCIe:
+        if (config->sample_rate != 4 && config->sample_rate != 8 && config->sample_rate != 16)
+            invalid |= SERIALFC_CONFIG_SAMPLE_RATE;
+
+        max_trigger = 255;
+        break;
+
+    case CARD_TYPE_FSCC:
+        if (config->sample_rate < 4 || config->sample_rate > 16)
+            invalid |= SERIALFC_CONFIG_SAMPLE_RATE;
+
+        max_trigger = 127;
+        break;
+
+    default:
+        max_trigger = 0;
+        break;
+    }
+
+    if (config->tx_trigger > max_trigger)
+        invalid |= SERIALFC_CONFIG_TX_TRIGGER;
+
+    if (config->rx_trigger > max_trigger)
+        invalid |= SERIALFC_CONFIG_RX_TRIGGER;
+
+    if (config->isochronous > 10 || config->isochronous < -1)
+        invalid |= SERIALFC_CONFIG_ISOCHRONOUS;
+
+    if (config->frame_length == 0 || config->frame_length > 256)
+        invalid |= SERIALFC_CONFIG_FRAME_LENGTH;
+
+    invalid &= config->fields & ~unsupported;
+
+    if (bad_fields)
+        *bad_fields = unsupported | invalid;
+
+    if (unsupported)
+        return STATUS_NOT_SUPPORTED;
+
+    if (invalid)
+        return STATUS_INVALID_PARAMETER;
+
+    return STATUS_SUCCESS;
+}
+
+/* Returns which of the selected settings differ from what the port
+   already has. */
+ULONG FastcomGetConfigChanges(SERIAL_DEVICE_EXTENSION *pDevExt, struct serialfc_config *config)
+{
+    ULONG changes = 0;
+
+    if ((config->rs485 ? TRUE : FALSE) != pDevExt->RS485)
+        changes |= SERIALFC_CONFIG_RS485;
+
+    if (config->sample_rate != pDevExt->SampleRate)
+        changes |= SERIALFC_CONFIG_SAMPLE_RATE;
+
+    if (config->tx_trigger != pDevExt->TxTrigger)
+        changes |= SERIALFC_CONFIG_TX_TRIGGER;
+
+    if (config->rx_trigger != pDevExt->RxTrigger)
+        changes |= SERIALFC_CONFIG_RX_TRIGGER;
+
+    if ((config->termination ? TRUE : FALSE) != pDevExt->Termination)
+        changes |= SERIALFC_CONFIG_TERMINATION;
+
+    if ((config->echo_cancel ? TRUE : FALSE) != pDevExt->EchoCancel)
+        changes |= SERIALFC_CONFIG_ECHO_CANCEL;
+
+    if (config->isochronous != pDevExt->Isochronous)
+        changes |= SERIALFC_CONFIG_ISOCHRONOUS;
+
+    if (config->frame_length != pDevExt->FrameLength)
+        changes |= SERIALFC_CONFIG_FRAME_LENGTH;
+
+    if ((config->nine_bit ? TRUE : FALSE) != pDevExt->NineBit)
+        changes |= SERIALFC_CONFIG_NINE_BIT;
+
+    if (config->fixed_baud_rate != pDevExt->FixedBaudRate)
+        changes |= SERIALFC_CONFIG_FIXED_BAUD_RATE;
+
+    return config->fields & changes;
+}
+
+/* Every register behind ICR is written within a single LCR save/restore
+   and RS485 and echo cancel share one FCR update. */
+void FastcomApplyConfigFSCC(SERIAL_DEVICE_EXTENSION *pDevExt, struct serialfc_config *config, ULONG fields)
+{
+    UCHAR orig_lcr;
+    UINT32 current_fcr, new_fcr;
+    UINT32 rs485_mask, echo_cancel_mask;
+    UCHAR new_cks, new_mdm;
+
+    if (fields & (SERIALFC_CONFIG_RS485 | SERIALFC_CONFIG_SAMPLE_RATE |
+                  SERIALFC_CONFIG_TX_TRIGGER | SERIALFC_CONFIG_RX_TRIGGER |
+                  SERIALFC_CONFIG_ISOCHRONOUS | SERIALFC_CONFIG_FRAME_LENGTH |
+                  SERIALFC_CONFIG_NINE_BIT)) {
+        orig_lcr = READ_LINE_CONTROL(pDevExt, pDevExt->Controller);
+
+        WRITE_LINE_CONTROL(pDevExt, pDevExt->Controller, 0); /* Ensure last LCR value is not 0xbf */
+
+        if (fields & SERIALFC_CONFIG_RS485) {
+            if (config->rs485)
+                pDevExt->ACR |= 0x10; /* DTR is active during transmission to turn on drivers */
+            else
+                pDevExt->ACR &= ~0x10;
+
+            pDevExt->SerialWriteUChar(pDevExt->Controller + SPR_OFFSET, ACR_OFFSET); /* To allow access to ACR */
+            pDevExt->SerialWriteUChar(pDevExt->Controller + ICR_OFFSET, pDevExt->ACR);
+        }
+
+        if (fields & SERIALFC_CONFIG_SAMPLE_RATE) {
+            pDevExt->SerialWriteUChar(pDevExt->Controller + SPR_OFFSET, TCR_OFFSET); /* To allow access to TCR */
+            pDevExt->SerialWriteUChar(pDevExt->Controller + ICR_OFFSET, (UCHAR)config->sample_rate);
+        }
+
+        if (fields & SERIALFC_CONFIG_TX_TRIGGER) {
+            pDevExt->SerialWriteUChar(pDevExt->Controller + SPR_OFFSET, TTL_OFFSET); /* To allow access to TTL */
+            pDevExt->SerialWriteUChar(pDevExt->Controller + ICR_OFFSET, (UCHAR)config->tx_trigger);
+        }
+
+        if (fields & SERIALFC_CONFIG_RX_TRIGGER) {
+            pDevExt->SerialWriteUChar(pDevExt->Controller + SPR_OFFSET, RTL_OFFSET); /* To allow access to RTL */
+            pDevExt->SerialWriteUChar(pDevExt->Controller + ICR_OFFSET, (UCHAR)config->rx_trigger);
+        }
+
+        if (fields & SERIALFC_CONFIG_ISOCHRONOUS) {
+            FastcomGetIsochronousBitsFSCC(config->isochronous, &new_cks, &new_mdm);
+
+            pDevExt->SerialWriteUChar(pDevExt->Controller + SPR_OFFSET, MDM_OFFSET); /* To allow access to MDM */
+            pDevExt->SerialWriteUChar(pDevExt->Controller + ICR_OFFSET, new_mdm);
+            pDevExt->SerialWriteUChar(pDevExt->Controller + SPR_OFFSET, CKS_OFFSET); /* To allow access to CKS */
+            pDevExt->SerialWriteUChar(pDevExt->Controller + ICR_OFFSET, new_cks);
+        }
+
+        if (fields & SERIALFC_CONFIG_FRAME_LENGTH) {
+            pDevExt->SerialWriteUChar(pDevExt->Controller + SPR_OFFSET, FLR_OFFSET); /* To allow access to FLR */
+            pDevExt->SerialWriteUChar(pDevExt->Controller + ICR_OFFSET, (UCHAR)(config->frame_length - 1));
+        }
+
+        if (fields & SERIALFC_CONFIG_NINE_BIT) {
+            pDevExt->SerialWriteUChar(pDevExt->Controller + SPR_OFFSET, NMR_OFFSET); /* To allow access to NMR */
+            pDevExt->SerialWriteUChar(pDevExt->Controller + ICR_OFFSET, config->nine_bit ? 0x01 : 0x00);
+        }
+
+        WRITE_LINE_CONTROL(pDevExt, pDevExt->Controller, orig_lcr);
+    }
+
+    if (fields & (SERIALFC_CONFIG_RS485 | SERIALFC_CONFIG_ECHO_CANCEL)) {
+        switch (pDevExt->Channel) {
+        case 1:
+            rs485_mask = 0x00400000;
+            echo_cancel_mask = 0x00100000;
+            break;
+
+        default:
+            rs485_mask = 0x00040000;
+            echo_cancel_mask = 0x00010000;
+            break;
+        }
+
+        current_fcr = READ_PORT_ULONG(ULongToPtr(pDevExt->Bar2));
+        new_fcr = current_fcr;
+
+        if (fields & SERIALFC_CONFIG_RS485)
+            new_fcr = config->rs485 ? (new_fcr | rs485_mask) : (new_fcr & ~rs485_mask);
+
+        if (fields & SERIALFC_CONFIG_ECHO_CANCEL)
+            new_fcr = config->echo_cancel ? (new_fcr | echo_cancel_mask) : (new_fcr & ~echo_cancel_mask);
+
+        if (new_fcr != current_fcr)
+            WRITE_PORT_ULONG(ULongToPtr(pDevExt->Bar2), new_fcr);
+    }
+
+    if (fields & SERIALFC_CONFIG_RS485)
+        pDevExt->RS485 = config->rs485 ? TRUE : FALSE;
+
+    if (fields & SERIALFC_CONFIG_SAMPLE_RATE) {
+        /* An exact divisor was only right for the old sample rate, as in
+           FastcomSetSampleRate */
+        if (config->sample_rate != pDevExt->SampleRate)
+            pDevExt->ExactDivisor = 0;
+
+        pDevExt->SampleRate = config->sample_rate;
+    }
+
+    if (fields & SERIALFC_CONFIG_TX_TRIGGER)
+        pDevExt->TxTrigger = config->tx_trigger;
+
+    if (fields & SERIALFC_CONFIG_RX_TRIGGER)
+        pDevExt->RxTrigger = config->rx_trigger;
+
+    if (fields & SERIALFC_CONFIG_ECHO_CANCEL)
+        pDevExt->EchoCancel = config->echo_cancel ? TRUE : FALSE;
+
+    if (fields & SERIALFC_CONFIG_ISOCHRONOUS)
+        pDevExt->Isochronous = config->isochronous;
+
+    if (fields & SERIALFC_CONFIG_FRAME_LENGTH)
+        pDevExt->FrameLength = config->frame_length;
+
+    if (fields & SERIALFC_CONFIG_NINE_BIT)
+        pDevExt->NineBit = config->nine_bit ? TRUE : FALSE;
+}
+
+/* Applies the selected settings, which must have already been through
+   FastcomCheckConfig. */
+void FastcomApplyConfig(SERIAL_DEVICE_EXTENSION *pDevExt, struct serialfc_config *config, ULONG fields)
+{
+    switch (FastcomGetCardType(pDevExt)) {
+    case CARD_TYPE_FSCC:
+        FastcomApplyConfigFSCC(pDevExt, config, fields);
+        break;
+
+    default:
+        /* The 335 and PCIe registers are written directly without going
+           through LCR so there isn't anything to share between them. */
+        if (fields & SERIALFC_CONFIG_RS485)
+            FastcomSetRS485(pDevExt, config->rs485 ? TRUE : FALSE);
+
+        if (fields & SERIALFC_CONFIG_SAMPLE_RATE)
+            FastcomSetSampleRate(pDevExt, config->sample_rate);
+
+        if (fields & SERIALFC_CONFIG_TX_TRIGGER)
+            FastcomSetTxTrigger(pDevExt, config->tx_trigger);
+
+        if (fields & SERIALFC_CONFIG_RX_TRIGGER)
+            FastcomSetRxTrigger(pDevExt, config->rx_trigger);
+
+        if (fields & SERIALFC_CONFIG_TERMINATION)
+            FastcomSetTermination(pDevExt, config->termination ? TRUE : FALSE);
+
+        if (fields & SERIALFC_CONFIG_ECHO_CANCEL)
+            FastcomSetEchoCancel(pDevExt, config->echo_cancel ? TRUE : FALSE);
+
+        break;
+    }
+
+    if (fields & SERIALFC_CONFIG_FIXED_BAUD_RATE)
+        pDevExt->FixedBaudRate = config->fixed_baud_rate;
+
+    SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_PNP,
+                     "Applied configuration 0x%x\n", fields);
+}
+
 void FastcomInitGpio(SERIAL_DEVICE_EXTENSION *pDevExt)
 {
     switch (FastcomGetCardType(pDevExt)) {
@@ -3560,11 +4487,18 @@ void FastcomInitTriggers(SERIAL_DEVICE_EXTENSION *pDevExt)
         }
         break;
 
-    case CARD_TYPE_FSCC:
-        pDevExt->SerialWriteUChar(pDevExt->Controller + FCR_OFFSET, 0x01); /* Enable FIFO (combined with enhanced enables 950 mode) */
+    case CARD_TYPE_FSCC: {
+            UCHAR orig_lcr;
+
+            orig_lcr = READ_LINE_CONTROL(pDevExt, pDevExt->Controller);
+
+            pDevExt->SerialWriteUChar(pDevExt->Controller + FCR_OFFSET, 0x01); /* Enable FIFO (combined with enhanced enables 950 mode) */
 
-        pDevExt->SerialWriteUChar(pDevExt->Controller + LCR_OFFSET, 0xbf); /* Set to 0xbf to access 650 registers */
-        pDevExt->SerialWriteUChar(pDevExt->Controller + EFR_OFFSET, 0x10); /* Enable enhanced mode */
+            pDevExt->SerialWriteUChar(pDevExt->Controller + LCR_OFFSET, 0xbf); /* Set to 0xbf to access 650 registers */
+            pDevExt->SerialWriteUChar(pDevExt->Controller + EFR_OFFSET, 0x10); /* Enable enhanced mode */
+
+            WRITE_LINE_CONTROL(pDevExt, pDevExt->Controller, orig_lcr); /* Ensure last LCR value is not 0xbf */
+        }
 
         /* Temporarily disable 950 trigger levels due to either interrupts not firing or not being handled correctly */
 #if 0
@@ -3588,20 +4522,48 @@ void SerialFcInit(
     struct clock_data_fscc default_fscc_clock;
     struct clock_data_335 default_335_clock;
     unsigned char default_fscc_bits[20] = DEFAULT_FSCC_CLOCK_BITS;
+    struct serialfc_config config;
+    ULONG bad_fields = 0;
     int i;
 
     FastcomInitGpio(pDevExt);
     FastcomInitTriggers(pDevExt);
 
+    /* Coming back to D0 the clock last programmed is restored rather than
+       the default so it still matches the baud rate divisor. Either way
+       nothing is written if the generator already holds it. */
     switch (FastcomGetCardType(pDevExt)) {
         case CARD_TYPE_FSCC:
-            default_fscc_clock.frequency = 18432000;
-            for (i = 0; i < 20; i++) default_fscc_clock.clock_bits[i] = default_fscc_bits[i];
+            if (PConfigData == NULL && pDevExt->ClockFrequency) {
+                default_fscc_clock.frequency = pDevExt->ClockFrequency;
+                for (i = 0; i < 20; i++) default_fscc_clock.clock_bits[i] = pDevExt->ClockBits[i];
+            }
+            else {
+                default_fscc_clock.frequency = 18432000;
+                for (i = 0; i < 20; i++) default_fscc_clock.clock_bits[i] = default_fscc_bits[i];
+            }
             FastcomSetClockBitsFSCC(pDevExt, &default_fscc_clock);
             break;
         case CARD_TYPE_PCI:
             default_335_clock.frequency = 18432000;
             default_335_clock.clock_bits = DEFAULT_335_CLOCK_BITS;
+
+            if (PConfigData == NULL) {
+                PSERIAL_CARD_CLOCK card_clock;
+                KIRQL oldIrql;
+
+                KeAcquireSpinLock(&SerialCardClockLock, &oldIrql);
+
+                card_clock = FastcomFindCardClock(pDevExt, FALSE);
+
+                if (card_clock && card_clock->Frequency) {
+                    default_335_clock.frequency = card_clock->Frequency;
+                    default_335_clock.clock_bits = card_clock->ClockBits;
+                }
+
+                KeReleaseSpinLock(&SerialCardClockLock, oldIrql);
+            }
+
             FastcomSetClockBitsPCI(pDevExt, &default_335_clock);
             break;
         case CARD_TYPE_PCIe:
@@ -3609,28 +4571,27 @@ void SerialFcInit(
             break;
     }
 
+    FastcomGetConfig(pDevExt, &config);
+
     if (PConfigData) {
-        FastcomSetRS485(pDevExt, (BOOLEAN)PConfigData->RS485);
-        FastcomSetSampleRate(pDevExt, PConfigData->SampleRate);
-        FastcomSetTxTrigger(pDevExt, PConfigData->TxTrigger);
-        FastcomSetRxTrigger(pDevExt, PConfigData->RxTrigger);
-        FastcomSetTermination(pDevExt, (BOOLEAN)PConfigData->Termination);
-        FastcomSetEchoCancel(pDevExt, (BOOLEAN)PConfigData->EchoCancel);
-        FastcomSetIsochronous(pDevExt, PConfigData->Isochronous);
-        FastcomSetFrameLength(pDevExt, PConfigData->FrameLength);
-        FastcomSet9Bit(pDevExt, (BOOLEAN)PConfigData->NineBit);
-        FastcomSetFixedBaudRate(pDevExt, PConfigData->FixedBaudRate);
+        config.rs485 = PConfigData->RS485;
+        config.sample_rate = PConfigData->SampleRate;
+        config.tx_trigger = PConfigData->TxTrigger;
+        config.rx_trigger = PConfigData->RxTrigger;
+        config.termination = PConfigData->Termination;
+        config.echo_cancel = PConfigData->EchoCancel;
+        config.isochronous = PConfigData->Isochronous;
+        config.frame_length = PConfigData->FrameLength;
+        config.nine_bit = PConfigData->NineBit;
+        config.fixed_baud_rate = PConfigData->FixedBaudRate;
     }
-    else {
-        FastcomSetRS485(pDevExt, pDevExt->RS485);
-        FastcomSetSampleRate(pDevExt, pDevExt->SampleRate);
-        FastcomSetTxTrigger(pDevExt, pDevExt->TxTrigger);
-        FastcomSetRxTrigger(pDevExt, pDevExt->RxTrigger);
-        FastcomSetTermination(pDevExt, pDevExt->Termination);
-        FastcomSetEchoCancel(pDevExt, pDevExt->EchoCancel);
-        FastcomSetIsochronous(pDevExt, pDevExt->Isochronous);
-        FastcomSetFrameLength(pDevExt, pDevExt->FrameLength);
-        FastcomSet9Bit(pDevExt, pDevExt->NineBit);
-        FastcomSetFixedBaudRate(pDevExt, pDevExt->FixedBaudRate);
+
+    if (!NT_SUCCESS(FastcomCheckConfig(pDevExt, &config, &bad_fields))) {
+        SerialDbgPrintEx(TRACE_LEVEL_WARNING, DBG_PNP,
+                         "Skipping invalid configuration 0x%x\n", bad_fields);
     }
+
+    /* Everything is written here, not just what changed, since the
+       hardware might have lost its state. */
+    FastcomApplyConfig(pDevExt, &config, config.fields & ~bad_fields);
 }
\ No newline at end of file
@@ -29,6 +29,7 @@ EVT_WDF_WMI_INSTANCE_QUERY_INSTANCE EvtWmiQueryPortCommData;
 EVT_WDF_WMI_INSTANCE_QUERY_INSTANCE EvtWmiQueryPortHWData;
 EVT_WDF_WMI_INSTANCE_QUERY_INSTANCE EvtWmiQueryPortPerfData;
 EVT_WDF_WMI_INSTANCE_QUERY_INSTANCE EvtWmiQueryPortPropData;
+EVT_WDF_WMI_INSTANCE_QUERY_INSTANCE EvtWmiQueryPortExtStats;
 
 NTSTATUS
 SerialWmiRegisterInstance(
@@ -46,6 +47,7 @@ SerialWmiRegisterInstance(
 #pragma alloc_text(PAGESRP0, EvtWmiQueryPortHWData)
 #pragma alloc_text(PAGESRP0, EvtWmiQueryPortPerfData)
 #pragma alloc_text(PAGESRP0, EvtWmiQueryPortPropData)
+#pragma alloc_text(PAGESRP0, EvtWmiQueryPortExtStats)
 #endif
 
 NTSTATUS
@@ -91,6 +93,7 @@ Routine Description
 {
     NTSTATUS        status = STATUS_SUCCESS;
     PSERIAL_DEVICE_EXTENSION pDevExt;
+    DECLARE_CONST_UNICODE_STRING(mofResourceName, L"MofResource");
 
     PAGED_CODE();
 
@@ -142,6 +145,23 @@ Routine Description
         return status;
     }
 
+    //
+    // The extended statistics are our own block, described by the
+    // MOF resource (serialfc.mof) built into the driver.
+    //
+    status = WdfDeviceAssignMofResourceName(Device, &mofResourceName);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    status = SerialWmiRegisterInstance(Device,
+                                       &FastcomSerial_ExtendedStatistics_GUID,
+                                       sizeof(struct serialfc_ext_stats),
+                                       EvtWmiQueryPortExtStats);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
     return status;
 }
 
@@ -293,3 +313,35 @@ EvtWmiQueryPortPropData(
     return STATUS_SUCCESS;
 }
 
+NTSTATUS
+EvtWmiQueryPortExtStats(
+    IN  WDFWMIINSTANCE WmiInstance,
+    IN  ULONG OutBufferSize,
+    IN  PVOID OutBuffer,
+    OUT PULONG BufferUsed
+    )
+{
+    PSERIAL_DEVICE_EXTENSION pDevExt;
+    SERIAL_IOCTL_SYNC S;
+
+    PAGED_CODE();
+
+    pDevExt = SerialGetDeviceExtension (WdfWmiInstanceGetDevice(WmiInstance));
+
+    *BufferUsed = sizeof(struct serialfc_ext_stats);
+
+    if (OutBufferSize < *BufferUsed) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    S.Extension = pDevExt;
+    S.Data = OutBuffer;
+
+    WdfInterruptSynchronize(
+        pDevExt->WdfInterrupt,
+        SerialGetExtStats,
+        &S
+        );
+
+    return STATUS_SUCCESS;
+}
@@ -30,6 +30,11 @@ EVT_WDF_INTERRUPT_SYNCHRONIZE SerialGiveXoffToIsr;
 EVT_WDF_INTERRUPT_SYNCHRONIZE SerialGrabWriteFromIsr;
 EVT_WDF_INTERRUPT_SYNCHRONIZE SerialGrabXoffFromIsr;
 
+VOID
+SerialHoldTimedWrite(
+    IN PSERIAL_DEVICE_EXTENSION Extension
+    );
+
 
 VOID
 SerialEvtIoWrite(
@@ -222,6 +227,26 @@ Return Value:
 
         }
 
+        //
+        // A timed write doesn't go to the isr yet.  It is held by
+        // the timed write timer until just before its launch time.
+        // The write timeouts don't apply to it, it can only be
+        // cancelled or purged.
+        //
+
+        if (SERIAL_IS_TIMED_WRITE(reqContext)) {
+
+            SERIAL_INIT_REFERENCE(reqContext);
+
+            SerialSetCancelRoutine(Extension->CurrentWriteRequest,
+                                            SerialCancelCurrentWrite);
+
+            SerialHoldTimedWrite(Extension);
+
+            break;
+
+        }
+
         UseATimer = FALSE;
 
         //
@@ -368,6 +393,42 @@ Return Value:
 
             Extension->TotalCharsQueued -= reqContext->Length;
 
+        } else if (SERIAL_IS_TIMED_WRITE(reqContext)) {
+
+            PVOID buffer;
+            NTSTATUS status;
+
+            ASSERT(Extension->TotalCharsQueued >= reqContext->Length);
+
+            Extension->TotalCharsQueued -= reqContext->Length;
+
+            //
+            // Report the launch time back if the caller gave us
+            // somewhere to put it.  The data has already gone out
+            // so it is safe to overwrite the system buffer.
+            //
+
+            reqContext->Information = 0;
+
+            if (reqContext->Status == STATUS_SUCCESS &&
+                Extension->TimedWriteLaunchTime) {
+
+                status = WdfRequestRetrieveOutputBuffer(*CurrentOpRequest,
+                                                        sizeof(LONGLONG),
+                                                        &buffer,
+                                                        NULL);
+
+                if (NT_SUCCESS(status)) {
+
+                    *(PLONGLONG)buffer = Extension->TimedWriteLaunchTime;
+                    reqContext->Information = sizeof(LONGLONG);
+
+                }
+
+            }
+
+            Extension->TimedWriteLaunchTime = 0;
+
         } else if (reqContext->MajorFunction == IRP_MJ_DEVICE_CONTROL) {
 
             WDFREQUEST request = *CurrentOpRequest;
@@ -551,10 +612,13 @@ Return Value:
     SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_WRITE, ">SerialCompleteWrite(%p)\n",
                      Extension);
 
+    SERIAL_RECORD_DPC(Extension->LatencyHistograms.write_dpc,
+                      Extension->WriteDpcQueuedTime);
 
     SerialTryToCompleteCurrent(Extension, NULL, STATUS_SUCCESS,
                                &Extension->CurrentWriteRequest,
-                               Extension->WriteQueue, NULL,
+                               Extension->WriteQueue,
+                               Extension->TimedWriteTimer,
                                Extension->WriteRequestTotalTimer,
                                SerialStartWrite, SerialGetNextWrite,
                                SERIAL_REF_ISR);
@@ -603,7 +667,8 @@ Return Value:
 
     if (Extension->IsrWaitMask && (Extension->IsrWaitMask & SERIAL_EV_TXEMPTY) &&
         Extension->EmptiedTransmit && (!Extension->TransmitImmediate) &&
-        (!Extension->CurrentWriteRequest) && IsQueueEmpty(Extension->WriteQueue)) {
+        (!Extension->CurrentWriteRequest) && IsQueueEmpty(Extension->WriteQueue) &&
+        (!Extension->CurrentPriorityRequest) && IsQueueEmpty(Extension->PriorityQueue)) {
 
         Extension->HistoryMask |= SERIAL_EV_TXEMPTY;
         if (Extension->IrpMaskLocation) {
@@ -686,6 +751,19 @@ Return Value:
         Extension->WriteLength = reqContext->Length;
         Extension->WriteCurrentChar = reqContext->SystemBuffer;
 
+        SerialUpdateLaneStats(&Extension->TransmitStats.normal, reqContext);
+
+    } else if (SERIAL_IS_TIMED_WRITE(reqContext)) {
+
+        //
+        // The data of a timed write follows its header.
+        //
+
+        Extension->WriteLength = reqContext->Length;
+        Extension->WriteCurrentChar =
+            ((PUCHAR)reqContext->SystemBuffer) +
+            sizeof(struct serialfc_timed_write);
+
     } else {
 
         Extension->WriteLength = 1;
@@ -698,6 +776,8 @@ Return Value:
 
     }
 
+    Extension->WriteFirstByte = TRUE;
+
     //
     // The isr now has a reference to the request.
     //
@@ -794,7 +874,7 @@ Return Value:
         STATUS_CANCELLED,
         &Extension->CurrentWriteRequest,
         Extension->WriteQueue,
-        NULL,
+        Extension->TimedWriteTimer,
         Extension->WriteRequestTotalTimer,
         SerialStartWrite,
         SerialGetNextWrite,
@@ -834,7 +914,8 @@ Return Value:
 
     SerialTryToCompleteCurrent(Extension, SerialGrabWriteFromIsr,
                                STATUS_TIMEOUT, &Extension->CurrentWriteRequest,
-                               Extension->WriteQueue, NULL,
+                               Extension->WriteQueue,
+                               Extension->TimedWriteTimer,
                                Extension->WriteRequestTotalTimer,
                                SerialStartWrite, SerialGetNextWrite,
                                SERIAL_REF_TOTAL_TIMER);
@@ -1193,3 +1274,406 @@ Return Value:
 }
 
 
+
+
+VOID
+SerialHoldTimedWrite(
+    IN PSERIAL_DEVICE_EXTENSION Extension
+    )
+
+/*++
+
+Routine Description:
+
+    This routine holds the current timed write on the timed write
+    timer.  While the launch time is further off than
+    SERIAL_TIMED_WRITE_LEAD_US the timer is set to go off that far
+    ahead of it, after that for the last SERIAL_TIMED_WRITE_SPIN_US less
+    however late the timer has been going off.  The write is launched
+    straight away if the launch time has passed or a flush is waiting.
+
+    NOTE: The request must already have its references initialized
+          and its cancel routine set.
+
+    NOTE: This routine is called with the device lock held.
+
+Arguments:
+
+    Extension - Points to the serial device extension
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PREQUEST_CONTEXT reqContext;
+    struct serialfc_timed_write *timedWrite;
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER now;
+    LARGE_INTEGER dueTime;
+    LONGLONG ticksLeft;
+    LONGLONG leadTicks;
+    LONGLONG spinTicks;
+    LONGLONG waitTicks;
+    BOOLEAN result;
+
+    reqContext = SerialGetRequestContext(Extension->CurrentWriteRequest);
+    timedWrite = reqContext->SystemBuffer;
+
+    now = KeQueryPerformanceCounter(&frequency);
+
+    ticksLeft = timedWrite->launch_time - now.QuadPart;
+
+    //
+    // A flush is waiting for the write queue to empty, so the
+    // write goes now.
+    //
+
+    if (Extension->TimedWriteFlushes || ticksLeft <= 0) {
+
+        WdfInterruptSynchronize(
+            Extension->WdfInterrupt,
+            SerialLaunchTimedWrite,
+            Extension
+            );
+
+        return;
+
+    }
+
+    leadTicks = (frequency.QuadPart * SERIAL_TIMED_WRITE_LEAD_US) / 1000000;
+    spinTicks = (frequency.QuadPart * SERIAL_TIMED_WRITE_SPIN_US) / 1000000;
+
+    if (ticksLeft > leadTicks) {
+
+        waitTicks = ticksLeft - leadTicks;
+
+    } else {
+
+        //
+        // If this is already too close the timer goes off right away
+        // and its routine spins off the rest.
+        //
+
+        waitTicks = ticksLeft - spinTicks - Extension->TimedWriteTimerSlack;
+
+        if (waitTicks < 0) {
+
+            waitTicks = 0;
+
+        }
+
+    }
+
+    //
+    // Convert the counts into a relative due time in 100ns units.  It
+    // is done in two pieces so a launch time far in the future can't
+    // overflow the multiplication.
+    //
+
+    dueTime.QuadPart = (waitTicks / frequency.QuadPart) * 10000000 +
+                       ((waitTicks % frequency.QuadPart) * 10000000) /
+                       frequency.QuadPart;
+
+    if (!dueTime.QuadPart) {
+
+        dueTime.QuadPart = 1;
+
+    }
+
+    dueTime.QuadPart = -dueTime.QuadPart;
+
+    SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_WRITE,
+                     "Holding timed write for %I64d\n", -dueTime.QuadPart);
+
+    Extension->TimedWriteTimerDue = now.QuadPart + waitTicks;
+
+    result = SerialSetTimer(
+        Extension->TimedWriteTimer,
+        dueTime
+        );
+
+    if (result == FALSE) {
+
+        //
+        // This timer now has a reference to the request.
+        //
+
+        SERIAL_SET_REFERENCE(reqContext, SERIAL_REF_INT_TIMER);
+
+    }
+
+}
+
+
+VOID
+SerialTimedWriteLaunch(
+    IN WDFTIMER Timer
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is invoked when the timed write timer fires.  It
+    sets the timer again if the launch time is still further off than
+    the timer can be trusted to hit, otherwise it spins off what is
+    left and launches the current timed write.  If the write was
+    cancelled while the timer was firing, it completes it.
+
+    The timer isn't serialized with the device, so the spin doesn't
+    hold the device lock.  The timer's reference keeps the write the
+    current one until the lock is taken again.
+
+Arguments:
+
+    Timer - The timed write timer.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSERIAL_DEVICE_EXTENSION Extension = NULL;
+    PREQUEST_CONTEXT reqContext;
+    struct serialfc_timed_write *timedWrite;
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER now;
+    LONGLONG launchTime;
+    LONGLONG late;
+    LONGLONG leadTicks;
+    LONGLONG spinTicks;
+
+    Extension = SerialGetDeviceExtension(WdfTimerGetParentObject(Timer));
+
+    now = KeQueryPerformanceCounter(&frequency);
+
+    SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_WRITE, ">SerialTimedWriteLaunch(%p)\n",
+                     Extension);
+
+    WdfObjectAcquireLock(Extension->WdfDevice);
+
+    if (!Extension->CurrentWriteRequest) {
+
+        WdfObjectReleaseLock(Extension->WdfDevice);
+        SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_WRITE, "<SerialTimedWriteLaunch (1)\n");
+        return;
+
+    }
+
+    reqContext = SerialGetRequestContext(Extension->CurrentWriteRequest);
+
+    if (!SERIAL_IS_TIMED_WRITE(reqContext) ||
+        !SERIAL_TEST_REFERENCE(reqContext, SERIAL_REF_INT_TIMER)) {
+
+        WdfObjectReleaseLock(Extension->WdfDevice);
+        SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_WRITE, "<SerialTimedWriteLaunch (2)\n");
+        return;
+
+    }
+
+    leadTicks = (frequency.QuadPart * SERIAL_TIMED_WRITE_LEAD_US) / 1000000;
+    spinTicks = (frequency.QuadPart * SERIAL_TIMED_WRITE_SPIN_US) / 1000000;
+
+    //
+    // Follow how late the timer goes off, rising straight away and
+    // falling by halves, and never past the lead.
+    //
+
+    late = now.QuadPart - Extension->TimedWriteTimerDue;
+
+    if (late < 0) {
+
+        late = 0;
+
+    } else if (late > leadTicks) {
+
+        late = leadTicks;
+
+    }
+
+    if (late > Extension->TimedWriteTimerSlack) {
+
+        Extension->TimedWriteTimerSlack = late;
+
+    } else {
+
+        Extension->TimedWriteTimerSlack = (Extension->TimedWriteTimerSlack + late) / 2;
+
+    }
+
+    timedWrite = reqContext->SystemBuffer;
+    launchTime = timedWrite->launch_time;
+
+    if (!reqContext->Cancelled && !Extension->TimedWriteFlushes &&
+        launchTime - now.QuadPart > spinTicks + Extension->TimedWriteTimerSlack) {
+
+        //
+        // Woken up too early, set the timer again closer in.
+        //
+
+        SERIAL_CLEAR_REFERENCE(reqContext, SERIAL_REF_INT_TIMER);
+
+        SerialHoldTimedWrite(Extension);
+
+        WdfObjectReleaseLock(Extension->WdfDevice);
+        SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_WRITE, "<SerialTimedWriteLaunch (3)\n");
+        return;
+
+    }
+
+    if (!reqContext->Cancelled) {
+
+        //
+        // A flush raises TimedWriteFlushes under the device lock and
+        // then finds the timer already gone, so it is watched for here.
+        //
+
+        WdfObjectReleaseLock(Extension->WdfDevice);
+
+        while (!Extension->TimedWriteFlushes && now.QuadPart < launchTime) {
+
+            now = KeQueryPerformanceCounter(NULL);
+
+        }
+
+        WdfObjectAcquireLock(Extension->WdfDevice);
+
+    }
+
+    if (reqContext->Cancelled) {
+
+        //
+        // The cancel routine couldn't stop the timer because it had
+        // already fired.  We hold the last reference so finish it off.
+        //
+
+        SerialTryToCompleteCurrent(Extension, NULL,
+                                   STATUS_CANCELLED, &Extension->CurrentWriteRequest,
+                                   Extension->WriteQueue,
+                                   Extension->TimedWriteTimer,
+                                   Extension->WriteRequestTotalTimer,
+                                   SerialStartWrite, SerialGetNextWrite,
+                                   SERIAL_REF_INT_TIMER);
+
+    } else {
+
+        SERIAL_CLEAR_REFERENCE(reqContext, SERIAL_REF_INT_TIMER);
+
+        WdfInterruptSynchronize(
+            Extension->WdfInterrupt,
+            SerialLaunchTimedWrite,
+            Extension
+            );
+
+    }
+
+    WdfObjectReleaseLock(Extension->WdfDevice);
+
+    SerialDbgPrintEx(TRACE_LEVEL_INFORMATION, DBG_WRITE, "<SerialTimedWriteLaunch\n");
+}
+
+
+BOOLEAN
+SerialLaunchTimedWrite(
+    IN WDFINTERRUPT Interrupt,
+    IN PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gives the current timed write to the isr, which
+    records the launch time when it puts the first byte in the
+    transmit fifo.
+
+    NOTE: This routine is called by WdfInterruptSynchronize.
+
+    NOTE: This routine assumes that it is called with the
+          cancel spin lock held.
+
+Arguments:
+
+    Context - Really a pointer to the device extension.
+
+Return Value:
+
+    This routine always returns FALSE.
+
+--*/
+
+{
+
+    PSERIAL_DEVICE_EXTENSION Extension = Context;
+
+    Extension->TimedWriteLaunchTime = 0;
+    Extension->TimedWriteStampPending = TRUE;
+
+    return SerialGiveWriteToIsr(Interrupt, Context);
+
+}
+
+
+VOID
+SerialFlushTimedWrite(
+    IN PSERIAL_DEVICE_EXTENSION Extension
+    )
+
+/*++
+
+Routine Description:
+
+    This routine launches the current timed write now if it is being
+    held on the timed write timer, so a flush doesn't wait for its
+    launch time.  If the timer has already fired, the timer routine
+    sees TimedWriteFlushes and launches it itself.
+
+    NOTE: This routine is called with the device lock held and
+          TimedWriteFlushes already raised.
+
+Arguments:
+
+    Extension - Points to the serial device extension
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PREQUEST_CONTEXT reqContext;
+
+    if (!Extension->CurrentWriteRequest) {
+
+        return;
+
+    }
+
+    reqContext = SerialGetRequestContext(Extension->CurrentWriteRequest);
+
+    if (!SERIAL_IS_TIMED_WRITE(reqContext) ||
+        !SERIAL_TEST_REFERENCE(reqContext, SERIAL_REF_INT_TIMER) ||
+        reqContext->Cancelled) {
+
+        return;
+
+    }
+
+    if (SerialCancelTimer(Extension->TimedWriteTimer, Extension)) {
+
+        SERIAL_CLEAR_REFERENCE(reqContext, SERIAL_REF_INT_TIMER);
+
+        SerialHoldTimedWrite(Extension);
+
+    }
+
+}
@@ -0,0 +1,443 @@
+/*
+    Times lib/raw/calculate-clock-bits.c and checks that it still gives the
+    same clock bits as it did before a change.
+
+    record solves a fixed set of FSCC (frequency, ppm) pairs and 335
+    frequencies and writes the results to a corpus file. How many rates
+    are spread over each range and where the FSCC range starts can be
+    changed, since the old search takes seconds for each low rate. check
+    solves everything in a corpus file again and reports anything that
+    differs. Lines starting with # are skipped. Both print the 50th and
+    99th percentile solve times. The clock cache is turned off so every
+    rate is really searched for.
+
+    clock-bits-baseline.corpus was recorded from the solver as it was
+    before any of the search changes, with 600 rates and the FSCC range
+    starting at 200 kHz. make check runs it.
+
+    batch times calculate_clock_bits_fscc_batch on evenly spaced sweeps
+    of FSCC rates against solving the same rates one at a time, prints
+    rates per second for each and checks they give the same bits. make
+    bench runs it.
+
+    The library only needs libc, libm and threads, so this builds anywhere.
+
+        cc -O2 -I../lib/raw -o clock-bits-bench clock-bits-bench.c \
+            ../lib/raw/calculate-clock-bits.c -lm -lpthread
+        ./clock-bits-bench record before.corpus [rates [lowest fscc rate]]
+        (change the solver and build again)
+        ./clock-bits-bench check before.corpus
+        ./clock-bits-bench batch [rates [ppm]]
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "calculate-clock-bits.h"
+
+#define LOG_RATES 2000 /* spread evenly on a log scale over each range */
+
+#define FSCC_MIN_RATE 1000
+#define FSCC_MAX_RATE 200000000
+#define PCI_MIN_RATE 6000000
+#define PCI_MAX_RATE 180000000
+
+static const unsigned long fscc_ppms[] = {0, 10, 100};
+
+/* Ranges batch sweeps, evenly spaced */
+static const struct {
+    unsigned long first;
+    unsigned long last;
+} batch_ranges[] = {
+    {100000, 1000000},
+    {1000000, 50000000},
+    {50000000, 270000000}
+};
+
+/* Rates people actually ask for, tried on both chips where they fit. */
+static const unsigned long standard_rates[] = {
+    1843200, 3686400, 7372800, 8000000, 10000000, 11059200, 12000000,
+    14745600, 16000000, 18432000, 20000000, 22118400, 24000000, 25000000,
+    29491200, 32000000, 33000000, 36864000, 40000000, 44236800, 48000000,
+    50000000, 58982400, 64000000, 73728000, 100000000, 125000000,
+    147456000, 160000000
+};
+
+struct sample {
+    char chip[8];
+    unsigned long frequency;
+    unsigned long ppm;
+    unsigned long result;       /* 0 if there is no setting */
+    unsigned char bits[20];
+    double seconds;
+};
+
+static double now(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER count, frequency;
+
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+
+    return (double)count.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+static void solve(struct sample *s)
+{
+    double start;
+
+    s->result = 0;
+    memset(s->bits, 0, sizeof(s->bits));
+
+    if (strcmp(s->chip, "fscc") == 0) {
+        clock_data_fscc clock_data;
+
+        start = now();
+        if (calculate_clock_bits_fscc_r(s->frequency, s->ppm, 1, &clock_data) == CLOCK_BITS_OK) {
+            s->result = clock_data.frequency;
+            memcpy(s->bits, clock_data.clock_bits, sizeof(s->bits));
+        }
+        s->seconds = now() - start;
+    }
+    else {
+        clock_data_335 clock_data;
+
+        start = now();
+        if (calculate_clock_bits_335_r(s->frequency, &clock_data) == CLOCK_BITS_OK) {
+            s->result = clock_data.frequency;
+            s->bits[0] = (unsigned char)(clock_data.clock_bits >> 16);
+            s->bits[1] = (unsigned char)(clock_data.clock_bits >> 8);
+            s->bits[2] = (unsigned char)clock_data.clock_bits;
+        }
+        s->seconds = now() - start;
+    }
+}
+
+static void write_sample(FILE *f, const struct sample *s)
+{
+    unsigned i;
+    unsigned count = strcmp(s->chip, "fscc") == 0 ? 20 : 3;
+
+    fprintf(f, "%s %lu %lu %lu ", s->chip, s->frequency, s->ppm, s->result);
+
+    for (i = 0; i < count; i++)
+        fprintf(f, "%02x", s->bits[i]);
+
+    fprintf(f, "\n");
+}
+
+static int parse_sample(const char *line, struct sample *s)
+{
+    char hex[64];
+    unsigned i, count;
+
+    memset(s, 0, sizeof(*s));
+
+    if (sscanf(line, "%7s %lu %lu %lu %63s", s->chip, &s->frequency, &s->ppm,
+               &s->result, hex) != 5)
+        return 1;
+
+    count = strcmp(s->chip, "fscc") == 0 ? 20 : 3;
+
+    if ((strcmp(s->chip, "fscc") != 0 && strcmp(s->chip, "335") != 0) ||
+        strlen(hex) != count * 2)
+        return 1;
+
+    for (i = 0; i < count; i++) {
+        unsigned byte;
+
+        if (sscanf(hex + i * 2, "%2x", &byte) != 1)
+            return 1;
+
+        s->bits[i] = (unsigned char)byte;
+    }
+
+    return 0;
+}
+
+/* The built in set of rates, returning how many were filled in. */
+static size_t make_samples(struct sample *samples, unsigned rates, unsigned long fscc_min)
+{
+    size_t count = 0;
+    unsigned i, p;
+
+    for (i = 0; i < rates; i++) {
+        double x = rates > 1 ? (double)i / (rates - 1) : 0.0;
+
+        for (p = 0; p < sizeof(fscc_ppms) / sizeof(fscc_ppms[0]); p++) {
+            strcpy(samples[count].chip, "fscc");
+            samples[count].frequency = (unsigned long)(fscc_min * pow((double)FSCC_MAX_RATE / fscc_min, x));
+            samples[count].ppm = fscc_ppms[p];
+            count++;
+        }
+
+        strcpy(samples[count].chip, "335");
+        samples[count].frequency = (unsigned long)(PCI_MIN_RATE * pow((double)PCI_MAX_RATE / PCI_MIN_RATE, x));
+        count++;
+    }
+
+    for (i = 0; i < sizeof(standard_rates) / sizeof(standard_rates[0]); i++) {
+        for (p = 0; p < sizeof(fscc_ppms) / sizeof(fscc_ppms[0]); p++) {
+            strcpy(samples[count].chip, "fscc");
+            samples[count].frequency = standard_rates[i];
+            samples[count].ppm = fscc_ppms[p];
+            count++;
+        }
+
+        if (standard_rates[i] >= PCI_MIN_RATE && standard_rates[i] <= PCI_MAX_RATE) {
+            strcpy(samples[count].chip, "335");
+            samples[count].frequency = standard_rates[i];
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void print_times(const char *chip, const struct sample *samples, size_t count)
+{
+    double *times;
+    size_t i, n = 0;
+
+    times = malloc((count ? count : 1) * sizeof(*times));
+    if (!times)
+        return;
+
+    for (i = 0; i < count; i++) {
+        if (strcmp(samples[i].chip, chip) == 0)
+            times[n++] = samples[i].seconds;
+    }
+
+    if (n) {
+        qsort(times, n, sizeof(*times), compare_double);
+        printf("%-4s %6lu rates  p50 %10.3f us  p99 %10.3f us  max %10.3f us\n",
+               chip, (unsigned long)n, times[(n - 1) / 2] * 1e6,
+               times[(n - 1) * 99 / 100] * 1e6, times[n - 1] * 1e6);
+    }
+
+    free(times);
+}
+
+static int record(const char *path, unsigned rates, unsigned long fscc_min)
+{
+    size_t max = (size_t)rates * 4 + sizeof(standard_rates) / sizeof(standard_rates[0]) * 4;
+    struct sample *samples;
+    size_t count, i;
+    FILE *f;
+
+    samples = malloc(max * sizeof(*samples));
+    if (!samples)
+        return 1;
+
+    count = make_samples(samples, rates, fscc_min);
+
+    f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        free(samples);
+        return 1;
+    }
+
+    for (i = 0; i < count; i++) {
+        solve(&samples[i]);
+        write_sample(f, &samples[i]);
+    }
+
+    if (fclose(f) != 0) {
+        perror(path);
+        free(samples);
+        return 1;
+    }
+
+    print_times("fscc", samples, count);
+    print_times("335", samples, count);
+
+    free(samples);
+    return 0;
+}
+
+static int check(const char *path)
+{
+    struct sample *samples = NULL;
+    size_t count = 0, allocated = 0, differ = 0;
+    char line[256];
+    FILE *f;
+
+    f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        struct sample expected, got;
+
+        if (line[0] == '#')
+            continue;
+
+        if (parse_sample(line, &expected)) {
+            fprintf(stderr, "%s: bad line: %s", path, line);
+            fclose(f);
+            free(samples);
+            return 1;
+        }
+
+        got = expected;
+        solve(&got);
+
+        if (got.result != expected.result || memcmp(got.bits, expected.bits, sizeof(got.bits)) != 0) {
+            printf("differs: ");
+            write_sample(stdout, &expected);
+            printf("     now: ");
+            write_sample(stdout, &got);
+            differ++;
+        }
+
+        if (count == allocated) {
+            struct sample *more;
+
+            allocated = allocated ? allocated * 2 : 1024;
+            more = realloc(samples, allocated * sizeof(*samples));
+            if (!more) {
+                fclose(f);
+                free(samples);
+                return 1;
+            }
+            samples = more;
+        }
+
+        samples[count++] = got;
+    }
+
+    fclose(f);
+
+    print_times("fscc", samples, count);
+    print_times("335", samples, count);
+    printf("%lu of %lu rates differ\n", (unsigned long)differ, (unsigned long)count);
+
+    free(samples);
+    return differ ? 1 : 0;
+}
+
+static int batch(unsigned rates, unsigned long ppm)
+{
+    unsigned long *frequencies;
+    clock_data_fscc *batched, *single;
+    size_t differ = 0;
+    unsigned i, b;
+
+    frequencies = malloc(rates * sizeof(*frequencies));
+    batched = malloc(rates * sizeof(*batched));
+    single = malloc(rates * sizeof(*single));
+    if (!frequencies || !batched || !single) {
+        free(frequencies);
+        free(batched);
+        free(single);
+        return 1;
+    }
+
+    for (b = 0; b < sizeof(batch_ranges) / sizeof(batch_ranges[0]); b++) {
+        unsigned long first = batch_ranges[b].first, last = batch_ranges[b].last;
+        double start, batch_seconds, single_seconds;
+
+        for (i = 0; i < rates; i++)
+            frequencies[i] = first + (unsigned long)((double)(last - first) * i / (rates > 1 ? rates - 1 : 1));
+
+        start = now();
+        calculate_clock_bits_fscc_batch(frequencies, rates, ppm, batched);
+        batch_seconds = now() - start;
+
+        start = now();
+        for (i = 0; i < rates; i++) {
+            if (calculate_clock_bits_fscc_r(frequencies[i], ppm, 1, &single[i]) != CLOCK_BITS_OK) {
+                single[i].frequency = 0;
+                memset(single[i].clock_bits, 0, sizeof(single[i].clock_bits));
+            }
+        }
+        single_seconds = now() - start;
+
+        for (i = 0; i < rates; i++) {
+            if (batched[i].frequency != single[i].frequency ||
+                memcmp(batched[i].clock_bits, single[i].clock_bits, sizeof(single[i].clock_bits)) != 0) {
+                printf("differs: %lu Hz %lu ppm, batch %lu Hz, single %lu Hz\n", frequencies[i], ppm,
+                       batched[i].frequency, single[i].frequency);
+                differ++;
+            }
+        }
+
+        printf("%9lu-%9lu Hz %6u rates %4lu ppm  batch %10.1f/s  single %10.1f/s\n",
+               first, last, rates, ppm, rates / batch_seconds, rates / single_seconds);
+    }
+
+    printf("%lu rates differ\n", (unsigned long)differ);
+
+    free(frequencies);
+    free(batched);
+    free(single);
+    return differ ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned rates = LOG_RATES;
+    unsigned long fscc_min = FSCC_MIN_RATE;
+
+    unsigned long ppm = 10;
+
+    if (argc >= 2 && argc <= 4 && strcmp(argv[1], "batch") == 0) {
+        rates = 1000;
+        if (argc > 2)
+            rates = (unsigned)strtoul(argv[2], NULL, 0);
+        if (argc > 3)
+            ppm = strtoul(argv[3], NULL, 0);
+    }
+    else if (argc >= 3 && argc <= 5 && strcmp(argv[1], "record") == 0) {
+        if (argc > 3)
+            rates = (unsigned)strtoul(argv[3], NULL, 0);
+        if (argc > 4)
+            fscc_min = strtoul(argv[4], NULL, 0);
+    }
+    else if (argc != 3 || strcmp(argv[1], "check") != 0) {
+        fprintf(stderr, "usage: %s record <corpus file> [rates [lowest fscc rate]]\n"
+                        "       %s check <corpus file>\n"
+                        "       %s batch [rates [ppm]]\n", argv[0], argv[0], argv[0]);
+        return 2;
+    }
+
+    if (rates < 1 || fscc_min < 1 || fscc_min >= FSCC_MAX_RATE) {
+        fprintf(stderr, "%s: bad rates or lowest fscc rate\n", argv[0]);
+        return 2;
+    }
+
+    calculate_clock_bits_set_cache(NULL);
+
+    if (strcmp(argv[1], "batch") == 0)
+        return batch(rates, ppm);
+
+    if (strcmp(argv[1], "record") == 0)
+        return record(argv[2], rates, fscc_min);
+
+    return check(argv[2]);
+}
@@ -0,0 +1,211 @@
+/*
+    Decodes a flight recorder snapshot taken with IOCTL_FASTCOM_DUMP_TRACE
+    and saved as-is to a file (see examples/dump-trace.c).
+
+    This is plain C with no Windows dependencies so the snapshot can be
+    looked at anywhere.
+
+        cc -o decode-trace decode-trace.c
+        ./decode-trace COM3.trace
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* These mirror serialfc.h, which needs Windows.h. */
+#define SERIALFC_TRACE_IIR 1
+#define SERIALFC_TRACE_LSR_ERROR 2
+#define SERIALFC_TRACE_REQUEST_START 3
+#define SERIALFC_TRACE_REQUEST_COMPLETE 4
+#define SERIALFC_TRACE_TX_HOLDING 5
+#define SERIALFC_TRACE_RX_HOLDING 6
+
+#define SERIALFC_TRACE_ENTRIES 1024
+
+#define HEADER_SIZE 16
+#define ENTRY_SIZE 24
+
+struct entry {
+    int64_t timestamp;
+    uint32_t sequence;
+    uint16_t event;
+    uint16_t info;
+    uint32_t data;
+    uint32_t extra;
+};
+
+static uint32_t get32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+           (uint32_t)p[3] << 24;
+}
+
+static int64_t get64(const unsigned char *p)
+{
+    return (int64_t)((uint64_t)get32(p) | (uint64_t)get32(p + 4) << 32);
+}
+
+static int compare_sequence(const void *a, const void *b)
+{
+    const struct entry *x = a, *y = b;
+
+    return (x->sequence > y->sequence) - (x->sequence < y->sequence);
+}
+
+static const char *major_function(unsigned major)
+{
+    switch (major) {
+    case 0x00: return "CREATE";
+    case 0x02: return "CLOSE";
+    case 0x03: return "READ";
+    case 0x04: return "WRITE";
+    case 0x0e: return "DEVICE_CONTROL";
+    case 0x0f: return "INTERNAL_DEVICE_CONTROL";
+    default: return "?";
+    }
+}
+
+static const char *iir_cause(unsigned iir)
+{
+    switch (iir & 0x0f) {
+    case 0x06: return "RLS";
+    case 0x04: return "RDA";
+    case 0x0c: return "CTI";
+    case 0x02: return "THR";
+    case 0x00: return "MS";
+    default: return "?";
+    }
+}
+
+static void print_bits(unsigned value, const char *const *names, unsigned count)
+{
+    unsigned i;
+    int any = 0;
+
+    for (i = 0; i < count; i++) {
+        if (value & (1u << i) && names[i]) {
+            printf("%s%s", any ? "|" : "", names[i]);
+            any = 1;
+        }
+    }
+
+    if (!any)
+        printf("none");
+}
+
+static void print_entry(const struct entry *e)
+{
+    static const char *const lsr[] = {"DR", "OE", "PE", "FE", "BI", "THRE", "TEMT", "FIFOERR"};
+    static const char *const tx_holding[] = {"CTS", "DSR", "DCD", "XOFF", "BREAK"};
+    static const char *const rx_holding[] = {"DTR", "XOFF", "RTS", "DSR"};
+
+    switch (e->event) {
+    case SERIALFC_TRACE_IIR:
+        printf("IIR 0x%02x %s", (unsigned)e->data, iir_cause(e->data));
+        break;
+
+    case SERIALFC_TRACE_LSR_ERROR:
+        printf("LSR 0x%02x ", (unsigned)e->data);
+        print_bits(e->data, lsr, 8);
+        break;
+
+    case SERIALFC_TRACE_REQUEST_START:
+        printf("START %s length %u", major_function(e->info), (unsigned)e->data);
+        if (e->extra)
+            printf(" ioctl 0x%08x", (unsigned)e->extra);
+        break;
+
+    case SERIALFC_TRACE_REQUEST_COMPLETE:
+        printf("COMPLETE %s status 0x%08x", major_function(e->info), (unsigned)e->data);
+        if (e->extra)
+            printf(" ioctl 0x%08x", (unsigned)e->extra);
+        break;
+
+    case SERIALFC_TRACE_TX_HOLDING:
+        printf("TXHolding ");
+        print_bits(e->data, tx_holding, 5);
+        break;
+
+    case SERIALFC_TRACE_RX_HOLDING:
+        printf("RXHolding ");
+        print_bits(e->data, rx_holding, 4);
+        break;
+
+    default:
+        printf("event %u info 0x%x data 0x%x extra 0x%x", (unsigned)e->event,
+               (unsigned)e->info, (unsigned)e->data, (unsigned)e->extra);
+        break;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned char raw[HEADER_SIZE + SERIALFC_TRACE_ENTRIES * ENTRY_SIZE];
+    struct entry entries[SERIALFC_TRACE_ENTRIES];
+    int64_t frequency;
+    uint32_t next_sequence;
+    unsigned count = 0;
+    unsigned i;
+    FILE *f;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <trace file>\n", argv[0]);
+        return 2;
+    }
+
+    f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    if (fread(raw, sizeof(raw), 1, f) != 1) {
+        fprintf(stderr, "%s: not a complete trace snapshot\n", argv[1]);
+        fclose(f);
+        return 1;
+    }
+
+    fclose(f);
+
+    frequency = get64(raw);
+    next_sequence = get32(raw + 8);
+
+    if (frequency <= 0) {
+        fprintf(stderr, "%s: bad performance counter frequency\n", argv[1]);
+        return 1;
+    }
+
+    /* Skip unused slots and anything overwritten while the snapshot was
+       being taken. */
+    for (i = 0; i < SERIALFC_TRACE_ENTRIES; i++) {
+        const unsigned char *p = raw + HEADER_SIZE + i * ENTRY_SIZE;
+        struct entry e;
+
+        e.timestamp = get64(p);
+        e.sequence = get32(p + 8);
+        e.event = (uint16_t)(p[12] | p[13] << 8);
+        e.info = (uint16_t)(p[14] | p[15] << 8);
+        e.data = get32(p + 16);
+        e.extra = get32(p + 20);
+
+        if (e.sequence == 0 || next_sequence - e.sequence > SERIALFC_TRACE_ENTRIES)
+            continue;
+
+        entries[count++] = e;
+    }
+
+    qsort(entries, count, sizeof(entries[0]), compare_sequence);
+
+    for (i = 0; i < count; i++) {
+        double us = (double)(entries[i].timestamp - entries[0].timestamp) * 1e6 /
+                    (double)frequency;
+
+        printf("%10u %14.3f us  ", (unsigned)entries[i].sequence, us);
+        print_entry(&entries[i]);
+        printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,348 @@
+/*
+    Puts uart-emu cards on the wdf-shim bus. See emu-card.h.
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "emu-card.h"
+
+#define EMU_CARD_MAX 16
+#define EMU_CARD_VENDOR_ID 0x18f7
+#define EMU_CARD_MEMORY_BASE 0xfe000000ULL
+#define EMU_CARD_MEMORY_SPAN 0x100000
+#define EMU_CARD_PORT_BASE 0xd000
+#define EMU_CARD_PORT_SPAN 0x100
+#define EMU_CARD_VECTOR 16
+
+/* Device IDs FastcomGetCardType knows, from serial.h */
+#define EMU_CARD_422_2_PCI_335_ID 0x0004
+#define EMU_CARD_422_4_PCI_335_ID 0x0002
+#define EMU_CARD_232_8_PCI_335_ID 0x000b
+#define EMU_CARD_422_4_PCIE_ID 0x0020
+#define EMU_CARD_422_8_PCIE_ID 0x0021
+#define EMU_CARD_FSCC_ID 0x000f
+
+DRIVER_INITIALIZE DriverEntry;
+
+struct emu_card;
+
+struct emu_port {
+    struct emu_card *card;
+    unsigned channel;
+    WDFDEVICE device;
+    WCHAR port_name[16];
+};
+
+struct emu_card {
+    struct uart_emu_card *uart;
+    enum uart_emu_family family;
+    unsigned index;
+    unsigned channels;
+    unsigned char *registers;
+    struct emu_port ports[UART_EMU_MAX_CHANNELS];
+};
+
+static struct emu_card *cards[EMU_CARD_MAX];
+static unsigned long long origin;
+
+static unsigned long long monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Brings every card up to the wall clock, called with the bus lock held */
+static ULONGLONG run_hardware(PVOID context)
+{
+    unsigned long long target = monotonic_ns() - origin;
+    unsigned long long now = uart_emu_now();
+
+    UNREFERENCED_PARAMETER(context);
+
+    if (target > now)
+        uart_emu_advance(target - now);
+
+    return uart_emu_next_event();
+}
+
+static void line_active(void *context, struct uart_emu_card *card, unsigned channel)
+{
+    UNREFERENCED_PARAMETER(context);
+    UNREFERENCED_PARAMETER(card);
+    UNREFERENCED_PARAMETER(channel);
+
+    WdfShimBusWake();
+}
+
+static BOOLEAN interrupt_asserted(PVOID context)
+{
+    struct emu_port *port = context;
+
+    return uart_emu_interrupt_pending(port->card->uart, port->channel) != 0;
+}
+
+static UCHAR read_uchar(PVOID context, ULONG offset)
+{
+    struct emu_card *card = context;
+
+    return uart_emu_read_uchar(card->registers + offset);
+}
+
+static VOID write_uchar(PVOID context, ULONG offset, UCHAR value)
+{
+    struct emu_card *card = context;
+
+    uart_emu_write_uchar(card->registers + offset, value);
+}
+
+static const WDF_SHIM_BUS_HANDLERS uart_handlers = { read_uchar, write_uchar, NULL, NULL };
+
+static ULONG channel_stride(enum uart_emu_family family)
+{
+    switch (family) {
+    case UART_EMU_XR17D15X:
+        return 0x200;
+
+    case UART_EMU_XR17V35X:
+        return 0x400;
+
+    default:
+        return 8;
+    }
+}
+
+static USHORT device_id(enum uart_emu_family family, unsigned channels)
+{
+    switch (family) {
+    case UART_EMU_XR17D15X:
+        if (channels <= 2)
+            return EMU_CARD_422_2_PCI_335_ID;
+        return channels <= 4 ? EMU_CARD_422_4_PCI_335_ID : EMU_CARD_232_8_PCI_335_ID;
+
+    case UART_EMU_XR17V35X:
+        return channels <= 4 ? EMU_CARD_422_4_PCIE_ID : EMU_CARD_422_8_PCIE_ID;
+
+    default:
+        return EMU_CARD_FSCC_ID;
+    }
+}
+
+NTSTATUS emu_card_start(unsigned long long spin_ns)
+{
+    WDF_SHIM_HARDWARE hardware;
+    NTSTATUS status;
+
+    status = WdfShimDriverLoad(DriverEntry);
+    if (!NT_SUCCESS(status))
+        return status;
+
+    origin = monotonic_ns() - uart_emu_now();
+
+    hardware.Run = run_hardware;
+    hardware.Context = NULL;
+    hardware.SpinNs = spin_ns;
+    WdfShimBusSetHardware(&hardware);
+
+    return STATUS_SUCCESS;
+}
+
+void emu_card_stop(void)
+{
+    unsigned i;
+
+    for (i = 0; i < EMU_CARD_MAX; i++) {
+        if (cards[i])
+            emu_card_remove(cards[i]);
+    }
+
+    WdfShimDriverUnload();
+    WdfShimBusSetHardware(NULL);
+}
+
+static NTSTATUS add_port(struct emu_card *card, unsigned channel, ULONGLONG base, ULONG stride,
+                         const WDF_SHIM_REGISTRY_VALUE *registry, unsigned long registry_count)
+{
+    struct emu_port *port = &card->ports[channel];
+    WDF_SHIM_REGISTRY_VALUE *values;
+    WDF_SHIM_DEVICE_CONFIG config;
+    BOOLEAN named = FALSE;
+    unsigned long i;
+    NTSTATUS status;
+
+    values = calloc(registry_count + 1, sizeof(*values));
+    if (!values)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    for (i = 0; i < registry_count; i++) {
+        values[i] = registry[i];
+        if (!wcscmp(registry[i].Name, L"PortName"))
+            named = TRUE;
+    }
+
+    port->card = card;
+    port->channel = channel;
+    swprintf(port->port_name, sizeof(port->port_name) / sizeof(WCHAR), L"EMU%u%u", card->index, channel);
+
+    if (!named) {
+        values[i].Name = L"PortName";
+        values[i].Type = REG_SZ;
+        values[i].String = port->port_name;
+        i++;
+    }
+
+    RtlZeroMemory(&config, sizeof(config));
+    config.VendorId = EMU_CARD_VENDOR_ID;
+    config.DeviceId = device_id(card->family, card->channels);
+    config.InterruptAsserted = interrupt_asserted;
+    config.InterruptContext = port;
+    config.Registry = values;
+    config.RegistryCount = i;
+
+    if (card->family == UART_EMU_16C950) {
+        /* I/O BARs, the low bit says so */
+        config.Bars[0] = (ULONG)(base | 1);
+        config.Bars[1] = (ULONG)(base + 0x80) | 1;
+        config.Bars[2] = (ULONG)(base + 0xc0) | 1;
+
+        config.Resources[0].Type = CmResourceTypePort;
+        config.Resources[0].Flags = CM_RESOURCE_PORT_IO;
+        config.Resources[0].u.Port.Start.QuadPart = base + 0x80 + channel * stride;
+        config.Resources[0].u.Port.Length = stride;
+    }
+    else {
+        config.Bars[0] = (ULONG)base;
+
+        config.Resources[0].Type = CmResourceTypeMemory;
+        config.Resources[0].Flags = CM_RESOURCE_PORT_MEMORY;
+        config.Resources[0].u.Memory.Start.QuadPart = base + channel * stride;
+        config.Resources[0].u.Memory.Length = stride;
+    }
+
+    config.Resources[1].Type = CmResourceTypeInterrupt;
+    config.Resources[1].ShareDisposition = CmResourceShareShared;
+    config.Resources[1].Flags = CM_RESOURCE_INTERRUPT_LEVEL_SENSITIVE;
+    config.Resources[1].u.Interrupt.Level = EMU_CARD_VECTOR + card->index;
+    config.Resources[1].u.Interrupt.Vector = EMU_CARD_VECTOR + card->index;
+    config.Resources[1].u.Interrupt.Affinity = 1;
+    config.ResourceCount = 2;
+
+    status = WdfShimDeviceAdd(&config, &port->device);
+
+    free(values);
+
+    if (!NT_SUCCESS(status))
+        port->device = NULL;
+
+    return status;
+}
+
+NTSTATUS emu_card_add(enum uart_emu_family family, unsigned channels,
+                      const WDF_SHIM_REGISTRY_VALUE *registry, unsigned long registry_count,
+                      struct emu_card **out)
+{
+    ULONG stride = channel_stride(family);
+    struct emu_card *card;
+    ULONGLONG base;
+    NTSTATUS status;
+    unsigned i, index;
+
+    for (index = 0; index < EMU_CARD_MAX && cards[index]; index++)
+        ;
+
+    if (index == EMU_CARD_MAX)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    card = calloc(1, sizeof(*card));
+    if (!card)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    /* The interrupt thread runs every card there is */
+    WdfShimBusLock();
+    card->uart = uart_emu_create(family, channels);
+    if (card->uart)
+        uart_emu_set_interrupt(card->uart, line_active, card);
+    WdfShimBusUnlock();
+
+    if (!card->uart) {
+        free(card);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    card->family = family;
+    card->index = index;
+    card->channels = channels;
+    card->registers = uart_emu_channel(card->uart, 0);
+
+    if (family == UART_EMU_16C950) {
+        base = EMU_CARD_PORT_BASE + index * EMU_CARD_PORT_SPAN;
+
+        /* Bar0 and Bar2 hold the FSCC's own registers, which read back
+           what was written */
+        status = WdfShimBusAddPorts((ULONG)base, 0x80, NULL, card);
+        if (NT_SUCCESS(status))
+            status = WdfShimBusAddPorts((ULONG)base + 0x80, channels * stride, &uart_handlers, card);
+        if (NT_SUCCESS(status))
+            status = WdfShimBusAddPorts((ULONG)base + 0xc0, 0x40, NULL, card);
+    }
+    else {
+        base = EMU_CARD_MEMORY_BASE + (ULONGLONG)index * EMU_CARD_MEMORY_SPAN;
+
+        status = WdfShimBusAddMemory(base, channels * stride, card->registers, &uart_handlers, card);
+    }
+
+    if (!NT_SUCCESS(status)) {
+        WdfShimBusRemove(card);
+        WdfShimBusLock();
+        uart_emu_destroy(card->uart);
+        WdfShimBusUnlock();
+        free(card);
+        return status;
+    }
+
+    cards[index] = card;
+
+    for (i = 0; i < channels; i++) {
+        status = add_port(card, i, base, stride, registry, registry_count);
+        if (!NT_SUCCESS(status))
+            fprintf(stderr, "emu-card: channel %u of card %u didn't start, 0x%08x\n", i, index,
+                    (unsigned)status);
+    }
+
+    if (out)
+        *out = card;
+
+    return STATUS_SUCCESS;
+}
+
+void emu_card_remove(struct emu_card *card)
+{
+    unsigned i;
+
+    for (i = 0; i < card->channels; i++) {
+        if (card->ports[i].device)
+            WdfShimDeviceRemove(card->ports[i].device);
+    }
+
+    WdfShimBusRemove(card);
+
+    WdfShimBusLock();
+    uart_emu_destroy(card->uart);
+    WdfShimBusUnlock();
+
+    cards[card->index] = NULL;
+    free(card);
+}
+
+struct uart_emu_card *emu_card_uart(struct emu_card *card)
+{
+    return card->uart;
+}
+
+WDFDEVICE emu_card_device(struct emu_card *card, unsigned channel)
+{
+    return channel < card->channels ? card->ports[channel].device : NULL;
+}
@@ -0,0 +1,51 @@
+/*
+    Puts uart-emu cards on the wdf-shim bus, so the driver finds them the
+    way it finds a real card: each channel is a device with the card's
+    PCI IDs, BARs and a register resource of its own, and its interrupt
+    line is the channel's. Build it, uart-emu.c and wdf-shim.c with the
+    driver the way wdf-shim.h says.
+
+    The emulated clock follows the wall clock from emu_card_start on, so
+    characters take as long as they would on the wire. Touch a card's
+    uart-emu functions between WdfShimBusLock and WdfShimBusUnlock once
+    it has been started.
+*/
+
+#ifndef EMU_CARD_H
+#define EMU_CARD_H
+
+#include "wdf-shim.h"
+#include "uart-emu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct emu_card;
+
+/* Loads the driver and starts running the emulated line. Below SpinNs
+   the interrupt thread waits on the line by spinning, which costs a
+   processor but keeps interrupt latency near the hardware's. */
+NTSTATUS emu_card_start(unsigned long long spin_ns);
+
+/* Removes any cards left and unloads the driver */
+void emu_card_stop(void);
+
+/* Adds a card and a device for each of its channels. The registry values
+   go in every channel's device key. PortName is set to EMU<card><channel>
+   unless the values have one. */
+NTSTATUS emu_card_add(enum uart_emu_family family, unsigned channels,
+                      const WDF_SHIM_REGISTRY_VALUE *registry, unsigned long registry_count,
+                      struct emu_card **card);
+void emu_card_remove(struct emu_card *card);
+
+struct uart_emu_card *emu_card_uart(struct emu_card *card);
+
+/* NULL if the channel's device didn't start */
+WDFDEVICE emu_card_device(struct emu_card *card, unsigned channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
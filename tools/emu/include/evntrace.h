@@ -0,0 +1,9 @@
+/*
+    Stands in for evntrace.h. The driver is built without EVENT_TRACING,
+    so trace.h only wants the TRACE_LEVEL values, which it defines itself.
+*/
+
+#ifndef WDF_SHIM_EVNTRACE_H
+#define WDF_SHIM_EVNTRACE_H
+
+#endif
@@ -0,0 +1,11 @@
+/*
+    Stands in for initguid.h. DEFINE_GUID always defines the GUID in the
+    user mode build, see ntddk.h.
+*/
+
+#ifndef WDF_SHIM_INITGUID_H
+#define WDF_SHIM_INITGUID_H
+
+#include "ntddk.h"
+
+#endif
@@ -0,0 +1,25 @@
+/*
+    Stands in for ntstrsafe.h. The format strings are the kernel's, so %ws
+    and %wZ are understood.
+*/
+
+#ifndef WDF_SHIM_NTSTRSAFE_H
+#define WDF_SHIM_NTSTRSAFE_H
+
+#include <stdarg.h>
+
+#include "ntddk.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+NTSTATUS RtlUnicodeStringPrintf(PUNICODE_STRING DestinationString, PCWSTR Format, ...);
+NTSTATUS RtlStringCbPrintfA(PCHAR Destination, size_t Size, PCSTR Format, ...);
+NTSTATUS RtlStringCbVPrintfA(PCHAR Destination, size_t Size, PCSTR Format, va_list Arguments);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,75 @@
+/*
+    Stands in for serlog.h, which the message compiler makes from
+    src/serlog.mc when the driver is built. The codes are worked out the
+    way mc does it, from the severity, the Serial facility (6) and the
+    message id. The list was made from serlog.mc with
+
+        awk '/^MessageId=/ { split($1,a,"="); split($3,s,"="); split($4,n,"=");
+             printf "#define %s SERIAL_LOG_CODE(%s, %s)\n", n[2], toupper(s[2]), a[2] }' \
+            ../../../src/serlog.mc
+
+    so run that again if a message is added there.
+*/
+
+#ifndef WDF_SHIM_SERLOG_H
+#define WDF_SHIM_SERLOG_H
+
+#define FACILITY_SERIAL_ERROR_CODE 0x6
+#define FACILITY_IO_ERROR_CODE 0x4
+
+#define STATUS_SEVERITY_SUCCESS 0x0
+#define STATUS_SEVERITY_INFORMATIONAL 0x1
+#define STATUS_SEVERITY_WARNING 0x2
+#define STATUS_SEVERITY_ERROR 0x3
+
+#define SERIAL_LOG_CODE(severity, id) \
+    ((NTSTATUS)(((ULONG)STATUS_SEVERITY_ ## severity << 30) | \
+                (FACILITY_SERIAL_ERROR_CODE << 16) | (id)))
+
+#define SERIAL_KERNEL_DEBUGGER_ACTIVE SERIAL_LOG_CODE(INFORMATIONAL, 0x0001)
+#define SERIAL_FIFO_PRESENT SERIAL_LOG_CODE(INFORMATIONAL, 0x0002)
+#define SERIAL_USER_OVERRIDE SERIAL_LOG_CODE(INFORMATIONAL, 0x0003)
+#define SERIAL_NO_SYMLINK_CREATED SERIAL_LOG_CODE(WARNING, 0x0004)
+#define SERIAL_NO_DEVICE_MAP_CREATED SERIAL_LOG_CODE(WARNING, 0x0005)
+#define SERIAL_NO_DEVICE_MAP_DELETED SERIAL_LOG_CODE(WARNING, 0x0006)
+#define SERIAL_UNREPORTED_IRQL_CONFLICT SERIAL_LOG_CODE(ERROR, 0x0007)
+#define SERIAL_INSUFFICIENT_RESOURCES SERIAL_LOG_CODE(ERROR, 0x0008)
+#define SERIAL_UNSUPPORTED_CLOCK_RATE SERIAL_LOG_CODE(ERROR, 0x0009)
+#define SERIAL_REGISTERS_NOT_MAPPED SERIAL_LOG_CODE(ERROR, 0x000A)
+#define SERIAL_RESOURCE_CONFLICT SERIAL_LOG_CODE(ERROR, 0x000B)
+#define SERIAL_NO_BUFFER_ALLOCATED SERIAL_LOG_CODE(ERROR, 0x000C)
+#define SERIAL_IER_INVALID SERIAL_LOG_CODE(ERROR, 0x000D)
+#define SERIAL_MCR_INVALID SERIAL_LOG_CODE(ERROR, 0x000E)
+#define SERIAL_IIR_INVALID SERIAL_LOG_CODE(ERROR, 0x000F)
+#define SERIAL_DL_INVALID SERIAL_LOG_CODE(ERROR, 0x0010)
+#define SERIAL_NOT_ENOUGH_CONFIG_INFO SERIAL_LOG_CODE(ERROR, 0x0011)
+#define SERIAL_NO_PARAMETERS_INFO SERIAL_LOG_CODE(ERROR, 0x0012)
+#define SERIAL_UNABLE_TO_ACCESS_CONFIG SERIAL_LOG_CODE(ERROR, 0x0013)
+#define SERIAL_INVALID_PORT_INDEX SERIAL_LOG_CODE(ERROR, 0x0014)
+#define SERIAL_PORT_INDEX_TOO_HIGH SERIAL_LOG_CODE(ERROR, 0x0015)
+#define SERIAL_UNKNOWN_BUS SERIAL_LOG_CODE(ERROR, 0x0016)
+#define SERIAL_BUS_NOT_PRESENT SERIAL_LOG_CODE(ERROR, 0x0017)
+#define SERIAL_BUS_INTERRUPT_CONFLICT SERIAL_LOG_CODE(ERROR, 0x0018)
+#define SERIAL_INVALID_USER_CONFIG SERIAL_LOG_CODE(ERROR, 0x0019)
+#define SERIAL_DEVICE_TOO_HIGH SERIAL_LOG_CODE(ERROR, 0x001A)
+#define SERIAL_STATUS_TOO_HIGH SERIAL_LOG_CODE(ERROR, 0x001B)
+#define SERIAL_STATUS_CONTROL_CONFLICT SERIAL_LOG_CODE(ERROR, 0x001C)
+#define SERIAL_CONTROL_OVERLAP SERIAL_LOG_CODE(ERROR, 0x001D)
+#define SERIAL_STATUS_OVERLAP SERIAL_LOG_CODE(ERROR, 0x001E)
+#define SERIAL_STATUS_STATUS_OVERLAP SERIAL_LOG_CODE(ERROR, 0x001F)
+#define SERIAL_CONTROL_STATUS_OVERLAP SERIAL_LOG_CODE(ERROR, 0x0020)
+#define SERIAL_MULTI_INTERRUPT_CONFLICT SERIAL_LOG_CODE(ERROR, 0x0021)
+#define SERIAL_DISABLED_PORT SERIAL_LOG_CODE(INFORMATIONAL, 0x0022)
+#define SERIAL_GARBLED_PARAMETER SERIAL_LOG_CODE(ERROR, 0x0023)
+#define SERIAL_DLAB_INVALID SERIAL_LOG_CODE(ERROR, 0x0024)
+#define SERIAL_NO_TRANSLATE_PORT SERIAL_LOG_CODE(ERROR, 0x0025)
+#define SERIAL_NO_GET_INTERRUPT SERIAL_LOG_CODE(ERROR, 0x0026)
+#define SERIAL_NO_TRANSLATE_ISR SERIAL_LOG_CODE(ERROR, 0x0027)
+#define SERIAL_NO_DEVICE_REPORT SERIAL_LOG_CODE(ERROR, 0x0028)
+#define SERIAL_REGISTRY_WRITE_FAILED SERIAL_LOG_CODE(ERROR, 0x0029)
+#define SERIAL_MOUSE_CONFLICT_IRQ SERIAL_LOG_CODE(WARNING, 0x002A)
+#define SERIAL_MOUSE_ON_PORT SERIAL_LOG_CODE(WARNING, 0x002B)
+#define SERIAL_NO_DEVICE_REPORT_RES SERIAL_LOG_CODE(ERROR, 0x002C)
+#define SERIAL_HARDWARE_FAILURE SERIAL_LOG_CODE(ERROR, 0x002D)
+
+#endif
@@ -0,0 +1,9 @@
+/*
+    Stands in for wmilib.h. The driver registers with WMI through KMDF, so
+    nothing from here is used.
+*/
+
+#ifndef WDF_SHIM_WMILIB_H
+#define WDF_SHIM_WMILIB_H
+
+#endif
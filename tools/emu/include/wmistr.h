@@ -0,0 +1,10 @@
+/*
+    Stands in for wmistr.h. WMI isn't there in a user mode build.
+*/
+
+#ifndef WDF_SHIM_WMISTR_H
+#define WDF_SHIM_WMISTR_H
+
+#include "ntddk.h"
+
+#endif
@@ -0,0 +1,908 @@
+/*
+    Measures where the time goes in a small request and its answer over a
+    pair of emulated ports. Channel 0 and 1 of one emulated card are wired
+    together, channel 0 writes a message, channel 1 reads it and writes it
+    straight back and channel 0 reads the echo, one round trip at a time,
+    for every combination of the baud rates, trigger levels, message sizes
+    and read modes asked for. Reads either ask for the message's length
+    exactly, or for more with an interval timeout so the interval timer
+    finishes them, the way a reader that doesn't know the length would.
+
+    Each direction is split into stages from the ports' flight recorders
+    (IOCTL_FASTCOM_DUMP_TRACE), and the stages of both directions are
+    added up for each round trip:
+        queue   the write sent to SerialStartOrQueue taking it
+        handoff the write started to the first THR interrupt, which is
+                SerialStartWrite giving it to the ISR
+        tx      that interrupt to the first receive interrupt on the other
+                port, the ISR filling the FIFO and the line
+        rx      the first receive interrupt to the last, the ISR emptying
+                the FIFO as it fills and the character timeout for what
+                is left under the trigger level
+        done    the last receive interrupt to the read completing, the
+                completion DPC for exact reads or the interval timer
+        return  the driver completing the read to it reaching the caller
+        turn    the echo's read reaching the caller to its write being sent
+    with p50, p99, max and mean microseconds and the share of the round
+    trip each takes.
+
+    Then every DPC and timer that ran on either port, by the device
+    extension field it's kept in, with how often it ran for each round
+    trip, how long it waited from being queued or due and how long it ran,
+    and the microseconds of both it cost each round trip, most costly
+    first. The ISR is in there too. The timer waits are only how late it
+    went off; the interval itself is in the done stage.
+
+    Under 20 seconds the driver checks a read's interval by setting the
+    interval timer to go off again right away, which on Windows means on
+    the next clock tick. Timers here go off on a tick of -r microseconds,
+    1000 by default, which is what a machine with timeBeginPeriod(1) in
+    effect ticks at; 15625 is the usual Windows default and 0 lets the
+    timer poll as fast as the DPC thread can run it.
+
+    Reads and writes are sent and reaped on the benchmark's own thread and
+    the emulated interrupts and DPCs run on the shim's, so the numbers
+    include a thread switch or two that a driver on Windows wouldn't have.
+    Runs on a single processor machine make that worse.
+
+    Build it from this directory the way wdf-shim.h says, adding this
+    file, emu-card.c, uart-emu.c and ../../lib/raw/calculate-clock-bits.c,
+    then for example
+
+        ./latency-bench -c pcie -b 921600 -s 1,64 -m exact,interval
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "emu-card.h"
+#include "ntddser.h"
+#include "serialfc.h"
+#include "../../lib/raw/calculate-clock-bits.h"
+
+#define MAX_LIST 16
+#define MAX_SIZE 4096
+#define MAX_DPCS 32
+#define WARMUP 4
+
+/* Interrupt causes the ISR traces, from serial.h */
+#define IIR_RDA 0x04
+#define IIR_CTI 0x0c
+#define IIR_THR 0x02
+
+#define MODE_EXACT 0
+#define MODE_INTERVAL 1
+
+static const char *mode_names[] = {"exact", "interval"};
+
+enum stage {
+    STAGE_QUEUE,
+    STAGE_HANDOFF,
+    STAGE_TX,
+    STAGE_RX,
+    STAGE_DONE,
+    STAGE_RETURN,
+    STAGE_TURN,
+    STAGE_RTT,
+    STAGE_COUNT
+};
+
+static const char *stage_names[] = {"queue", "handoff", "tx", "rx", "done", "return", "turn", "rtt"};
+
+/* The driver's DPCs and timers, see SerialCreateTimersAndDpcs */
+EVT_WDF_DPC SerialCompleteRead;
+EVT_WDF_DPC SerialCompleteWrite;
+EVT_WDF_DPC SerialCommError;
+EVT_WDF_DPC SerialCompleteImmediate;
+EVT_WDF_DPC SerialCompletePriority;
+EVT_WDF_DPC SerialCompleteXoff;
+EVT_WDF_DPC SerialCompleteWait;
+EVT_WDF_DPC SerialStartTimerLowerRTS;
+
+EVT_WDF_TIMER SerialReadTimeout;
+EVT_WDF_TIMER SerialIntervalReadTimeout;
+EVT_WDF_TIMER SerialWriteTimeout;
+EVT_WDF_TIMER SerialTimeoutImmediate;
+EVT_WDF_TIMER SerialTimeoutPriority;
+EVT_WDF_TIMER SerialTimeoutXoff;
+EVT_WDF_TIMER SerialInvokePerhapsLowerRTS;
+EVT_WDF_TIMER SerialTimedWriteLaunch;
+
+static const struct {
+    PVOID callback;
+    const char *name;
+} dpc_names[] = {
+    {(PVOID)SerialCompleteRead, "CompleteReadDpc"},
+    {(PVOID)SerialCompleteWrite, "CompleteWriteDpc"},
+    {(PVOID)SerialCommError, "CommErrorDpc"},
+    {(PVOID)SerialCompleteImmediate, "CompleteImmediateDpc"},
+    {(PVOID)SerialCompletePriority, "CompletePriorityDpc"},
+    {(PVOID)SerialCompleteXoff, "XoffCountCompleteDpc"},
+    {(PVOID)SerialCompleteWait, "CommWaitDpc"},
+    {(PVOID)SerialStartTimerLowerRTS, "StartTimerLowerRTSDpc"},
+    {(PVOID)SerialReadTimeout, "ReadRequestTotalTimer"},
+    {(PVOID)SerialIntervalReadTimeout, "ReadRequestIntervalTimer"},
+    {(PVOID)SerialWriteTimeout, "WriteRequestTotalTimer"},
+    {(PVOID)SerialTimeoutImmediate, "ImmediateTotalTimer"},
+    {(PVOID)SerialTimeoutPriority, "PriorityTotalTimer"},
+    {(PVOID)SerialTimeoutXoff, "XoffCountTimer"},
+    {(PVOID)SerialInvokePerhapsLowerRTS, "LowerRTSTimer"},
+    {(PVOID)SerialTimedWriteLaunch, "TimedWriteTimer"},
+};
+
+struct card_kind {
+    const char *name;
+    enum uart_emu_family family;
+    int (*baud_setting)(unsigned long baud, baud_setting *setting, double *error_ppm);
+};
+
+static const struct card_kind card_kinds[] = {
+    {"pcie", UART_EMU_XR17V35X, calculate_baud_setting_pcie},
+    {"335", UART_EMU_XR17D15X, calculate_baud_setting_335},
+    {"fscc", UART_EMU_16C950, calculate_baud_setting_fscc},
+};
+
+struct options {
+    const struct card_kind *card;
+    unsigned long bauds[MAX_LIST];
+    unsigned baud_count;
+    unsigned long triggers[MAX_LIST];   /* 0 leaves the driver's */
+    unsigned trigger_count;
+    unsigned long sizes[MAX_LIST];
+    unsigned size_count;
+    unsigned modes[2];
+    unsigned mode_count;
+    unsigned iterations;
+    unsigned long interval_ms;          /* 0 works one out from the size */
+    unsigned long long tick_ns;
+    unsigned long long spin_ns;
+};
+
+struct request {
+    struct bench *bench;
+    unsigned char buffer[MAX_SIZE];
+    ULONG length;
+    unsigned long long sent;
+    unsigned long long completed;
+    NTSTATUS status;
+    ULONG_PTR information;
+    int done;
+};
+
+/* A port and the part of its flight recorder that's new since the last
+   dump */
+struct port {
+    WDFDEVICE device;
+    struct serialfc_trace trace;
+    ULONG start;
+    double ns_per_count;
+};
+
+struct samples {
+    double *values;
+    size_t count;
+    size_t allocated;
+};
+
+struct bench {
+    const struct options *options;
+    struct emu_card *card;
+    struct uart_emu_card *uart;
+    struct port ports[2];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct request reads[2];
+    struct request writes[2];
+    struct samples stages[STAGE_COUNT];
+};
+
+struct point {
+    unsigned long baud;
+    unsigned long trigger;
+    unsigned long size;
+    unsigned mode;
+};
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void add_sample(struct samples *samples, double value)
+{
+    if (samples->count == samples->allocated) {
+        size_t allocated = samples->allocated ? samples->allocated * 2 : 1024;
+        double *more = realloc(samples->values, allocated * sizeof(*more));
+
+        if (!more)
+            return;
+
+        samples->values = more;
+        samples->allocated = allocated;
+    }
+
+    samples->values[samples->count++] = value;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void summarize(struct samples *samples, double *p50, double *p99, double *max, double *mean)
+{
+    size_t n = samples->count, i;
+    double sum = 0;
+
+    if (!n) {
+        *p50 = *p99 = *max = *mean = 0;
+        return;
+    }
+
+    qsort(samples->values, n, sizeof(double), compare_doubles);
+
+    for (i = 0; i < n; i++)
+        sum += samples->values[i];
+
+    *p50 = samples->values[n * 50 / 100];
+    *p99 = samples->values[n * 99 / 100];
+    *max = samples->values[n - 1];
+    *mean = sum / n;
+}
+
+static NTSTATUS device_ioctl(WDFDEVICE device, ULONG code, void *in, size_t in_length, void *out,
+                             size_t out_length)
+{
+    return WdfShimRequestSendSynchronously(device, WdfRequestTypeDeviceControl, code, in, in_length,
+                                           out, out_length, NULL);
+}
+
+static NTSTATUS ioctl_value(WDFDEVICE device, ULONG code, unsigned value)
+{
+    return device_ioctl(device, code, &value, sizeof(value), NULL, 0);
+}
+
+static VOID request_done(PVOID context, NTSTATUS status, ULONG_PTR information)
+{
+    struct request *request = context;
+    struct bench *bench = request->bench;
+
+    request->completed = now_ns();
+    request->status = status;
+    request->information = information;
+
+    pthread_mutex_lock(&bench->lock);
+    request->done = 1;
+    pthread_cond_broadcast(&bench->cond);
+    pthread_mutex_unlock(&bench->lock);
+}
+
+static void send_request(struct request *request, WDFDEVICE device, WDF_REQUEST_TYPE type, ULONG length)
+{
+    request->length = length;
+    request->information = 0;
+    request->done = 0;
+
+    request->sent = now_ns();
+
+    if (type == WdfRequestTypeWrite)
+        WdfShimRequestSend(device, type, 0, request->buffer, length, NULL, 0, request_done, request);
+    else
+        WdfShimRequestSend(device, type, 0, NULL, 0, request->buffer, length, request_done, request);
+}
+
+static void wait_request(struct bench *bench, struct request *request)
+{
+    pthread_mutex_lock(&bench->lock);
+    while (!request->done)
+        pthread_cond_wait(&bench->cond, &bench->lock);
+    pthread_mutex_unlock(&bench->lock);
+}
+
+/* Takes a snapshot of the port's flight recorder, nonzero if it can't or
+   the recorder has wrapped past what the last one ended on */
+static int dump_trace(struct port *port)
+{
+    ULONG start = port->trace.next_sequence ? port->trace.next_sequence : 1;
+
+    if (!NT_SUCCESS(device_ioctl(port->device, IOCTL_FASTCOM_DUMP_TRACE, NULL, 0, &port->trace,
+                                 sizeof(port->trace))) || !port->trace.frequency)
+        return -1;
+
+    port->start = start;
+    port->ns_per_count = 1e9 / port->trace.frequency;
+
+    return port->trace.next_sequence - start > SERIALFC_TRACE_ENTRIES;
+}
+
+/* The entries of the last snapshot that weren't in the one before */
+static const struct serialfc_trace_entry *new_entry(const struct port *port, unsigned i)
+{
+    const struct serialfc_trace_entry *entry = &port->trace.entries[i];
+
+    if (entry->sequence < port->start || entry->sequence >= port->trace.next_sequence)
+        return NULL;
+
+    return entry;
+}
+
+static double entry_ns(const struct port *port, const struct serialfc_trace_entry *entry)
+{
+    return entry->timestamp * port->ns_per_count;
+}
+
+/* The trace has a tenth of a microsecond resolution, so an edge with the
+   benchmark's own clock on one side can come out a little backwards */
+static double span(double from, double to)
+{
+    return to > from ? to - from : 0;
+}
+
+/* Adds up the stages of one direction, from the write being sent on tx to
+   the read on rx reaching us. Nonzero if the trace missed part of it. */
+static int time_leg(const struct port *tx, const struct port *rx, const struct request *write,
+                    const struct request *read, double *stages)
+{
+    const struct serialfc_trace_entry *entry;
+    double start = -1, thr = -1, first_rx = -1, last_rx = -1, done = -1;
+    unsigned i;
+
+    for (i = 0; i < SERIALFC_TRACE_ENTRIES && thr < 0; i++) {
+        entry = new_entry(tx, i);
+        if (!entry)
+            continue;
+
+        if (start < 0) {
+            if (entry->event == SERIALFC_TRACE_REQUEST_START && entry->info == IRP_MJ_WRITE)
+                start = entry_ns(tx, entry);
+        }
+        else if (entry->event == SERIALFC_TRACE_IIR && entry->data == IIR_THR) {
+            thr = entry_ns(tx, entry);
+        }
+    }
+
+    for (i = 0; i < SERIALFC_TRACE_ENTRIES && done < 0; i++) {
+        entry = new_entry(rx, i);
+        if (!entry)
+            continue;
+
+        if (entry->event == SERIALFC_TRACE_REQUEST_COMPLETE && entry->info == IRP_MJ_READ) {
+            done = entry_ns(rx, entry);
+        }
+        else if (entry->event == SERIALFC_TRACE_IIR && (entry->data == IIR_RDA || entry->data == IIR_CTI)) {
+            if (first_rx < 0)
+                first_rx = entry_ns(rx, entry);
+            last_rx = entry_ns(rx, entry);
+        }
+    }
+
+    if (thr < 0 || first_rx < 0 || done < 0)
+        return -1;
+
+    stages[STAGE_QUEUE] += span(write->sent, start);
+    stages[STAGE_HANDOFF] += span(start, thr);
+    stages[STAGE_TX] += span(thr, first_rx);
+    stages[STAGE_RX] += span(first_rx, last_rx);
+    stages[STAGE_DONE] += span(last_rx, done);
+    stages[STAGE_RETURN] += span(done, read->completed);
+
+    return 0;
+}
+
+static NTSTATUS set_rate(struct bench *bench, WDFDEVICE device, unsigned long baud)
+{
+    const struct card_kind *kind = bench->options->card;
+    struct serialfc_baud_setting exact;
+    baud_setting setting;
+    NTSTATUS status;
+
+    if (kind->baud_setting(baud, &setting, NULL))
+        return STATUS_INVALID_PARAMETER;
+
+    /* The library's longs aren't the driver's ULONGs everywhere */
+    memset(&exact, 0, sizeof(exact));
+    exact.baud = (ULONG)setting.baud;
+    exact.sample_rate = (ULONG)setting.sample_rate;
+    exact.divisor = (ULONG)setting.divisor;
+    exact.clock_frequency = (ULONG)setting.clock_frequency;
+    exact.clock_bits_335 = (ULONG)setting.clock_bits_335;
+    memcpy(exact.clock_bits_fscc, setting.clock_bits_fscc, sizeof(exact.clock_bits_fscc));
+
+    status = device_ioctl(device, IOCTL_FASTCOM_SET_BAUD_EXACT, &exact, sizeof(exact), NULL, 0);
+
+    /* The FSCC's clock generator is behind Bar0, which isn't emulated */
+    if (NT_SUCCESS(status) && kind->family == UART_EMU_16C950 && setting.clock_frequency) {
+        WdfShimBusLock();
+        uart_emu_set_clock(bench->uart, setting.clock_frequency);
+        WdfShimBusUnlock();
+    }
+
+    return status;
+}
+
+/* Sets up one port for a point, NULL or what didn't take */
+static const char *configure(struct bench *bench, WDFDEVICE device, const struct point *point,
+                             ULONG interval_ms, ULONG timeout_ms)
+{
+    SERIAL_LINE_CONTROL line = {STOP_BIT_1, NO_PARITY, 8};
+    SERIAL_TIMEOUTS timeouts;
+
+    if (!NT_SUCCESS(device_ioctl(device, IOCTL_SERIAL_SET_LINE_CONTROL, &line, sizeof(line), NULL, 0)))
+        return "line control";
+
+    if (!NT_SUCCESS(set_rate(bench, device, point->baud)))
+        return "baud";
+
+    if (point->trigger) {
+        if (!NT_SUCCESS(ioctl_value(device, IOCTL_FASTCOM_SET_RX_TRIGGER, point->trigger)) ||
+            !NT_SUCCESS(ioctl_value(device, IOCTL_FASTCOM_SET_TX_TRIGGER, point->trigger)))
+            return "trigger";
+    }
+
+    /* The total timeouts only stop a lost byte from hanging the run */
+    memset(&timeouts, 0, sizeof(timeouts));
+    timeouts.ReadIntervalTimeout = point->mode == MODE_INTERVAL ? interval_ms : 0;
+    timeouts.ReadTotalTimeoutConstant = timeout_ms;
+    timeouts.WriteTotalTimeoutConstant = timeout_ms;
+
+    if (!NT_SUCCESS(device_ioctl(device, IOCTL_SERIAL_SET_TIMEOUTS, &timeouts, sizeof(timeouts), NULL, 0)))
+        return "timeouts";
+
+    if (!NT_SUCCESS(ioctl_value(device, IOCTL_SERIAL_PURGE,
+                                SERIAL_PURGE_TXABORT | SERIAL_PURGE_RXABORT |
+                                SERIAL_PURGE_TXCLEAR | SERIAL_PURGE_RXCLEAR)))
+        return "purge";
+
+    return NULL;
+}
+
+/* One message out and back, nonzero if the echo didn't match */
+static int round_trip(struct bench *bench, const struct point *point, unsigned n, int record)
+{
+    struct request *rd_a = &bench->reads[0], *rd_b = &bench->reads[1];
+    struct request *wr_a = &bench->writes[0], *wr_b = &bench->writes[1];
+    ULONG length = point->mode == MODE_INTERVAL ? MAX_SIZE : (ULONG)point->size;
+    double stages[STAGE_COUNT];
+    int bad = 0;
+    unsigned i;
+
+    send_request(rd_b, bench->ports[1].device, WdfRequestTypeRead, length);
+    send_request(rd_a, bench->ports[0].device, WdfRequestTypeRead, length);
+
+    for (i = 0; i < point->size; i++)
+        wr_a->buffer[i] = (unsigned char)(n * 7 + i * 13);
+
+    send_request(wr_a, bench->ports[0].device, WdfRequestTypeWrite, (ULONG)point->size);
+
+    wait_request(bench, rd_b);
+
+    if (rd_b->information) {
+        memcpy(wr_b->buffer, rd_b->buffer, rd_b->information);
+        send_request(wr_b, bench->ports[1].device, WdfRequestTypeWrite, (ULONG)rd_b->information);
+    }
+    else {
+        /* Nothing to echo, don't wait out the other read's timeout */
+        ioctl_value(bench->ports[0].device, IOCTL_SERIAL_PURGE, SERIAL_PURGE_RXABORT | SERIAL_PURGE_RXCLEAR);
+        wr_b->done = 1;
+    }
+
+    wait_request(bench, rd_a);
+    wait_request(bench, wr_a);
+    wait_request(bench, wr_b);
+
+    if (rd_a->information != point->size || memcmp(rd_a->buffer, wr_a->buffer, point->size))
+        bad = 1;
+
+    /* Dumped every time so a long run doesn't wrap the recorders */
+    if (dump_trace(&bench->ports[0]) | dump_trace(&bench->ports[1]) || bad || !record)
+        return bad;
+
+    memset(stages, 0, sizeof(stages));
+
+    if (time_leg(&bench->ports[0], &bench->ports[1], wr_a, rd_b, stages) ||
+        time_leg(&bench->ports[1], &bench->ports[0], wr_b, rd_a, stages))
+        return 0;
+
+    stages[STAGE_TURN] = span(rd_b->completed, wr_b->sent);
+    stages[STAGE_RTT] = span(wr_a->sent, rd_a->completed);
+
+    for (i = 0; i < STAGE_COUNT; i++)
+        add_sample(&bench->stages[i], stages[i] / 1000);
+
+    return 0;
+}
+
+static const char *dpc_name(PVOID callback)
+{
+    unsigned i;
+
+    for (i = 0; i < sizeof(dpc_names) / sizeof(dpc_names[0]); i++) {
+        if (dpc_names[i].callback == callback)
+            return dpc_names[i].name;
+    }
+
+    return "?";
+}
+
+static int compare_dpc_cost(const void *a, const void *b)
+{
+    const WDF_SHIM_DPC_STATS *x = a, *y = b;
+    ULONGLONG cx = x->WaitNs + x->RunNs, cy = y->WaitNs + y->RunNs;
+
+    return cx > cy ? -1 : cx < cy;
+}
+
+/* Both ports' DPCs and timers, one row for each callback */
+static void print_dpcs(struct bench *bench, unsigned trips)
+{
+    WDF_SHIM_DPC_STATS all[MAX_DPCS], port[MAX_DPCS];
+    WDF_SHIM_INTERRUPT_STATS isr, total = {0, 0, 0};
+    unsigned count = 0, p, i, j;
+    ULONG found;
+
+    for (p = 0; p < 2; p++) {
+        found = WdfShimDeviceGetDpcStats(bench->ports[p].device, port, MAX_DPCS);
+        if (found > MAX_DPCS)
+            found = MAX_DPCS;
+
+        for (i = 0; i < found; i++) {
+            for (j = 0; j < count && all[j].Callback != port[i].Callback; j++)
+                ;
+
+            if (j == count) {
+                all[count++] = port[i];
+                continue;
+            }
+
+            all[j].Runs += port[i].Runs;
+            all[j].WaitNs += port[i].WaitNs;
+            all[j].RunNs += port[i].RunNs;
+            if (port[i].MaxWaitNs > all[j].MaxWaitNs)
+                all[j].MaxWaitNs = port[i].MaxWaitNs;
+            if (port[i].MaxRunNs > all[j].MaxRunNs)
+                all[j].MaxRunNs = port[i].MaxRunNs;
+        }
+
+        WdfShimDeviceGetInterruptStats(bench->ports[p].device, &isr);
+        total.Calls += isr.Calls;
+        total.Nanoseconds += isr.Nanoseconds;
+    }
+
+    qsort(all, count, sizeof(all[0]), compare_dpc_cost);
+
+    printf("  %-25s %-5s %8s %8s %8s %8s %8s %8s\n", "callback", "kind", "runs/rtt", "wait_avg",
+           "wait_max", "run_avg", "run_max", "us/rtt");
+
+    for (i = 0; i < count; i++) {
+        if (!all[i].Runs)
+            continue;
+
+        printf("  %-25s %-5s %8.2f %8.1f %8.1f %8.1f %8.1f %8.1f\n", dpc_name(all[i].Callback),
+               all[i].Timer ? "timer" : "dpc", (double)all[i].Runs / trips,
+               all[i].WaitNs / 1000.0 / all[i].Runs, all[i].MaxWaitNs / 1000.0,
+               all[i].RunNs / 1000.0 / all[i].Runs, all[i].MaxRunNs / 1000.0,
+               (all[i].WaitNs + all[i].RunNs) / 1000.0 / trips);
+    }
+
+    if (total.Calls)
+        printf("  %-25s %-5s %8.2f %8s %8s %8.1f %8s %8.1f\n", "isr", "isr", (double)total.Calls / trips,
+               "-", "-", total.Nanoseconds / 1000.0 / total.Calls, "-", total.Nanoseconds / 1000.0 / trips);
+}
+
+static void run_point(struct bench *bench, const struct point *point)
+{
+    const struct options *options = bench->options;
+    double char_seconds = 10.0 / point->baud, line_baud, p50, p99, max, mean, rtt_mean = 0;
+    ULONG interval_ms, timeout_ms;
+    const char *failed;
+    unsigned i, bad = 0;
+
+    interval_ms = options->interval_ms ? (ULONG)options->interval_ms :
+                                         (ULONG)((point->size + 4) * char_seconds * 1000) + 1;
+    timeout_ms = (ULONG)(point->size * char_seconds * 4000) + 1000;
+
+    failed = configure(bench, bench->ports[0].device, point, interval_ms, timeout_ms);
+    if (!failed)
+        failed = configure(bench, bench->ports[1].device, point, interval_ms, timeout_ms);
+
+    WdfShimBusLock();
+    line_baud = uart_emu_get_baud(bench->uart, 1);
+    WdfShimBusUnlock();
+
+    printf("%s %lu baud (%.0f), trigger %lu, %lu bytes, %s reads", options->card->name, point->baud,
+           line_baud, point->trigger, point->size, mode_names[point->mode]);
+    if (point->mode == MODE_INTERVAL)
+        printf(" after %lu ms", (unsigned long)interval_ms);
+
+    if (failed) {
+        printf(": unsupported %s\n\n", failed);
+        return;
+    }
+
+    for (i = 0; i < WARMUP; i++)
+        round_trip(bench, point, i, 0);
+
+    for (i = 0; i < STAGE_COUNT; i++)
+        bench->stages[i].count = 0;
+
+    for (i = 0; i < 2; i++) {
+        WdfShimDeviceClearDpcStats(bench->ports[i].device);
+        WdfShimDeviceClearInterruptStats(bench->ports[i].device);
+    }
+
+    for (i = 0; i < options->iterations; i++)
+        bad += round_trip(bench, point, WARMUP + i, 1);
+
+    printf(": %u round trips, %u bad, %u traced\n", options->iterations, bad,
+           (unsigned)bench->stages[STAGE_RTT].count);
+
+    if (bench->stages[STAGE_RTT].count) {
+        summarize(&bench->stages[STAGE_RTT], &p50, &p99, &max, &rtt_mean);
+
+        printf("  %-8s %8s %8s %8s %8s %6s\n", "stage", "p50", "p99", "max", "mean", "share");
+
+        for (i = 0; i < STAGE_COUNT; i++) {
+            summarize(&bench->stages[i], &p50, &p99, &max, &mean);
+            printf("  %-8s %8.1f %8.1f %8.1f %8.1f %5.1f%%\n", stage_names[i], p50, p99, max, mean,
+                   rtt_mean > 0 ? 100 * mean / rtt_mean : 0);
+        }
+
+        printf("\n");
+    }
+    print_dpcs(bench, options->iterations);
+    printf("\n");
+}
+
+static int parse_list(const char *arg, unsigned long *list, unsigned *count)
+{
+    char *end;
+
+    *count = 0;
+
+    do {
+        if (*count == MAX_LIST)
+            return -1;
+
+        list[(*count)++] = strtoul(arg, &end, 0);
+        if (end == arg || (*end && *end != ','))
+            return -1;
+
+        arg = end + 1;
+    } while (*end);
+
+    return 0;
+}
+
+static int parse_modes(const char *arg, unsigned *modes, unsigned *count)
+{
+    char copy[64], *name, *next;
+    unsigned i;
+
+    if (strlen(arg) >= sizeof(copy))
+        return -1;
+
+    strcpy(copy, arg);
+    *count = 0;
+
+    for (name = copy; name; name = next) {
+        next = strchr(name, ',');
+        if (next)
+            *next++ = '\0';
+
+        for (i = 0; i < 2 && strcmp(name, mode_names[i]); i++)
+            ;
+
+        if (i == 2 || *count == 2)
+            return -1;
+
+        modes[(*count)++] = i;
+    }
+
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-c pcie|335|fscc] [-b bauds] [-t triggers] [-s sizes]\n"
+            "          [-m exact,interval] [-n round trips] [-i interval ms] [-r timer us]\n"
+            "          [-p spin ns]\n"
+            "\n"
+            "Lists are comma separated. A trigger of 0 leaves the driver's levels.\n"
+            "Sizes go up to %u bytes.\n",
+            name, MAX_SIZE);
+}
+
+static void defaults(struct options *options)
+{
+    static const unsigned long bauds[] = {115200, 921600, 3000000};
+    static const unsigned long sizes[] = {1, 16, 64};
+    unsigned i;
+
+    if (!options->baud_count) {
+        for (i = 0; i < sizeof(bauds) / sizeof(bauds[0]); i++)
+            options->bauds[options->baud_count++] = bauds[i];
+    }
+
+    if (!options->trigger_count)
+        options->triggers[options->trigger_count++] = 0;
+
+    if (!options->size_count) {
+        for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+            options->sizes[options->size_count++] = sizes[i];
+    }
+
+    if (!options->mode_count) {
+        options->modes[options->mode_count++] = MODE_EXACT;
+        options->modes[options->mode_count++] = MODE_INTERVAL;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    struct options options;
+    struct bench *bench;
+    struct point point;
+    unsigned b, t, s, m, i;
+    NTSTATUS status;
+    int c, result = 0;
+
+    memset(&options, 0, sizeof(options));
+    options.card = &card_kinds[0];
+    options.iterations = 200;
+    options.tick_ns = 1000000;
+    options.spin_ns = 50000;
+
+    while ((c = getopt(argc, argv, "c:b:t:s:m:n:i:r:p:")) != -1) {
+        switch (c) {
+        case 'c':
+            for (i = 0; i < sizeof(card_kinds) / sizeof(card_kinds[0]); i++) {
+                if (!strcmp(optarg, card_kinds[i].name))
+                    break;
+            }
+            if (i == sizeof(card_kinds) / sizeof(card_kinds[0])) {
+                usage(argv[0]);
+                return 2;
+            }
+            options.card = &card_kinds[i];
+            break;
+
+        case 'b':
+            result = parse_list(optarg, options.bauds, &options.baud_count);
+            break;
+
+        case 't':
+            result = parse_list(optarg, options.triggers, &options.trigger_count);
+            break;
+
+        case 's':
+            result = parse_list(optarg, options.sizes, &options.size_count);
+            break;
+
+        case 'm':
+            result = parse_modes(optarg, options.modes, &options.mode_count);
+            break;
+
+        case 'n':
+            options.iterations = (unsigned)strtoul(optarg, NULL, 0);
+            result = options.iterations ? 0 : -1;
+            break;
+
+        case 'i':
+            options.interval_ms = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'r':
+            options.tick_ns = strtoull(optarg, NULL, 0) * 1000;
+            break;
+
+        case 'p':
+            options.spin_ns = strtoull(optarg, NULL, 0);
+            break;
+
+        default:
+            result = -1;
+            break;
+        }
+
+        if (result) {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (optind != argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    defaults(&options);
+
+    for (s = 0; s < options.size_count; s++) {
+        if (!options.sizes[s] || options.sizes[s] > MAX_SIZE) {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    /* Two flight recorder snapshots and four buffers, too much for the stack */
+    bench = calloc(1, sizeof(*bench));
+    if (!bench) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    bench->options = &options;
+    pthread_mutex_init(&bench->lock, NULL);
+    pthread_cond_init(&bench->cond, NULL);
+
+    for (i = 0; i < 2; i++) {
+        bench->reads[i].bench = bench;
+        bench->writes[i].bench = bench;
+    }
+
+    status = emu_card_start(options.spin_ns);
+    if (NT_SUCCESS(status))
+        status = emu_card_add(options.card->family, 2, NULL, 0, &bench->card);
+    if (!NT_SUCCESS(status)) {
+        fprintf(stderr, "the emulated card didn't start, 0x%08x\n", (unsigned)status);
+        free(bench);
+        return 1;
+    }
+
+    WdfShimSetTimerResolution(options.tick_ns);
+
+    bench->uart = emu_card_uart(bench->card);
+    bench->ports[0].device = emu_card_device(bench->card, 0);
+    bench->ports[1].device = emu_card_device(bench->card, 1);
+
+    if (!bench->ports[0].device || !bench->ports[1].device ||
+        !NT_SUCCESS(WdfShimDeviceOpen(bench->ports[0].device)) ||
+        !NT_SUCCESS(WdfShimDeviceOpen(bench->ports[1].device))) {
+        fprintf(stderr, "the emulated ports didn't open\n");
+        emu_card_stop();
+        free(bench);
+        return 1;
+    }
+
+    WdfShimBusLock();
+    uart_emu_connect(bench->uart, 0, bench->uart, 1);
+    WdfShimBusUnlock();
+
+    for (b = 0; b < options.baud_count; b++) {
+        for (t = 0; t < options.trigger_count; t++) {
+            for (s = 0; s < options.size_count; s++) {
+                for (m = 0; m < options.mode_count; m++) {
+                    point.baud = options.bauds[b];
+                    point.trigger = options.triggers[t];
+                    point.size = options.sizes[s];
+                    point.mode = options.modes[m];
+
+                    run_point(bench, &point);
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+
+    WdfShimDeviceClose(bench->ports[0].device);
+    WdfShimDeviceClose(bench->ports[1].device);
+    emu_card_stop();
+
+    for (i = 0; i < STAGE_COUNT; i++)
+        free(bench->stages[i].values);
+
+    free(bench);
+
+    return result;
+}
@@ -0,0 +1,169 @@
+/*
+    Checks that a divisor from IOCTL_FASTCOM_SET_BAUD_EXACT is only kept
+    while the sample rate it was worked out for is. SerialSetBaud writes
+    the exact divisor back whenever the baud rate is restored, which
+    happens each time the port is opened, so one left behind after the
+    sample rate changed would put the port on a rate nobody asked for.
+
+    An emulated FSCC port is given 115200 baud as sample rate 8 and
+    divisor 21, which is off from what SerialGetDivisorFromBaud would
+    pick so it shows whether the exact divisor is in use. The sample
+    rate is then changed, left alone or set to what it already was
+    through IOCTL_FASTCOM_SET_SAMPLE_RATE and IOCTL_FASTCOM_SET_CONFIG,
+    and the port reopened. The rate the emulated line runs at afterwards
+    has to be the exact one if the sample rate is unchanged and 115200
+    otherwise.
+
+    Build it from this directory the way wdf-shim.h says, adding this
+    file, emu-card.c, uart-emu.c and ../../lib/raw/calculate-clock-bits.c,
+    then
+
+        ./test-exact-divisor
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "emu-card.h"
+#include "ntddser.h"
+#include "serialfc.h"
+
+#define BAUD 115200
+#define EXACT_SAMPLE_RATE 8
+#define EXACT_DIVISOR 21
+#define CLOCK 18432000
+
+#define HOW_NONE 0
+#define HOW_IOCTL 1
+#define HOW_CONFIG 2
+
+static const char *how_names[] = {"nothing", "IOCTL_FASTCOM_SET_SAMPLE_RATE", "IOCTL_FASTCOM_SET_CONFIG"};
+
+static struct emu_card *card;
+static WDFDEVICE device;
+static unsigned checked, failed;
+
+static NTSTATUS device_ioctl(ULONG code, void *in, size_t in_length, void *out, size_t out_length)
+{
+    return WdfShimRequestSendSynchronously(device, WdfRequestTypeDeviceControl, code, in, in_length,
+                                           out, out_length, NULL);
+}
+
+static NTSTATUS set_sample_rate(unsigned how, ULONG sample_rate)
+{
+    struct serialfc_config config;
+    NTSTATUS status;
+
+    switch (how) {
+    case HOW_IOCTL:
+        return device_ioctl(IOCTL_FASTCOM_SET_SAMPLE_RATE, &sample_rate, sizeof(sample_rate), NULL, 0);
+
+    case HOW_CONFIG:
+        memset(&config, 0, sizeof(config));
+        config.size = sizeof(config);
+        config.version = SERIALFC_CONFIG_VERSION;
+
+        status = device_ioctl(IOCTL_FASTCOM_GET_CONFIG, NULL, 0, &config, sizeof(config));
+        if (!NT_SUCCESS(status))
+            return status;
+
+        config.fields = SERIALFC_CONFIG_SAMPLE_RATE;
+        config.sample_rate = sample_rate;
+
+        return device_ioctl(IOCTL_FASTCOM_SET_CONFIG, &config, sizeof(config), NULL, 0);
+
+    default:
+        return STATUS_SUCCESS;
+    }
+}
+
+static double line_rate(void)
+{
+    double rate;
+
+    WdfShimBusLock();
+    rate = uart_emu_get_baud(emu_card_uart(card), 0);
+    WdfShimBusUnlock();
+
+    return rate;
+}
+
+static void check(unsigned how, ULONG sample_rate)
+{
+    struct serialfc_baud_setting exact;
+    double expected, rate;
+    NTSTATUS status;
+
+    memset(&exact, 0, sizeof(exact));
+    exact.baud = BAUD;
+    exact.sample_rate = EXACT_SAMPLE_RATE;
+    exact.divisor = EXACT_DIVISOR;
+
+    status = device_ioctl(IOCTL_FASTCOM_SET_BAUD_EXACT, &exact, sizeof(exact), NULL, 0);
+    if (NT_SUCCESS(status))
+        status = set_sample_rate(how, sample_rate);
+
+    /* SerialMarkOpen restores the baud rate */
+    WdfShimDeviceClose(device);
+    if (NT_SUCCESS(status))
+        status = WdfShimDeviceOpen(device);
+
+    checked++;
+
+    if (!NT_SUCCESS(status)) {
+        printf("%s to %lu: failed, 0x%08x\n", how_names[how], (unsigned long)sample_rate, (unsigned)status);
+        failed++;
+        return;
+    }
+
+    if (how == HOW_NONE || sample_rate == EXACT_SAMPLE_RATE)
+        expected = (double)CLOCK / (EXACT_SAMPLE_RATE * EXACT_DIVISOR);
+    else
+        expected = BAUD;
+
+    rate = line_rate();
+
+    if (fabs(rate - expected) > expected / 100) {
+        printf("%s to %lu: line at %.0f baud after reopening, not %.0f\n", how_names[how],
+               (unsigned long)sample_rate, rate, expected);
+        failed++;
+    }
+}
+
+int main(void)
+{
+    static const ULONG sample_rates[] = {EXACT_SAMPLE_RATE, 16};
+    NTSTATUS status;
+    unsigned how, i;
+
+    status = emu_card_start(0);
+    if (NT_SUCCESS(status))
+        status = emu_card_add(UART_EMU_16C950, 1, NULL, 0, &card);
+    if (!NT_SUCCESS(status)) {
+        fprintf(stderr, "the emulated card didn't start, 0x%08x\n", (unsigned)status);
+        return 1;
+    }
+
+    device = emu_card_device(card, 0);
+
+    if (!device || !NT_SUCCESS(WdfShimDeviceOpen(device))) {
+        fprintf(stderr, "the emulated port didn't open\n");
+        emu_card_stop();
+        return 1;
+    }
+
+    check(HOW_NONE, 0);
+
+    for (how = HOW_IOCTL; how <= HOW_CONFIG; how++) {
+        for (i = 0; i < sizeof(sample_rates) / sizeof(sample_rates[0]); i++)
+            check(how, sample_rates[i]);
+    }
+
+    WdfShimDeviceClose(device);
+    emu_card_stop();
+
+    printf("%u of %u checks failed\n", failed, checked);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,826 @@
+/*
+    Measures what the driver's read and write paths get through a pair of
+    emulated ports. Channel 0 and 1 of one emulated card are wired
+    together and the driver is sent real write requests on the first and
+    read requests on the second, with a few of each outstanding, for every
+    combination of the baud rates, trigger levels, request sizes, flow
+    control modes and 9-bit settings asked for. Each point runs for about
+    the same time whatever the rate, and is skipped if one request alone
+    would take too long.
+
+    For each point it prints:
+        KB/s    data received a second
+        line%   how much of the line that is
+        isr/KB  ISR calls on both ports for every 1024 bytes
+        acc/B   register reads and writes on both ports for every byte
+        burst   bytes the ISR read from the receive FIFO each time
+        wr/rd   p50, p99 and max microseconds from sending a request to its
+                completion
+        ovr     receive FIFO and interrupt buffer overruns
+        err     bytes received that weren't the ones sent
+        lost    bytes sent that never arrived
+
+    Rates are set with IOCTL_FASTCOM_SET_BAUD_EXACT from what
+    calculate_baud_setting_* in lib/raw works out, so each card runs as
+    close to the rate as it can get and the line column says how close
+    that was. 9-bit mode is only there on the FSCC; other cards print the
+    point as unsupported.
+
+    The interrupt thread is an ordinary thread, so at the highest rates
+    how soon the host runs it decides whether the receive FIFO overruns.
+    Runs on a busy or single processor machine lose data there that a
+    card wouldn't.
+
+    Build it from this directory the way wdf-shim.h says, adding this
+    file, emu-card.c, uart-emu.c and ../../lib/raw/calculate-clock-bits.c,
+    then for example
+
+        ./throughput-bench -c pcie -b 115200,921600 -s 64,4096 -f none
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "emu-card.h"
+#include "ntddser.h"
+#include "serialfc.h"
+#include "../../lib/raw/calculate-clock-bits.h"
+
+#define MAX_LIST 16
+#define MAX_DEPTH 64
+#define RESYNC 512          /* how far ahead a byte is looked for after a gap */
+
+#define FLOW_NONE 0
+#define FLOW_RTSCTS 1
+#define FLOW_XONXOFF 2
+
+static const char *flow_names[] = {"none", "rtscts", "xonxoff"};
+
+struct card_kind {
+    const char *name;
+    enum uart_emu_family family;
+    unsigned fifo;
+    int (*baud_setting)(unsigned long baud, baud_setting *setting, double *error_ppm);
+};
+
+static const struct card_kind card_kinds[] = {
+    {"pcie", UART_EMU_XR17V35X, 256, calculate_baud_setting_pcie},
+    {"335", UART_EMU_XR17D15X, 64, calculate_baud_setting_335},
+    {"fscc", UART_EMU_16C950, 128, calculate_baud_setting_fscc},
+};
+
+struct options {
+    const struct card_kind *card;
+    unsigned long bauds[MAX_LIST];
+    unsigned baud_count;
+    unsigned long triggers[MAX_LIST];   /* 0 leaves the driver's */
+    unsigned trigger_count;
+    unsigned long sizes[MAX_LIST];
+    unsigned size_count;
+    unsigned flows[MAX_LIST];
+    unsigned flow_count;
+    int nine_bit;               /* also run each point in 9-bit mode */
+    unsigned depth;
+    double seconds;
+    double max_seconds;
+    unsigned long long spin_ns;
+};
+
+/* One request in flight. The ring is reaped in the order it was sent in,
+   which is the order the driver's queues complete it in. */
+struct slot {
+    struct bench *bench;
+    unsigned char *buffer;
+    ULONG length;
+    unsigned long long sent;
+    unsigned long long completed;
+    NTSTATUS status;
+    ULONG_PTR information;
+    int done;
+};
+
+struct ring {
+    struct slot slots[MAX_DEPTH];
+    unsigned head;
+    unsigned count;
+};
+
+struct samples {
+    double *values;
+    size_t count;
+    size_t allocated;
+};
+
+struct bench {
+    const struct options *options;
+    struct emu_card *card;
+    struct uart_emu_card *uart;
+    WDFDEVICE tx;
+    WDFDEVICE rx;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct ring writes;
+    struct ring reads;
+    struct samples write_latency;
+    struct samples read_latency;
+};
+
+/* Where the received data is in the stream that was sent. A byte that
+   isn't the next one is looked for a little further on, so a byte lost
+   to an overrun counts once and not for everything after it. */
+struct stream {
+    unsigned long long next;
+    unsigned long long matched;
+    unsigned long long errors;
+};
+
+struct point {
+    unsigned long baud;
+    unsigned long trigger;
+    unsigned long size;
+    unsigned flow;
+    int nine_bit;
+};
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned char pattern(unsigned long long i, unsigned flow)
+{
+    unsigned char c = (unsigned char)(i * 7 + (i >> 8));
+
+    /* Keep XON and XOFF off the line when they mean something */
+    if (flow == FLOW_XONXOFF && (c == 0x11 || c == 0x13))
+        c ^= 0x40;
+
+    return c;
+}
+
+static void check_byte(struct stream *stream, unsigned char c, unsigned flow)
+{
+    unsigned k;
+
+    for (k = 0; k < RESYNC; k++) {
+        if (c == pattern(stream->next + k, flow)) {
+            stream->next += k + 1;
+            stream->matched++;
+            return;
+        }
+    }
+
+    stream->errors++;
+}
+
+static void add_sample(struct samples *samples, double value)
+{
+    if (samples->count == samples->allocated) {
+        size_t allocated = samples->allocated ? samples->allocated * 2 : 1024;
+        double *more = realloc(samples->values, allocated * sizeof(*more));
+
+        if (!more)
+            return;
+
+        samples->values = more;
+        samples->allocated = allocated;
+    }
+
+    samples->values[samples->count++] = value;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void percentiles(struct samples *samples, double *p50, double *p99, double *max)
+{
+    size_t n = samples->count;
+
+    if (!n) {
+        *p50 = *p99 = *max = 0;
+        return;
+    }
+
+    qsort(samples->values, n, sizeof(double), compare_doubles);
+
+    *p50 = samples->values[n * 50 / 100];
+    *p99 = samples->values[n * 99 / 100];
+    *max = samples->values[n - 1];
+}
+
+static NTSTATUS device_ioctl(WDFDEVICE device, ULONG code, void *in, size_t in_length, void *out,
+                             size_t out_length)
+{
+    return WdfShimRequestSendSynchronously(device, WdfRequestTypeDeviceControl, code, in, in_length,
+                                           out, out_length, NULL);
+}
+
+static NTSTATUS ioctl_value(WDFDEVICE device, ULONG code, unsigned value)
+{
+    return device_ioctl(device, code, &value, sizeof(value), NULL, 0);
+}
+
+static VOID request_done(PVOID context, NTSTATUS status, ULONG_PTR information)
+{
+    struct slot *slot = context;
+    struct bench *bench = slot->bench;
+
+    slot->completed = now_ns();
+    slot->status = status;
+    slot->information = information;
+
+    pthread_mutex_lock(&bench->lock);
+    slot->done = 1;
+    pthread_cond_broadcast(&bench->cond);
+    pthread_mutex_unlock(&bench->lock);
+}
+
+static void send_request(struct bench *bench, struct ring *ring, WDFDEVICE device, WDF_REQUEST_TYPE type,
+                         ULONG length)
+{
+    struct slot *slot = &ring->slots[(ring->head + ring->count) % bench->options->depth];
+
+    slot->length = length;
+    slot->done = 0;
+    ring->count++;
+
+    slot->sent = now_ns();
+
+    if (type == WdfRequestTypeWrite)
+        WdfShimRequestSend(device, type, 0, slot->buffer, length, NULL, 0, request_done, slot);
+    else
+        WdfShimRequestSend(device, type, 0, NULL, 0, slot->buffer, length, request_done, slot);
+}
+
+/* Waits for the oldest request in either ring, NULL once both are empty */
+static struct slot *reap(struct bench *bench, struct ring **from)
+{
+    struct ring *rings[2] = {&bench->reads, &bench->writes};
+    struct slot *slot = NULL;
+    unsigned i;
+
+    pthread_mutex_lock(&bench->lock);
+
+    while (bench->reads.count || bench->writes.count) {
+        for (i = 0; i < 2 && !slot; i++) {
+            struct ring *ring = rings[i];
+
+            if (ring->count && ring->slots[ring->head].done) {
+                slot = &ring->slots[ring->head];
+                ring->head = (ring->head + 1) % bench->options->depth;
+                ring->count--;
+                *from = ring;
+            }
+        }
+
+        if (slot)
+            break;
+
+        pthread_cond_wait(&bench->cond, &bench->lock);
+    }
+
+    pthread_mutex_unlock(&bench->lock);
+
+    return slot;
+}
+
+static NTSTATUS set_rate(struct bench *bench, WDFDEVICE device, unsigned long baud)
+{
+    const struct card_kind *kind = bench->options->card;
+    struct serialfc_baud_setting exact;
+    baud_setting setting;
+    NTSTATUS status;
+
+    if (kind->baud_setting(baud, &setting, NULL))
+        return STATUS_INVALID_PARAMETER;
+
+    /* The library's longs aren't the driver's ULONGs everywhere */
+    memset(&exact, 0, sizeof(exact));
+    exact.baud = (ULONG)setting.baud;
+    exact.sample_rate = (ULONG)setting.sample_rate;
+    exact.divisor = (ULONG)setting.divisor;
+    exact.clock_frequency = (ULONG)setting.clock_frequency;
+    exact.clock_bits_335 = (ULONG)setting.clock_bits_335;
+    memcpy(exact.clock_bits_fscc, setting.clock_bits_fscc, sizeof(exact.clock_bits_fscc));
+
+    status = device_ioctl(device, IOCTL_FASTCOM_SET_BAUD_EXACT, &exact, sizeof(exact), NULL, 0);
+
+    /* The FSCC's clock generator is behind Bar0, which isn't emulated */
+    if (NT_SUCCESS(status) && kind->family == UART_EMU_16C950 && setting.clock_frequency) {
+        WdfShimBusLock();
+        uart_emu_set_clock(bench->uart, setting.clock_frequency);
+        WdfShimBusUnlock();
+    }
+
+    return status;
+}
+
+static NTSTATUS set_handflow(WDFDEVICE device, unsigned flow)
+{
+    SERIAL_HANDFLOW handflow;
+    NTSTATUS status;
+
+    status = device_ioctl(device, IOCTL_SERIAL_GET_HANDFLOW, NULL, 0, &handflow, sizeof(handflow));
+    if (!NT_SUCCESS(status))
+        return status;
+
+    handflow.ControlHandShake = SERIAL_DTR_CONTROL;
+    handflow.FlowReplace = SERIAL_RTS_CONTROL;
+
+    switch (flow) {
+    case FLOW_RTSCTS:
+        handflow.ControlHandShake |= SERIAL_CTS_HANDSHAKE;
+        handflow.FlowReplace = SERIAL_RTS_HANDSHAKE;
+        break;
+
+    case FLOW_XONXOFF:
+        handflow.FlowReplace |= SERIAL_AUTO_TRANSMIT | SERIAL_AUTO_RECEIVE;
+        break;
+    }
+
+    return device_ioctl(device, IOCTL_SERIAL_SET_HANDFLOW, &handflow, sizeof(handflow), NULL, 0);
+}
+
+/* Sets up one port for a point, NULL or what didn't take */
+static const char *configure(struct bench *bench, WDFDEVICE device, const struct point *point,
+                             ULONG interval_ms, ULONG timeout_ms)
+{
+    SERIAL_LINE_CONTROL line = {STOP_BIT_1, NO_PARITY, 8};
+    SERIAL_TIMEOUTS timeouts;
+
+    if (!NT_SUCCESS(device_ioctl(device, IOCTL_SERIAL_SET_LINE_CONTROL, &line, sizeof(line), NULL, 0)))
+        return "line control";
+
+    if (!NT_SUCCESS(set_rate(bench, device, point->baud)))
+        return "baud";
+
+    if (point->trigger) {
+        if (!NT_SUCCESS(ioctl_value(device, IOCTL_FASTCOM_SET_RX_TRIGGER, point->trigger)) ||
+            !NT_SUCCESS(ioctl_value(device, IOCTL_FASTCOM_SET_TX_TRIGGER, point->trigger)))
+            return "trigger";
+    }
+
+    if (!NT_SUCCESS(set_handflow(device, point->flow)))
+        return "flow control";
+
+    if (!NT_SUCCESS(device_ioctl(device, point->nine_bit ? IOCTL_FASTCOM_ENABLE_9BIT : IOCTL_FASTCOM_DISABLE_9BIT,
+                                 NULL, 0, NULL, 0)))
+        return "9-bit";
+
+    if (point->nine_bit) {
+        BOOLEAN enabled = FALSE;
+
+        device_ioctl(device, IOCTL_FASTCOM_GET_9BIT, NULL, 0, &enabled, sizeof(enabled));
+        if (!enabled)
+            return "9-bit";
+    }
+
+    /* Requests should finish by filling up, these only stop a lost byte
+       from hanging the run */
+    memset(&timeouts, 0, sizeof(timeouts));
+    timeouts.ReadIntervalTimeout = interval_ms;
+    timeouts.ReadTotalTimeoutConstant = timeout_ms;
+    timeouts.WriteTotalTimeoutConstant = timeout_ms;
+
+    if (!NT_SUCCESS(device_ioctl(device, IOCTL_SERIAL_SET_TIMEOUTS, &timeouts, sizeof(timeouts), NULL, 0)))
+        return "timeouts";
+
+    if (!NT_SUCCESS(ioctl_value(device, IOCTL_SERIAL_PURGE,
+                                SERIAL_PURGE_TXABORT | SERIAL_PURGE_RXABORT |
+                                SERIAL_PURGE_TXCLEAR | SERIAL_PURGE_RXCLEAR)))
+        return "purge";
+
+    device_ioctl(device, IOCTL_SERIAL_CLEAR_STATS, NULL, 0, NULL, 0);
+    WdfShimDeviceClearInterruptStats(device);
+
+    return NULL;
+}
+
+static void run_point(struct bench *bench, const struct point *point)
+{
+    const struct options *options = bench->options;
+    unsigned bits = point->nine_bit ? 11 : 10;
+    double char_seconds, line_baud, elapsed, p[6];
+    unsigned long long total, rx_total, tx_posted = 0, rx_posted = 0, rx_received = 0;
+    unsigned long long start, end, accesses = 0;
+    struct stream stream = {0, 0, 0};
+    struct serialfc_ext_stats ext_rx;
+    WDF_SHIM_INTERRUPT_STATS isr_tx, isr_rx;
+    struct uart_emu_stats stats;
+    const char *failed;
+    ULONG interval_ms, timeout_ms;
+    int stalled = 0;
+    struct ring *ring;
+    struct slot *slot;
+    unsigned i;
+
+    printf("%-4s %8lu ", options->card->name, point->baud);
+
+    char_seconds = (double)bits / point->baud;
+
+    if (point->size * char_seconds > options->max_seconds) {
+        printf("skipped, one request takes %.0f s\n", point->size * char_seconds);
+        return;
+    }
+
+    total = (unsigned long long)(options->seconds / char_seconds);
+    total = (total + point->size - 1) / point->size * point->size;
+    if (total < point->size)
+        total = point->size;
+
+    /* 9-bit mode reads each character back as the character and its 9th bit */
+    rx_total = point->nine_bit ? total * 2 : total;
+
+    interval_ms = (ULONG)(char_seconds * 64 * 1000) + 20;
+    timeout_ms = (ULONG)(point->size * char_seconds * 4000) + 1000;
+
+    failed = configure(bench, bench->tx, point, interval_ms, timeout_ms);
+    if (!failed)
+        failed = configure(bench, bench->rx, point, interval_ms, timeout_ms);
+
+    WdfShimBusLock();
+    line_baud = uart_emu_get_baud(bench->uart, 1);
+    for (i = 0; i < 2; i++)
+        uart_emu_clear_stats(bench->uart, i);
+    WdfShimBusUnlock();
+
+    printf("%8.0f %4lu %7lu %-7s %-3s ", line_baud, point->trigger, point->size, flow_names[point->flow],
+           point->nine_bit ? "on" : "off");
+
+    if (failed) {
+        printf("unsupported %s\n", failed);
+        return;
+    }
+
+    bench->write_latency.count = 0;
+    bench->read_latency.count = 0;
+
+    start = now_ns();
+    end = start;
+
+    for (;;) {
+        while (bench->writes.count < options->depth && tx_posted < total) {
+            ULONG length = (ULONG)point->size;
+            unsigned char *buffer = bench->writes.slots[(bench->writes.head + bench->writes.count) %
+                                                        options->depth].buffer;
+            ULONG j;
+
+            for (j = 0; j < length; j++)
+                buffer[j] = pattern(tx_posted + j, point->flow);
+
+            send_request(bench, &bench->writes, bench->tx, WdfRequestTypeWrite, length);
+            tx_posted += length;
+        }
+
+        while (!stalled && bench->reads.count < options->depth && rx_posted < rx_total) {
+            ULONG length = (ULONG)(rx_total - rx_posted < point->size ? rx_total - rx_posted : point->size);
+
+            send_request(bench, &bench->reads, bench->rx, WdfRequestTypeRead, length);
+            rx_posted += length;
+        }
+
+        slot = reap(bench, &ring);
+        if (!slot)
+            break;
+
+        if (ring == &bench->writes) {
+            add_sample(&bench->write_latency, (slot->completed - slot->sent) / 1000.0);
+
+            /* A write that timed out held the rest back, stop sending */
+            if (slot->status != STATUS_SUCCESS)
+                tx_posted = total;
+
+            continue;
+        }
+
+        add_sample(&bench->read_latency, (slot->completed - slot->sent) / 1000.0);
+
+        for (i = 0; i < slot->information; i++) {
+            /* The 9th bit follows each character in 9-bit mode */
+            if (point->nine_bit && (rx_received + i) % 2) {
+                if (slot->buffer[i] > 1)
+                    stream.errors++;
+                continue;
+            }
+
+            check_byte(&stream, slot->buffer[i], point->flow);
+        }
+
+        rx_received += slot->information;
+        rx_posted -= slot->length - slot->information;
+
+        if (slot->information)
+            end = slot->completed;
+
+        /* Nothing came for a whole timeout, whatever is left is lost */
+        if (slot->status != STATUS_SUCCESS && !slot->information) {
+            stalled = 1;
+            ioctl_value(bench->tx, IOCTL_SERIAL_PURGE, SERIAL_PURGE_TXABORT | SERIAL_PURGE_TXCLEAR);
+            ioctl_value(bench->rx, IOCTL_SERIAL_PURGE, SERIAL_PURGE_RXABORT | SERIAL_PURGE_RXCLEAR);
+        }
+    }
+
+    elapsed = (end - start) / 1e9;
+
+    WdfShimDeviceGetInterruptStats(bench->tx, &isr_tx);
+    WdfShimDeviceGetInterruptStats(bench->rx, &isr_rx);
+
+    memset(&ext_rx, 0, sizeof(ext_rx));
+    device_ioctl(bench->rx, IOCTL_FASTCOM_GET_EXT_STATS, NULL, 0, &ext_rx, sizeof(ext_rx));
+
+    WdfShimBusLock();
+    for (i = 0; i < 2; i++) {
+        uart_emu_get_stats(bench->uart, i, &stats);
+        accesses += stats.reads + stats.writes;
+    }
+    WdfShimBusUnlock();
+
+    percentiles(&bench->write_latency, &p[0], &p[1], &p[2]);
+    percentiles(&bench->read_latency, &p[3], &p[4], &p[5]);
+
+    printf("%8.1f %5.1f %6.1f %5.2f %5.1f %7.0f %7.0f %7.0f %7.0f %7.0f %7.0f %4llu %6llu %6llu\n",
+           elapsed > 0 ? stream.matched / elapsed / 1024 : 0,
+           elapsed > 0 && line_baud > 0 ? 100 * stream.matched * bits / (elapsed * line_baud) : 0,
+           stream.matched ? (isr_tx.Calls + isr_rx.Calls) * 1024.0 / stream.matched : 0,
+           stream.matched ? (double)accesses / stream.matched : 0,
+           ext_rx.rx_bursts ? (double)ext_rx.rx_burst_bytes / ext_rx.rx_bursts : 0,
+           p[0], p[1], p[2], p[3], p[4], p[5],
+           (unsigned long long)(ext_rx.serial_overruns + ext_rx.buffer_overruns), stream.errors,
+           total - stream.matched);
+}
+
+static int parse_list(const char *arg, unsigned long *list, unsigned *count)
+{
+    char *end;
+
+    *count = 0;
+
+    do {
+        if (*count == MAX_LIST)
+            return -1;
+
+        list[(*count)++] = strtoul(arg, &end, 0);
+        if (end == arg || (*end && *end != ','))
+            return -1;
+
+        arg = end + 1;
+    } while (*end);
+
+    return 0;
+}
+
+static int parse_flows(const char *arg, unsigned *flows, unsigned *count)
+{
+    char copy[64], *name, *next;
+    unsigned i;
+
+    if (strlen(arg) >= sizeof(copy))
+        return -1;
+
+    strcpy(copy, arg);
+    *count = 0;
+
+    for (name = copy; name; name = next) {
+        next = strchr(name, ',');
+        if (next)
+            *next++ = '\0';
+
+        for (i = 0; i < 3 && strcmp(name, flow_names[i]); i++)
+            ;
+
+        if (i == 3 || *count == MAX_LIST)
+            return -1;
+
+        flows[(*count)++] = i;
+    }
+
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-c pcie|335|fscc] [-b bauds] [-t triggers] [-s sizes]\n"
+            "          [-f none,rtscts,xonxoff] [-9] [-d depth] [-T seconds] [-M seconds] [-p spin ns]\n"
+            "\n"
+            "Lists are comma separated. A trigger of 0 leaves the driver's levels.\n",
+            name);
+}
+
+static void defaults(struct options *options)
+{
+    static const unsigned long bauds[] = {9600, 115200, 921600, 3000000, 15000000};
+    static const unsigned long sizes[] = {1, 64, 4096, 65536, 1048576};
+    unsigned fifo = options->card->fifo;
+    unsigned i;
+
+    if (!options->baud_count) {
+        for (i = 0; i < sizeof(bauds) / sizeof(bauds[0]); i++)
+            options->bauds[options->baud_count++] = bauds[i];
+    }
+
+    if (!options->trigger_count) {
+        options->triggers[0] = 0;
+        options->triggers[1] = 8;
+        options->triggers[2] = fifo / 2;
+        options->triggers[3] = fifo - 8;
+        options->trigger_count = 4;
+    }
+
+    if (!options->size_count) {
+        for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+            options->sizes[options->size_count++] = sizes[i];
+    }
+
+    if (!options->flow_count) {
+        for (i = 0; i < 3; i++)
+            options->flows[options->flow_count++] = i;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    struct options options;
+    struct bench bench;
+    struct point point;
+    unsigned long largest = 0;
+    unsigned b, t, s, f, n, i;
+    NTSTATUS status;
+    int c, result = 0;
+
+    memset(&options, 0, sizeof(options));
+    options.card = &card_kinds[0];
+    options.depth = 4;
+    options.seconds = 0.25;
+    options.max_seconds = 5;
+    options.spin_ns = 50000;
+
+    while ((c = getopt(argc, argv, "c:b:t:s:f:9d:T:M:p:")) != -1) {
+        switch (c) {
+        case 'c':
+            for (i = 0; i < sizeof(card_kinds) / sizeof(card_kinds[0]); i++) {
+                if (!strcmp(optarg, card_kinds[i].name))
+                    break;
+            }
+            if (i == sizeof(card_kinds) / sizeof(card_kinds[0])) {
+                usage(argv[0]);
+                return 2;
+            }
+            options.card = &card_kinds[i];
+            break;
+
+        case 'b':
+            result = parse_list(optarg, options.bauds, &options.baud_count);
+            break;
+
+        case 't':
+            result = parse_list(optarg, options.triggers, &options.trigger_count);
+            break;
+
+        case 's':
+            result = parse_list(optarg, options.sizes, &options.size_count);
+            break;
+
+        case 'f':
+            result = parse_flows(optarg, options.flows, &options.flow_count);
+            break;
+
+        case '9':
+            options.nine_bit = 1;
+            break;
+
+        case 'd':
+            options.depth = (unsigned)strtoul(optarg, NULL, 0);
+            result = options.depth < 1 || options.depth > MAX_DEPTH ? -1 : 0;
+            break;
+
+        case 'T':
+            options.seconds = atof(optarg);
+            break;
+
+        case 'M':
+            options.max_seconds = atof(optarg);
+            break;
+
+        case 'p':
+            options.spin_ns = strtoull(optarg, NULL, 0);
+            break;
+
+        default:
+            result = -1;
+            break;
+        }
+
+        if (result) {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (optind != argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    defaults(&options);
+
+    for (s = 0; s < options.size_count; s++) {
+        if (!options.sizes[s] || options.sizes[s] > 0x7fffffff) {
+            usage(argv[0]);
+            return 2;
+        }
+
+        if (options.sizes[s] > largest)
+            largest = options.sizes[s];
+    }
+
+    memset(&bench, 0, sizeof(bench));
+    bench.options = &options;
+    pthread_mutex_init(&bench.lock, NULL);
+    pthread_cond_init(&bench.cond, NULL);
+
+    status = emu_card_start(options.spin_ns);
+    if (NT_SUCCESS(status))
+        status = emu_card_add(options.card->family, 2, NULL, 0, &bench.card);
+    if (!NT_SUCCESS(status)) {
+        fprintf(stderr, "the emulated card didn't start, 0x%08x\n", (unsigned)status);
+        return 1;
+    }
+
+    bench.uart = emu_card_uart(bench.card);
+    bench.tx = emu_card_device(bench.card, 0);
+    bench.rx = emu_card_device(bench.card, 1);
+
+    if (!bench.tx || !bench.rx || !NT_SUCCESS(WdfShimDeviceOpen(bench.tx)) ||
+        !NT_SUCCESS(WdfShimDeviceOpen(bench.rx))) {
+        fprintf(stderr, "the emulated ports didn't open\n");
+        emu_card_stop();
+        return 1;
+    }
+
+    WdfShimBusLock();
+    uart_emu_connect(bench.uart, 0, bench.uart, 1);
+    WdfShimBusUnlock();
+
+    for (i = 0; i < options.depth; i++) {
+        bench.writes.slots[i].bench = &bench;
+        bench.writes.slots[i].buffer = malloc(largest);
+        bench.reads.slots[i].bench = &bench;
+        bench.reads.slots[i].buffer = malloc(largest);
+
+        if (!bench.writes.slots[i].buffer || !bench.reads.slots[i].buffer) {
+            fprintf(stderr, "out of memory\n");
+            result = 1;
+            goto done;
+        }
+    }
+
+    printf("card     baud     line trig    size flow    9b      KB/s line%% isr/KB  acc/B burst "
+           " wr_p50  wr_p99  wr_max  rd_p50  rd_p99  rd_max  ovr    err   lost\n");
+
+    for (b = 0; b < options.baud_count; b++) {
+        for (t = 0; t < options.trigger_count; t++) {
+            for (s = 0; s < options.size_count; s++) {
+                for (f = 0; f < options.flow_count; f++) {
+                    for (n = 0; n <= (unsigned)options.nine_bit; n++) {
+                        point.baud = options.bauds[b];
+                        point.trigger = options.triggers[t];
+                        point.size = options.sizes[s];
+                        point.flow = options.flows[f];
+                        point.nine_bit = n;
+
+                        run_point(&bench, &point);
+                        fflush(stdout);
+                    }
+                }
+            }
+        }
+    }
+
+done:
+    WdfShimDeviceClose(bench.tx);
+    WdfShimDeviceClose(bench.rx);
+    emu_card_stop();
+
+    for (i = 0; i < options.depth; i++) {
+        free(bench.writes.slots[i].buffer);
+        free(bench.reads.slots[i].buffer);
+    }
+
+    free(bench.write_latency.values);
+    free(bench.read_latency.values);
+
+    return result;
+}
@@ -0,0 +1,1530 @@
+/*
+    UART emulator, see uart-emu.h.
+
+    Register names and bit meanings follow src/serial.h. The places where
+    the emulation is simpler than the parts are noted where they happen.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "uart-emu.h"
+
+/* A FIFO entry is the character in the low 8 bits with the 9th bit and
+   the errors it was received with above it. */
+#define CHAR_NINTH 0x100
+#define CHAR_PE 0x200
+#define CHAR_FE 0x400
+#define CHAR_BI 0x800
+#define CHAR_ERRORS (CHAR_PE | CHAR_FE | CHAR_BI)
+
+#define FIFO_MAX 256
+#define EXTERNAL_MAX 4096
+
+#define IER_RDA 0x01
+#define IER_THR 0x02
+#define IER_RLS 0x04
+#define IER_MS 0x08
+
+#define IIR_RLS 0x06
+#define IIR_RDA 0x04
+#define IIR_CTI 0x0c
+#define IIR_THR 0x02
+#define IIR_MS 0x00
+#define IIR_NONE 0x01
+#define IIR_FIFOS 0xc0
+
+#define FCR_ENABLE 0x01
+#define FCR_RX_RESET 0x02
+#define FCR_TX_RESET 0x04
+
+#define LCR_BREAK 0x40
+#define LCR_DLAB 0x80
+#define LCR_650 0xbf
+
+#define MCR_DTR 0x01
+#define MCR_RTS 0x02
+#define MCR_OUT1 0x04
+#define MCR_OUT2 0x08
+#define MCR_LOOP 0x10
+
+#define LSR_DR 0x01
+#define LSR_OE 0x02
+#define LSR_PE 0x04
+#define LSR_FE 0x08
+#define LSR_BI 0x10
+#define LSR_THRE 0x20
+#define LSR_TEMT 0x40
+#define LSR_FIFOERR 0x80
+
+#define MSR_DCTS 0x01
+#define MSR_DDSR 0x02
+#define MSR_TERI 0x04
+#define MSR_DDCD 0x08
+#define MSR_CTS 0x10
+#define MSR_DSR 0x20
+#define MSR_RI 0x40
+#define MSR_DCD 0x80
+
+#define EFR_ENHANCED 0x10
+#define EFR_AUTO_RTS 0x40
+#define EFR_AUTO_CTS 0x80
+
+/* 950 indexed registers */
+#define ICR_ACR 0x00
+#define ICR_CPR 0x01
+#define ICR_TCR 0x02
+#define ICR_TTL 0x04
+#define ICR_RTL 0x05
+#define ICR_ID1 0x08
+#define ICR_ID2 0x09
+#define ICR_ID3 0x0a
+#define ICR_REV 0x0b
+#define ICR_CSR 0x0c
+#define ICR_NMR 0x0d
+
+#define ACR_950_TRIGGERS 0x20
+#define ACR_ICR_READ 0x40
+#define ACR_STATUS_READ 0x80
+
+/* Exar registers, offsets into the channel */
+#define EXAR_FCTR 0x08
+#define EXAR_EFR 0x09
+#define EXAR_TXTRG 0x0a
+#define EXAR_RXTRG 0x0b
+#define EXAR_XOFF1 0x0c
+#define EXAR_XOFF2 0x0d
+#define EXAR_XON1 0x0e
+#define EXAR_XON2 0x0f
+#define EXAR_CONFIG 0x80    /* device configuration registers, 0x80 - 0x9f */
+#define EXAR_CONFIG_SIZE 0x20
+#define EXAR_FIFO 0x100     /* FIFO data window, 0x100 - 0x1ff */
+#define EXAR_FIFO_END 0x200
+
+/* Device configuration registers, offsets from EXAR_CONFIG */
+#define CONFIG_INT0 0x00
+#define CONFIG_INT1 0x01
+#define CONFIG_INT3 0x03
+#define CONFIG_8XMODE 0x08
+#define CONFIG_4XMODE 0x09
+#define CONFIG_RESET 0x0a
+#define CONFIG_DREV 0x0c
+#define CONFIG_DVID 0x0d
+#define CONFIG_MPIOLVL 0x10
+#define CONFIG_MPIOINV 0x13
+#define CONFIG_MPIOSEL 0x14
+#define CONFIG_MPIOLVLH 0x17
+#define CONFIG_MPIOINVH 0x19
+#define CONFIG_MPIOSELH 0x1a
+
+#define FCTR_TABLE_D 0xc0
+
+/* MPIOLVL pins the ICS307 on the 335 is programmed through */
+#define MPIO_SDTA 0x01
+#define MPIO_SCLK 0x02
+#define MPIO_SSTB 0x04
+
+#define ICS30702_INPUT 18432000u
+
+struct fifo {
+    unsigned short data[FIFO_MAX];
+    unsigned head;
+    unsigned count;
+};
+
+struct bytes {
+    unsigned char data[EXTERNAL_MAX];
+    unsigned long head;
+    unsigned long count;
+};
+
+struct channel {
+    struct uart_emu_card *card;
+    unsigned index;
+
+    unsigned char ier;
+    unsigned char fcr;
+    unsigned char lcr;
+    unsigned char mcr;
+    unsigned char msr;          /* inputs in the top four bits, changes below */
+    unsigned char spr;
+    unsigned char dll;
+    unsigned char dlm;
+    unsigned char dld;
+    unsigned char efr;
+    unsigned char xon1, xon2, xoff1, xoff2;
+    unsigned char fctr;
+    unsigned char txtrg;
+    unsigned char rxtrg;
+    unsigned char icr[256];
+
+    struct fifo rx;
+    struct fifo tx;
+    int overrun;                /* until LSR is read */
+    int thr_pending;            /* THR interrupt until IIR shows it or THR is written */
+    int irq;                    /* interrupt line as last reported */
+
+    int shifting;               /* a character is going out */
+    unsigned short shift;
+    unsigned long long shift_done;
+    int break_pending;          /* break started, the far end sees it at break_at */
+    unsigned long long break_at;
+    unsigned long long rx_last; /* last receive FIFO activity, for the timeout */
+
+    unsigned long baud;         /* fixed baud rate, 0 for the registers */
+    struct channel *peer;
+    unsigned char inputs;       /* modem inputs when nothing is wired */
+    struct bytes in;            /* uart_emu_send */
+    unsigned long long in_last;
+    struct bytes out;           /* uart_emu_receive */
+
+    struct uart_emu_stats stats;
+};
+
+struct uart_emu_card {
+    struct uart_emu_card *next;
+    enum uart_emu_family family;
+    unsigned channels;
+    unsigned long stride;
+    unsigned char *base;        /* addresses only, never read or written */
+    unsigned long clock;
+    unsigned char config[EXAR_CONFIG_SIZE];
+    unsigned mpio_inputs;
+    unsigned char mpio_last;    /* for MPIOLVL edges */
+    unsigned long ics307_shift;
+    uart_emu_interrupt callback;
+    void *context;
+    struct channel channel[UART_EMU_MAX_CHANNELS];
+};
+
+static struct uart_emu_card *cards;
+static unsigned long long now;
+
+static void start_tx(struct channel *ch);
+static void refresh_inputs(struct channel *ch);
+
+static void fifo_push(struct fifo *f, unsigned short value)
+{
+    f->data[(f->head + f->count) % FIFO_MAX] = value;
+    f->count++;
+}
+
+static unsigned short fifo_pop(struct fifo *f)
+{
+    unsigned short value = f->data[f->head];
+
+    f->head = (f->head + 1) % FIFO_MAX;
+    f->count--;
+
+    return value;
+}
+
+static void bytes_push(struct bytes *b, unsigned char value)
+{
+    b->data[(b->head + b->count) % EXTERNAL_MAX] = value;
+    b->count++;
+}
+
+static unsigned char bytes_pop(struct bytes *b)
+{
+    unsigned char value = b->data[b->head];
+
+    b->head = (b->head + 1) % EXTERNAL_MAX;
+    b->count--;
+
+    return value;
+}
+
+static int nine_bit(const struct channel *ch)
+{
+    return ch->card->family == UART_EMU_16C950 && (ch->icr[ICR_NMR] & 0x01);
+}
+
+static int fifo_enabled(const struct channel *ch)
+{
+    return (ch->fcr & FCR_ENABLE) != 0;
+}
+
+static unsigned fifo_depth(const struct channel *ch)
+{
+    if (!fifo_enabled(ch))
+        return 1;
+
+    switch (ch->card->family) {
+    case UART_EMU_16C950:
+        return (ch->efr & EFR_ENHANCED) ? 128 : 16;
+
+    case UART_EMU_XR17D15X:
+        return 64;
+
+    default:
+        return 256;
+    }
+}
+
+/* Receive FIFO level the data available interrupt comes at. The Exar
+   trigger tables A to C are all taken as the 16550 one. */
+static unsigned rx_trigger(const struct channel *ch)
+{
+    static const unsigned char levels_550[] = {1, 4, 8, 14};
+    static const unsigned char levels_650[] = {16, 32, 112, 120};
+    unsigned level;
+
+    if (!fifo_enabled(ch))
+        return 1;
+
+    if (ch->card->family == UART_EMU_16C950) {
+        if (ch->icr[ICR_ACR] & ACR_950_TRIGGERS)
+            level = ch->icr[ICR_RTL];
+        else if (ch->efr & EFR_ENHANCED)
+            level = levels_650[ch->fcr >> 6];
+        else
+            level = levels_550[ch->fcr >> 6];
+    }
+    else {
+        if ((ch->fctr & FCTR_TABLE_D) == FCTR_TABLE_D)
+            level = ch->rxtrg;
+        else
+            level = levels_550[ch->fcr >> 6];
+    }
+
+    if (level == 0)
+        level = 1;
+
+    if (level > fifo_depth(ch))
+        level = fifo_depth(ch);
+
+    return level;
+}
+
+/* Transmit FIFO level at or below which the THR interrupt comes. */
+static unsigned tx_trigger(const struct channel *ch)
+{
+    static const unsigned char levels_650[] = {16, 32, 64, 112};
+
+    if (!fifo_enabled(ch))
+        return 0;
+
+    if (ch->card->family == UART_EMU_16C950) {
+        if (ch->icr[ICR_ACR] & ACR_950_TRIGGERS)
+            return ch->icr[ICR_TTL];
+
+        if (ch->efr & EFR_ENHANCED)
+            return levels_650[(ch->fcr >> 4) & 3];
+
+        return 0;
+    }
+
+    if ((ch->fctr & FCTR_TABLE_D) == FCTR_TABLE_D)
+        return ch->txtrg;
+
+    return 0;
+}
+
+/* The 950's clock prescaler (CPR, MCR bit 7) isn't emulated. */
+static double channel_baud(const struct channel *ch)
+{
+    const struct uart_emu_card *card = ch->card;
+    double divisor = (ch->dlm << 8) | ch->dll;
+    unsigned sample_rate = 16;
+
+    if (ch->baud)
+        return ch->baud;
+
+    switch (card->family) {
+    case UART_EMU_16C950:
+        if ((ch->icr[ICR_TCR] & 0x0f) >= 4)
+            sample_rate = ch->icr[ICR_TCR] & 0x0f;
+        break;
+
+    case UART_EMU_XR17D15X:
+        if (card->config[CONFIG_8XMODE] & (1 << ch->index))
+            sample_rate = 8;
+        break;
+
+    case UART_EMU_XR17V35X:
+        if (card->config[CONFIG_4XMODE] & (1 << ch->index))
+            sample_rate = 4;
+        else if (card->config[CONFIG_8XMODE] & (1 << ch->index))
+            sample_rate = 8;
+
+        divisor += (ch->dld & 0x0f) / 16.0;
+        break;
+    }
+
+    if (divisor == 0)
+        return 0;
+
+    return card->clock / (sample_rate * divisor);
+}
+
+/* Bits in a character, in halves for 1.5 stop bits. */
+static unsigned half_bits(const struct channel *ch)
+{
+    unsigned data = 5 + (ch->lcr & 0x03);
+    unsigned bits = 2 + data * 2;
+
+    if (nine_bit(ch))
+        bits += 2;
+    else if (ch->lcr & 0x08)
+        bits += 2;
+
+    if (ch->lcr & 0x04)
+        bits += (data == 5) ? 3 : 4;
+    else
+        bits += 2;
+
+    return bits;
+}
+
+/* How long a character takes, 0 if the line isn't running. */
+static unsigned long long char_ns(const struct channel *ch)
+{
+    double baud = channel_baud(ch);
+    unsigned long long ns;
+
+    if (baud <= 0)
+        return 0;
+
+    ns = (unsigned long long)(half_bits(ch) * 1e9 / (2 * baud) + 0.5);
+
+    return ns ? ns : 1;
+}
+
+/* A receiver set up differently from the transmitter sees framing
+   errors rather than garbage. */
+static int frames_match(const struct channel *from, const struct channel *to)
+{
+    double a = channel_baud(from), b = channel_baud(to);
+
+    if (a <= 0 || b <= 0)
+        return 0;
+
+    if (a > b * 1.02 || b > a * 1.02)
+        return 0;
+
+    if (nine_bit(from) != nine_bit(to))
+        return 0;
+
+    return (from->lcr & 0x3f) == (to->lcr & 0x3f);
+}
+
+static void rx_push(struct channel *to, unsigned short value, const struct channel *from)
+{
+    if (from && !frames_match(from, to))
+        value |= CHAR_FE;
+
+    if (!nine_bit(to))
+        value &= ~CHAR_NINTH;
+
+    /* Bits past the receiver's character length never arrive */
+    value &= (unsigned short)~(0xffu & (0xffu << (5 + (to->lcr & 0x03))));
+
+    if (to->rx.count >= fifo_depth(to)) {
+        to->overrun = 1;
+        to->stats.overruns++;
+        return;
+    }
+
+    fifo_push(&to->rx, value);
+    to->stats.rx_chars++;
+    to->rx_last = now;
+
+    if (to->efr & EFR_AUTO_RTS)
+        refresh_inputs(to->peer ? to->peer : to);
+}
+
+/* Puts a character on the line, or back into the channel in loopback. */
+static void deliver(struct channel *ch, unsigned short value)
+{
+    if (ch->mcr & MCR_LOOP)
+        rx_push(ch, value, ch);
+    else if (ch->peer)
+        rx_push(ch->peer, value, ch);
+    else if (!(value & CHAR_BI) && ch->out.count < EXTERNAL_MAX)
+        bytes_push(&ch->out, (unsigned char)value);
+}
+
+/* RTS as it leaves the UART. Auto RTS drops it at the receive trigger
+   level and raises it again below. */
+static int rts_out(const struct channel *ch)
+{
+    if (!(ch->mcr & MCR_RTS))
+        return 0;
+
+    if ((ch->efr & EFR_AUTO_RTS) && ch->rx.count >= rx_trigger(ch))
+        return 0;
+
+    return 1;
+}
+
+static unsigned char modem_inputs(const struct channel *ch)
+{
+    unsigned char msr = 0;
+
+    if (ch->mcr & MCR_LOOP) {
+        if (ch->mcr & MCR_RTS)
+            msr |= MSR_CTS;
+        if (ch->mcr & MCR_DTR)
+            msr |= MSR_DSR;
+        if (ch->mcr & MCR_OUT1)
+            msr |= MSR_RI;
+        if (ch->mcr & MCR_OUT2)
+            msr |= MSR_DCD;
+
+        return msr;
+    }
+
+    if (!ch->peer)
+        return ch->inputs & 0xf0;
+
+    /* A channel in loopback keeps its outputs off the cable */
+    if (ch->peer->mcr & MCR_LOOP)
+        return 0;
+
+    if (rts_out(ch->peer))
+        msr |= MSR_CTS;
+    if (ch->peer->mcr & MCR_DTR)
+        msr |= MSR_DSR | MSR_DCD;
+
+    return msr;
+}
+
+static void set_inputs(struct channel *ch, unsigned char inputs)
+{
+    unsigned char old = ch->msr & 0xf0;
+    unsigned char delta = ch->msr & 0x0f;
+
+    if ((old ^ inputs) & MSR_CTS)
+        delta |= MSR_DCTS;
+    if ((old ^ inputs) & MSR_DSR)
+        delta |= MSR_DDSR;
+    if ((old & MSR_RI) && !(inputs & MSR_RI))
+        delta |= MSR_TERI;
+    if ((old ^ inputs) & MSR_DCD)
+        delta |= MSR_DDCD;
+
+    ch->msr = inputs | delta;
+
+    if (!(old & MSR_CTS) && (inputs & MSR_CTS))
+        start_tx(ch);
+}
+
+static void refresh_inputs(struct channel *ch)
+{
+    set_inputs(ch, modem_inputs(ch));
+}
+
+static void refresh_line(struct channel *ch)
+{
+    refresh_inputs(ch);
+
+    if (ch->peer)
+        refresh_inputs(ch->peer);
+}
+
+/* Moves the next character into the transmit shift register. */
+static void start_tx(struct channel *ch)
+{
+    unsigned long long ns;
+
+    if (ch->shifting || ch->tx.count == 0)
+        return;
+
+    if ((ch->efr & EFR_AUTO_CTS) && !(ch->msr & MSR_CTS))
+        return;
+
+    ns = char_ns(ch);
+    if (ns == 0)
+        return;
+
+    ch->shift = fifo_pop(&ch->tx);
+    ch->shifting = 1;
+    ch->shift_done = now + ns;
+
+    /* A FIFO loaded below the trigger never falls to it, the interrupt
+       comes when it empties then, like THRE on any 16550 */
+    if ((ch->tx.count == tx_trigger(ch) || ch->tx.count == 0) && (ch->ier & IER_THR))
+        ch->thr_pending = 1;
+}
+
+static void tx_push(struct channel *ch, unsigned char value)
+{
+    unsigned short entry = value;
+
+    if (nine_bit(ch) && (ch->spr & 0x01))
+        entry |= CHAR_NINTH;
+
+    ch->thr_pending = 0;
+
+    if (ch->tx.count >= fifo_depth(ch)) {
+        ch->stats.tx_dropped++;
+        return;
+    }
+
+    fifo_push(&ch->tx, entry);
+    start_tx(ch);
+}
+
+static unsigned char rx_pop(struct channel *ch)
+{
+    unsigned short value;
+
+    if (ch->rx.count == 0)
+        return 0;
+
+    value = fifo_pop(&ch->rx);
+    ch->rx_last = now;
+
+    if (ch->efr & EFR_AUTO_RTS)
+        refresh_inputs(ch->peer ? ch->peer : ch);
+
+    return (unsigned char)value;
+}
+
+static int rx_timed_out(const struct channel *ch)
+{
+    unsigned long long ns = char_ns(ch);
+
+    return ch->rx.count && ns && now >= ch->rx_last + 4 * ns;
+}
+
+static int line_error(const struct channel *ch)
+{
+    unsigned short errors = CHAR_ERRORS;
+
+    if (ch->overrun)
+        return 1;
+
+    if (ch->rx.count == 0)
+        return 0;
+
+    /* In 9-bit mode LSR[2] is the 9th bit rather than a parity error */
+    if (nine_bit(ch))
+        errors &= ~CHAR_PE;
+
+    return (ch->rx.data[ch->rx.head] & errors) != 0;
+}
+
+static unsigned char iir_value(const struct channel *ch)
+{
+    unsigned char iir = IIR_NONE;
+
+    if ((ch->ier & IER_RLS) && line_error(ch))
+        iir = IIR_RLS;
+    else if ((ch->ier & IER_RDA) && ch->rx.count >= rx_trigger(ch))
+        iir = IIR_RDA;
+    else if ((ch->ier & IER_RDA) && rx_timed_out(ch))
+        iir = IIR_CTI;
+    else if ((ch->ier & IER_THR) && ch->thr_pending)
+        iir = IIR_THR;
+    else if ((ch->ier & IER_MS) && (ch->msr & 0x0f))
+        iir = IIR_MS;
+
+    if (fifo_enabled(ch))
+        iir |= IIR_FIFOS;
+
+    return iir;
+}
+
+static unsigned char lsr_value(const struct channel *ch)
+{
+    unsigned char lsr = 0;
+    unsigned i;
+
+    if (ch->rx.count) {
+        unsigned short top = ch->rx.data[ch->rx.head];
+
+        lsr |= LSR_DR;
+
+        if (nine_bit(ch) ? (top & CHAR_NINTH) : (top & CHAR_PE))
+            lsr |= LSR_PE;
+        if (top & CHAR_FE)
+            lsr |= LSR_FE;
+        if (top & CHAR_BI)
+            lsr |= LSR_BI;
+    }
+
+    if (ch->overrun)
+        lsr |= LSR_OE;
+
+    if (ch->tx.count == 0) {
+        lsr |= LSR_THRE;
+
+        if (!ch->shifting)
+            lsr |= LSR_TEMT;
+    }
+
+    if (fifo_enabled(ch)) {
+        for (i = 0; i < ch->rx.count; i++) {
+            if (ch->rx.data[(ch->rx.head + i) % FIFO_MAX] & CHAR_ERRORS) {
+                lsr |= LSR_FIFOERR;
+                break;
+            }
+        }
+    }
+
+    return lsr;
+}
+
+/* A full 256 byte FIFO reads as 255 through the 8 bit level registers. */
+static unsigned char count_register(unsigned count)
+{
+    return (unsigned char)(count > 255 ? 255 : count);
+}
+
+/* Reading LSR reports the top character's errors once. */
+static unsigned char read_lsr(struct channel *ch)
+{
+    unsigned char lsr = lsr_value(ch);
+
+    ch->overrun = 0;
+
+    if (ch->rx.count)
+        ch->rx.data[ch->rx.head] &= ~CHAR_ERRORS;
+
+    return lsr;
+}
+
+static unsigned char read_iir(struct channel *ch)
+{
+    unsigned char iir = iir_value(ch);
+
+    if ((iir & 0x0f) == IIR_THR)
+        ch->thr_pending = 0;
+
+    return iir;
+}
+
+static unsigned char read_msr(struct channel *ch)
+{
+    unsigned char msr = ch->msr;
+
+    ch->msr &= 0xf0;
+
+    return msr;
+}
+
+static void reset_channel(struct channel *ch)
+{
+    ch->ier = 0;
+    ch->fcr = 0;
+    ch->lcr = 0;
+    ch->mcr = 0;
+    ch->msr &= 0xf0;
+    ch->spr = 0xff;
+    ch->dll = 0;
+    ch->dlm = 0;
+    ch->dld = 0;
+    ch->efr = 0;
+    ch->xon1 = ch->xon2 = ch->xoff1 = ch->xoff2 = 0;
+    ch->fctr = 0;
+    ch->txtrg = 0;
+    ch->rxtrg = 0;
+
+    memset(ch->icr, 0, sizeof(ch->icr));
+    ch->icr[ICR_CPR] = 0x20;
+    ch->icr[ICR_ID1] = 0x16;
+    ch->icr[ICR_ID2] = 0xc9;
+    ch->icr[ICR_ID3] = 0x50;
+    ch->icr[ICR_REV] = 0x03;
+
+    ch->rx.head = ch->rx.count = 0;
+    ch->tx.head = ch->tx.count = 0;
+    ch->overrun = 0;
+    ch->thr_pending = 0;
+    ch->shifting = 0;
+    ch->break_pending = 0;
+    ch->rx_last = now;
+
+    refresh_line(ch);
+}
+
+static void write_fcr(struct channel *ch, unsigned char value)
+{
+    unsigned char old = ch->fcr;
+
+    ch->fcr = value & ~(FCR_RX_RESET | FCR_TX_RESET);
+
+    if ((old ^ value) & FCR_ENABLE)
+        value |= FCR_RX_RESET | FCR_TX_RESET;
+
+    if (value & FCR_RX_RESET) {
+        ch->rx.head = ch->rx.count = 0;
+        ch->rx_last = now;
+
+        if (ch->efr & EFR_AUTO_RTS)
+            refresh_inputs(ch->peer ? ch->peer : ch);
+    }
+
+    if (value & FCR_TX_RESET) {
+        ch->tx.head = ch->tx.count = 0;
+
+        if (ch->ier & IER_THR)
+            ch->thr_pending = 1;
+    }
+}
+
+static void write_lcr(struct channel *ch, unsigned char value)
+{
+    unsigned char old = ch->lcr;
+    unsigned long long ns;
+
+    ch->lcr = value;
+
+    /* The far end sees the break a character time after it starts. */
+    if (!(old & LCR_BREAK) && (value & LCR_BREAK)) {
+        ns = char_ns(ch);
+        ch->break_pending = 1;
+        ch->break_at = now + (ns ? ns : 1);
+    }
+    else if (!(value & LCR_BREAK)) {
+        ch->break_pending = 0;
+    }
+}
+
+static void write_ier(struct channel *ch, unsigned char value)
+{
+    unsigned char old = ch->ier;
+
+    ch->ier = value;
+
+    if (!(value & IER_THR))
+        ch->thr_pending = 0;
+    else if (!(old & IER_THR) && ch->tx.count <= tx_trigger(ch))
+        ch->thr_pending = 1;
+}
+
+/* Offsets 0 to 7 once the banked registers are out of the way. */
+static unsigned char read_common(struct channel *ch, unsigned long offset)
+{
+    switch (offset) {
+    case 0: return rx_pop(ch);
+    case 1: return ch->ier;
+    case 2: return read_iir(ch);
+    case 3: return ch->lcr;
+    case 4: return ch->mcr;
+    case 5: return read_lsr(ch);
+    case 6: return read_msr(ch);
+    default: return ch->spr;
+    }
+}
+
+static void write_common(struct channel *ch, unsigned long offset, unsigned char value)
+{
+    switch (offset) {
+    case 0:
+        tx_push(ch, value);
+        break;
+
+    case 1:
+        write_ier(ch, value);
+        break;
+
+    case 2:
+        write_fcr(ch, value);
+        break;
+
+    case 3:
+        write_lcr(ch, value);
+        break;
+
+    case 4:
+        ch->mcr = value;
+        refresh_line(ch);
+        start_tx(ch);
+        break;
+
+    case 7:
+        ch->spr = value;
+        break;
+
+    default:
+        break;  /* LSR and MSR writes are for factory test */
+    }
+}
+
+/*
+    16C950
+*/
+
+static unsigned char read_icr(struct channel *ch, unsigned char index)
+{
+    if (index == ICR_CSR)
+        return 0;
+
+    return ch->icr[index];
+}
+
+static void write_icr(struct channel *ch, unsigned char index, unsigned char value)
+{
+    switch (index) {
+    case ICR_ID1:
+    case ICR_ID2:
+    case ICR_ID3:
+    case ICR_REV:
+        break;
+
+    case ICR_CSR:
+        if (value == 0)
+            reset_channel(ch);
+        break;
+
+    default:
+        ch->icr[index] = value;
+        break;
+    }
+}
+
+static unsigned char read_950(struct channel *ch, unsigned long offset)
+{
+    if (ch->lcr == LCR_650) {
+        switch (offset) {
+        case 0: return ch->dll;
+        case 1: return ch->dlm;
+        case 2: return ch->efr;
+        case 3: return ch->lcr;
+        case 4: return ch->xon1;
+        case 5: return ch->xon2;
+        case 6: return ch->xoff1;
+        default: return ch->xoff2;
+        }
+    }
+
+    if ((ch->lcr & LCR_DLAB) && offset < 2)
+        return offset ? ch->dlm : ch->dll;
+
+    if (ch->icr[ICR_ACR] & ACR_STATUS_READ) {
+        switch (offset) {
+        case 1: return (ch->tx.count == 0 && !ch->shifting) ? 0x80 : 0x00;    /* ASR */
+        case 3: return count_register(ch->rx.count);                          /* RFL */
+        case 4: return count_register(ch->tx.count);                          /* TFL */
+        default: break;
+        }
+    }
+
+    if (offset == 5 && (ch->icr[ICR_ACR] & ACR_ICR_READ))
+        return read_icr(ch, ch->spr);
+
+    return read_common(ch, offset);
+}
+
+static void write_950(struct channel *ch, unsigned long offset, unsigned char value)
+{
+    if (ch->lcr == LCR_650) {
+        switch (offset) {
+        case 0: ch->dll = value; break;
+        case 1: ch->dlm = value; break;
+        case 2: ch->efr = value; refresh_line(ch); break;
+        case 3: write_lcr(ch, value); break;
+        case 4: ch->xon1 = value; break;
+        case 5: ch->xon2 = value; break;
+        case 6: ch->xoff1 = value; break;
+        default: ch->xoff2 = value; break;
+        }
+        return;
+    }
+
+    if ((ch->lcr & LCR_DLAB) && offset < 2) {
+        if (offset)
+            ch->dlm = value;
+        else
+            ch->dll = value;
+        return;
+    }
+
+    if (offset == 5) {
+        write_icr(ch, ch->spr, value);
+        return;
+    }
+
+    write_common(ch, offset, value);
+}
+
+/*
+    XR17D15X and XR17V35X
+*/
+
+static unsigned long ics307_od(unsigned long bits)
+{
+    switch ((bits >> 16) & 0x07) {
+    case 1: return 2;
+    case 6: return 3;
+    case 3: return 4;
+    case 4: return 5;
+    case 7: return 6;
+    case 5: return 7;
+    case 2: return 8;
+    default: return 10;
+    }
+}
+
+/* The ICS307 takes a bit on each rising SCLK and the word on a rising
+   SSTB. The frequency is worked out the way gen-335-clock-table.c does. */
+static void write_mpiolvl(struct uart_emu_card *card, unsigned char value)
+{
+    unsigned char old = card->mpio_last;
+
+    card->mpio_last = value;
+    card->config[CONFIG_MPIOLVL] = value;
+
+    if (card->family != UART_EMU_XR17D15X)
+        return;
+
+    if (!(old & MPIO_SCLK) && (value & MPIO_SCLK))
+        card->ics307_shift = ((card->ics307_shift << 1) | (value & MPIO_SDTA)) & 0xffffff;
+
+    if (!(old & MPIO_SSTB) && (value & MPIO_SSTB)) {
+        unsigned long bits = card->ics307_shift;
+        unsigned long rdw = bits & 0x7f;
+        unsigned long vdw = (bits >> 7) & 0x1ff;
+
+        card->clock = ((ICS30702_INPUT * 2) / ((rdw + 2) * ics307_od(bits))) * (vdw + 8);
+    }
+}
+
+static unsigned char mpio_level(const struct uart_emu_card *card, unsigned level, unsigned inv,
+                                unsigned sel, unsigned shift)
+{
+    unsigned char inputs = (unsigned char)(card->mpio_inputs >> shift);
+
+    return (unsigned char)((card->config[level] & ~card->config[sel]) |
+                           ((inputs ^ card->config[inv]) & card->config[sel]));
+}
+
+static int interrupt_pending(const struct channel *ch)
+{
+    return (iir_value(ch) & IIR_NONE) == 0;
+}
+
+static unsigned char read_config(struct uart_emu_card *card, unsigned long index)
+{
+    unsigned char value = 0;
+    unsigned i;
+
+    switch (index) {
+    case CONFIG_INT0:
+        for (i = 0; i < card->channels; i++) {
+            if (interrupt_pending(&card->channel[i]))
+                value |= (unsigned char)(1 << i);
+        }
+        return value;
+
+    case CONFIG_INT1:
+    case CONFIG_INT1 + 1:
+    case CONFIG_INT3:
+    case CONFIG_RESET:
+        return 0;
+
+    case CONFIG_MPIOLVL:
+        return mpio_level(card, CONFIG_MPIOLVL, CONFIG_MPIOINV, CONFIG_MPIOSEL, 0);
+
+    case CONFIG_MPIOLVLH:
+        return mpio_level(card, CONFIG_MPIOLVLH, CONFIG_MPIOINVH, CONFIG_MPIOSELH, 8);
+
+    default:
+        return card->config[index];
+    }
+}
+
+static void write_config(struct uart_emu_card *card, unsigned long index, unsigned char value)
+{
+    unsigned i;
+
+    switch (index) {
+    case CONFIG_INT0:
+    case CONFIG_INT1:
+    case CONFIG_INT1 + 1:
+    case CONFIG_INT3:
+    case CONFIG_DREV:
+    case CONFIG_DVID:
+        break;
+
+    case CONFIG_RESET:
+        for (i = 0; i < card->channels; i++) {
+            if (value & (1 << i))
+                reset_channel(&card->channel[i]);
+        }
+        break;
+
+    case CONFIG_MPIOLVL:
+        write_mpiolvl(card, value);
+        break;
+
+    default:
+        card->config[index] = value;
+        break;
+    }
+}
+
+static unsigned char read_exar(struct channel *ch, unsigned long offset)
+{
+    struct uart_emu_card *card = ch->card;
+
+    if (offset >= EXAR_FIFO && offset < EXAR_FIFO_END)
+        return rx_pop(ch);
+
+    if (offset >= EXAR_CONFIG && offset < EXAR_CONFIG + EXAR_CONFIG_SIZE)
+        return read_config(card, offset - EXAR_CONFIG);
+
+    if (ch->lcr & LCR_DLAB) {
+        if (offset == 0)
+            return ch->dll;
+        if (offset == 1)
+            return ch->dlm;
+        if (offset == 2 && card->family == UART_EMU_XR17V35X)
+            return ch->dld;
+    }
+
+    switch (offset) {
+    case EXAR_FCTR: return ch->fctr;
+    case EXAR_EFR: return ch->efr;
+    case EXAR_TXTRG: return count_register(ch->tx.count);  /* TXCNT */
+    case EXAR_RXTRG: return count_register(ch->rx.count);  /* RXCNT */
+    case EXAR_XOFF1: return ch->xoff1;
+    case EXAR_XOFF2: return ch->xoff2;
+    case EXAR_XON1: return ch->xon1;
+    case EXAR_XON2: return ch->xon2;
+    default: break;
+    }
+
+    if (offset < 8)
+        return read_common(ch, offset);
+
+    return 0;
+}
+
+static void write_exar(struct channel *ch, unsigned long offset, unsigned char value)
+{
+    struct uart_emu_card *card = ch->card;
+
+    if (offset >= EXAR_FIFO && offset < EXAR_FIFO_END) {
+        tx_push(ch, value);
+        return;
+    }
+
+    if (offset >= EXAR_CONFIG && offset < EXAR_CONFIG + EXAR_CONFIG_SIZE) {
+        write_config(card, offset - EXAR_CONFIG, value);
+        return;
+    }
+
+    if (ch->lcr & LCR_DLAB) {
+        if (offset == 0) {
+            ch->dll = value;
+            return;
+        }
+        if (offset == 1) {
+            ch->dlm = value;
+            return;
+        }
+        if (offset == 2 && card->family == UART_EMU_XR17V35X) {
+            ch->dld = value;
+            return;
+        }
+    }
+
+    switch (offset) {
+    case EXAR_FCTR: ch->fctr = value; break;
+    case EXAR_EFR: ch->efr = value; refresh_line(ch); break;
+    case EXAR_TXTRG: ch->txtrg = value; break;
+    case EXAR_RXTRG: ch->rxtrg = value; break;
+    case EXAR_XOFF1: ch->xoff1 = value; break;
+    case EXAR_XOFF2: ch->xoff2 = value; break;
+    case EXAR_XON1: ch->xon1 = value; break;
+    case EXAR_XON2: ch->xon2 = value; break;
+    default:
+        if (offset < 8)
+            write_common(ch, offset, value);
+        break;
+    }
+}
+
+/*
+    Interrupts and time
+*/
+
+static void update_interrupts(void)
+{
+    struct uart_emu_card *card;
+    unsigned i;
+
+    for (card = cards; card; card = card->next) {
+        for (i = 0; i < card->channels; i++) {
+            struct channel *ch = &card->channel[i];
+            int pending = interrupt_pending(ch);
+
+            if (pending && !ch->irq) {
+                ch->irq = 1;
+                ch->stats.interrupts++;
+
+                if (card->callback)
+                    card->callback(card->context, card, i);
+            }
+
+            ch->irq = pending;
+        }
+    }
+}
+
+/* The next time something happens on the channel by itself, ~0 for
+   never. */
+static unsigned long long channel_next_event(const struct channel *ch)
+{
+    unsigned long long next = ~0ULL;
+    unsigned long long ns = char_ns(ch);
+
+    if (ch->shifting && ch->shift_done < next)
+        next = ch->shift_done;
+
+    if (ch->break_pending && ch->break_at < next)
+        next = ch->break_at;
+
+    if (ch->in.count && ns && ch->in_last + ns < next)
+        next = ch->in_last + ns;
+
+    /* The character timeout only changes the interrupt line */
+    if (ch->rx.count && ns && ch->rx_last + 4 * ns > now && ch->rx_last + 4 * ns < next)
+        next = ch->rx_last + 4 * ns;
+
+    return next;
+}
+
+static void channel_run(struct channel *ch)
+{
+    unsigned long long ns = char_ns(ch);
+
+    if (ch->shifting && ch->shift_done <= now) {
+        ch->shifting = 0;
+        ch->stats.tx_chars++;
+        deliver(ch, ch->shift);
+        start_tx(ch);
+    }
+
+    if (ch->break_pending && ch->break_at <= now) {
+        ch->break_pending = 0;
+        deliver(ch, CHAR_BI);
+    }
+
+    if (ch->in.count && ns && ch->in_last + ns <= now) {
+        ch->in_last = now;
+        rx_push(ch, bytes_pop(&ch->in), NULL);
+    }
+}
+
+unsigned long long uart_emu_now(void)
+{
+    return now;
+}
+
+unsigned long long uart_emu_next_event(void)
+{
+    unsigned long long next = ~0ULL;
+    struct uart_emu_card *card;
+    unsigned i;
+
+    for (card = cards; card; card = card->next) {
+        for (i = 0; i < card->channels; i++) {
+            unsigned long long t = channel_next_event(&card->channel[i]);
+
+            if (t < next)
+                next = t;
+        }
+    }
+
+    if (next == ~0ULL)
+        return next;
+
+    return next > now ? next - now : 0;
+}
+
+void uart_emu_advance(unsigned long long ns)
+{
+    unsigned long long end = now + ns;
+
+    for (;;) {
+        unsigned long long next = uart_emu_next_event();
+        struct uart_emu_card *card;
+        unsigned i;
+
+        if (next == ~0ULL || now + next > end)
+            break;
+
+        now += next;
+
+        for (card = cards; card; card = card->next) {
+            for (i = 0; i < card->channels; i++)
+                channel_run(&card->channel[i]);
+        }
+
+        update_interrupts();
+    }
+
+    now = end;
+    update_interrupts();
+}
+
+/*
+    Cards
+*/
+
+static struct channel *find_register(unsigned char *address, unsigned long *offset)
+{
+    struct uart_emu_card *card;
+
+    for (card = cards; card; card = card->next) {
+        if (address >= card->base && address < card->base + card->stride * card->channels) {
+            unsigned long index = (unsigned long)(address - card->base);
+
+            *offset = index % card->stride;
+            return &card->channel[index / card->stride];
+        }
+    }
+
+    return NULL;
+}
+
+struct uart_emu_card *uart_emu_create(enum uart_emu_family family, unsigned channels)
+{
+    struct uart_emu_card *card;
+    unsigned i;
+
+    if (channels == 0 || channels > UART_EMU_MAX_CHANNELS)
+        return NULL;
+
+    card = calloc(1, sizeof(*card));
+    if (!card)
+        return NULL;
+
+    card->family = family;
+    card->channels = channels;
+
+    switch (family) {
+    case UART_EMU_16C950:
+        card->stride = 8;
+        card->clock = 18432000;
+        break;
+
+    case UART_EMU_XR17D15X:
+        card->stride = 0x200;
+        card->clock = 18432000;
+        card->config[CONFIG_DVID] = (unsigned char)(0x20 | channels);
+        break;
+
+    default:
+        card->stride = 0x400;
+        card->clock = 125000000;
+        card->config[CONFIG_DVID] = (unsigned char)(0x80 | channels);
+        break;
+    }
+
+    card->config[CONFIG_DREV] = 0x01;
+    card->config[CONFIG_MPIOSEL] = 0xff;
+    card->config[CONFIG_MPIOSELH] = 0xff;
+
+    card->base = malloc(card->stride * channels);
+    if (!card->base) {
+        free(card);
+        return NULL;
+    }
+
+    for (i = 0; i < channels; i++) {
+        card->channel[i].card = card;
+        card->channel[i].index = i;
+    }
+
+    card->next = cards;
+    cards = card;
+
+    for (i = 0; i < channels; i++)
+        reset_channel(&card->channel[i]);
+
+    return card;
+}
+
+void uart_emu_destroy(struct uart_emu_card *card)
+{
+    struct uart_emu_card **p;
+    unsigned i;
+
+    if (!card)
+        return;
+
+    for (i = 0; i < card->channels; i++)
+        uart_emu_disconnect(card, i);
+
+    for (p = &cards; *p; p = &(*p)->next) {
+        if (*p == card) {
+            *p = card->next;
+            break;
+        }
+    }
+
+    free(card->base);
+    free(card);
+}
+
+unsigned char *uart_emu_channel(struct uart_emu_card *card, unsigned channel)
+{
+    return card->base + card->stride * channel;
+}
+
+unsigned char uart_emu_read_uchar(unsigned char *address)
+{
+    unsigned long offset;
+    struct channel *ch = find_register(address, &offset);
+    unsigned char value;
+
+    if (!ch)
+        return 0xff;
+
+    ch->stats.reads++;
+
+    if (ch->card->family == UART_EMU_16C950)
+        value = read_950(ch, offset);
+    else
+        value = read_exar(ch, offset);
+
+    update_interrupts();
+
+    return value;
+}
+
+void uart_emu_write_uchar(unsigned char *address, unsigned char value)
+{
+    unsigned long offset;
+    struct channel *ch = find_register(address, &offset);
+
+    if (!ch)
+        return;
+
+    ch->stats.writes++;
+
+    if (ch->card->family == UART_EMU_16C950)
+        write_950(ch, offset, value);
+    else
+        write_exar(ch, offset, value);
+
+    update_interrupts();
+}
+
+void uart_emu_write_uchars(unsigned char *address, unsigned char *values, unsigned long count)
+{
+    unsigned long i;
+
+    for (i = 0; i < count; i++)
+        uart_emu_write_uchar(address, values[i]);
+}
+
+void uart_emu_set_clock(struct uart_emu_card *card, unsigned long hz)
+{
+    card->clock = hz;
+}
+
+unsigned long uart_emu_get_clock(const struct uart_emu_card *card)
+{
+    return card->clock;
+}
+
+void uart_emu_set_baud(struct uart_emu_card *card, unsigned channel, unsigned long baud)
+{
+    card->channel[channel].baud = baud;
+}
+
+double uart_emu_get_baud(const struct uart_emu_card *card, unsigned channel)
+{
+    return channel_baud(&card->channel[channel]);
+}
+
+void uart_emu_connect(struct uart_emu_card *a, unsigned channel_a,
+                      struct uart_emu_card *b, unsigned channel_b)
+{
+    struct channel *x = &a->channel[channel_a];
+    struct channel *y = &b->channel[channel_b];
+
+    uart_emu_disconnect(a, channel_a);
+    uart_emu_disconnect(b, channel_b);
+
+    x->peer = y;
+    y->peer = x;
+
+    refresh_line(x);
+    update_interrupts();
+}
+
+void uart_emu_disconnect(struct uart_emu_card *card, unsigned channel)
+{
+    struct channel *ch = &card->channel[channel];
+    struct channel *peer = ch->peer;
+
+    if (!peer)
+        return;
+
+    ch->peer = NULL;
+    peer->peer = NULL;
+
+    refresh_inputs(ch);
+    refresh_inputs(peer);
+    update_interrupts();
+}
+
+unsigned long uart_emu_send(struct uart_emu_card *card, unsigned channel,
+                            const unsigned char *data, unsigned long count)
+{
+    struct channel *ch = &card->channel[channel];
+    unsigned long i;
+
+    if (ch->in.count == 0)
+        ch->in_last = now;
+
+    for (i = 0; i < count && ch->in.count < EXTERNAL_MAX; i++)
+        bytes_push(&ch->in, data[i]);
+
+    return i;
+}
+
+unsigned long uart_emu_receive(struct uart_emu_card *card, unsigned channel,
+                               unsigned char *data, unsigned long count)
+{
+    struct channel *ch = &card->channel[channel];
+    unsigned long i;
+
+    for (i = 0; i < count && ch->out.count; i++)
+        data[i] = bytes_pop(&ch->out);
+
+    return i;
+}
+
+void uart_emu_set_modem_inputs(struct uart_emu_card *card, unsigned channel, unsigned char msr)
+{
+    struct channel *ch = &card->channel[channel];
+
+    ch->inputs = msr & 0xf0;
+    refresh_inputs(ch);
+    update_interrupts();
+}
+
+void uart_emu_set_mpio_inputs(struct uart_emu_card *card, unsigned inputs)
+{
+    card->mpio_inputs = inputs;
+}
+
+void uart_emu_set_interrupt(struct uart_emu_card *card, uart_emu_interrupt callback, void *context)
+{
+    card->callback = callback;
+    card->context = context;
+}
+
+int uart_emu_interrupt_pending(const struct uart_emu_card *card, unsigned channel)
+{
+    return interrupt_pending(&card->channel[channel]);
+}
+
+void uart_emu_get_stats(const struct uart_emu_card *card, unsigned channel, struct uart_emu_stats *stats)
+{
+    *stats = card->channel[channel].stats;
+}
+
+void uart_emu_clear_stats(struct uart_emu_card *card, unsigned channel)
+{
+    memset(&card->channel[channel].stats, 0, sizeof(card->channel[channel].stats));
+}
@@ -0,0 +1,140 @@
+/*
+    Emulates the UARTs on the cards the driver supports so the driver's
+    register code can run without a card:
+
+        UART_EMU_16C950     FSCC, 128 byte FIFOs, 8 registers a channel
+        UART_EMU_XR17D15X   Async-335, 64 byte FIFOs, 0x200 a channel
+        UART_EMU_XR17V35X   Async-PCIe, 256 byte FIFOs, 0x400 a channel
+
+    A card is a block of made up register addresses laid out like the real
+    card. Set Controller to uart_emu_channel() and SerialReadUChar,
+    SerialWriteUChar and SerialWriteUChars to uart_emu_read_uchar,
+    uart_emu_write_uchar and uart_emu_write_uchars and the driver's
+    register macros work unchanged. Reads from an address that isn't on a
+    card return 0xff, like a card that has gone away.
+
+    The line runs on an emulated clock that only moves when
+    uart_emu_advance is called, so a run always gives the same result.
+    Characters take as long as the clock, sample rate, divisor and line
+    control say. Two channels can be wired together like a null modem
+    cable, and a channel that isn't wired to anything can be fed from and
+    drained to a buffer.
+
+    What is emulated:
+    - Transmit and receive FIFOs with the 16550, 650 (950) and Exar
+      programmable trigger levels, TFL/RFL on the 950 and TXCNT/RXCNT on
+      the Exar parts.
+    - IIR causes in 16550 priority order, the character timeout, and LSR
+      error bits that travel with the character they belong to.
+    - The 950's 650 registers behind LCR 0xbf and its indexed registers
+      behind SPR/ICR, including ACR, TCR, TTL, RTL, NMR and 9-bit mode.
+    - The Exar FCTR, EFR, TXTRG/RXTRG, DLD, 8XMODE, 4XMODE, INT0, RESET,
+      the FIFO burst window at 0x100 and the MPIO registers. MPIOLVL
+      writes on the 335 are decoded like the ICS307 would take them, so
+      programming the clock through the driver changes the line rate.
+    - Modem lines, internal loopback, break and auto RTS/CTS.
+
+    The FSCC's own registers in Bar0 and Bar2 aren't reached through the
+    function pointers and aren't emulated. Set the FSCC clock with
+    uart_emu_set_clock instead. Nothing here is thread safe, callers
+    serialize access to all cards.
+
+        cc -O2 -c uart-emu.c
+*/
+
+#ifndef UART_EMU_H
+#define UART_EMU_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum uart_emu_family {
+    UART_EMU_16C950,
+    UART_EMU_XR17D15X,
+    UART_EMU_XR17V35X
+};
+
+#define UART_EMU_MAX_CHANNELS 8
+
+struct uart_emu_card;
+
+struct uart_emu_stats {
+    unsigned long long reads;       /* register reads */
+    unsigned long long writes;      /* register writes, each byte of a buffered write */
+    unsigned long long tx_chars;    /* characters that left the transmitter */
+    unsigned long long rx_chars;    /* characters put in the receive FIFO */
+    unsigned long long overruns;    /* characters lost to a full receive FIFO */
+    unsigned long long tx_dropped;  /* writes to a full transmit FIFO */
+    unsigned long long interrupts;  /* times the interrupt line went active */
+};
+
+/* Called when a channel's interrupt line goes from idle to active. It can
+   be called from inside any of the functions below, including a register
+   access, so it shouldn't touch the card itself. */
+typedef void (*uart_emu_interrupt)(void *context, struct uart_emu_card *card, unsigned channel);
+
+/* NULL if the channel count is out of range or memory runs out. */
+struct uart_emu_card *uart_emu_create(enum uart_emu_family family, unsigned channels);
+void uart_emu_destroy(struct uart_emu_card *card);
+
+/* The register address of a channel, what the driver keeps in Controller. */
+unsigned char *uart_emu_channel(struct uart_emu_card *card, unsigned channel);
+
+/* The same signatures as PREAD_PORT_UCHAR, PWRITE_PORT_UCHAR and
+   PWRITE_PORT_UCHARS. A buffered write writes each byte to the one
+   register, like WRITE_REGISTER_BUFFER_UCHAR. */
+unsigned char uart_emu_read_uchar(unsigned char *address);
+void uart_emu_write_uchar(unsigned char *address, unsigned char value);
+void uart_emu_write_uchars(unsigned char *address, unsigned char *values, unsigned long count);
+
+/* The UART input clock. It starts at 18.432 MHz, or 125 MHz on the
+   XR17V35X. */
+void uart_emu_set_clock(struct uart_emu_card *card, unsigned long hz);
+unsigned long uart_emu_get_clock(const struct uart_emu_card *card);
+
+/* Runs a channel at a fixed baud rate whatever its divisor, 0 to go back
+   to the registers. */
+void uart_emu_set_baud(struct uart_emu_card *card, unsigned channel, unsigned long baud);
+
+/* The baud rate the channel is running at, 0 if its divisor is 0. */
+double uart_emu_get_baud(const struct uart_emu_card *card, unsigned channel);
+
+/* Wires TX to RX, RTS to CTS and DTR to DSR and DCD both ways. Either
+   channel is taken off anything it was wired to first. */
+void uart_emu_connect(struct uart_emu_card *a, unsigned channel_a,
+                      struct uart_emu_card *b, unsigned channel_b);
+void uart_emu_disconnect(struct uart_emu_card *card, unsigned channel);
+
+/* For a channel that isn't wired to another one. send queues characters
+   to arrive one character time apart and returns how many fit. receive
+   takes characters the channel has transmitted and returns how many there
+   were. modem_inputs sets CTS, DSR, RI and DCD the way they appear in the
+   top four bits of MSR. */
+unsigned long uart_emu_send(struct uart_emu_card *card, unsigned channel,
+                            const unsigned char *data, unsigned long count);
+unsigned long uart_emu_receive(struct uart_emu_card *card, unsigned channel,
+                               unsigned char *data, unsigned long count);
+void uart_emu_set_modem_inputs(struct uart_emu_card *card, unsigned channel, unsigned char msr);
+
+/* MPIO pins configured as inputs, one bit a pin. */
+void uart_emu_set_mpio_inputs(struct uart_emu_card *card, unsigned inputs);
+
+void uart_emu_set_interrupt(struct uart_emu_card *card, uart_emu_interrupt callback, void *context);
+int uart_emu_interrupt_pending(const struct uart_emu_card *card, unsigned channel);
+
+/* Emulated time in nanoseconds, shared by every card. advance moves it on
+   and runs everything that happens in between. next_event is how long
+   until the line does something by itself, ~0ULL if nothing will. */
+unsigned long long uart_emu_now(void);
+void uart_emu_advance(unsigned long long ns);
+unsigned long long uart_emu_next_event(void);
+
+void uart_emu_get_stats(const struct uart_emu_card *card, unsigned channel, struct uart_emu_stats *stats);
+void uart_emu_clear_stats(struct uart_emu_card *card, unsigned channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,4006 @@
+/*
+    The KMDF objects and kernel routines the driver uses, for running it
+    as a user mode program. wdf-shim.h says how it behaves as a whole,
+    this file is the details.
+
+    Everything the framework keeps about queues, requests, DPCs and timers
+    is guarded by one lock, shim_lock. It is never held while the driver
+    is called, so the driver can call back in from anywhere. Lock order is
+    device lock, then interrupt lock, then shim_lock, then the bus lock.
+*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+#include <wctype.h>
+
+#include "wdf-shim.h"
+#include "include/ntstrsafe.h"
+
+#define SHIM_MAX_WINDOWS 32
+#define SHIM_MAX_INTERRUPTS 64
+#define SHIM_MAX_SLEEP_NS 1000000ULL
+#define SHIM_NAME_LENGTH 64
+#define SHIM_STRING_LENGTH 128
+#define SHIM_IRP_MJ_COUNT (IRP_MJ_PNP + 1)
+#define SHIM_DIRQL 8
+#define SHIM_CONFIG_SPACE 0x40
+
+/* Time */
+static ULONGLONG shim_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ULONGLONG)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void shim_timespec(struct timespec *ts, ULONGLONG ns)
+{
+    ts->tv_sec = ns / 1000000000ULL;
+    ts->tv_nsec = ns % 1000000000ULL;
+}
+
+/* A kernel due time, negative for relative and positive for absolute
+   system time, both in 100 ns units, as a monotonic time in ns */
+static ULONGLONG shim_due(LONGLONG due)
+{
+    LARGE_INTEGER system;
+    ULONGLONG now = shim_now();
+
+    if (due < 0)
+        return now + (ULONGLONG)-due * 100;
+
+    KeQuerySystemTime(&system);
+
+    if (due <= system.QuadPart)
+        return now;
+
+    return now + (ULONGLONG)(due - system.QuadPart) * 100;
+}
+
+static void shim_cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void shim_recursive_init(pthread_mutex_t *mutex)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+/* Objects */
+typedef enum _SHIM_OBJECT_TYPE {
+    ShimDriver = 1,
+    ShimDevice,
+    ShimQueue,
+    ShimRequest,
+    ShimFile,
+    ShimDpc,
+    ShimTimer,
+    ShimInterrupt,
+    ShimWaitLock,
+    ShimSpinLock,
+    ShimKey,
+    ShimString,
+    ShimResourceList,
+    ShimWmiInstance
+} SHIM_OBJECT_TYPE;
+
+struct shim_context {
+    struct shim_context *next;
+    PCWDF_OBJECT_CONTEXT_TYPE_INFO type;
+    PFN_WDF_OBJECT_CONTEXT_CLEANUP cleanup;
+    PFN_WDF_OBJECT_CONTEXT_DESTROY destroy;
+    max_align_t data[];
+};
+
+struct WDF_SHIM_OBJECT {
+    SHIM_OBJECT_TYPE type;
+    struct WDF_SHIM_OBJECT *parent;
+    struct shim_device *device;
+    struct shim_context *contexts;
+    LIST_ENTRY children;
+    LIST_ENTRY sibling;
+};
+
+/* A DPC, a timer that went off or an interrupt's DPC waiting for the DPC
+   thread */
+struct shim_deferred {
+    LIST_ENTRY entry;
+    BOOLEAN queued;
+    BOOLEAN running;
+    void (*run)(struct shim_deferred *deferred);
+    ULONGLONG queued_at;
+    WDF_SHIM_DPC_STATS stats;
+};
+
+struct shim_registry_value {
+    WCHAR name[SHIM_NAME_LENGTH];
+    ULONG type;
+    ULONG value;
+    WCHAR string[SHIM_STRING_LENGTH];
+};
+
+struct shim_registry {
+    struct shim_registry_value *values;
+    ULONG count;
+};
+
+struct shim_driver {
+    struct WDF_SHIM_OBJECT header;
+    WDF_DRIVER_CONFIG config;
+    DRIVER_OBJECT driver_object;
+};
+
+struct shim_resource_list {
+    struct WDF_SHIM_OBJECT header;
+    ULONG count;
+    PCM_PARTIAL_RESOURCE_DESCRIPTOR descriptors;
+};
+
+struct WDFDEVICE_INIT {
+    const WDF_SHIM_DEVICE_CONFIG *config;
+    struct shim_registry registry;
+    WCHAR name[SHIM_NAME_LENGTH];
+    WDF_OBJECT_ATTRIBUTES request_attributes;
+    WDF_PNPPOWER_EVENT_CALLBACKS pnp;
+    WDF_FILEOBJECT_CONFIG file_config;
+    WDF_OBJECT_ATTRIBUTES file_attributes;
+    PFN_WDFDEVICE_WDM_IRP_PREPROCESS preprocess[SHIM_IRP_MJ_COUNT];
+    struct shim_device *device;
+};
+
+struct shim_device {
+    struct WDF_SHIM_OBJECT header;
+    pthread_mutex_t lock;
+    BOOLEAN serialized;
+    BOOLEAN started;
+    DEVICE_OBJECT device_object;
+    WDF_SHIM_DEVICE_CONFIG config;
+    struct shim_registry registry;
+    WCHAR name[SHIM_NAME_LENGTH];
+    WDF_OBJECT_ATTRIBUTES request_attributes;
+    WDF_PNPPOWER_EVENT_CALLBACKS pnp;
+    WDF_FILEOBJECT_CONFIG file_config;
+    WDF_OBJECT_ATTRIBUTES file_attributes;
+    PFN_WDFDEVICE_WDM_IRP_PREPROCESS preprocess[SHIM_IRP_MJ_COUNT];
+    struct shim_queue *default_queue;
+    struct shim_interrupt *interrupt;
+    struct WDF_SHIM_OBJECT *file;
+    struct shim_resource_list resources;
+    LIST_ENTRY entry;
+};
+
+struct shim_queue {
+    struct WDF_SHIM_OBJECT header;
+    WDF_IO_QUEUE_CONFIG config;
+    BOOLEAN serialized;
+    BOOLEAN accepting;
+    BOOLEAN dispatching;
+    BOOLEAN busy;               /* a sequential queue has a request out */
+    LIST_ENTRY requests;
+    ULONG queued;
+    ULONG driver_owned;
+};
+
+struct shim_request {
+    struct WDF_SHIM_OBJECT header;
+    WDF_REQUEST_PARAMETERS parameters;
+    PVOID input;
+    size_t input_length;
+    PVOID output;
+    size_t output_length;
+    PVOID system_buffer;        /* METHOD_BUFFERED, copied out on completion */
+    PVOID user_output;
+    ULONG_PTR information;
+    NTSTATUS status;
+    struct shim_queue *queue;   /* the queue it is waiting on */
+    struct shim_queue *owner;   /* the queue that gave it to the driver */
+    struct shim_queue *last_queue;
+    LIST_ENTRY entry;
+    PFN_WDF_REQUEST_CANCEL cancel;
+    WDF_SHIM_REQUEST_COMPLETION *completion;
+    PVOID completion_context;
+    IRP irp;
+    IO_STACK_LOCATION stack;
+};
+
+/* An IRP the shim built, for a preprocess callback or the bus */
+struct shim_irp {
+    IRP irp;
+    IO_STACK_LOCATION stack;
+    WDF_SHIM_REQUEST_COMPLETION *completion;
+    PVOID completion_context;
+};
+
+struct shim_dpc {
+    struct WDF_SHIM_OBJECT header;
+    WDF_DPC_CONFIG config;
+    BOOLEAN serialized;
+    struct shim_deferred deferred;
+};
+
+struct shim_timer {
+    struct WDF_SHIM_OBJECT header;
+    WDF_TIMER_CONFIG config;
+    BOOLEAN serialized;
+    BOOLEAN armed;
+    ULONGLONG due;
+    LIST_ENTRY timer_entry;
+    struct shim_deferred deferred;
+};
+
+struct shim_interrupt {
+    struct WDF_SHIM_OBJECT header;
+    WDF_INTERRUPT_CONFIG config;
+    pthread_mutex_t lock;
+    BOOLEAN serialized;
+    BOOLEAN enabled;
+    BOOLEAN connected;
+    LIST_ENTRY entry;
+    struct shim_deferred dpc;
+    WDF_SHIM_INTERRUPT_STATS stats;
+};
+
+struct shim_lock_object {
+    struct WDF_SHIM_OBJECT header;
+    pthread_mutex_t mutex;
+};
+
+struct shim_key {
+    struct WDF_SHIM_OBJECT header;
+    struct shim_registry *registry;
+};
+
+struct shim_string {
+    struct WDF_SHIM_OBJECT header;
+    UNICODE_STRING string;
+    WCHAR buffer[SHIM_STRING_LENGTH];
+};
+
+struct shim_wmi_instance {
+    struct WDF_SHIM_OBJECT header;
+    WDF_WMI_INSTANCE_CONFIG config;
+};
+
+struct shim_window {
+    BOOLEAN memory;
+    ULONGLONG base;
+    ULONG length;
+    PUCHAR address;
+    WDF_SHIM_BUS_HANDLERS handlers;
+    PVOID context;
+    PULONG registers;
+};
+
+static pthread_mutex_t shim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t shim_dpc_cond;        /* something for the DPC thread */
+static pthread_cond_t shim_done_cond;       /* a deferred finished running */
+static pthread_cond_t shim_idle_cond;       /* a queue ran out of driver owned requests */
+static pthread_cond_t shim_pass_cond;       /* the interrupt thread went round */
+static pthread_cond_t shim_event_cond;      /* a KEVENT was set */
+static LIST_ENTRY shim_dpcs;
+static LIST_ENTRY shim_timers;
+static LIST_ENTRY shim_interrupts;
+static LIST_ENTRY shim_devices;
+static ULONGLONG shim_passes;
+static BOOLEAN shim_stopping;
+static ULONGLONG shim_timer_resolution;
+static BOOLEAN shim_threads;
+static pthread_t shim_dpc_thread;
+static pthread_t shim_isr_thread;
+static struct shim_driver *shim_driver;
+static struct shim_registry shim_parameters;
+static BOOLEAN shim_debug;
+
+static pthread_mutex_t shim_bus_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct shim_window shim_windows[SHIM_MAX_WINDOWS];
+static ULONG shim_window_count;
+static WDF_SHIM_HARDWARE shim_hardware;
+
+static pthread_mutex_t shim_line_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t shim_line_cond;
+static int shim_line_wake;
+static int shim_line_sleeping;
+
+static __thread KIRQL shim_irql;
+static __thread BOOLEAN shim_on_dpc_thread;
+static __thread BOOLEAN shim_on_isr_thread;
+
+static CONFIGURATION_INFORMATION shim_configuration;
+static PUCHAR shim_kd_com_port;
+PUCHAR *KdComPortInUse = &shim_kd_com_port;
+
+__attribute__((constructor)) static void shim_init(void)
+{
+    shim_cond_init(&shim_dpc_cond);
+    shim_cond_init(&shim_done_cond);
+    shim_cond_init(&shim_idle_cond);
+    shim_cond_init(&shim_pass_cond);
+    shim_cond_init(&shim_event_cond);
+    shim_cond_init(&shim_line_cond);
+    InitializeListHead(&shim_dpcs);
+    InitializeListHead(&shim_timers);
+    InitializeListHead(&shim_interrupts);
+    InitializeListHead(&shim_devices);
+    shim_debug = getenv("WDF_SHIM_DEBUG") != NULL;
+}
+
+static NTSTATUS shim_context_add(WDFOBJECT object, PWDF_OBJECT_ATTRIBUTES attributes, PVOID *data)
+{
+    struct shim_context *context;
+    size_t size = 0;
+
+    if (data)
+        *data = NULL;
+
+    if (!attributes || (!attributes->ContextTypeInfo && !attributes->EvtCleanupCallback &&
+                        !attributes->EvtDestroyCallback))
+        return STATUS_SUCCESS;
+
+    if (attributes->ContextTypeInfo)
+        size = attributes->ContextSizeOverride ? attributes->ContextSizeOverride
+                                               : attributes->ContextTypeInfo->ContextSize;
+
+    context = calloc(1, sizeof(*context) + size);
+    if (!context)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    context->type = attributes->ContextTypeInfo;
+    context->cleanup = attributes->EvtCleanupCallback;
+    context->destroy = attributes->EvtDestroyCallback;
+    context->next = object->contexts;
+    object->contexts = context;
+
+    if (data)
+        *data = context->data;
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS shim_object_init(WDFOBJECT object, SHIM_OBJECT_TYPE type, struct shim_device *device,
+                                 WDFOBJECT parent, PWDF_OBJECT_ATTRIBUTES attributes)
+{
+    NTSTATUS status;
+
+    object->type = type;
+    object->device = device;
+    object->parent = parent;
+    InitializeListHead(&object->children);
+    InitializeListHead(&object->sibling);
+
+    status = shim_context_add(object, attributes, NULL);
+    if (!NT_SUCCESS(status))
+        return status;
+
+    if (parent) {
+        pthread_mutex_lock(&shim_lock);
+        InsertTailList(&parent->children, &object->sibling);
+        pthread_mutex_unlock(&shim_lock);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static void shim_object_free(WDFOBJECT object);
+
+PVOID WdfObjectGetTypedContextWorker(WDFOBJECT Handle, PCWDF_OBJECT_CONTEXT_TYPE_INFO TypeInfo)
+{
+    struct shim_context *context;
+
+    for (context = Handle->contexts; context; context = context->next) {
+        if (context->type == TypeInfo ||
+            (context->type && !strcmp(context->type->ContextName, TypeInfo->ContextName)))
+            return context->data;
+    }
+
+    return NULL;
+}
+
+NTSTATUS WdfObjectAllocateContext(WDFOBJECT Handle, PWDF_OBJECT_ATTRIBUTES ContextAttributes,
+                                  PVOID *Context)
+{
+    if (!ContextAttributes->ContextTypeInfo)
+        return STATUS_INVALID_PARAMETER;
+
+    if (WdfObjectGetTypedContextWorker(Handle, ContextAttributes->ContextTypeInfo))
+        return STATUS_OBJECT_NAME_COLLISION;
+
+    return shim_context_add(Handle, ContextAttributes, Context);
+}
+
+VOID WdfObjectDelete(WDFOBJECT Object)
+{
+    if (Object)
+        shim_object_free(Object);
+}
+
+static pthread_mutex_t *shim_object_lock(WDFOBJECT object)
+{
+    if (object->type == ShimInterrupt)
+        return &((struct shim_interrupt *)object)->lock;
+
+    if (object->type == ShimWaitLock || object->type == ShimSpinLock)
+        return &((struct shim_lock_object *)object)->mutex;
+
+    return object->device ? &object->device->lock : NULL;
+}
+
+VOID WdfObjectAcquireLock(WDFOBJECT Object)
+{
+    pthread_mutex_t *lock = shim_object_lock(Object);
+
+    if (lock)
+        pthread_mutex_lock(lock);
+}
+
+VOID WdfObjectReleaseLock(WDFOBJECT Object)
+{
+    pthread_mutex_t *lock = shim_object_lock(Object);
+
+    if (lock)
+        pthread_mutex_unlock(lock);
+}
+
+/* Deferred work and the DPC thread */
+static BOOLEAN shim_defer(struct shim_deferred *deferred)
+{
+    if (deferred->queued)
+        return FALSE;
+
+    deferred->queued = TRUE;
+    deferred->queued_at = shim_now();
+    InsertTailList(&shim_dpcs, &deferred->entry);
+    pthread_cond_signal(&shim_dpc_cond);
+
+    return TRUE;
+}
+
+/* Takes a deferred off the DPC list. Waiting while on the DPC thread
+   would wait on ourselves, so it doesn't wait there. */
+static BOOLEAN shim_defer_cancel(struct shim_deferred *deferred, BOOLEAN wait)
+{
+    BOOLEAN removed;
+
+    pthread_mutex_lock(&shim_lock);
+
+    removed = deferred->queued;
+
+    if (deferred->queued) {
+        RemoveEntryList(&deferred->entry);
+        deferred->queued = FALSE;
+    }
+
+    while (wait && !shim_on_dpc_thread && deferred->running)
+        pthread_cond_wait(&shim_done_cond, &shim_lock);
+
+    pthread_mutex_unlock(&shim_lock);
+
+    return removed;
+}
+
+static void shim_timer_insert(struct shim_timer *timer)
+{
+    PLIST_ENTRY entry;
+
+    for (entry = shim_timers.Flink; entry != &shim_timers; entry = entry->Flink) {
+        if (CONTAINING_RECORD(entry, struct shim_timer, timer_entry)->due > timer->due)
+            break;
+    }
+
+    InsertTailList(entry, &timer->timer_entry);
+    timer->armed = TRUE;
+
+    pthread_cond_signal(&shim_dpc_cond);
+}
+
+/* Moves the timers that are due to the DPC list, returns when the next
+   one is due */
+static ULONGLONG shim_timers_expire(ULONGLONG now)
+{
+    while (!IsListEmpty(&shim_timers)) {
+        struct shim_timer *timer = CONTAINING_RECORD(shim_timers.Flink, struct shim_timer, timer_entry);
+        ULONGLONG due = timer->due;
+
+        if (due > now)
+            return due;
+
+        RemoveEntryList(&timer->timer_entry);
+        timer->armed = FALSE;
+
+        if (timer->config.Period) {
+            timer->due += (ULONGLONG)timer->config.Period * 1000000;
+
+            if (timer->due <= now)
+                timer->due = now + (ULONGLONG)timer->config.Period * 1000000;
+
+            shim_timer_insert(timer);
+        }
+
+        /* Late is counted from when it was due, not from when we looked */
+        if (shim_defer(&timer->deferred))
+            timer->deferred.queued_at = due;
+    }
+
+    return ~0ULL;
+}
+
+static void *shim_dpc_main(void *unused)
+{
+    UNREFERENCED_PARAMETER(unused);
+
+    shim_on_dpc_thread = TRUE;
+
+    pthread_mutex_lock(&shim_lock);
+
+    for (;;) {
+        ULONGLONG next = shim_timers_expire(shim_now());
+        struct timespec ts;
+
+        if (!IsListEmpty(&shim_dpcs)) {
+            struct shim_deferred *deferred = CONTAINING_RECORD(RemoveHeadList(&shim_dpcs),
+                                                               struct shim_deferred, entry);
+            ULONGLONG start = shim_now(), wait = start - deferred->queued_at, run;
+
+            deferred->queued = FALSE;
+            deferred->running = TRUE;
+            pthread_mutex_unlock(&shim_lock);
+
+            shim_irql = DISPATCH_LEVEL;
+            deferred->run(deferred);
+            shim_irql = PASSIVE_LEVEL;
+
+            run = shim_now() - start;
+
+            pthread_mutex_lock(&shim_lock);
+            deferred->stats.Runs++;
+            deferred->stats.WaitNs += wait;
+            deferred->stats.RunNs += run;
+            if (wait > deferred->stats.MaxWaitNs)
+                deferred->stats.MaxWaitNs = wait;
+            if (run > deferred->stats.MaxRunNs)
+                deferred->stats.MaxRunNs = run;
+            deferred->running = FALSE;
+            pthread_cond_broadcast(&shim_done_cond);
+            continue;
+        }
+
+        if (shim_stopping)
+            break;
+
+        if (next == ~0ULL) {
+            pthread_cond_wait(&shim_dpc_cond, &shim_lock);
+        }
+        else {
+            shim_timespec(&ts, next);
+            pthread_cond_timedwait(&shim_dpc_cond, &shim_lock, &ts);
+        }
+    }
+
+    pthread_mutex_unlock(&shim_lock);
+
+    return NULL;
+}
+
+/* The bus */
+static struct shim_window *shim_port_window(ULONG port)
+{
+    ULONG i;
+
+    for (i = 0; i < shim_window_count; i++) {
+        struct shim_window *window = &shim_windows[i];
+
+        if (!window->memory && port - (ULONG)window->base < window->length)
+            return window;
+    }
+
+    return NULL;
+}
+
+static struct shim_window *shim_memory_window(const volatile UCHAR *address)
+{
+    ULONG i;
+
+    for (i = 0; i < shim_window_count; i++) {
+        struct shim_window *window = &shim_windows[i];
+
+        if (window->memory && (ULONG_PTR)(address - window->address) < window->length)
+            return window;
+    }
+
+    return NULL;
+}
+
+static NTSTATUS shim_window_add(BOOLEAN memory, ULONGLONG base, ULONG length, PVOID address,
+                                const WDF_SHIM_BUS_HANDLERS *handlers, PVOID context)
+{
+    struct shim_window *window;
+    NTSTATUS status = STATUS_SUCCESS;
+
+    pthread_mutex_lock(&shim_bus_lock);
+
+    if (shim_window_count == SHIM_MAX_WINDOWS) {
+        status = STATUS_INSUFFICIENT_RESOURCES;
+        goto done;
+    }
+
+    window = &shim_windows[shim_window_count];
+    RtlZeroMemory(window, sizeof(*window));
+
+    if (!handlers || !handlers->ReadULong) {
+        window->registers = calloc(1, length + sizeof(ULONG));
+        if (!window->registers) {
+            status = STATUS_INSUFFICIENT_RESOURCES;
+            goto done;
+        }
+    }
+
+    window->memory = memory;
+    window->base = base;
+    window->length = length;
+    window->address = address;
+    window->context = context;
+    if (handlers)
+        window->handlers = *handlers;
+
+    shim_window_count++;
+
+done:
+    pthread_mutex_unlock(&shim_bus_lock);
+
+    return status;
+}
+
+NTSTATUS WdfShimBusAddPorts(ULONG Base, ULONG Length, const WDF_SHIM_BUS_HANDLERS *Handlers,
+                            PVOID Context)
+{
+    return shim_window_add(FALSE, Base, Length, NULL, Handlers, Context);
+}
+
+NTSTATUS WdfShimBusAddMemory(ULONGLONG Base, ULONG Length, PVOID Address,
+                             const WDF_SHIM_BUS_HANDLERS *Handlers, PVOID Context)
+{
+    return shim_window_add(TRUE, Base, Length, Address, Handlers, Context);
+}
+
+VOID WdfShimBusRemove(PVOID Context)
+{
+    ULONG i = 0;
+
+    pthread_mutex_lock(&shim_bus_lock);
+
+    while (i < shim_window_count) {
+        if (shim_windows[i].context == Context) {
+            free(shim_windows[i].registers);
+            shim_windows[i] = shim_windows[--shim_window_count];
+        }
+        else {
+            i++;
+        }
+    }
+
+    pthread_mutex_unlock(&shim_bus_lock);
+}
+
+VOID WdfShimBusSetHardware(const WDF_SHIM_HARDWARE *Hardware)
+{
+    pthread_mutex_lock(&shim_bus_lock);
+
+    if (Hardware)
+        shim_hardware = *Hardware;
+    else
+        RtlZeroMemory(&shim_hardware, sizeof(shim_hardware));
+
+    pthread_mutex_unlock(&shim_bus_lock);
+
+    WdfShimBusWake();
+}
+
+VOID WdfShimBusWake(void)
+{
+    if (__atomic_exchange_n(&shim_line_wake, 1, __ATOMIC_SEQ_CST))
+        return;
+
+    if (__atomic_load_n(&shim_line_sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&shim_line_lock);
+        pthread_cond_signal(&shim_line_cond);
+        pthread_mutex_unlock(&shim_line_lock);
+    }
+}
+
+VOID WdfShimBusLock(void)
+{
+    pthread_mutex_lock(&shim_bus_lock);
+}
+
+VOID WdfShimBusUnlock(void)
+{
+    pthread_mutex_unlock(&shim_bus_lock);
+}
+
+/* An access from outside the interrupt thread may have changed when the
+   hardware next needs to run */
+static void shim_bus_touched(void)
+{
+    if (!shim_on_isr_thread && !__atomic_load_n(&shim_line_wake, __ATOMIC_RELAXED))
+        WdfShimBusWake();
+}
+
+static UCHAR shim_read_uchar(struct shim_window *window, ULONG offset)
+{
+    if (!window || !window->handlers.ReadUChar)
+        return 0xff;
+
+    return window->handlers.ReadUChar(window->context, offset);
+}
+
+static void shim_write_uchar(struct shim_window *window, ULONG offset, UCHAR value)
+{
+    if (window && window->handlers.WriteUChar)
+        window->handlers.WriteUChar(window->context, offset, value);
+}
+
+static ULONG shim_read_ulong(struct shim_window *window, ULONG offset)
+{
+    if (!window)
+        return 0xffffffff;
+
+    if (window->handlers.ReadULong)
+        return window->handlers.ReadULong(window->context, offset);
+
+    return window->registers[offset / sizeof(ULONG)];
+}
+
+static void shim_write_ulong(struct shim_window *window, ULONG offset, ULONG value)
+{
+    if (!window)
+        return;
+
+    if (window->handlers.WriteULong)
+        window->handlers.WriteULong(window->context, offset, value);
+    else if (!window->handlers.ReadULong)
+        window->registers[offset / sizeof(ULONG)] = value;
+}
+
+UCHAR READ_PORT_UCHAR(PUCHAR Port)
+{
+    struct shim_window *window;
+    UCHAR value;
+
+    pthread_mutex_lock(&shim_bus_lock);
+    window = shim_port_window(PtrToUlong(Port));
+    value = shim_read_uchar(window, window ? PtrToUlong(Port) - (ULONG)window->base : 0);
+    pthread_mutex_unlock(&shim_bus_lock);
+
+    shim_bus_touched();
+
+    return value;
+}
+
+VOID WRITE_PORT_UCHAR(PUCHAR Port, UCHAR Value)
+{
+    WRITE_PORT_BUFFER_UCHAR(Port, &Value, 1);
+}
+
+VOID WRITE_PORT_BUFFER_UCHAR(PUCHAR Port, PUCHAR Buffer, ULONG Count)
+{
+    struct shim_window *window;
+    ULONG i;
+
+    pthread_mutex_lock(&shim_bus_lock);
+    window = shim_port_window(PtrToUlong(Port));
+    for (i = 0; i < Count; i++)
+        shim_write_uchar(window, window ? PtrToUlong(Port) - (ULONG)window->base : 0, Buffer[i]);
+    pthread_mutex_unlock(&shim_bus_lock);
+
+    shim_bus_touched();
+}
+
+UCHAR READ_REGISTER_UCHAR(volatile UCHAR *Register)
+{
+    struct shim_window *window;
+    UCHAR value;
+
+    pthread_mutex_lock(&shim_bus_lock);
+    window = shim_memory_window(Register);
+    value = shim_read_uchar(window, window ? (ULONG)(Register - window->address) : 0);
+    pthread_mutex_unlock(&shim_bus_lock);
+
+    shim_bus_touched();
+
+    return value;
+}
+
+VOID WRITE_REGISTER_UCHAR(volatile UCHAR *Register, UCHAR Value)
+{
+    WRITE_REGISTER_BUFFER_UCHAR(Register, &Value, 1);
+}
+
+VOID WRITE_REGISTER_BUFFER_UCHAR(volatile UCHAR *Register, PUCHAR Buffer, ULONG Count)
+{
+    struct shim_window *window;
+    ULONG i;
+
+    pthread_mutex_lock(&shim_bus_lock);
+    window = shim_memory_window(Register);
+    for (i = 0; i < Count; i++)
+        shim_write_uchar(window, window ? (ULONG)(Register - window->address) : 0, Buffer[i]);
+    pthread_mutex_unlock(&shim_bus_lock);
+
+    shim_bus_touched();
+}
+
+ULONG READ_PORT_ULONG(PULONG Port)
+{
+    struct shim_window *window;
+    ULONG value;
+
+    pthread_mutex_lock(&shim_bus_lock);
+    window = shim_port_window(PtrToUlong(Port));
+    value = shim_read_ulong(window, window ? PtrToUlong(Port) - (ULONG)window->base : 0);
+    pthread_mutex_unlock(&shim_bus_lock);
+
+    shim_bus_touched();
+
+    return value;
+}
+
+VOID WRITE_PORT_ULONG(PULONG Port, ULONG Value)
+{
+    WRITE_PORT_BUFFER_ULONG(Port, &Value, 1);
+}
+
+VOID WRITE_PORT_BUFFER_ULONG(PULONG Port, PULONG Buffer, ULONG Count)
+{
+    struct shim_window *window;
+    ULONG i;
+
+    pthread_mutex_lock(&shim_bus_lock);
+    window = shim_port_window(PtrToUlong(Port));
+    for (i = 0; i < Count; i++)
+        shim_write_ulong(window, window ? PtrToUlong(Port) - (ULONG)window->base : 0, Buffer[i]);
+    pthread_mutex_unlock(&shim_bus_lock);
+
+    shim_bus_touched();
+}
+
+PVOID MmMapIoSpace(PHYSICAL_ADDRESS PhysicalAddress, SIZE_T NumberOfBytes, MEMORY_CACHING_TYPE CacheType)
+{
+    PVOID address = NULL;
+    ULONG i;
+
+    UNREFERENCED_PARAMETER(CacheType);
+
+    pthread_mutex_lock(&shim_bus_lock);
+
+    for (i = 0; i < shim_window_count; i++) {
+        struct shim_window *window = &shim_windows[i];
+        ULONGLONG offset = (ULONGLONG)PhysicalAddress.QuadPart - window->base;
+
+        if (window->memory && offset < window->length && offset + NumberOfBytes <= window->length) {
+            address = window->address + offset;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&shim_bus_lock);
+
+    return address;
+}
+
+VOID MmUnmapIoSpace(PVOID BaseAddress, SIZE_T NumberOfBytes)
+{
+    UNREFERENCED_PARAMETER(BaseAddress);
+    UNREFERENCED_PARAMETER(NumberOfBytes);
+}
+
+PHYSICAL_ADDRESS MmGetPhysicalAddress(PVOID BaseAddress)
+{
+    PHYSICAL_ADDRESS physical;
+    struct shim_window *window;
+
+    physical.QuadPart = 0;
+
+    pthread_mutex_lock(&shim_bus_lock);
+    window = shim_memory_window(BaseAddress);
+    if (window)
+        physical.QuadPart = window->base + ((PUCHAR)BaseAddress - window->address);
+    pthread_mutex_unlock(&shim_bus_lock);
+
+    return physical;
+}
+
+PVOID MmGetSystemRoutineAddress(PUNICODE_STRING SystemRoutineName)
+{
+    UNREFERENCED_PARAMETER(SystemRoutineName);
+
+    return NULL;
+}
+
+MM_SYSTEMSIZE MmQuerySystemSize(void)
+{
+    return MmLargeSystem;
+}
+
+/* The interrupt thread */
+static void shim_interrupt_service(struct shim_interrupt *interrupt, BOOLEAN *serviced)
+{
+    struct shim_device *device = interrupt->header.device;
+    ULONG i;
+
+    for (i = 0; i < 16; i++) {
+        BOOLEAN asserted, claimed;
+        ULONGLONG start;
+
+        pthread_mutex_lock(&shim_bus_lock);
+        asserted = device->config.InterruptAsserted &&
+                   device->config.InterruptAsserted(device->config.InterruptContext);
+        pthread_mutex_unlock(&shim_bus_lock);
+
+        if (!asserted)
+            return;
+
+        pthread_mutex_lock(&interrupt->lock);
+
+        if (!interrupt->enabled) {
+            pthread_mutex_unlock(&interrupt->lock);
+            return;
+        }
+
+        start = shim_now();
+
+        shim_irql = SHIM_DIRQL;
+        claimed = interrupt->config.EvtInterruptIsr(&interrupt->header, 0);
+        shim_irql = PASSIVE_LEVEL;
+
+        interrupt->stats.Calls++;
+        if (claimed)
+            interrupt->stats.Claimed++;
+        interrupt->stats.Nanoseconds += shim_now() - start;
+
+        pthread_mutex_unlock(&interrupt->lock);
+
+        /* Nobody claiming a level triggered line would storm on real
+           hardware, here the line is looked at again after a wait */
+        if (!claimed)
+            return;
+
+        *serviced = TRUE;
+    }
+}
+
+static void shim_line_wait(ULONGLONG ns, ULONGLONG spin)
+{
+    ULONGLONG end = shim_now() + ns;
+    struct timespec ts;
+
+    if (ns <= spin) {
+        while (shim_now() < end && !__atomic_load_n(&shim_line_wake, __ATOMIC_RELAXED))
+            __builtin_ia32_pause();
+        return;
+    }
+
+    shim_timespec(&ts, end);
+
+    pthread_mutex_lock(&shim_line_lock);
+    __atomic_store_n(&shim_line_sleeping, 1, __ATOMIC_SEQ_CST);
+
+    while (!__atomic_load_n(&shim_line_wake, __ATOMIC_SEQ_CST)) {
+        if (pthread_cond_timedwait(&shim_line_cond, &shim_line_lock, &ts) == ETIMEDOUT)
+            break;
+    }
+
+    __atomic_store_n(&shim_line_sleeping, 0, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&shim_line_lock);
+}
+
+static void *shim_isr_main(void *unused)
+{
+    struct shim_interrupt *interrupts[SHIM_MAX_INTERRUPTS];
+
+    UNREFERENCED_PARAMETER(unused);
+
+    shim_on_isr_thread = TRUE;
+
+    for (;;) {
+        ULONG count = 0, i;
+        ULONGLONG wait = ~0ULL, spin;
+        BOOLEAN serviced = FALSE;
+        PLIST_ENTRY entry;
+
+        __atomic_store_n(&shim_line_wake, 0, __ATOMIC_SEQ_CST);
+
+        pthread_mutex_lock(&shim_lock);
+
+        if (shim_stopping) {
+            pthread_mutex_unlock(&shim_lock);
+            break;
+        }
+
+        for (entry = shim_interrupts.Flink; entry != &shim_interrupts && count < SHIM_MAX_INTERRUPTS;
+             entry = entry->Flink)
+            interrupts[count++] = CONTAINING_RECORD(entry, struct shim_interrupt, entry);
+
+        pthread_mutex_unlock(&shim_lock);
+
+        pthread_mutex_lock(&shim_bus_lock);
+        if (shim_hardware.Run)
+            wait = shim_hardware.Run(shim_hardware.Context);
+        spin = shim_hardware.SpinNs;
+        pthread_mutex_unlock(&shim_bus_lock);
+
+        for (i = 0; i < count; i++)
+            shim_interrupt_service(interrupts[i], &serviced);
+
+        pthread_mutex_lock(&shim_lock);
+        shim_passes++;
+        pthread_cond_broadcast(&shim_pass_cond);
+        pthread_mutex_unlock(&shim_lock);
+
+        if (serviced)
+            continue;
+
+        shim_line_wait(min(wait, SHIM_MAX_SLEEP_NS), spin);
+    }
+
+    return NULL;
+}
+
+/* Waits for the interrupt thread to go round once, so it no longer has
+   anything it took off the interrupt list before */
+static void shim_isr_sync(void)
+{
+    ULONGLONG target;
+
+    if (shim_on_isr_thread)
+        return;
+
+    pthread_mutex_lock(&shim_lock);
+
+    target = shim_passes + 2;
+
+    while (shim_threads && !shim_stopping && shim_passes < target) {
+        pthread_mutex_unlock(&shim_lock);
+        WdfShimBusWake();
+        pthread_mutex_lock(&shim_lock);
+
+        if (shim_passes < target)
+            pthread_cond_wait(&shim_pass_cond, &shim_lock);
+    }
+
+    pthread_mutex_unlock(&shim_lock);
+}
+
+/* The registry */
+static BOOLEAN shim_name_equal(PCWSTR name, PCWSTR other, size_t length)
+{
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        if (!name[i] || towlower(name[i]) != towlower(other[i]))
+            return FALSE;
+    }
+
+    return name[length] == UNICODE_NULL;
+}
+
+static struct shim_registry_value *shim_registry_find(struct shim_registry *registry, PCWSTR name,
+                                                      size_t length)
+{
+    ULONG i;
+
+    for (i = 0; i < registry->count; i++) {
+        if (shim_name_equal(registry->values[i].name, name, length))
+            return &registry->values[i];
+    }
+
+    return NULL;
+}
+
+static NTSTATUS shim_registry_set(struct shim_registry *registry, PCWSTR name, size_t length,
+                                  ULONG type, ULONG value, PCWSTR string)
+{
+    struct shim_registry_value *entry;
+
+    if (length >= SHIM_NAME_LENGTH || (string && wcslen(string) >= SHIM_STRING_LENGTH))
+        return STATUS_INVALID_PARAMETER;
+
+    entry = shim_registry_find(registry, name, length);
+
+    if (!entry) {
+        struct shim_registry_value *values = realloc(registry->values,
+                                                     (registry->count + 1) * sizeof(*values));
+
+        if (!values)
+            return STATUS_INSUFFICIENT_RESOURCES;
+
+        registry->values = values;
+        entry = &values[registry->count++];
+        RtlZeroMemory(entry, sizeof(*entry));
+        wmemcpy(entry->name, name, length);
+    }
+
+    entry->type = type;
+    entry->value = value;
+    entry->string[0] = UNICODE_NULL;
+    if (string)
+        wcscpy(entry->string, string);
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS WdfShimSetRegistryValue(WDFDEVICE Device, const WDF_SHIM_REGISTRY_VALUE *Value)
+{
+    struct shim_registry *registry = Device ? &((struct shim_device *)Device)->registry : &shim_parameters;
+    NTSTATUS status;
+
+    pthread_mutex_lock(&shim_lock);
+    status = shim_registry_set(registry, Value->Name, wcslen(Value->Name), Value->Type, Value->Value,
+                               Value->Type == REG_SZ ? Value->String : NULL);
+    pthread_mutex_unlock(&shim_lock);
+
+    return status;
+}
+
+static NTSTATUS shim_key_open(struct shim_registry *registry, PWDF_OBJECT_ATTRIBUTES attributes, WDFKEY *key)
+{
+    struct shim_key *object = calloc(1, sizeof(*object));
+    NTSTATUS status;
+
+    if (!object)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    status = shim_object_init(&object->header, ShimKey, NULL, NULL, attributes);
+    if (!NT_SUCCESS(status)) {
+        shim_object_free(&object->header);
+        return status;
+    }
+
+    object->registry = registry;
+    *key = &object->header;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS WdfDeviceOpenRegistryKey(WDFDEVICE Device, ULONG DeviceInstanceKeyType, ACCESS_MASK DesiredAccess,
+                                  PWDF_OBJECT_ATTRIBUTES KeyAttributes, WDFKEY *Key)
+{
+    UNREFERENCED_PARAMETER(DeviceInstanceKeyType);
+    UNREFERENCED_PARAMETER(DesiredAccess);
+
+    return shim_key_open(&((struct shim_device *)Device)->registry, KeyAttributes, Key);
+}
+
+NTSTATUS WdfFdoInitOpenRegistryKey(PWDFDEVICE_INIT DeviceInit, ULONG DeviceInstanceKeyType,
+                                   ACCESS_MASK DesiredAccess, PWDF_OBJECT_ATTRIBUTES KeyAttributes,
+                                   WDFKEY *Key)
+{
+    UNREFERENCED_PARAMETER(DeviceInstanceKeyType);
+    UNREFERENCED_PARAMETER(DesiredAccess);
+
+    return shim_key_open(&DeviceInit->registry, KeyAttributes, Key);
+}
+
+NTSTATUS WdfDriverOpenParametersRegistryKey(WDFDRIVER Driver, ACCESS_MASK DesiredAccess,
+                                            PWDF_OBJECT_ATTRIBUTES KeyAttributes, WDFKEY *Key)
+{
+    UNREFERENCED_PARAMETER(Driver);
+    UNREFERENCED_PARAMETER(DesiredAccess);
+
+    return shim_key_open(&shim_parameters, KeyAttributes, Key);
+}
+
+NTSTATUS WdfRegistryQueryULong(WDFKEY Key, PCUNICODE_STRING ValueName, PULONG Value)
+{
+    struct shim_registry_value *entry;
+    NTSTATUS status = STATUS_SUCCESS;
+
+    pthread_mutex_lock(&shim_lock);
+
+    entry = shim_registry_find(((struct shim_key *)Key)->registry, ValueName->Buffer,
+                               ValueName->Length / sizeof(WCHAR));
+
+    if (!entry)
+        status = STATUS_OBJECT_NAME_NOT_FOUND;
+    else if (entry->type != REG_DWORD)
+        status = STATUS_INVALID_PARAMETER;
+    else
+        *Value = entry->value;
+
+    pthread_mutex_unlock(&shim_lock);
+
+    return status;
+}
+
+NTSTATUS WdfRegistryAssignULong(WDFKEY Key, PCUNICODE_STRING ValueName, ULONG Value)
+{
+    NTSTATUS status;
+
+    pthread_mutex_lock(&shim_lock);
+    status = shim_registry_set(((struct shim_key *)Key)->registry, ValueName->Buffer,
+                               ValueName->Length / sizeof(WCHAR), REG_DWORD, Value, NULL);
+    pthread_mutex_unlock(&shim_lock);
+
+    return status;
+}
+
+NTSTATUS WdfRegistryQueryUnicodeString(WDFKEY Key, PCUNICODE_STRING ValueName, PUSHORT ValueByteLength,
+                                       PUNICODE_STRING Value)
+{
+    struct shim_registry_value *entry;
+    NTSTATUS status = STATUS_SUCCESS;
+    USHORT length;
+
+    pthread_mutex_lock(&shim_lock);
+
+    entry = shim_registry_find(((struct shim_key *)Key)->registry, ValueName->Buffer,
+                               ValueName->Length / sizeof(WCHAR));
+
+    if (!entry) {
+        status = STATUS_OBJECT_NAME_NOT_FOUND;
+        goto done;
+    }
+
+    if (entry->type != REG_SZ) {
+        status = STATUS_INVALID_PARAMETER;
+        goto done;
+    }
+
+    length = (USHORT)(wcslen(entry->string) * sizeof(WCHAR));
+
+    if (ValueByteLength)
+        *ValueByteLength = length;
+
+    if (Value) {
+        if (Value->MaximumLength < length) {
+            status = STATUS_BUFFER_OVERFLOW;
+            goto done;
+        }
+
+        RtlCopyMemory(Value->Buffer, entry->string, length);
+        Value->Length = length;
+    }
+
+done:
+    pthread_mutex_unlock(&shim_lock);
+
+    return status;
+}
+
+VOID WdfRegistryClose(WDFKEY Key)
+{
+    shim_object_free(Key);
+}
+
+NTSTATUS RtlWriteRegistryValue(ULONG RelativeTo, PCWSTR Path, PCWSTR ValueName, ULONG ValueType,
+                               PVOID ValueData, ULONG ValueLength)
+{
+    UNREFERENCED_PARAMETER(RelativeTo);
+    UNREFERENCED_PARAMETER(Path);
+    UNREFERENCED_PARAMETER(ValueName);
+    UNREFERENCED_PARAMETER(ValueType);
+    UNREFERENCED_PARAMETER(ValueData);
+    UNREFERENCED_PARAMETER(ValueLength);
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS RtlDeleteRegistryValue(ULONG RelativeTo, PCWSTR Path, PCWSTR ValueName)
+{
+    UNREFERENCED_PARAMETER(RelativeTo);
+    UNREFERENCED_PARAMETER(Path);
+    UNREFERENCED_PARAMETER(ValueName);
+
+    return STATUS_SUCCESS;
+}
+
+/* Drivers */
+NTSTATUS WdfDriverCreate(PDRIVER_OBJECT DriverObject, PCUNICODE_STRING RegistryPath,
+                         PWDF_OBJECT_ATTRIBUTES DriverAttributes, PWDF_DRIVER_CONFIG DriverConfig,
+                         WDFDRIVER *Driver)
+{
+    struct shim_driver *driver;
+    NTSTATUS status;
+
+    UNREFERENCED_PARAMETER(DriverObject);
+    UNREFERENCED_PARAMETER(RegistryPath);
+
+    if (shim_driver)
+        return STATUS_OBJECT_NAME_COLLISION;
+
+    driver = calloc(1, sizeof(*driver));
+    if (!driver)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    status = shim_object_init(&driver->header, ShimDriver, NULL, NULL, DriverAttributes);
+    if (!NT_SUCCESS(status)) {
+        shim_object_free(&driver->header);
+        return status;
+    }
+
+    driver->config = *DriverConfig;
+    shim_driver = driver;
+
+    if (Driver)
+        *Driver = &driver->header;
+
+    return STATUS_SUCCESS;
+}
+
+PDRIVER_OBJECT WdfDriverWdmGetDriverObject(WDFDRIVER Driver)
+{
+    return &((struct shim_driver *)Driver)->driver_object;
+}
+
+NTSTATUS WdfShimDriverLoad(DRIVER_INITIALIZE *DriverEntry)
+{
+    static DRIVER_OBJECT driver_object;
+    UNICODE_STRING registry_path;
+    NTSTATUS status;
+
+    RtlInitUnicodeString(&registry_path, L"\\Registry\\Machine\\System\\CurrentControlSet\\Services\\serialfc");
+
+    status = DriverEntry(&driver_object, &registry_path);
+    if (!NT_SUCCESS(status))
+        return status;
+
+    if (!shim_driver)
+        return STATUS_UNSUCCESSFUL;
+
+    shim_stopping = FALSE;
+
+    if (pthread_create(&shim_dpc_thread, NULL, shim_dpc_main, NULL))
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    if (pthread_create(&shim_isr_thread, NULL, shim_isr_main, NULL)) {
+        pthread_mutex_lock(&shim_lock);
+        shim_stopping = TRUE;
+        pthread_cond_signal(&shim_dpc_cond);
+        pthread_mutex_unlock(&shim_lock);
+        pthread_join(shim_dpc_thread, NULL);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    shim_threads = TRUE;
+
+    return STATUS_SUCCESS;
+}
+
+VOID WdfShimDriverUnload(void)
+{
+    for (;;) {
+        WDFDEVICE device = NULL;
+
+        pthread_mutex_lock(&shim_lock);
+        if (!IsListEmpty(&shim_devices))
+            device = &CONTAINING_RECORD(shim_devices.Flink, struct shim_device, entry)->header;
+        pthread_mutex_unlock(&shim_lock);
+
+        if (!device)
+            break;
+
+        WdfShimDeviceRemove(device);
+    }
+
+    if (shim_threads) {
+        pthread_mutex_lock(&shim_lock);
+        shim_stopping = TRUE;
+        pthread_cond_signal(&shim_dpc_cond);
+        pthread_mutex_unlock(&shim_lock);
+
+        WdfShimBusWake();
+
+        pthread_join(shim_dpc_thread, NULL);
+        pthread_join(shim_isr_thread, NULL);
+        shim_threads = FALSE;
+    }
+
+    if (shim_driver) {
+        if (shim_driver->config.EvtDriverUnload)
+            shim_driver->config.EvtDriverUnload(&shim_driver->header);
+
+        shim_object_free(&shim_driver->header);
+        shim_driver = NULL;
+    }
+}
+
+VOID WdfShimSetTimerResolution(ULONGLONG Nanoseconds)
+{
+    pthread_mutex_lock(&shim_lock);
+    shim_timer_resolution = Nanoseconds;
+    pthread_mutex_unlock(&shim_lock);
+}
+
+/* Devices */
+static PWDFDEVICE_INIT shim_device_init_allocate(const WDF_SHIM_DEVICE_CONFIG *config)
+{
+    PWDFDEVICE_INIT init = calloc(1, sizeof(*init));
+    ULONG i;
+
+    if (!init)
+        return NULL;
+
+    init->config = config;
+
+    for (i = 0; i < config->RegistryCount; i++) {
+        const WDF_SHIM_REGISTRY_VALUE *value = &config->Registry[i];
+
+        if (!NT_SUCCESS(shim_registry_set(&init->registry, value->Name, wcslen(value->Name), value->Type,
+                                          value->Value, value->Type == REG_SZ ? value->String : NULL))) {
+            free(init->registry.values);
+            free(init);
+            return NULL;
+        }
+    }
+
+    return init;
+}
+
+NTSTATUS WdfDeviceInitAssignName(PWDFDEVICE_INIT DeviceInit, PCUNICODE_STRING DeviceName)
+{
+    size_t length = DeviceName->Length / sizeof(WCHAR);
+
+    if (length >= SHIM_NAME_LENGTH)
+        return STATUS_INVALID_PARAMETER;
+
+    wmemcpy(DeviceInit->name, DeviceName->Buffer, length);
+    DeviceInit->name[length] = UNICODE_NULL;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS WdfDeviceInitAssignSDDLString(PWDFDEVICE_INIT DeviceInit, PCUNICODE_STRING SDDLString)
+{
+    UNREFERENCED_PARAMETER(DeviceInit);
+    UNREFERENCED_PARAMETER(SDDLString);
+
+    return STATUS_SUCCESS;
+}
+
+VOID WdfDeviceInitSetExclusive(PWDFDEVICE_INIT DeviceInit, BOOLEAN IsExclusive)
+{
+    UNREFERENCED_PARAMETER(DeviceInit);
+    UNREFERENCED_PARAMETER(IsExclusive);
+}
+
+VOID WdfDeviceInitSetDeviceType(PWDFDEVICE_INIT DeviceInit, DEVICE_TYPE DeviceType)
+{
+    UNREFERENCED_PARAMETER(DeviceInit);
+    UNREFERENCED_PARAMETER(DeviceType);
+}
+
+VOID WdfDeviceInitSetRequestAttributes(PWDFDEVICE_INIT DeviceInit, PWDF_OBJECT_ATTRIBUTES RequestAttributes)
+{
+    DeviceInit->request_attributes = *RequestAttributes;
+}
+
+VOID WdfDeviceInitSetPnpPowerEventCallbacks(PWDFDEVICE_INIT DeviceInit,
+                                            PWDF_PNPPOWER_EVENT_CALLBACKS PnpPowerEventCallbacks)
+{
+    DeviceInit->pnp = *PnpPowerEventCallbacks;
+}
+
+VOID WdfDeviceInitSetPowerPolicyOwnership(PWDFDEVICE_INIT DeviceInit, BOOLEAN IsPowerPolicyOwner)
+{
+    UNREFERENCED_PARAMETER(DeviceInit);
+    UNREFERENCED_PARAMETER(IsPowerPolicyOwner);
+}
+
+NTSTATUS WdfDeviceInitAssignWdmIrpPreprocessCallback(PWDFDEVICE_INIT DeviceInit,
+                                                     PFN_WDFDEVICE_WDM_IRP_PREPROCESS EvtDeviceWdmIrpPreprocess,
+                                                     UCHAR MajorFunction, PUCHAR MinorFunctions,
+                                                     ULONG NumMinorFunctions)
+{
+    UNREFERENCED_PARAMETER(MinorFunctions);
+    UNREFERENCED_PARAMETER(NumMinorFunctions);
+
+    if (MajorFunction >= SHIM_IRP_MJ_COUNT)
+        return STATUS_INVALID_PARAMETER;
+
+    DeviceInit->preprocess[MajorFunction] = EvtDeviceWdmIrpPreprocess;
+
+    return STATUS_SUCCESS;
+}
+
+VOID WdfDeviceInitSetFileObjectConfig(PWDFDEVICE_INIT DeviceInit, PWDF_FILEOBJECT_CONFIG FileObjectConfig,
+                                      PWDF_OBJECT_ATTRIBUTES FileObjectAttributes)
+{
+    DeviceInit->file_config = *FileObjectConfig;
+
+    if (FileObjectAttributes)
+        DeviceInit->file_attributes = *FileObjectAttributes;
+}
+
+NTSTATUS WdfDeviceCreate(PWDFDEVICE_INIT *DeviceInit, PWDF_OBJECT_ATTRIBUTES DeviceAttributes,
+                         WDFDEVICE *Device)
+{
+    PWDFDEVICE_INIT init = *DeviceInit;
+    struct shim_device *device;
+    NTSTATUS status;
+
+    device = calloc(1, sizeof(*device));
+    if (!device)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    shim_recursive_init(&device->lock);
+    InitializeListHead(&device->entry);
+
+    status = shim_object_init(&device->header, ShimDevice, device, &shim_driver->header, DeviceAttributes);
+    if (!NT_SUCCESS(status)) {
+        shim_object_free(&device->header);
+        return status;
+    }
+
+    device->serialized = DeviceAttributes &&
+                         (DeviceAttributes->SynchronizationScope == WdfSynchronizationScopeDevice ||
+                          DeviceAttributes->SynchronizationScope == WdfSynchronizationScopeQueue);
+    device->config = *init->config;
+    device->config.Registry = NULL;
+    device->config.RegistryCount = 0;
+    device->registry = init->registry;
+    init->registry.values = NULL;
+    init->registry.count = 0;
+    wcscpy(device->name, init->name);
+    device->request_attributes = init->request_attributes;
+    device->pnp = init->pnp;
+    device->file_config = init->file_config;
+    device->file_attributes = init->file_attributes;
+    RtlCopyMemory(device->preprocess, init->preprocess, sizeof(device->preprocess));
+
+    device->device_object.DriverObject = &shim_driver->driver_object;
+    device->device_object.DeviceExtension = device;
+
+    device->resources.header.type = ShimResourceList;
+    device->resources.header.device = device;
+    device->resources.count = device->config.ResourceCount;
+    device->resources.descriptors = device->config.Resources;
+
+    init->device = device;
+    *DeviceInit = NULL;
+    *Device = &device->header;
+
+    return STATUS_SUCCESS;
+}
+
+static void shim_device_stop(struct shim_device *device)
+{
+    WDFDEVICE handle = &device->header;
+
+    if (!device->started)
+        return;
+
+    if (device->pnp.EvtDeviceD0ExitPreInterruptsDisabled)
+        device->pnp.EvtDeviceD0ExitPreInterruptsDisabled(handle, WdfPowerDeviceD3Final);
+
+    if (device->interrupt) {
+        WdfInterruptDisable(&device->interrupt->header);
+
+        pthread_mutex_lock(&shim_lock);
+        RemoveEntryList(&device->interrupt->entry);
+        device->interrupt->connected = FALSE;
+        pthread_mutex_unlock(&shim_lock);
+
+        shim_isr_sync();
+    }
+
+    if (device->pnp.EvtDeviceD0Exit)
+        device->pnp.EvtDeviceD0Exit(handle, WdfPowerDeviceD3Final);
+
+    if (device->pnp.EvtDeviceReleaseHardware)
+        device->pnp.EvtDeviceReleaseHardware(handle, &device->resources.header);
+
+    device->started = FALSE;
+}
+
+NTSTATUS WdfShimDeviceAdd(const WDF_SHIM_DEVICE_CONFIG *Config, WDFDEVICE *Device)
+{
+    PWDFDEVICE_INIT init;
+    struct shim_device *device;
+    WDFDEVICE handle;
+    NTSTATUS status;
+
+    if (!shim_driver)
+        return STATUS_INVALID_DEVICE_STATE;
+
+    if (Config->ResourceCount > WDF_SHIM_MAX_RESOURCES)
+        return STATUS_INVALID_PARAMETER;
+
+    init = shim_device_init_allocate(Config);
+    if (!init)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    status = shim_driver->config.EvtDriverDeviceAdd(&shim_driver->header, init);
+    device = init->device;
+
+    free(init->registry.values);
+    free(init);
+
+    if (!NT_SUCCESS(status)) {
+        if (device)
+            shim_object_free(&device->header);
+        return status;
+    }
+
+    if (!device)
+        return STATUS_UNSUCCESSFUL;
+
+    handle = &device->header;
+
+    pthread_mutex_lock(&shim_lock);
+    InsertTailList(&shim_devices, &device->entry);
+    pthread_mutex_unlock(&shim_lock);
+
+    if (device->pnp.EvtDevicePrepareHardware) {
+        status = device->pnp.EvtDevicePrepareHardware(handle, &device->resources.header,
+                                                      &device->resources.header);
+        if (!NT_SUCCESS(status))
+            goto failed;
+    }
+
+    device->started = TRUE;
+
+    if (device->pnp.EvtDeviceD0Entry) {
+        status = device->pnp.EvtDeviceD0Entry(handle, WdfPowerDeviceD3Final);
+        if (!NT_SUCCESS(status))
+            goto failed;
+    }
+
+    if (device->interrupt) {
+        WdfInterruptEnable(&device->interrupt->header);
+
+        pthread_mutex_lock(&shim_lock);
+        InsertTailList(&shim_interrupts, &device->interrupt->entry);
+        device->interrupt->connected = TRUE;
+        pthread_mutex_unlock(&shim_lock);
+
+        WdfShimBusWake();
+    }
+
+    if (device->pnp.EvtDeviceD0EntryPostInterruptsEnabled) {
+        status = device->pnp.EvtDeviceD0EntryPostInterruptsEnabled(handle, WdfPowerDeviceD3Final);
+        if (!NT_SUCCESS(status))
+            goto failed;
+    }
+
+    if (Device)
+        *Device = handle;
+
+    return STATUS_SUCCESS;
+
+failed:
+    WdfShimDeviceRemove(handle);
+
+    return status;
+}
+
+VOID WdfShimDeviceRemove(WDFDEVICE Device)
+{
+    struct shim_device *device = (struct shim_device *)Device;
+
+    if (device->file)
+        WdfShimDeviceClose(Device);
+
+    shim_device_stop(device);
+
+    pthread_mutex_lock(&shim_lock);
+    RemoveEntryList(&device->entry);
+    InitializeListHead(&device->entry);
+    pthread_mutex_unlock(&shim_lock);
+
+    shim_object_free(Device);
+}
+
+VOID WdfDeviceSetFailed(WDFDEVICE Device, WDF_DEVICE_FAILED_ACTION FailedAction)
+{
+    UNREFERENCED_PARAMETER(FailedAction);
+
+    DbgPrint("wdf-shim: %ws failed\n", ((struct shim_device *)Device)->name);
+}
+
+PDEVICE_OBJECT WdfDeviceWdmGetDeviceObject(WDFDEVICE Device)
+{
+    return &((struct shim_device *)Device)->device_object;
+}
+
+PDEVICE_OBJECT WdfDeviceWdmGetPhysicalDevice(WDFDEVICE Device)
+{
+    return &((struct shim_device *)Device)->device_object;
+}
+
+PDEVICE_OBJECT WdfDeviceWdmGetAttachedDevice(WDFDEVICE Device)
+{
+    return &((struct shim_device *)Device)->device_object;
+}
+
+WDFDEVICE WdfFileObjectGetDevice(WDFFILEOBJECT FileObject)
+{
+    return &FileObject->device->header;
+}
+
+NTSTATUS WdfDeviceCreateSymbolicLink(WDFDEVICE Device, PCUNICODE_STRING SymbolicLinkName)
+{
+    UNREFERENCED_PARAMETER(Device);
+    UNREFERENCED_PARAMETER(SymbolicLinkName);
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS WdfDeviceCreateDeviceInterface(WDFDEVICE Device, const GUID *InterfaceClassGUID,
+                                        PCUNICODE_STRING ReferenceString)
+{
+    UNREFERENCED_PARAMETER(Device);
+    UNREFERENCED_PARAMETER(InterfaceClassGUID);
+    UNREFERENCED_PARAMETER(ReferenceString);
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS WdfDeviceRetrieveDeviceName(WDFDEVICE Device, WDFSTRING String)
+{
+    struct shim_string *string = (struct shim_string *)String;
+
+    wcscpy(string->buffer, ((struct shim_device *)Device)->name);
+    string->string.Length = (USHORT)(wcslen(string->buffer) * sizeof(WCHAR));
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS WdfDeviceAssignMofResourceName(WDFDEVICE Device, PCUNICODE_STRING MofResourceName)
+{
+    UNREFERENCED_PARAMETER(Device);
+    UNREFERENCED_PARAMETER(MofResourceName);
+
+    return STATUS_SUCCESS;
+}
+
+VOID WdfDeviceSetStaticStopRemove(WDFDEVICE Device, BOOLEAN Stoppable)
+{
+    UNREFERENCED_PARAMETER(Device);
+    UNREFERENCED_PARAMETER(Stoppable);
+}
+
+NTSTATUS WdfDeviceStopIdle(WDFDEVICE Device, BOOLEAN WaitForD0)
+{
+    UNREFERENCED_PARAMETER(Device);
+    UNREFERENCED_PARAMETER(WaitForD0);
+
+    return STATUS_SUCCESS;
+}
+
+VOID WdfDeviceResumeIdle(WDFDEVICE Device)
+{
+    UNREFERENCED_PARAMETER(Device);
+}
+
+NTSTATUS WdfDeviceAssignS0IdleSettings(WDFDEVICE Device, PWDF_DEVICE_POWER_POLICY_IDLE_SETTINGS Settings)
+{
+    UNREFERENCED_PARAMETER(Device);
+    UNREFERENCED_PARAMETER(Settings);
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS WdfDeviceAssignSxWakeSettings(WDFDEVICE Device, PWDF_DEVICE_POWER_POLICY_WAKE_SETTINGS Settings)
+{
+    UNREFERENCED_PARAMETER(Device);
+    UNREFERENCED_PARAMETER(Settings);
+
+    return STATUS_SUCCESS;
+}
+
+ULONG WdfCmResourceListGetCount(WDFCMRESLIST List)
+{
+    return ((struct shim_resource_list *)List)->count;
+}
+
+PCM_PARTIAL_RESOURCE_DESCRIPTOR WdfCmResourceListGetDescriptor(WDFCMRESLIST List, ULONG Index)
+{
+    struct shim_resource_list *list = (struct shim_resource_list *)List;
+
+    return Index < list->count ? &list->descriptors[Index] : NULL;
+}
+
+/* Strings and WMI */
+NTSTATUS WdfStringCreate(PCUNICODE_STRING UnicodeString, PWDF_OBJECT_ATTRIBUTES StringAttributes,
+                         WDFSTRING *String)
+{
+    struct shim_string *string;
+    NTSTATUS status;
+
+    if (UnicodeString && UnicodeString->Length >= sizeof(string->buffer))
+        return STATUS_INVALID_PARAMETER;
+
+    string = calloc(1, sizeof(*string));
+    if (!string)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    status = shim_object_init(&string->header, ShimString, NULL,
+                              StringAttributes ? StringAttributes->ParentObject : NULL, StringAttributes);
+    if (!NT_SUCCESS(status)) {
+        shim_object_free(&string->header);
+        return status;
+    }
+
+    string->string.Buffer = string->buffer;
+    string->string.MaximumLength = sizeof(string->buffer);
+
+    if (UnicodeString) {
+        RtlCopyMemory(string->buffer, UnicodeString->Buffer, UnicodeString->Length);
+        string->string.Length = UnicodeString->Length;
+    }
+
+    *String = &string->header;
+
+    return STATUS_SUCCESS;
+}
+
+VOID WdfStringGetUnicodeString(WDFSTRING String, PUNICODE_STRING UnicodeString)
+{
+    *UnicodeString = ((struct shim_string *)String)->string;
+}
+
+NTSTATUS WdfWmiInstanceCreate(WDFDEVICE Device, PWDF_WMI_INSTANCE_CONFIG InstanceConfig,
+                              PWDF_OBJECT_ATTRIBUTES InstanceAttributes, WDFWMIINSTANCE *Instance)
+{
+    struct shim_wmi_instance *instance = calloc(1, sizeof(*instance));
+    NTSTATUS status;
+
+    if (!instance)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    status = shim_object_init(&instance->header, ShimWmiInstance, Device->device, Device, InstanceAttributes);
+    if (!NT_SUCCESS(status)) {
+        shim_object_free(&instance->header);
+        return status;
+    }
+
+    instance->config = *InstanceConfig;
+
+    if (Instance)
+        *Instance = &instance->header;
+
+    return STATUS_SUCCESS;
+}
+
+WDFDEVICE WdfWmiInstanceGetDevice(WDFWMIINSTANCE WmiInstance)
+{
+    return &WmiInstance->device->header;
+}
+
+/* Requests and queues */
+static void shim_queue_dispatch(struct shim_queue *queue);
+
+/* shim_lock held */
+static void shim_queue_release(struct shim_queue *queue)
+{
+    queue->driver_owned--;
+
+    if (queue->config.DispatchType == WdfIoQueueDispatchSequential)
+        queue->busy = FALSE;
+
+    if (!queue->driver_owned)
+        pthread_cond_broadcast(&shim_idle_cond);
+}
+
+/* shim_lock held */
+static void shim_queue_take(struct shim_queue *queue, struct shim_request *request)
+{
+    RemoveEntryList(&request->entry);
+    queue->queued--;
+    queue->driver_owned++;
+    request->queue = NULL;
+    request->owner = queue;
+    request->last_queue = queue;
+}
+
+static void shim_request_finish(struct shim_request *request, NTSTATUS status, ULONG_PTR information)
+{
+    struct shim_queue *owner;
+
+    pthread_mutex_lock(&shim_lock);
+
+    owner = request->owner;
+    request->owner = NULL;
+
+    if (owner)
+        shim_queue_release(owner);
+
+    pthread_mutex_unlock(&shim_lock);
+
+    if (request->system_buffer) {
+        if (request->user_output)
+            RtlCopyMemory(request->user_output, request->system_buffer,
+                          min(information, request->output_length));
+        free(request->system_buffer);
+    }
+
+    if (request->completion)
+        request->completion(request->completion_context, status, information);
+
+    shim_object_free(&request->header);
+
+    if (owner && owner->config.DispatchType == WdfIoQueueDispatchSequential)
+        shim_queue_dispatch(owner);
+}
+
+static void shim_queue_present(struct shim_queue *queue, struct shim_request *request)
+{
+    PWDF_IO_QUEUE_CONFIG config = &queue->config;
+    WDFQUEUE handle = &queue->header;
+    WDFREQUEST r = &request->header;
+    BOOLEAN handled = FALSE;
+
+    switch (request->parameters.Type) {
+    case WdfRequestTypeRead:
+    case WdfRequestTypeWrite:
+        if (!request->parameters.Parameters.Read.Length && !config->AllowZeroLengthRequests) {
+            shim_request_finish(request, STATUS_SUCCESS, 0);
+            return;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    if (queue->serialized)
+        pthread_mutex_lock(&queue->header.device->lock);
+
+    switch (request->parameters.Type) {
+    case WdfRequestTypeRead:
+        if (config->EvtIoRead) {
+            config->EvtIoRead(handle, r, request->parameters.Parameters.Read.Length);
+            handled = TRUE;
+        }
+        break;
+
+    case WdfRequestTypeWrite:
+        if (config->EvtIoWrite) {
+            config->EvtIoWrite(handle, r, request->parameters.Parameters.Write.Length);
+            handled = TRUE;
+        }
+        break;
+
+    case WdfRequestTypeDeviceControl:
+        if (config->EvtIoDeviceControl) {
+            config->EvtIoDeviceControl(handle, r, request->parameters.Parameters.DeviceIoControl.OutputBufferLength,
+                                       request->parameters.Parameters.DeviceIoControl.InputBufferLength,
+                                       request->parameters.Parameters.DeviceIoControl.IoControlCode);
+            handled = TRUE;
+        }
+        break;
+
+    case WdfRequestTypeDeviceControlInternal:
+        if (config->EvtIoInternalDeviceControl) {
+            config->EvtIoInternalDeviceControl(handle, r,
+                                               request->parameters.Parameters.DeviceIoControl.OutputBufferLength,
+                                               request->parameters.Parameters.DeviceIoControl.InputBufferLength,
+                                               request->parameters.Parameters.DeviceIoControl.IoControlCode);
+            handled = TRUE;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    if (!handled) {
+        if (config->EvtIoDefault)
+            config->EvtIoDefault(handle, r);
+        else
+            shim_request_finish(request, STATUS_INVALID_DEVICE_REQUEST, 0);
+    }
+
+    if (queue->serialized)
+        pthread_mutex_unlock(&queue->header.device->lock);
+}
+
+static void shim_queue_dispatch(struct shim_queue *queue)
+{
+    for (;;) {
+        struct shim_request *request;
+
+        pthread_mutex_lock(&shim_lock);
+
+        if (queue->config.DispatchType == WdfIoQueueDispatchManual || !queue->dispatching ||
+            IsListEmpty(&queue->requests) || queue->busy) {
+            pthread_mutex_unlock(&shim_lock);
+            return;
+        }
+
+        request = CONTAINING_RECORD(queue->requests.Flink, struct shim_request, entry);
+        shim_queue_take(queue, request);
+
+        if (queue->config.DispatchType == WdfIoQueueDispatchSequential)
+            queue->busy = TRUE;
+
+        pthread_mutex_unlock(&shim_lock);
+
+        shim_queue_present(queue, request);
+    }
+}
+
+/* Puts a request the driver owns, if anyone, on a queue */
+static NTSTATUS shim_queue_insert(struct shim_queue *queue, struct shim_request *request, BOOLEAN head)
+{
+    struct shim_queue *owner;
+
+    pthread_mutex_lock(&shim_lock);
+
+    if (!queue->accepting) {
+        pthread_mutex_unlock(&shim_lock);
+        return STATUS_INVALID_DEVICE_STATE;
+    }
+
+    owner = request->owner;
+    request->owner = NULL;
+
+    if (owner)
+        shim_queue_release(owner);
+
+    request->queue = queue;
+    queue->queued++;
+
+    if (head)
+        InsertHeadList(&queue->requests, &request->entry);
+    else
+        InsertTailList(&queue->requests, &request->entry);
+
+    pthread_mutex_unlock(&shim_lock);
+
+    shim_queue_dispatch(queue);
+
+    if (owner && owner != queue && owner->config.DispatchType == WdfIoQueueDispatchSequential)
+        shim_queue_dispatch(owner);
+
+    return STATUS_SUCCESS;
+}
+
+static struct shim_request *shim_request_create(struct shim_device *device, WDF_REQUEST_TYPE type,
+                                                ULONG code, PVOID input, size_t input_length,
+                                                PVOID output, size_t output_length)
+{
+    struct shim_request *request = calloc(1, sizeof(*request));
+
+    if (!request)
+        return NULL;
+
+    if (!NT_SUCCESS(shim_object_init(&request->header, ShimRequest, device, NULL,
+                                     &device->request_attributes))) {
+        shim_object_free(&request->header);
+        return NULL;
+    }
+
+    InitializeListHead(&request->entry);
+
+    WDF_REQUEST_PARAMETERS_INIT(&request->parameters);
+    request->parameters.Type = type;
+
+    switch (type) {
+    case WdfRequestTypeRead:
+        request->parameters.Parameters.Read.Length = output_length;
+        request->output = output;
+        request->output_length = output_length;
+        request->stack.Parameters.Read.Length = (ULONG)output_length;
+        break;
+
+    case WdfRequestTypeWrite:
+        /* A write's system buffer is both its input and its output */
+        request->parameters.Parameters.Write.Length = input_length;
+        request->input = request->output = input;
+        request->input_length = request->output_length = input_length;
+        request->stack.Parameters.Write.Length = (ULONG)input_length;
+        break;
+
+    case WdfRequestTypeDeviceControl:
+    case WdfRequestTypeDeviceControlInternal:
+        request->parameters.Parameters.DeviceIoControl.IoControlCode = code;
+        request->parameters.Parameters.DeviceIoControl.InputBufferLength = input_length;
+        request->parameters.Parameters.DeviceIoControl.OutputBufferLength = output_length;
+        request->stack.Parameters.DeviceIoControl.IoControlCode = code;
+        request->stack.Parameters.DeviceIoControl.InputBufferLength = (ULONG)input_length;
+        request->stack.Parameters.DeviceIoControl.OutputBufferLength = (ULONG)output_length;
+
+        if ((code & 3) == METHOD_BUFFERED && (input_length || output_length)) {
+            request->system_buffer = calloc(1, max(input_length, output_length));
+            if (!request->system_buffer) {
+                shim_object_free(&request->header);
+                return NULL;
+            }
+
+            if (input_length)
+                RtlCopyMemory(request->system_buffer, input, input_length);
+
+            request->user_output = output;
+            input = output = request->system_buffer;
+        }
+
+        request->input = input;
+        request->input_length = input_length;
+        request->output = output;
+        request->output_length = output_length;
+        break;
+
+    default:
+        break;
+    }
+
+    request->irp.StackLocation = &request->stack;
+    request->irp.AssociatedIrp.SystemBuffer = request->system_buffer ? request->system_buffer
+                                                                     : (request->input ? request->input
+                                                                                       : request->output);
+    request->stack.MajorFunction = (UCHAR)type;
+
+    return request;
+}
+
+/* Sends a request that has a preprocess callback as an IRP */
+static void shim_irp_send(struct shim_device *device, PFN_WDFDEVICE_WDM_IRP_PREPROCESS preprocess,
+                          WDF_REQUEST_TYPE type, ULONG code, PVOID input, size_t input_length,
+                          PVOID output, size_t output_length,
+                          WDF_SHIM_REQUEST_COMPLETION *completion, PVOID context)
+{
+    struct shim_irp *irp = calloc(1, sizeof(*irp));
+
+    if (!irp) {
+        completion(context, STATUS_INSUFFICIENT_RESOURCES, 0);
+        return;
+    }
+
+    irp->completion = completion;
+    irp->completion_context = context;
+    irp->irp.StackLocation = &irp->stack;
+    irp->stack.MajorFunction = (UCHAR)type;
+    irp->stack.DeviceObject = &device->device_object;
+
+    switch (type) {
+    case WdfRequestTypeQueryInformation:
+        irp->stack.Parameters.QueryFile.Length = (ULONG)output_length;
+        irp->stack.Parameters.QueryFile.FileInformationClass = (FILE_INFORMATION_CLASS)code;
+        irp->irp.AssociatedIrp.SystemBuffer = output;
+        break;
+
+    case WdfRequestTypeSetInformation:
+        irp->stack.Parameters.SetFile.Length = (ULONG)input_length;
+        irp->stack.Parameters.SetFile.FileInformationClass = (FILE_INFORMATION_CLASS)code;
+        irp->irp.AssociatedIrp.SystemBuffer = input;
+        break;
+
+    default:
+        irp->irp.AssociatedIrp.SystemBuffer = input ? input : output;
+        break;
+    }
+
+    preprocess(&device->header, &irp->irp);
+}
+
+VOID WdfShimRequestSend(WDFDEVICE Device, WDF_REQUEST_TYPE Type, ULONG IoControlCode,
+                        PVOID InputBuffer, size_t InputLength,
+                        PVOID OutputBuffer, size_t OutputLength,
+                        WDF_SHIM_REQUEST_COMPLETION *Completion, PVOID Context)
+{
+    struct shim_device *device = (struct shim_device *)Device;
+    struct shim_request *request;
+    NTSTATUS status;
+
+    if ((ULONG)Type < SHIM_IRP_MJ_COUNT && device->preprocess[Type]) {
+        shim_irp_send(device, device->preprocess[Type], Type, IoControlCode, InputBuffer, InputLength,
+                      OutputBuffer, OutputLength, Completion, Context);
+        return;
+    }
+
+    if (!device->default_queue) {
+        Completion(Context, STATUS_INVALID_DEVICE_REQUEST, 0);
+        return;
+    }
+
+    request = shim_request_create(device, Type, IoControlCode, InputBuffer, InputLength,
+                                  OutputBuffer, OutputLength);
+    if (!request) {
+        Completion(Context, STATUS_INSUFFICIENT_RESOURCES, 0);
+        return;
+    }
+
+    request->completion = Completion;
+    request->completion_context = Context;
+
+    status = shim_queue_insert(device->default_queue, request, FALSE);
+    if (!NT_SUCCESS(status))
+        shim_request_finish(request, status, 0);
+}
+
+struct shim_wait {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    BOOLEAN done;
+    NTSTATUS status;
+    ULONG_PTR information;
+};
+
+static void shim_wait_init(struct shim_wait *wait)
+{
+    pthread_mutex_init(&wait->lock, NULL);
+    pthread_cond_init(&wait->cond, NULL);
+    wait->done = FALSE;
+}
+
+static VOID shim_wait_complete(PVOID Context, NTSTATUS Status, ULONG_PTR Information)
+{
+    struct shim_wait *wait = Context;
+
+    pthread_mutex_lock(&wait->lock);
+    wait->status = Status;
+    wait->information = Information;
+    wait->done = TRUE;
+    pthread_cond_signal(&wait->cond);
+    pthread_mutex_unlock(&wait->lock);
+}
+
+static NTSTATUS shim_wait_finish(struct shim_wait *wait, PULONG_PTR information)
+{
+    pthread_mutex_lock(&wait->lock);
+    while (!wait->done)
+        pthread_cond_wait(&wait->cond, &wait->lock);
+    pthread_mutex_unlock(&wait->lock);
+
+    pthread_cond_destroy(&wait->cond);
+    pthread_mutex_destroy(&wait->lock);
+
+    if (information)
+        *information = wait->information;
+
+    return wait->status;
+}
+
+NTSTATUS WdfShimRequestSendSynchronously(WDFDEVICE Device, WDF_REQUEST_TYPE Type, ULONG IoControlCode,
+                                         PVOID InputBuffer, size_t InputLength,
+                                         PVOID OutputBuffer, size_t OutputLength,
+                                         PULONG_PTR Information)
+{
+    struct shim_wait wait;
+
+    shim_wait_init(&wait);
+
+    WdfShimRequestSend(Device, Type, IoControlCode, InputBuffer, InputLength, OutputBuffer, OutputLength,
+                       shim_wait_complete, &wait);
+
+    return shim_wait_finish(&wait, Information);
+}
+
+NTSTATUS WdfShimDeviceOpen(WDFDEVICE Device)
+{
+    struct shim_device *device = (struct shim_device *)Device;
+    struct WDF_SHIM_OBJECT *file;
+    struct shim_wait wait;
+    NTSTATUS status;
+
+    if (device->file)
+        return STATUS_SHARING_VIOLATION;
+
+    file = calloc(1, sizeof(*file));
+    if (!file)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    status = shim_object_init(file, ShimFile, device, Device, &device->file_attributes);
+    if (!NT_SUCCESS(status)) {
+        shim_object_free(file);
+        return status;
+    }
+
+    device->file = file;
+
+    shim_wait_init(&wait);
+
+    if (device->preprocess[IRP_MJ_CREATE]) {
+        shim_irp_send(device, device->preprocess[IRP_MJ_CREATE], WdfRequestTypeCreate, 0, NULL, 0,
+                      NULL, 0, shim_wait_complete, &wait);
+    }
+    else if (device->file_config.EvtDeviceFileCreate) {
+        struct shim_request *request = shim_request_create(device, WdfRequestTypeCreate, 0, NULL, 0, NULL, 0);
+
+        if (request) {
+            request->completion = shim_wait_complete;
+            request->completion_context = &wait;
+            device->file_config.EvtDeviceFileCreate(Device, &request->header, file);
+        }
+        else {
+            shim_wait_complete(&wait, STATUS_INSUFFICIENT_RESOURCES, 0);
+        }
+    }
+    else {
+        shim_wait_complete(&wait, STATUS_SUCCESS, 0);
+    }
+
+    status = shim_wait_finish(&wait, NULL);
+
+    if (!NT_SUCCESS(status)) {
+        device->file = NULL;
+        shim_object_free(file);
+    }
+
+    return status;
+}
+
+VOID WdfShimDeviceClose(WDFDEVICE Device)
+{
+    struct shim_device *device = (struct shim_device *)Device;
+    struct shim_wait wait;
+
+    if (!device->file)
+        return;
+
+    if (device->file_config.EvtFileCleanup)
+        device->file_config.EvtFileCleanup(device->file);
+
+    shim_wait_init(&wait);
+
+    if (device->preprocess[IRP_MJ_CLOSE]) {
+        shim_irp_send(device, device->preprocess[IRP_MJ_CLOSE], WdfRequestTypeClose, 0, NULL, 0,
+                      NULL, 0, shim_wait_complete, &wait);
+    }
+    else {
+        if (device->file_config.EvtFileClose)
+            device->file_config.EvtFileClose(device->file);
+
+        shim_wait_complete(&wait, STATUS_SUCCESS, 0);
+    }
+
+    shim_wait_finish(&wait, NULL);
+
+    shim_object_free(device->file);
+    device->file = NULL;
+}
+
+VOID WdfShimDeviceGetInterruptStats(WDFDEVICE Device, PWDF_SHIM_INTERRUPT_STATS Stats)
+{
+    struct shim_interrupt *interrupt = ((struct shim_device *)Device)->interrupt;
+
+    RtlZeroMemory(Stats, sizeof(*Stats));
+
+    if (!interrupt)
+        return;
+
+    pthread_mutex_lock(&interrupt->lock);
+    *Stats = interrupt->stats;
+    pthread_mutex_unlock(&interrupt->lock);
+}
+
+VOID WdfShimDeviceClearInterruptStats(WDFDEVICE Device)
+{
+    struct shim_interrupt *interrupt = ((struct shim_device *)Device)->interrupt;
+
+    if (!interrupt)
+        return;
+
+    pthread_mutex_lock(&interrupt->lock);
+    RtlZeroMemory(&interrupt->stats, sizeof(interrupt->stats));
+    pthread_mutex_unlock(&interrupt->lock);
+}
+
+/* The deferred of one of the device's DPCs or timers, NULL for other
+   children */
+static struct shim_deferred *shim_child_deferred(struct WDF_SHIM_OBJECT *object, PVOID *callback)
+{
+    if (object->type == ShimDpc) {
+        struct shim_dpc *dpc = (struct shim_dpc *)object;
+
+        *callback = (PVOID)dpc->config.EvtDpcFunc;
+        return &dpc->deferred;
+    }
+
+    if (object->type == ShimTimer) {
+        struct shim_timer *timer = (struct shim_timer *)object;
+
+        *callback = (PVOID)timer->config.EvtTimerFunc;
+        return &timer->deferred;
+    }
+
+    return NULL;
+}
+
+ULONG WdfShimDeviceGetDpcStats(WDFDEVICE Device, PWDF_SHIM_DPC_STATS Stats, ULONG Count)
+{
+    struct shim_device *device = (struct shim_device *)Device;
+    struct shim_deferred *deferred;
+    PLIST_ENTRY entry;
+    PVOID callback;
+    ULONG found = 0;
+
+    pthread_mutex_lock(&shim_lock);
+
+    for (entry = device->header.children.Flink; entry != &device->header.children; entry = entry->Flink) {
+        struct WDF_SHIM_OBJECT *child = CONTAINING_RECORD(entry, struct WDF_SHIM_OBJECT, sibling);
+
+        deferred = shim_child_deferred(child, &callback);
+        if (!deferred)
+            continue;
+
+        if (found < Count) {
+            Stats[found] = deferred->stats;
+            Stats[found].Callback = callback;
+            Stats[found].Timer = child->type == ShimTimer;
+        }
+
+        found++;
+    }
+
+    pthread_mutex_unlock(&shim_lock);
+
+    return found;
+}
+
+VOID WdfShimDeviceClearDpcStats(WDFDEVICE Device)
+{
+    struct shim_device *device = (struct shim_device *)Device;
+    struct shim_deferred *deferred;
+    PLIST_ENTRY entry;
+    PVOID callback;
+
+    pthread_mutex_lock(&shim_lock);
+
+    for (entry = device->header.children.Flink; entry != &device->header.children; entry = entry->Flink) {
+        deferred = shim_child_deferred(CONTAINING_RECORD(entry, struct WDF_SHIM_OBJECT, sibling), &callback);
+        if (deferred)
+            RtlZeroMemory(&deferred->stats, sizeof(deferred->stats));
+    }
+
+    pthread_mutex_unlock(&shim_lock);
+}
+
+VOID WdfRequestGetParameters(WDFREQUEST Request, PWDF_REQUEST_PARAMETERS Parameters)
+{
+    *Parameters = ((struct shim_request *)Request)->parameters;
+}
+
+NTSTATUS WdfRequestRetrieveInputBuffer(WDFREQUEST Request, size_t MinimumRequiredLength,
+                                       PVOID *Buffer, size_t *Length)
+{
+    struct shim_request *request = (struct shim_request *)Request;
+
+    if (request->parameters.Type == WdfRequestTypeRead)
+        return STATUS_INVALID_DEVICE_REQUEST;
+
+    if (!request->input_length || request->input_length < MinimumRequiredLength)
+        return STATUS_BUFFER_TOO_SMALL;
+
+    *Buffer = request->input;
+    if (Length)
+        *Length = request->input_length;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS WdfRequestRetrieveOutputBuffer(WDFREQUEST Request, size_t MinimumRequiredSize,
+                                        PVOID *Buffer, size_t *Length)
+{
+    struct shim_request *request = (struct shim_request *)Request;
+
+    if (!request->output_length || request->output_length < MinimumRequiredSize)
+        return STATUS_BUFFER_TOO_SMALL;
+
+    *Buffer = request->output;
+    if (Length)
+        *Length = request->output_length;
+
+    return STATUS_SUCCESS;
+}
+
+VOID WdfRequestComplete(WDFREQUEST Request, NTSTATUS Status)
+{
+    struct shim_request *request = (struct shim_request *)Request;
+
+    shim_request_finish(request, Status, request->information);
+}
+
+VOID WdfRequestCompleteWithInformation(WDFREQUEST Request, NTSTATUS Status, ULONG_PTR Information)
+{
+    shim_request_finish((struct shim_request *)Request, Status, Information);
+}
+
+VOID WdfRequestSetInformation(WDFREQUEST Request, ULONG_PTR Information)
+{
+    ((struct shim_request *)Request)->information = Information;
+}
+
+ULONG_PTR WdfRequestGetInformation(WDFREQUEST Request)
+{
+    return ((struct shim_request *)Request)->information;
+}
+
+NTSTATUS WdfRequestGetStatus(WDFREQUEST Request)
+{
+    return ((struct shim_request *)Request)->status;
+}
+
+/* Nothing cancels a request from outside, so cancel routines are kept
+   but never called */
+VOID WdfRequestMarkCancelable(WDFREQUEST Request, PFN_WDF_REQUEST_CANCEL EvtRequestCancel)
+{
+    ((struct shim_request *)Request)->cancel = EvtRequestCancel;
+}
+
+NTSTATUS WdfRequestMarkCancelableEx(WDFREQUEST Request, PFN_WDF_REQUEST_CANCEL EvtRequestCancel)
+{
+    ((struct shim_request *)Request)->cancel = EvtRequestCancel;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS WdfRequestUnmarkCancelable(WDFREQUEST Request)
+{
+    ((struct shim_request *)Request)->cancel = NULL;
+
+    return STATUS_SUCCESS;
+}
+
+BOOLEAN WdfRequestIsCanceled(WDFREQUEST Request)
+{
+    UNREFERENCED_PARAMETER(Request);
+
+    return FALSE;
+}
+
+VOID WdfRequestStopAcknowledge(WDFREQUEST Request, BOOLEAN Requeue)
+{
+    UNREFERENCED_PARAMETER(Request);
+    UNREFERENCED_PARAMETER(Requeue);
+}
+
+NTSTATUS WdfRequestForwardToIoQueue(WDFREQUEST Request, WDFQUEUE DestinationQueue)
+{
+    return shim_queue_insert((struct shim_queue *)DestinationQueue, (struct shim_request *)Request, FALSE);
+}
+
+NTSTATUS WdfRequestRequeue(WDFREQUEST Request)
+{
+    struct shim_request *request = (struct shim_request *)Request;
+
+    if (!request->owner)
+        return STATUS_INVALID_DEVICE_REQUEST;
+
+    return shim_queue_insert(request->owner, request, TRUE);
+}
+
+WDFQUEUE WdfRequestGetIoQueue(WDFREQUEST Request)
+{
+    struct shim_request *request = (struct shim_request *)Request;
+
+    return request->last_queue ? &request->last_queue->header : NULL;
+}
+
+PIRP WdfRequestWdmGetIrp(WDFREQUEST Request)
+{
+    return &((struct shim_request *)Request)->irp;
+}
+
+NTSTATUS WdfIoQueueCreate(WDFDEVICE Device, PWDF_IO_QUEUE_CONFIG Config,
+                          PWDF_OBJECT_ATTRIBUTES QueueAttributes, WDFQUEUE *Queue)
+{
+    struct shim_device *device = (struct shim_device *)Device;
+    struct shim_queue *queue;
+    NTSTATUS status;
+
+    if (Config->DefaultQueue && device->default_queue)
+        return STATUS_OBJECT_NAME_COLLISION;
+
+    queue = calloc(1, sizeof(*queue));
+    if (!queue)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    InitializeListHead(&queue->requests);
+
+    status = shim_object_init(&queue->header, ShimQueue, device, Device, QueueAttributes);
+    if (!NT_SUCCESS(status)) {
+        shim_object_free(&queue->header);
+        return status;
+    }
+
+    queue->config = *Config;
+    queue->accepting = TRUE;
+    queue->dispatching = TRUE;
+
+    if (QueueAttributes && QueueAttributes->SynchronizationScope == WdfSynchronizationScopeNone)
+        queue->serialized = FALSE;
+    else
+        queue->serialized = device->serialized;
+
+    if (Config->DefaultQueue)
+        device->default_queue = queue;
+
+    if (Queue)
+        *Queue = &queue->header;
+
+    return STATUS_SUCCESS;
+}
+
+WDFDEVICE WdfIoQueueGetDevice(WDFQUEUE Queue)
+{
+    return &Queue->device->header;
+}
+
+NTSTATUS WdfIoQueueRetrieveNextRequest(WDFQUEUE Queue, WDFREQUEST *OutRequest)
+{
+    struct shim_queue *queue = (struct shim_queue *)Queue;
+    struct shim_request *request;
+
+    pthread_mutex_lock(&shim_lock);
+
+    if (IsListEmpty(&queue->requests)) {
+        pthread_mutex_unlock(&shim_lock);
+        return STATUS_NO_MORE_ENTRIES;
+    }
+
+    request = CONTAINING_RECORD(queue->requests.Flink, struct shim_request, entry);
+    shim_queue_take(queue, request);
+
+    pthread_mutex_unlock(&shim_lock);
+
+    *OutRequest = &request->header;
+
+    return STATUS_SUCCESS;
+}
+
+WDF_IO_QUEUE_STATE WdfIoQueueGetState(WDFQUEUE Queue, PULONG QueueRequests, PULONG DriverRequests)
+{
+    struct shim_queue *queue = (struct shim_queue *)Queue;
+    ULONG state = 0;
+
+    pthread_mutex_lock(&shim_lock);
+
+    if (queue->accepting)
+        state |= WdfIoQueueAcceptRequests;
+    if (queue->dispatching)
+        state |= WdfIoQueueDispatchRequests;
+    if (!queue->queued)
+        state |= WdfIoQueueNoRequests;
+    if (!queue->driver_owned)
+        state |= WdfIoQueueDriverNoRequests;
+
+    if (QueueRequests)
+        *QueueRequests = queue->queued;
+    if (DriverRequests)
+        *DriverRequests = queue->driver_owned;
+
+    pthread_mutex_unlock(&shim_lock);
+
+    return (WDF_IO_QUEUE_STATE)state;
+}
+
+VOID WdfIoQueueStart(WDFQUEUE Queue)
+{
+    struct shim_queue *queue = (struct shim_queue *)Queue;
+
+    pthread_mutex_lock(&shim_lock);
+    queue->accepting = TRUE;
+    queue->dispatching = TRUE;
+    pthread_mutex_unlock(&shim_lock);
+
+    shim_queue_dispatch(queue);
+}
+
+static void shim_queue_wait_idle(struct shim_queue *queue)
+{
+    pthread_mutex_lock(&shim_lock);
+    while (queue->driver_owned)
+        pthread_cond_wait(&shim_idle_cond, &shim_lock);
+    pthread_mutex_unlock(&shim_lock);
+}
+
+/* The callbacks for Stop and Purge are called before returning rather
+   than once the driver's requests are back */
+VOID WdfIoQueueStop(WDFQUEUE Queue, PFN_WDF_IO_QUEUE_STATE StopComplete, WDFCONTEXT Context)
+{
+    struct shim_queue *queue = (struct shim_queue *)Queue;
+
+    pthread_mutex_lock(&shim_lock);
+    queue->dispatching = FALSE;
+    pthread_mutex_unlock(&shim_lock);
+
+    if (StopComplete)
+        StopComplete(Queue, Context);
+}
+
+VOID WdfIoQueueStopSynchronously(WDFQUEUE Queue)
+{
+    WdfIoQueueStop(Queue, NULL, NULL);
+    shim_queue_wait_idle((struct shim_queue *)Queue);
+}
+
+VOID WdfIoQueuePurge(WDFQUEUE Queue, PFN_WDF_IO_QUEUE_STATE PurgeComplete, WDFCONTEXT Context)
+{
+    struct shim_queue *queue = (struct shim_queue *)Queue;
+    LIST_ENTRY purged;
+
+    InitializeListHead(&purged);
+
+    pthread_mutex_lock(&shim_lock);
+
+    queue->accepting = FALSE;
+
+    while (!IsListEmpty(&queue->requests)) {
+        struct shim_request *request = CONTAINING_RECORD(queue->requests.Flink, struct shim_request, entry);
+
+        shim_queue_take(queue, request);
+        InsertTailList(&purged, &request->entry);
+    }
+
+    pthread_mutex_unlock(&shim_lock);
+
+    while (!IsListEmpty(&purged)) {
+        struct shim_request *request = CONTAINING_RECORD(RemoveHeadList(&purged), struct shim_request, entry);
+
+        InitializeListHead(&request->entry);
+
+        if (queue->config.EvtIoCanceledOnQueue) {
+            if (queue->serialized)
+                pthread_mutex_lock(&queue->header.device->lock);
+
+            queue->config.EvtIoCanceledOnQueue(Queue, &request->header);
+
+            if (queue->serialized)
+                pthread_mutex_unlock(&queue->header.device->lock);
+        }
+        else {
+            shim_request_finish(request, STATUS_CANCELLED, 0);
+        }
+    }
+
+    if (PurgeComplete)
+        PurgeComplete(Queue, Context);
+}
+
+VOID WdfIoQueuePurgeSynchronously(WDFQUEUE Queue)
+{
+    WdfIoQueuePurge(Queue, NULL, NULL);
+    shim_queue_wait_idle((struct shim_queue *)Queue);
+}
+
+/* DPCs and timers */
+static struct shim_device *shim_parent_device(PWDF_OBJECT_ATTRIBUTES attributes)
+{
+    return attributes && attributes->ParentObject ? attributes->ParentObject->device : NULL;
+}
+
+static void shim_dpc_run(struct shim_deferred *deferred)
+{
+    struct shim_dpc *dpc = CONTAINING_RECORD(deferred, struct shim_dpc, deferred);
+
+    if (dpc->serialized)
+        pthread_mutex_lock(&dpc->header.device->lock);
+
+    dpc->config.EvtDpcFunc(&dpc->header);
+
+    if (dpc->serialized)
+        pthread_mutex_unlock(&dpc->header.device->lock);
+}
+
+NTSTATUS WdfDpcCreate(PWDF_DPC_CONFIG Config, PWDF_OBJECT_ATTRIBUTES Attributes, WDFDPC *Dpc)
+{
+    struct shim_device *device = shim_parent_device(Attributes);
+    struct shim_dpc *dpc;
+    NTSTATUS status;
+
+    if (!Attributes || !Attributes->ParentObject)
+        return STATUS_INVALID_PARAMETER;
+
+    dpc = calloc(1, sizeof(*dpc));
+    if (!dpc)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    dpc->deferred.run = shim_dpc_run;
+
+    status = shim_object_init(&dpc->header, ShimDpc, device, Attributes->ParentObject, Attributes);
+    if (!NT_SUCCESS(status)) {
+        shim_object_free(&dpc->header);
+        return status;
+    }
+
+    dpc->config = *Config;
+    dpc->serialized = Config->AutomaticSerialization && device && device->serialized;
+
+    *Dpc = &dpc->header;
+
+    return STATUS_SUCCESS;
+}
+
+BOOLEAN WdfDpcEnqueue(WDFDPC Dpc)
+{
+    BOOLEAN queued;
+
+    pthread_mutex_lock(&shim_lock);
+    queued = shim_defer(&((struct shim_dpc *)Dpc)->deferred);
+    pthread_mutex_unlock(&shim_lock);
+
+    return queued;
+}
+
+BOOLEAN WdfDpcCancel(WDFDPC Dpc, BOOLEAN Wait)
+{
+    return shim_defer_cancel(&((struct shim_dpc *)Dpc)->deferred, Wait);
+}
+
+WDFOBJECT WdfDpcGetParentObject(WDFDPC Dpc)
+{
+    return Dpc->parent;
+}
+
+static void shim_timer_run(struct shim_deferred *deferred)
+{
+    struct shim_timer *timer = CONTAINING_RECORD(deferred, struct shim_timer, deferred);
+
+    if (timer->serialized)
+        pthread_mutex_lock(&timer->header.device->lock);
+
+    timer->config.EvtTimerFunc(&timer->header);
+
+    if (timer->serialized)
+        pthread_mutex_unlock(&timer->header.device->lock);
+}
+
+NTSTATUS WdfTimerCreate(PWDF_TIMER_CONFIG Config, PWDF_OBJECT_ATTRIBUTES Attributes, WDFTIMER *Timer)
+{
+    struct shim_device *device = shim_parent_device(Attributes);
+    struct shim_timer *timer;
+    NTSTATUS status;
+
+    if (!Attributes || !Attributes->ParentObject)
+        return STATUS_INVALID_PARAMETER;
+
+    timer = calloc(1, sizeof(*timer));
+    if (!timer)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    timer->deferred.run = shim_timer_run;
+    InitializeListHead(&timer->timer_entry);
+
+    status = shim_object_init(&timer->header, ShimTimer, device, Attributes->ParentObject, Attributes);
+    if (!NT_SUCCESS(status)) {
+        shim_object_free(&timer->header);
+        return status;
+    }
+
+    timer->config = *Config;
+    timer->serialized = Config->AutomaticSerialization && device && device->serialized;
+
+    *Timer = &timer->header;
+
+    return STATUS_SUCCESS;
+}
+
+/* TRUE if the timer was already set */
+BOOLEAN WdfTimerStart(WDFTIMER Timer, LONGLONG DueTime)
+{
+    struct shim_timer *timer = (struct shim_timer *)Timer;
+    BOOLEAN armed;
+
+    pthread_mutex_lock(&shim_lock);
+
+    armed = timer->armed;
+    if (armed)
+        RemoveEntryList(&timer->timer_entry);
+
+    timer->due = shim_due(DueTime);
+    if (shim_timer_resolution)
+        timer->due = (timer->due + shim_timer_resolution - 1) / shim_timer_resolution * shim_timer_resolution;
+
+    shim_timer_insert(timer);
+
+    pthread_mutex_unlock(&shim_lock);
+
+    return armed;
+}
+
+/* TRUE if the timer was set and now won't go off. A timer that has gone
+   off but whose callback hasn't run yet still runs it, like a queued
+   DPC. */
+BOOLEAN WdfTimerStop(WDFTIMER Timer, BOOLEAN Wait)
+{
+    struct shim_timer *timer = (struct shim_timer *)Timer;
+    BOOLEAN armed;
+
+    pthread_mutex_lock(&shim_lock);
+
+    armed = timer->armed;
+
+    if (armed) {
+        RemoveEntryList(&timer->timer_entry);
+        timer->armed = FALSE;
+    }
+
+    while (Wait && !shim_on_dpc_thread && (timer->deferred.queued || timer->deferred.running))
+        pthread_cond_wait(&shim_done_cond, &shim_lock);
+
+    pthread_mutex_unlock(&shim_lock);
+
+    return armed;
+}
+
+WDFOBJECT WdfTimerGetParentObject(WDFTIMER Timer)
+{
+    return Timer->parent;
+}
+
+/* Interrupts */
+static void shim_interrupt_dpc_run(struct shim_deferred *deferred)
+{
+    struct shim_interrupt *interrupt = CONTAINING_RECORD(deferred, struct shim_interrupt, dpc);
+
+    if (interrupt->serialized)
+        pthread_mutex_lock(&interrupt->header.device->lock);
+
+    interrupt->config.EvtInterruptDpc(&interrupt->header, &interrupt->header.device->header);
+
+    if (interrupt->serialized)
+        pthread_mutex_unlock(&interrupt->header.device->lock);
+}
+
+NTSTATUS WdfInterruptCreate(WDFDEVICE Device, PWDF_INTERRUPT_CONFIG Configuration,
+                            PWDF_OBJECT_ATTRIBUTES Attributes, WDFINTERRUPT *Interrupt)
+{
+    struct shim_device *device = (struct shim_device *)Device;
+    struct shim_interrupt *interrupt;
+    NTSTATUS status;
+
+    if (device->interrupt)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    interrupt = calloc(1, sizeof(*interrupt));
+    if (!interrupt)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    shim_recursive_init(&interrupt->lock);
+    InitializeListHead(&interrupt->entry);
+    interrupt->dpc.run = shim_interrupt_dpc_run;
+
+    status = shim_object_init(&interrupt->header, ShimInterrupt, device, Device, Attributes);
+    if (!NT_SUCCESS(status)) {
+        shim_object_free(&interrupt->header);
+        return status;
+    }
+
+    interrupt->config = *Configuration;
+    interrupt->serialized = Configuration->AutomaticSerialization && device->serialized;
+    device->interrupt = interrupt;
+
+    *Interrupt = &interrupt->header;
+
+    return STATUS_SUCCESS;
+}
+
+BOOLEAN WdfInterruptSynchronize(WDFINTERRUPT Interrupt, PFN_WDF_INTERRUPT_SYNCHRONIZE Callback,
+                                WDFCONTEXT Context)
+{
+    struct shim_interrupt *interrupt = (struct shim_interrupt *)Interrupt;
+    KIRQL irql = shim_irql;
+    BOOLEAN result;
+
+    pthread_mutex_lock(&interrupt->lock);
+    shim_irql = SHIM_DIRQL;
+    result = Callback(Interrupt, Context);
+    shim_irql = irql;
+    pthread_mutex_unlock(&interrupt->lock);
+
+    return result;
+}
+
+VOID WdfInterruptAcquireLock(WDFINTERRUPT Interrupt)
+{
+    pthread_mutex_lock(&((struct shim_interrupt *)Interrupt)->lock);
+}
+
+VOID WdfInterruptReleaseLock(WDFINTERRUPT Interrupt)
+{
+    pthread_mutex_unlock(&((struct shim_interrupt *)Interrupt)->lock);
+}
+
+WDFDEVICE WdfInterruptGetDevice(WDFINTERRUPT Interrupt)
+{
+    return &Interrupt->device->header;
+}
+
+VOID WdfInterruptGetInfo(WDFINTERRUPT Interrupt, PWDF_INTERRUPT_INFO Info)
+{
+    struct shim_device *device = Interrupt->device;
+    ULONG i;
+
+    WDF_INTERRUPT_INFO_INIT(Info);
+
+    for (i = 0; i < device->config.ResourceCount; i++) {
+        PCM_PARTIAL_RESOURCE_DESCRIPTOR descriptor = &device->config.Resources[i];
+
+        if (descriptor->Type != CmResourceTypeInterrupt)
+            continue;
+
+        Info->Vector = descriptor->u.Interrupt.Vector;
+        Info->Irql = (KIRQL)descriptor->u.Interrupt.Level;
+        Info->TargetProcessorSet = descriptor->u.Interrupt.Affinity;
+        Info->Mode = (descriptor->Flags & CM_RESOURCE_INTERRUPT_LATCHED) ? Latched : LevelSensitive;
+        Info->ShareDisposition = descriptor->ShareDisposition;
+        break;
+    }
+}
+
+VOID WdfInterruptSetExtendedPolicy(WDFINTERRUPT Interrupt, PWDF_INTERRUPT_EXTENDED_POLICY PolicyAndGroup)
+{
+    UNREFERENCED_PARAMETER(Interrupt);
+    UNREFERENCED_PARAMETER(PolicyAndGroup);
+}
+
+BOOLEAN WdfInterruptQueueDpcForIsr(WDFINTERRUPT Interrupt)
+{
+    struct shim_interrupt *interrupt = (struct shim_interrupt *)Interrupt;
+    BOOLEAN queued;
+
+    if (!interrupt->config.EvtInterruptDpc)
+        return FALSE;
+
+    pthread_mutex_lock(&shim_lock);
+    queued = shim_defer(&interrupt->dpc);
+    pthread_mutex_unlock(&shim_lock);
+
+    return queued;
+}
+
+VOID WdfInterruptEnable(WDFINTERRUPT Interrupt)
+{
+    struct shim_interrupt *interrupt = (struct shim_interrupt *)Interrupt;
+
+    pthread_mutex_lock(&interrupt->lock);
+
+    if (!interrupt->enabled) {
+        if (interrupt->config.EvtInterruptEnable)
+            interrupt->config.EvtInterruptEnable(Interrupt, &Interrupt->device->header);
+        interrupt->enabled = TRUE;
+    }
+
+    pthread_mutex_unlock(&interrupt->lock);
+}
+
+VOID WdfInterruptDisable(WDFINTERRUPT Interrupt)
+{
+    struct shim_interrupt *interrupt = (struct shim_interrupt *)Interrupt;
+
+    pthread_mutex_lock(&interrupt->lock);
+
+    if (interrupt->enabled) {
+        if (interrupt->config.EvtInterruptDisable)
+            interrupt->config.EvtInterruptDisable(Interrupt, &Interrupt->device->header);
+        interrupt->enabled = FALSE;
+    }
+
+    pthread_mutex_unlock(&interrupt->lock);
+}
+
+/* Locks */
+static NTSTATUS shim_lock_create(SHIM_OBJECT_TYPE type, PWDF_OBJECT_ATTRIBUTES attributes, WDFOBJECT *lock)
+{
+    struct shim_lock_object *object = calloc(1, sizeof(*object));
+    WDFOBJECT parent = attributes ? attributes->ParentObject : NULL;
+    NTSTATUS status;
+
+    if (!object)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    pthread_mutex_init(&object->mutex, NULL);
+
+    status = shim_object_init(&object->header, type, parent ? parent->device : NULL, parent, attributes);
+    if (!NT_SUCCESS(status)) {
+        shim_object_free(&object->header);
+        return status;
+    }
+
+    *lock = &object->header;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS WdfWaitLockCreate(PWDF_OBJECT_ATTRIBUTES LockAttributes, WDFWAITLOCK *Lock)
+{
+    return shim_lock_create(ShimWaitLock, LockAttributes, Lock);
+}
+
+NTSTATUS WdfWaitLockAcquire(WDFWAITLOCK Lock, PLONGLONG Timeout)
+{
+    pthread_mutex_t *mutex = &((struct shim_lock_object *)Lock)->mutex;
+    struct timespec ts;
+
+    if (!Timeout) {
+        pthread_mutex_lock(mutex);
+        return STATUS_SUCCESS;
+    }
+
+    if (!*Timeout)
+        return pthread_mutex_trylock(mutex) ? STATUS_TIMEOUT : STATUS_SUCCESS;
+
+    /* timedlock only takes the realtime clock */
+    clock_gettime(CLOCK_REALTIME, &ts);
+    {
+        ULONGLONG ns = (ULONGLONG)ts.tv_sec * 1000000000ULL + ts.tv_nsec + (shim_due(*Timeout) - shim_now());
+
+        shim_timespec(&ts, ns);
+    }
+
+    return pthread_mutex_timedlock(mutex, &ts) ? STATUS_TIMEOUT : STATUS_SUCCESS;
+}
+
+VOID WdfWaitLockRelease(WDFWAITLOCK Lock)
+{
+    pthread_mutex_unlock(&((struct shim_lock_object *)Lock)->mutex);
+}
+
+NTSTATUS WdfSpinLockCreate(PWDF_OBJECT_ATTRIBUTES SpinLockAttributes, WDFSPINLOCK *SpinLock)
+{
+    return shim_lock_create(ShimSpinLock, SpinLockAttributes, SpinLock);
+}
+
+VOID WdfSpinLockAcquire(WDFSPINLOCK SpinLock)
+{
+    pthread_mutex_lock(&((struct shim_lock_object *)SpinLock)->mutex);
+}
+
+VOID WdfSpinLockRelease(WDFSPINLOCK SpinLock)
+{
+    pthread_mutex_unlock(&((struct shim_lock_object *)SpinLock)->mutex);
+}
+
+/* Deleting objects. Children go first and each object's own work is
+   stopped before its cleanup callbacks run. */
+static void shim_object_free(WDFOBJECT object)
+{
+    struct shim_context *context, *next;
+
+    for (;;) {
+        WDFOBJECT child = NULL;
+
+        pthread_mutex_lock(&shim_lock);
+        if (!IsListEmpty(&object->children))
+            child = CONTAINING_RECORD(object->children.Blink, struct WDF_SHIM_OBJECT, sibling);
+        pthread_mutex_unlock(&shim_lock);
+
+        if (!child)
+            break;
+
+        shim_object_free(child);
+    }
+
+    switch (object->type) {
+    case ShimDpc:
+        shim_defer_cancel(&((struct shim_dpc *)object)->deferred, TRUE);
+        break;
+
+    case ShimTimer:
+        WdfTimerStop(object, TRUE);
+        break;
+
+    case ShimInterrupt: {
+        struct shim_interrupt *interrupt = (struct shim_interrupt *)object;
+
+        pthread_mutex_lock(&shim_lock);
+        if (interrupt->connected) {
+            RemoveEntryList(&interrupt->entry);
+            interrupt->connected = FALSE;
+        }
+        pthread_mutex_unlock(&shim_lock);
+
+        shim_isr_sync();
+        shim_defer_cancel(&interrupt->dpc, TRUE);
+
+        if (object->device && object->device->interrupt == interrupt)
+            object->device->interrupt = NULL;
+        break;
+    }
+
+    case ShimQueue: {
+        struct shim_queue *queue = (struct shim_queue *)object;
+
+        WdfIoQueuePurge(object, NULL, NULL);
+
+        if (object->device && object->device->default_queue == queue)
+            object->device->default_queue = NULL;
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    for (context = object->contexts; context; context = context->next) {
+        if (context->cleanup)
+            context->cleanup(object);
+    }
+
+    for (context = object->contexts; context; context = context->next) {
+        if (context->destroy)
+            context->destroy(object);
+    }
+
+    for (context = object->contexts; context; context = next) {
+        next = context->next;
+        free(context);
+    }
+
+    if (object->parent) {
+        pthread_mutex_lock(&shim_lock);
+        RemoveEntryList(&object->sibling);
+        pthread_mutex_unlock(&shim_lock);
+    }
+
+    switch (object->type) {
+    case ShimDevice: {
+        struct shim_device *device = (struct shim_device *)object;
+
+        pthread_mutex_destroy(&device->lock);
+        free(device->registry.values);
+        break;
+    }
+
+    case ShimInterrupt:
+        pthread_mutex_destroy(&((struct shim_interrupt *)object)->lock);
+        break;
+
+    case ShimWaitLock:
+    case ShimSpinLock:
+        pthread_mutex_destroy(&((struct shim_lock_object *)object)->mutex);
+        break;
+
+    default:
+        break;
+    }
+
+    free(object);
+}
+
+/* Pool */
+SIZE_T WdfShimCompareMemory(const void *a, const void *b, SIZE_T length)
+{
+    const UCHAR *x = a, *y = b;
+    SIZE_T i;
+
+    for (i = 0; i < length && x[i] == y[i]; i++)
+        ;
+
+    return i;
+}
+
+PVOID ExAllocatePool2(POOL_FLAGS Flags, SIZE_T NumberOfBytes, ULONG Tag)
+{
+    UNREFERENCED_PARAMETER(Tag);
+
+    return (Flags & POOL_FLAG_UNINITIALIZED) ? malloc(NumberOfBytes) : calloc(1, NumberOfBytes);
+}
+
+PVOID ExAllocatePoolWithTag(POOL_TYPE PoolType, SIZE_T NumberOfBytes, ULONG Tag)
+{
+    UNREFERENCED_PARAMETER(PoolType);
+    UNREFERENCED_PARAMETER(Tag);
+
+    return malloc(NumberOfBytes);
+}
+
+VOID ExFreePool(PVOID P)
+{
+    free(P);
+}
+
+VOID ExFreePoolWithTag(PVOID P, ULONG Tag)
+{
+    UNREFERENCED_PARAMETER(Tag);
+
+    free(P);
+}
+
+/* IRQL and spin locks */
+VOID KeInitializeSpinLock(PKSPIN_LOCK SpinLock)
+{
+    *SpinLock = 0;
+}
+
+VOID KeAcquireSpinLock(PKSPIN_LOCK SpinLock, PKIRQL OldIrql)
+{
+    *OldIrql = shim_irql;
+
+    while (__atomic_exchange_n(SpinLock, 1, __ATOMIC_ACQUIRE))
+        sched_yield();
+
+    if (shim_irql < DISPATCH_LEVEL)
+        shim_irql = DISPATCH_LEVEL;
+}
+
+VOID KeReleaseSpinLock(PKSPIN_LOCK SpinLock, KIRQL NewIrql)
+{
+    __atomic_store_n(SpinLock, 0, __ATOMIC_RELEASE);
+    shim_irql = NewIrql;
+}
+
+KIRQL KeGetCurrentIrql(void)
+{
+    return shim_irql;
+}
+
+VOID KeRaiseIrql(KIRQL NewIrql, PKIRQL OldIrql)
+{
+    *OldIrql = shim_irql;
+    shim_irql = NewIrql;
+}
+
+VOID KeLowerIrql(KIRQL NewIrql)
+{
+    shim_irql = NewIrql;
+}
+
+/* Time */
+LARGE_INTEGER KeQueryPerformanceCounter(PLARGE_INTEGER PerformanceFrequency)
+{
+    LARGE_INTEGER counter;
+
+    if (PerformanceFrequency)
+        PerformanceFrequency->QuadPart = 10000000;
+
+    counter.QuadPart = (LONGLONG)(shim_now() / 100);
+
+    return counter;
+}
+
+VOID KeQuerySystemTime(PLARGE_INTEGER CurrentTime)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    CurrentTime->QuadPart = (LONGLONG)ts.tv_sec * 10000000 + ts.tv_nsec / 100 + 116444736000000000LL;
+}
+
+ULONGLONG KeQueryInterruptTime(void)
+{
+    return shim_now() / 100;
+}
+
+VOID KeQueryTickCount(PLARGE_INTEGER TickCount)
+{
+    TickCount->QuadPart = (LONGLONG)(KeQueryInterruptTime() / KeQueryTimeIncrement());
+}
+
+ULONG KeQueryTimeIncrement(void)
+{
+    return 156250;
+}
+
+VOID KeStallExecutionProcessor(ULONG MicroSeconds)
+{
+    ULONGLONG end = shim_now() + (ULONGLONG)MicroSeconds * 1000;
+
+    while (shim_now() < end)
+        __builtin_ia32_pause();
+}
+
+NTSTATUS KeDelayExecutionThread(KPROCESSOR_MODE WaitMode, BOOLEAN Alertable, PLARGE_INTEGER Interval)
+{
+    ULONGLONG due = shim_due(Interval->QuadPart);
+    struct timespec ts;
+
+    UNREFERENCED_PARAMETER(WaitMode);
+    UNREFERENCED_PARAMETER(Alertable);
+
+    shim_timespec(&ts, due);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+
+    return STATUS_SUCCESS;
+}
+
+/* Events. They all share one condition, there are never many waiting. */
+VOID KeInitializeEvent(PRKEVENT Event, EVENT_TYPE Type, BOOLEAN State)
+{
+    Event->Type = Type;
+    Event->State = State;
+}
+
+LONG KeSetEvent(PRKEVENT Event, KPRIORITY Increment, BOOLEAN Wait)
+{
+    LONG previous;
+
+    UNREFERENCED_PARAMETER(Increment);
+    UNREFERENCED_PARAMETER(Wait);
+
+    pthread_mutex_lock(&shim_lock);
+    previous = Event->State;
+    Event->State = 1;
+    pthread_cond_broadcast(&shim_event_cond);
+    pthread_mutex_unlock(&shim_lock);
+
+    return previous;
+}
+
+VOID KeClearEvent(PRKEVENT Event)
+{
+    pthread_mutex_lock(&shim_lock);
+    Event->State = 0;
+    pthread_mutex_unlock(&shim_lock);
+}
+
+NTSTATUS KeWaitForSingleObject(PVOID Object, KWAIT_REASON WaitReason, KPROCESSOR_MODE WaitMode,
+                               BOOLEAN Alertable, PLARGE_INTEGER Timeout)
+{
+    PRKEVENT event = Object;
+    NTSTATUS status = STATUS_SUCCESS;
+    struct timespec ts;
+
+    UNREFERENCED_PARAMETER(WaitReason);
+    UNREFERENCED_PARAMETER(WaitMode);
+    UNREFERENCED_PARAMETER(Alertable);
+
+    if (Timeout)
+        shim_timespec(&ts, shim_due(Timeout->QuadPart));
+
+    pthread_mutex_lock(&shim_lock);
+
+    while (!event->State) {
+        if (!Timeout) {
+            pthread_cond_wait(&shim_event_cond, &shim_lock);
+        }
+        else if (pthread_cond_timedwait(&shim_event_cond, &shim_lock, &ts) == ETIMEDOUT) {
+            status = STATUS_TIMEOUT;
+            break;
+        }
+    }
+
+    if (status == STATUS_SUCCESS && event->Type == SynchronizationEvent)
+        event->State = 0;
+
+    pthread_mutex_unlock(&shim_lock);
+
+    return status;
+}
+
+/* There are no KDPCs or KTIMERs, the driver only uses the framework's */
+BOOLEAN KeInsertQueueDpc(PRKDPC Dpc, PVOID SystemArgument1, PVOID SystemArgument2)
+{
+    UNREFERENCED_PARAMETER(Dpc);
+    UNREFERENCED_PARAMETER(SystemArgument1);
+    UNREFERENCED_PARAMETER(SystemArgument2);
+
+    return FALSE;
+}
+
+BOOLEAN KeSetTimerEx(PKTIMER Timer, LARGE_INTEGER DueTime, LONG Period, PKDPC Dpc)
+{
+    UNREFERENCED_PARAMETER(Timer);
+    UNREFERENCED_PARAMETER(DueTime);
+    UNREFERENCED_PARAMETER(Period);
+    UNREFERENCED_PARAMETER(Dpc);
+
+    return FALSE;
+}
+
+/* IRPs. The only IRPs are the ones the shim builds: preprocessed
+   requests, and PCI config space reads the device object answers as its
+   own bus driver. */
+PIO_STACK_LOCATION IoGetNextIrpStackLocation(PIRP Irp)
+{
+    return Irp->StackLocation;
+}
+
+PIO_STACK_LOCATION IoGetCurrentIrpStackLocation(PIRP Irp)
+{
+    return Irp->StackLocation;
+}
+
+PDRIVER_CANCEL IoSetCancelRoutine(PIRP Irp, PDRIVER_CANCEL CancelRoutine)
+{
+    UNREFERENCED_PARAMETER(Irp);
+    UNREFERENCED_PARAMETER(CancelRoutine);
+
+    return NULL;
+}
+
+PDEVICE_OBJECT IoGetAttachedDeviceReference(PDEVICE_OBJECT DeviceObject)
+{
+    return DeviceObject;
+}
+
+VOID ObDereferenceObject(PVOID Object)
+{
+    UNREFERENCED_PARAMETER(Object);
+}
+
+PIRP IoBuildSynchronousFsdRequest(ULONG MajorFunction, PDEVICE_OBJECT DeviceObject, PVOID Buffer,
+                                  ULONG Length, PLARGE_INTEGER StartingOffset, PKEVENT Event,
+                                  PIO_STATUS_BLOCK IoStatusBlock)
+{
+    struct shim_irp *irp = calloc(1, sizeof(*irp));
+
+    UNREFERENCED_PARAMETER(StartingOffset);
+
+    if (!irp)
+        return NULL;
+
+    irp->irp.StackLocation = &irp->stack;
+    irp->irp.AssociatedIrp.SystemBuffer = Buffer;
+    irp->irp.UserEvent = Event;
+    irp->irp.UserIosb = IoStatusBlock;
+    irp->stack.MajorFunction = (UCHAR)MajorFunction;
+    irp->stack.DeviceObject = DeviceObject;
+    irp->stack.Parameters.Read.Length = Length;
+
+    return &irp->irp;
+}
+
+NTSTATUS IoCallDriver(PDEVICE_OBJECT DeviceObject, PIRP Irp)
+{
+    struct shim_device *device = DeviceObject->DeviceExtension;
+    PIO_STACK_LOCATION stack = Irp->StackLocation;
+    NTSTATUS status;
+
+    if (stack->MajorFunction == IRP_MJ_PNP && stack->MinorFunction == IRP_MN_READ_CONFIG &&
+        stack->Parameters.ReadWriteConfig.WhichSpace == PCI_WHICHSPACE_CONFIG) {
+        UCHAR space[SHIM_CONFIG_SPACE] = { 0 };
+        ULONG offset = stack->Parameters.ReadWriteConfig.Offset;
+        ULONG length = stack->Parameters.ReadWriteConfig.Length;
+        ULONG i;
+
+        *(PUSHORT)&space[0x00] = device->config.VendorId;
+        *(PUSHORT)&space[0x02] = device->config.DeviceId;
+        for (i = 0; i < WDF_SHIM_MAX_BARS; i++)
+            *(PULONG)&space[0x10 + i * 4] = device->config.Bars[i];
+
+        if (offset < sizeof(space) && length <= sizeof(space) - offset) {
+            RtlCopyMemory(stack->Parameters.ReadWriteConfig.Buffer, &space[offset], length);
+            Irp->IoStatus.Information = length;
+            Irp->IoStatus.Status = STATUS_SUCCESS;
+        }
+        else {
+            Irp->IoStatus.Information = 0;
+            Irp->IoStatus.Status = STATUS_INVALID_PARAMETER;
+        }
+    }
+    else {
+        Irp->IoStatus.Status = STATUS_NOT_SUPPORTED;
+    }
+
+    status = Irp->IoStatus.Status;
+
+    IoCompleteRequest(Irp, IO_NO_INCREMENT);
+
+    return status;
+}
+
+VOID IoCompleteRequest(PIRP Irp, CCHAR PriorityBoost)
+{
+    struct shim_irp *irp = CONTAINING_RECORD(Irp, struct shim_irp, irp);
+
+    UNREFERENCED_PARAMETER(PriorityBoost);
+
+    if (Irp->UserIosb)
+        *Irp->UserIosb = Irp->IoStatus;
+
+    if (Irp->UserEvent)
+        KeSetEvent(Irp->UserEvent, IO_NO_INCREMENT, FALSE);
+
+    if (irp->completion)
+        irp->completion(irp->completion_context, Irp->IoStatus.Status, Irp->IoStatus.Information);
+
+    free(irp);
+}
+
+static pthread_mutex_t shim_cancel_lock = PTHREAD_MUTEX_INITIALIZER;
+
+VOID IoAcquireCancelSpinLock(PKIRQL Irql)
+{
+    pthread_mutex_lock(&shim_cancel_lock);
+    *Irql = shim_irql;
+    shim_irql = DISPATCH_LEVEL;
+}
+
+VOID IoReleaseCancelSpinLock(KIRQL Irql)
+{
+    shim_irql = Irql;
+    pthread_mutex_unlock(&shim_cancel_lock);
+}
+
+PCONFIGURATION_INFORMATION IoGetConfigurationInformation(void)
+{
+    return &shim_configuration;
+}
+
+PVOID IoAllocateErrorLogEntry(PVOID IoObject, UCHAR EntrySize)
+{
+    UNREFERENCED_PARAMETER(IoObject);
+
+    return calloc(1, EntrySize);
+}
+
+VOID IoWriteErrorLogEntry(PVOID ElEntry)
+{
+    PIO_ERROR_LOG_PACKET packet = ElEntry;
+
+    DbgPrint("wdf-shim: error log %08x\n", packet->ErrorCode);
+
+    free(ElEntry);
+}
+
+BOOLEAN RtlIsNtDdiVersionAvailable(ULONG Version)
+{
+    return Version <= NTDDI_WIN7;
+}
+
+/* Formatting the kernel's way: l is 32 bits, I64 and ll are 64, I and z
+   are pointer sized, %ws and %S take wide strings and %wZ a
+   UNICODE_STRING. Returns the length the whole string would need. */
+static size_t shim_narrow(char *out, size_t size, PCWSTR string, size_t length)
+{
+    size_t i;
+
+    for (i = 0; i < length && i + 1 < size; i++)
+        out[i] = string[i] < 0x80 ? (char)string[i] : '?';
+
+    out[i] = '\0';
+
+    return i;
+}
+
+static size_t shim_vformat(char *out, size_t size, const char *format, va_list arguments)
+{
+    size_t used = 0;
+
+    while (*format) {
+        char spec[32], text[512];
+        size_t spec_length = 0, text_length = 0, i;
+        int bits = 32, wide = 0;
+        char conversion;
+
+        if (*format != '%') {
+            if (used + 1 < size)
+                out[used] = *format;
+            used++;
+            format++;
+            continue;
+        }
+
+        spec[spec_length++] = *format++;
+
+        while (*format && strchr("-+ #0", *format) && spec_length < 8)
+            spec[spec_length++] = *format++;
+
+        if (*format == '*') {
+            spec_length += snprintf(&spec[spec_length], 10, "%d", va_arg(arguments, int));
+            format++;
+        }
+        else {
+            while (*format >= '0' && *format <= '9' && spec_length < 16)
+                spec[spec_length++] = *format++;
+        }
+
+        if (*format == '.') {
+            spec[spec_length++] = *format++;
+
+            if (*format == '*') {
+                spec_length += snprintf(&spec[spec_length], 10, "%d", va_arg(arguments, int));
+                format++;
+            }
+            else {
+                while (*format >= '0' && *format <= '9' && spec_length < 24)
+                    spec[spec_length++] = *format++;
+            }
+        }
+
+        if (!strncmp(format, "I64", 3)) {
+            bits = 64;
+            format += 3;
+        }
+        else if (!strncmp(format, "I32", 3)) {
+            format += 3;
+        }
+        else if (!strncmp(format, "ll", 2)) {
+            bits = 64;
+            format += 2;
+        }
+        else if (*format == 'I' || *format == 'z') {
+            bits = sizeof(size_t) * 8;
+            format++;
+        }
+        else if (*format == 'w') {
+            wide = 1;
+            format++;
+        }
+        else if (*format == 'l' || *format == 'h') {
+            wide = *format == 'l';
+            format++;
+            if (*format == 'h')
+                format++;
+        }
+
+        conversion = *format;
+        if (!conversion)
+            break;
+        format++;
+
+        switch (conversion) {
+        case 'd':
+        case 'i':
+            strcpy(&spec[spec_length], "lld");
+            text_length = snprintf(text, sizeof(text), spec,
+                                   bits == 64 ? va_arg(arguments, long long) : (long long)va_arg(arguments, int));
+            break;
+
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            spec[spec_length++] = 'l';
+            spec[spec_length++] = 'l';
+            spec[spec_length++] = conversion;
+            spec[spec_length] = '\0';
+            text_length = snprintf(text, sizeof(text), spec,
+                                   bits == 64 ? va_arg(arguments, unsigned long long)
+                                              : (unsigned long long)va_arg(arguments, unsigned int));
+            break;
+
+        case 'c':
+        case 'C':
+            strcpy(&spec[spec_length], "c");
+            text_length = snprintf(text, sizeof(text), spec, (char)va_arg(arguments, int));
+            break;
+
+        case 's':
+        case 'S':
+        case 'Z': {
+            char string[256];
+
+            if (conversion == 'Z') {
+                PCUNICODE_STRING unicode = va_arg(arguments, PCUNICODE_STRING);
+
+                if (unicode && unicode->Buffer)
+                    shim_narrow(string, sizeof(string), unicode->Buffer, unicode->Length / sizeof(WCHAR));
+                else
+                    strcpy(string, "(null)");
+            }
+            else if (wide || conversion == 'S') {
+                PCWSTR w = va_arg(arguments, PCWSTR);
+
+                if (w)
+                    shim_narrow(string, sizeof(string), w, wcslen(w));
+                else
+                    strcpy(string, "(null)");
+            }
+            else {
+                const char *s = va_arg(arguments, const char *);
+
+                snprintf(string, sizeof(string), "%s", s ? s : "(null)");
+            }
+
+            strcpy(&spec[spec_length], "s");
+            text_length = snprintf(text, sizeof(text), spec, string);
+            break;
+        }
+
+        case 'p':
+            strcpy(&spec[spec_length], "p");
+            text_length = snprintf(text, sizeof(text), spec, va_arg(arguments, void *));
+            break;
+
+        case 'e':
+        case 'f':
+        case 'g':
+            spec[spec_length++] = conversion;
+            spec[spec_length] = '\0';
+            text_length = snprintf(text, sizeof(text), spec, va_arg(arguments, double));
+            break;
+
+        case '%':
+            text[0] = '%';
+            text_length = 1;
+            break;
+
+        default:
+            text[0] = '%';
+            text[1] = conversion;
+            text_length = 2;
+            break;
+        }
+
+        text_length = min(text_length, sizeof(text) - 1);
+
+        for (i = 0; i < text_length; i++, used++) {
+            if (used + 1 < size)
+                out[used] = text[i];
+        }
+    }
+
+    if (size)
+        out[min(used, size - 1)] = '\0';
+
+    return used;
+}
+
+NTSTATUS RtlStringCbVPrintfA(PCHAR Destination, size_t Size, PCSTR Format, va_list Arguments)
+{
+    if (!Size)
+        return STATUS_INVALID_PARAMETER;
+
+    return shim_vformat(Destination, Size, Format, Arguments) < Size ? STATUS_SUCCESS : STATUS_BUFFER_OVERFLOW;
+}
+
+NTSTATUS RtlStringCbPrintfA(PCHAR Destination, size_t Size, PCSTR Format, ...)
+{
+    va_list arguments;
+    NTSTATUS status;
+
+    va_start(arguments, Format);
+    status = RtlStringCbVPrintfA(Destination, Size, Format, arguments);
+    va_end(arguments);
+
+    return status;
+}
+
+NTSTATUS RtlUnicodeStringPrintf(PUNICODE_STRING DestinationString, PCWSTR Format, ...)
+{
+    size_t characters = DestinationString->MaximumLength / sizeof(WCHAR);
+    char format[256], *text;
+    va_list arguments;
+    size_t length, i;
+
+    if (!characters)
+        return STATUS_INVALID_PARAMETER;
+
+    shim_narrow(format, sizeof(format), Format, wcslen(Format));
+
+    text = malloc(characters);
+    if (!text)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    va_start(arguments, Format);
+    length = shim_vformat(text, characters, format, arguments);
+    va_end(arguments);
+
+    for (i = 0; text[i]; i++)
+        DestinationString->Buffer[i] = (UCHAR)text[i];
+
+    DestinationString->Buffer[i] = UNICODE_NULL;
+    DestinationString->Length = (USHORT)(i * sizeof(WCHAR));
+
+    free(text);
+
+    return length < characters ? STATUS_SUCCESS : STATUS_BUFFER_OVERFLOW;
+}
+
+ULONG DbgPrint(PCSTR Format, ...)
+{
+    char text[1024];
+    va_list arguments;
+
+    if (!shim_debug)
+        return 0;
+
+    va_start(arguments, Format);
+    shim_vformat(text, sizeof(text), Format, arguments);
+    va_end(arguments);
+
+    fputs(text, stderr);
+
+    return 0;
+}
+
+ULONG DbgPrintEx(ULONG ComponentId, ULONG Level, PCSTR Format, ...)
+{
+    char text[1024];
+    va_list arguments;
+
+    UNREFERENCED_PARAMETER(ComponentId);
+    UNREFERENCED_PARAMETER(Level);
+
+    if (!shim_debug)
+        return 0;
+
+    va_start(arguments, Format);
+    shim_vformat(text, sizeof(text), Format, arguments);
+    va_end(arguments);
+
+    fputs(text, stderr);
+
+    return 0;
+}
+
+/* Unicode strings */
+VOID RtlInitUnicodeString(PUNICODE_STRING DestinationString, PCWSTR SourceString)
+{
+    DestinationString->Buffer = (PWSTR)SourceString;
+
+    if (SourceString) {
+        DestinationString->Length = (USHORT)(wcslen(SourceString) * sizeof(WCHAR));
+        DestinationString->MaximumLength = DestinationString->Length + sizeof(WCHAR);
+    }
+    else {
+        DestinationString->Length = DestinationString->MaximumLength = 0;
+    }
+}
+
+static NTSTATUS shim_append(PUNICODE_STRING destination, PCWSTR source, size_t length)
+{
+    size_t bytes = length * sizeof(WCHAR);
+
+    if (destination->Length + bytes > destination->MaximumLength)
+        return STATUS_BUFFER_TOO_SMALL;
+
+    RtlMoveMemory((PUCHAR)destination->Buffer + destination->Length, source, bytes);
+    destination->Length += (USHORT)bytes;
+
+    if (destination->Length + sizeof(WCHAR) <= destination->MaximumLength)
+        destination->Buffer[destination->Length / sizeof(WCHAR)] = UNICODE_NULL;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS RtlAppendUnicodeToString(PUNICODE_STRING Destination, PCWSTR Source)
+{
+    return Source ? shim_append(Destination, Source, wcslen(Source)) : STATUS_SUCCESS;
+}
+
+NTSTATUS RtlAppendUnicodeStringToString(PUNICODE_STRING Destination, PCUNICODE_STRING Source)
+{
+    return shim_append(Destination, Source->Buffer, Source->Length / sizeof(WCHAR));
+}
+
+BOOLEAN RtlEqualUnicodeString(PCUNICODE_STRING String1, PCUNICODE_STRING String2, BOOLEAN CaseInSensitive)
+{
+    size_t i;
+
+    if (String1->Length != String2->Length)
+        return FALSE;
+
+    for (i = 0; i < String1->Length / sizeof(WCHAR); i++) {
+        WCHAR a = String1->Buffer[i], b = String2->Buffer[i];
+
+        if (CaseInSensitive) {
+            a = towupper(a);
+            b = towupper(b);
+        }
+
+        if (a != b)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+NTSTATUS RtlIntegerToUnicodeString(ULONG Value, ULONG Base, PUNICODE_STRING String)
+{
+    WCHAR digits[33];
+    size_t count = 0, i;
+
+    if (!Base)
+        Base = 10;
+
+    if (Base != 2 && Base != 8 && Base != 10 && Base != 16)
+        return STATUS_INVALID_PARAMETER;
+
+    do {
+        digits[count++] = L"0123456789ABCDEF"[Value % Base];
+        Value /= Base;
+    } while (Value);
+
+    if ((count + 1) * sizeof(WCHAR) > String->MaximumLength)
+        return STATUS_BUFFER_OVERFLOW;
+
+    for (i = 0; i < count; i++)
+        String->Buffer[i] = digits[count - 1 - i];
+
+    String->Buffer[count] = UNICODE_NULL;
+    String->Length = (USHORT)(count * sizeof(WCHAR));
+
+    return STATUS_SUCCESS;
+}
@@ -0,0 +1,194 @@
+/*
+    Runs the driver in src/ as a Linux user mode program. The headers in
+    include/ stand in for the WDK's, so every file in src/ builds
+    unchanged, and wdf-shim.c provides the KMDF objects and kernel
+    routines behind them on top of pthreads. Build wdf-shim.c and every
+    .c file in ../../src with
+
+        cc -O2 -pthread -Iinclude -I../../src
+
+    How it runs:
+    - One device lock per device, taken around every callback the driver
+      asked to have serialized with WdfSynchronizationScopeDevice or
+      AutomaticSerialization: queue callbacks, cancel routines, DPCs and
+      timers. It is recursive, like the framework letting a callback call
+      back into the framework.
+    - One lock per interrupt, held around the ISR and
+      WdfInterruptSynchronize callbacks.
+    - One DPC thread runs every DPC and timer callback in the order they
+      became due, like a single processor would.
+    - One interrupt thread runs the hardware (WdfShimBusSetHardware) and
+      calls the ISR of any interrupt whose line is asserted.
+    - Requests go through the device's default queue and on from there
+      the way the driver forwards them. They can't be canceled from
+      outside and there is no power management: a device is in D0 from
+      WdfShimDeviceAdd until WdfShimDeviceRemove.
+
+    Register accesses all go through the bus, which serializes them with
+    one lock, so the hardware model behind it doesn't need its own.
+*/
+
+#ifndef WDF_SHIM_H
+#define WDF_SHIM_H
+
+#include "include/wdf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The bus. A window is a range of I/O ports or of device memory. Offsets
+   passed to the handlers are from the start of the window. A window
+   without ULONG handlers is a register file: it reads back what was
+   written. A window without UCHAR handlers reads 0xff. */
+typedef struct _WDF_SHIM_BUS_HANDLERS {
+    UCHAR (*ReadUChar)(PVOID Context, ULONG Offset);
+    VOID (*WriteUChar)(PVOID Context, ULONG Offset, UCHAR Value);
+    ULONG (*ReadULong)(PVOID Context, ULONG Offset);
+    VOID (*WriteULong)(PVOID Context, ULONG Offset, ULONG Value);
+} WDF_SHIM_BUS_HANDLERS, *PWDF_SHIM_BUS_HANDLERS;
+
+NTSTATUS WdfShimBusAddPorts(ULONG Base, ULONG Length, const WDF_SHIM_BUS_HANDLERS *Handlers,
+                            PVOID Context);
+
+/* Memory at physical Base maps to Address, which is what MmMapIoSpace
+   hands the driver. Address is never dereferenced, only compared. */
+NTSTATUS WdfShimBusAddMemory(ULONGLONG Base, ULONG Length, PVOID Address,
+                             const WDF_SHIM_BUS_HANDLERS *Handlers, PVOID Context);
+
+/* Removes every window whose handlers get Context */
+VOID WdfShimBusRemove(PVOID Context);
+
+/* The hardware behind the bus. Run is called on the interrupt thread
+   with the bus lock held, brings the hardware up to the current time and
+   returns how many nanoseconds until it needs to run again by itself,
+   ~0ULL for never. When that is under SpinNs the interrupt thread spins
+   instead of sleeping. */
+typedef struct _WDF_SHIM_HARDWARE {
+    ULONGLONG (*Run)(PVOID Context);
+    PVOID Context;
+    ULONGLONG SpinNs;
+} WDF_SHIM_HARDWARE, *PWDF_SHIM_HARDWARE;
+
+VOID WdfShimBusSetHardware(const WDF_SHIM_HARDWARE *Hardware);
+
+/* Tells the interrupt thread the hardware needs to run sooner than it
+   last said, for example because a line went active. Any register
+   access from outside the interrupt thread does this already. Safe to
+   call with the bus lock held. */
+VOID WdfShimBusWake(void);
+
+/* For the harness to touch the hardware while the driver is running */
+VOID WdfShimBusLock(void);
+VOID WdfShimBusUnlock(void);
+
+/* The registry. Values for the driver's Parameters key are set with a
+   NULL Device before WdfShimDriverLoad, values for a device's key go in
+   its WDF_SHIM_DEVICE_CONFIG. */
+typedef struct _WDF_SHIM_REGISTRY_VALUE {
+    PCWSTR Name;
+    ULONG Type;         /* REG_DWORD or REG_SZ */
+    ULONG Value;
+    PCWSTR String;
+} WDF_SHIM_REGISTRY_VALUE, *PWDF_SHIM_REGISTRY_VALUE;
+
+NTSTATUS WdfShimSetRegistryValue(WDFDEVICE Device, const WDF_SHIM_REGISTRY_VALUE *Value);
+
+/* Calls DriverEntry and keeps the driver the framework creates */
+NTSTATUS WdfShimDriverLoad(DRIVER_INITIALIZE *DriverEntry);
+
+/* Removes any devices left, stops the threads and deletes the driver */
+VOID WdfShimDriverUnload(void);
+
+/* Timers go off on the first multiple of Nanoseconds on the monotonic
+   clock after they're due, the way Windows only looks at its timers on a
+   clock tick. 0, the default, runs them as soon as they're due. */
+VOID WdfShimSetTimerResolution(ULONGLONG Nanoseconds);
+
+/* What the bus says about a device. The config space words the driver
+   reads are DeviceId at 0x02 and the BARs from 0x10. Resources are given
+   to EvtDevicePrepareHardware as both the raw and the translated list.
+   InterruptAsserted is called with the bus lock held. */
+#define WDF_SHIM_MAX_RESOURCES 4
+#define WDF_SHIM_MAX_BARS 6
+
+typedef struct _WDF_SHIM_DEVICE_CONFIG {
+    USHORT VendorId;
+    USHORT DeviceId;
+    ULONG Bars[WDF_SHIM_MAX_BARS];
+    CM_PARTIAL_RESOURCE_DESCRIPTOR Resources[WDF_SHIM_MAX_RESOURCES];
+    ULONG ResourceCount;
+    BOOLEAN (*InterruptAsserted)(PVOID Context);
+    PVOID InterruptContext;
+    const WDF_SHIM_REGISTRY_VALUE *Registry;
+    ULONG RegistryCount;
+} WDF_SHIM_DEVICE_CONFIG, *PWDF_SHIM_DEVICE_CONFIG;
+
+/* Adds a device and starts it: EvtDriverDeviceAdd, then
+   EvtDevicePrepareHardware, EvtDeviceD0Entry, the interrupt's
+   EvtInterruptEnable and EvtDeviceD0EntryPostInterruptsEnabled. */
+NTSTATUS WdfShimDeviceAdd(const WDF_SHIM_DEVICE_CONFIG *Config, WDFDEVICE *Device);
+
+/* Stops a device the reverse way and deletes it */
+VOID WdfShimDeviceRemove(WDFDEVICE Device);
+
+/* A handle open on the device, through EvtDeviceFileCreate and
+   EvtFileClose. A device has one handle open at most. */
+NTSTATUS WdfShimDeviceOpen(WDFDEVICE Device);
+VOID WdfShimDeviceClose(WDFDEVICE Device);
+
+/* What the device's ISR has cost since it was added or the stats were
+   cleared. Calls counts every time the ISR ran, Claimed the times it
+   returned TRUE. */
+typedef struct _WDF_SHIM_INTERRUPT_STATS {
+    ULONGLONG Calls;
+    ULONGLONG Claimed;
+    ULONGLONG Nanoseconds;      /* spent inside the ISR */
+} WDF_SHIM_INTERRUPT_STATS, *PWDF_SHIM_INTERRUPT_STATS;
+
+VOID WdfShimDeviceGetInterruptStats(WDFDEVICE Device, PWDF_SHIM_INTERRUPT_STATS Stats);
+VOID WdfShimDeviceClearInterruptStats(WDFDEVICE Device);
+
+/* What each of the device's DPCs and timers has cost since it was added
+   or the stats were cleared. Waiting runs from when a DPC was queued, or
+   a timer was due, to when its callback started; running includes
+   waiting for the device lock when it's serialized. GetDpcStats fills
+   up to Count of them and returns how many the device has. */
+typedef struct _WDF_SHIM_DPC_STATS {
+    PVOID Callback;             /* EvtDpcFunc or EvtTimerFunc */
+    BOOLEAN Timer;
+    ULONGLONG Runs;
+    ULONGLONG WaitNs;
+    ULONGLONG MaxWaitNs;
+    ULONGLONG RunNs;
+    ULONGLONG MaxRunNs;
+} WDF_SHIM_DPC_STATS, *PWDF_SHIM_DPC_STATS;
+
+ULONG WdfShimDeviceGetDpcStats(WDFDEVICE Device, PWDF_SHIM_DPC_STATS Stats, ULONG Count);
+VOID WdfShimDeviceClearDpcStats(WDFDEVICE Device);
+
+/* Sends a request to the device's default queue. Reads fill
+   OutputBuffer, writes send InputBuffer. Device control requests get a
+   system buffer for METHOD_BUFFERED the way the I/O manager gives one.
+   Completion is called once, on whatever thread completes the request,
+   possibly before WdfShimRequestSend returns and possibly with the device
+   lock held, so it must not wait on the driver. The buffers have to stay
+   put until then. */
+typedef VOID WDF_SHIM_REQUEST_COMPLETION(PVOID Context, NTSTATUS Status, ULONG_PTR Information);
+
+VOID WdfShimRequestSend(WDFDEVICE Device, WDF_REQUEST_TYPE Type, ULONG IoControlCode,
+                        PVOID InputBuffer, size_t InputLength,
+                        PVOID OutputBuffer, size_t OutputLength,
+                        WDF_SHIM_REQUEST_COMPLETION *Completion, PVOID Context);
+
+/* Sends a request and waits for it to complete */
+NTSTATUS WdfShimRequestSendSynchronously(WDFDEVICE Device, WDF_REQUEST_TYPE Type, ULONG IoControlCode,
+                                         PVOID InputBuffer, size_t InputLength,
+                                         PVOID OutputBuffer, size_t OutputLength,
+                                         PULONG_PTR Information);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,162 @@
+/*
+    Generates lib/raw/clock-table-335.h, the sorted table of frequencies
+    the 335's ICS30702 clock generator can make, which
+    calculate_clock_bits_335 looks rates up in.
+
+    The settings are found the same way GetICS30702Data used to search
+    them, including its 32-bit range arithmetic, so the table gives the
+    same bits that search gave on Windows. test-335-clock-table.c checks
+    lookups in the table against that search.
+
+        cc -o gen-335-clock-table gen-335-clock-table.c
+        ./gen-335-clock-table > ../lib/raw/clock-table-335.h
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define INPUT_FREQUENCY 18432000u
+
+struct setting {
+    uint32_t frequency;
+    uint32_t od;
+    uint32_t rdw;
+    uint32_t vdw;
+};
+
+/* Highest rate each output divider may be used for, 0 if it never is. */
+static uint32_t max_rate(uint32_t od)
+{
+    switch (od) {
+    case 2: return 180000000;
+    case 3: return 120000000;
+    case 4: return 90000000;
+    case 5: return 72000000;
+    case 6: return 60000000;
+    case 7: return 50000000;
+    case 8: return 45000000;
+    case 10: return 36000000;
+    default: return 0;
+    }
+}
+
+static uint32_t od_bits(uint32_t od)
+{
+    switch (od) {
+    case 2: return 0x11;
+    case 3: return 0x16;
+    case 4: return 0x13;
+    case 5: return 0x14;
+    case 6: return 0x17;
+    case 7: return 0x15;
+    case 8: return 0x12;
+    default: return 0x10;
+    }
+}
+
+/* By frequency, then output divider, then the order the search prefers
+   settings of the same frequency in: lowest rdw, then highest vdw. */
+static int compare_setting(const void *a, const void *b)
+{
+    const struct setting *x = a, *y = b;
+
+    if (x->frequency != y->frequency)
+        return x->frequency < y->frequency ? -1 : 1;
+
+    if (x->od != y->od)
+        return x->od < y->od ? -1 : 1;
+
+    if (x->rdw != y->rdw)
+        return x->rdw < y->rdw ? -1 : 1;
+
+    return (x->vdw < y->vdw) - (x->vdw > y->vdw);
+}
+
+int main(void)
+{
+    static struct setting settings[8 * 127 * 508];
+    size_t count = 0, kept = 0, i;
+    uint32_t od, rdw, vdw;
+
+    for (od = 2; od <= 10; od++) {
+        if (!max_rate(od))
+            continue;
+
+        for (rdw = 1; rdw <= 127; rdw++) {
+            for (vdw = 4; vdw <= 511; vdw++) {
+                uint32_t range1 = (INPUT_FREQUENCY * 2 * (vdw + 8)) / (rdw + 2);
+                uint32_t range2 = INPUT_FREQUENCY / (rdw + 2);
+
+                if (range1 <= 60000000 || range1 >= 360000000 || range2 <= 200000)
+                    continue;
+
+                settings[count].frequency = ((INPUT_FREQUENCY * 2) / ((rdw + 2) * od)) * (vdw + 8);
+                settings[count].od = od;
+                settings[count].rdw = rdw;
+                settings[count].vdw = vdw;
+                count++;
+            }
+        }
+    }
+
+    qsort(settings, count, sizeof(settings[0]), compare_setting);
+
+    /* The output dividers allowed for a rate are always 2 up to some
+       limit, so of the settings for one frequency a higher divider is
+       only worth keeping when the search would prefer it to all the
+       lower ones. Settings too far above their divider's highest rate
+       are never within the 10% the search looks. */
+    for (i = 0; i < count; ) {
+        uint32_t frequency = settings[i].frequency;
+        uint32_t best_rdw = 128, best_vdw = 0;
+
+        for (; i < count && settings[i].frequency == frequency; i++) {
+            const struct setting *s = &settings[i];
+            uint32_t limit = max_rate(s->od);
+
+            if (s->frequency > limit + limit / 10)
+                continue;
+
+            if (s->rdw > best_rdw || (s->rdw == best_rdw && s->vdw <= best_vdw))
+                continue;
+
+            best_rdw = s->rdw;
+            best_vdw = s->vdw;
+            settings[kept++] = *s;
+        }
+    }
+
+    printf("/*\n");
+    printf("    Generated by tools/gen-335-clock-table.c, do not edit.\n");
+    printf("\n");
+    printf("    Frequencies the ICS30702 can make from %u Hz, lowest first. Each\n", INPUT_FREQUENCY);
+    printf("    entry holds the clock bits for it, see GetICS30702Data.\n");
+    printf("*/\n");
+    printf("\n");
+    printf("#ifndef CLOCK_TABLE_335_H\n");
+    printf("#define CLOCK_TABLE_335_H\n");
+    printf("\n");
+    printf("#include <stdint.h>\n");
+    printf("\n");
+    printf("#define CLOCK_TABLE_335_SIZE %lu\n", (unsigned long)kept);
+    printf("\n");
+    printf("static const struct clock_table_335_entry {\n");
+    printf("    uint32_t frequency;\n");
+    printf("    uint32_t bits;\n");
+    printf("} clock_table_335[CLOCK_TABLE_335_SIZE] = {\n");
+
+    for (i = 0; i < kept; i++) {
+        const struct setting *s = &settings[i];
+
+        printf("%s{%lu,0x%06lx}%s", i % 4 ? "" : "    ", (unsigned long)s->frequency,
+               (unsigned long)(od_bits(s->od) << 16 | s->vdw << 7 | s->rdw),
+               i + 1 == kept ? "\n" : i % 4 == 3 ? ",\n" : ",");
+    }
+
+    printf("};\n");
+    printf("\n");
+    printf("#endif\n");
+
+    return 0;
+}
@@ -0,0 +1,184 @@
+/*
+    Generates lib/raw/clock-table-standard.h, the clock bits for the
+    clock rates people usually ask for, so the driver and
+    calculate-clock-bits.c can look them up instead of searching.
+
+    The bits come from the driver's own solvers in src/clockgen.h, which
+    give the same answers as calculate-clock-bits.c. Each FSCC entry is
+    solved with the least ppm that has a setting, up to
+    FSCC_CLOCK_RATE_PPM. The search always keeps the closest setting it
+    finds, so the entry is what any ppm from that one up would give.
+    Rates with no setting that close are left out.
+
+    The rates are given on the command line, or the built in list below is
+    used.
+
+        cc -o gen-standard-clocks gen-standard-clocks.c
+        ./gen-standard-clocks > ../lib/raw/clock-table-standard.h
+        ./gen-standard-clocks 14745600 24000000 > ../lib/raw/clock-table-standard.h
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../src/clockgen.h"
+
+/* The same limits as src/serial.h */
+#define FSCC_MIN_CLOCK_RATE 200
+#define FSCC_MAX_CLOCK_RATE 270000000
+#define FSCC_CLOCK_RATE_PPM 10
+#define PCI_MIN_CLOCK_RATE 6000000
+#define PCI_MAX_CLOCK_RATE 180000000
+
+static const unsigned long default_rates[] = {
+    1843200, 3686400, 7372800, 8000000, 10000000, 11059200, 12000000,
+    14745600, 16000000, 18432000, 20000000, 22118400, 24000000, 25000000,
+    29491200, 32000000, 33000000, 36864000, 40000000, 44236800, 48000000,
+    50000000, 58982400, 64000000, 73728000, 100000000, 125000000,
+    147456000, 160000000
+};
+
+static int compare_rate(const void *a, const void *b)
+{
+    unsigned long x = *(const unsigned long *)a, y = *(const unsigned long *)b;
+
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long *rates;
+    size_t count, kept, i;
+    unsigned j;
+
+    if (argc > 1) {
+        count = argc - 1;
+        rates = malloc(count * sizeof(*rates));
+        if (!rates)
+            return 1;
+
+        for (i = 0; i < count; i++) {
+            char *end;
+
+            rates[i] = strtoul(argv[i + 1], &end, 10);
+            if (*end != '\0' || rates[i] == 0) {
+                fprintf(stderr, "%s: bad rate %s\n", argv[0], argv[i + 1]);
+                return 2;
+            }
+        }
+    }
+    else {
+        count = sizeof(default_rates) / sizeof(default_rates[0]);
+        rates = malloc(count * sizeof(*rates));
+        if (!rates)
+            return 1;
+
+        for (i = 0; i < count; i++)
+            rates[i] = default_rates[i];
+    }
+
+    qsort(rates, count, sizeof(rates[0]), compare_rate);
+
+    for (i = 0, kept = 0; i < count; i++) {
+        if (kept == 0 || rates[i] != rates[kept - 1])
+            rates[kept++] = rates[i];
+    }
+    count = kept;
+
+    printf("/*\n");
+    printf("    Generated by tools/gen-standard-clocks.c, do not edit.\n");
+    printf("\n");
+    printf("    Clock bits for common clock rates, lowest first. An FSCC entry is\n");
+    printf("    what the ICS30703 search gives for its frequency at ppm or more,\n");
+    printf("    a 335 entry what the ICS30702 search gives for its frequency.\n");
+    printf("*/\n");
+    printf("\n");
+    printf("#ifndef CLOCK_TABLE_STANDARD_H\n");
+    printf("#define CLOCK_TABLE_STANDARD_H\n");
+    printf("\n");
+    printf("#if defined(__cplusplus) && __cplusplus >= 201103L\n");
+    printf("#define CLOCK_TABLE_STANDARD_CONST constexpr\n");
+    printf("#else\n");
+    printf("#define CLOCK_TABLE_STANDARD_CONST const\n");
+    printf("#endif\n");
+    printf("\n");
+
+    for (i = 0, kept = 0; i < count; i++) {
+        if (rates[i] >= FSCC_MIN_CLOCK_RATE && rates[i] <= FSCC_MAX_CLOCK_RATE)
+            kept++;
+    }
+
+    printf("#define CLOCK_TABLE_STANDARD_FSCC_SIZE %lu\n", (unsigned long)kept);
+    printf("\n");
+    printf("static CLOCK_TABLE_STANDARD_CONST struct clock_table_standard_fscc_entry {\n");
+    printf("    unsigned long frequency;\n");
+    printf("    unsigned long ppm;          /* least ppm the bits are for */\n");
+    printf("    unsigned long actual;       /* frequency the bits give */\n");
+    printf("    unsigned char bits[20];\n");
+    printf("} clock_table_standard_fscc[CLOCK_TABLE_STANDARD_FSCC_SIZE] = {\n");
+
+    for (i = 0; i < count; i++) {
+        unsigned char bits[20];
+        unsigned long actual = 0, ppm;
+
+        if (rates[i] < FSCC_MIN_CLOCK_RATE || rates[i] > FSCC_MAX_CLOCK_RATE)
+            continue;
+
+        for (ppm = 0; ppm <= FSCC_CLOCK_RATE_PPM; ppm++) {
+            if (ClockGenICS30703(rates[i], ppm, &actual, bits) == 0)
+                break;
+        }
+
+        if (ppm > FSCC_CLOCK_RATE_PPM) {
+            fprintf(stderr, "%s: no FSCC setting within %u ppm of %lu Hz\n",
+                    argv[0], FSCC_CLOCK_RATE_PPM, rates[i]);
+            return 1;
+        }
+
+        printf("    {%lu, %lu, %lu, {", rates[i], ppm, actual);
+
+        for (j = 0; j < 20; j++)
+            printf("0x%02x%s", bits[j], j == 19 ? "" : ",");
+
+        printf("}}%s\n", --kept ? "," : "");
+    }
+
+    printf("};\n");
+    printf("\n");
+
+    for (i = 0, kept = 0; i < count; i++) {
+        if (rates[i] >= PCI_MIN_CLOCK_RATE && rates[i] <= PCI_MAX_CLOCK_RATE)
+            kept++;
+    }
+
+    printf("#define CLOCK_TABLE_STANDARD_335_SIZE %lu\n", (unsigned long)kept);
+    printf("\n");
+    printf("static CLOCK_TABLE_STANDARD_CONST struct clock_table_standard_335_entry {\n");
+    printf("    unsigned long frequency;\n");
+    printf("    unsigned long actual;       /* frequency the bits give */\n");
+    printf("    unsigned int bits;\n");
+    printf("} clock_table_standard_335[CLOCK_TABLE_STANDARD_335_SIZE] = {\n");
+
+    for (i = 0; i < count; i++) {
+        unsigned long actual = 0;
+        unsigned int bits = 0;
+
+        if (rates[i] < PCI_MIN_CLOCK_RATE || rates[i] > PCI_MAX_CLOCK_RATE)
+            continue;
+
+        if (ClockGenICS30702(rates[i], &actual, &bits) != 0) {
+            fprintf(stderr, "%s: no 335 setting for %lu Hz\n", argv[0], rates[i]);
+            return 1;
+        }
+
+        printf("    {%lu, %lu, 0x%06x}%s\n", rates[i], actual, bits, --kept ? "," : "");
+    }
+
+    printf("};\n");
+    printf("\n");
+    printf("#endif\n");
+
+    free(rates);
+
+    return 0;
+}
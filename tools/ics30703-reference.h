@@ -0,0 +1,11 @@
+#ifndef ICS30703_REFERENCE_H
+#define ICS30703_REFERENCE_H
+
+#include "calculate-clock-bits.h"
+
+/* The ICS30703 search from before it was pruned, see ics30703-reference.c.
+   Takes the frequency in clock_data and returns 0 with the setting filled
+   in, or the library's error number. */
+int ReferenceICS30703Data(struct clock_data_fscc *clock_data, unsigned long ppm);
+
+#endif
@@ -0,0 +1,24 @@
+/*
+    lib/raw/calculate-clock-bits.c built without the output divider skip,
+    for test-od-skip.c to compare against. Everything it exports is
+    renamed so it can be linked next to the library itself.
+*/
+
+#define CLOCK_BITS_NO_OD_SKIP
+
+#define calculate_clock_bits_fscc noskip_clock_bits_fscc
+#define calculate_clock_bits_fscc_threaded noskip_clock_bits_fscc_threaded
+#define calculate_clock_bits_fscc_r noskip_clock_bits_fscc_r
+#define calculate_clock_bits_error_string noskip_clock_bits_error_string
+#define calculate_clock_bits_set_cache noskip_clock_bits_set_cache
+#define calculate_clock_bits_asynccom noskip_clock_bits_asynccom
+#define calculate_clock_bits_synccom noskip_clock_bits_synccom
+#define calculate_clock_bits_fscc_batch noskip_clock_bits_fscc_batch
+#define calculate_clock_solutions_fscc noskip_clock_solutions_fscc
+#define calculate_clock_bits_335 noskip_clock_bits_335
+#define calculate_clock_bits_335_r noskip_clock_bits_335_r
+#define calculate_baud_setting_fscc noskip_baud_setting_fscc
+#define calculate_baud_setting_335 noskip_baud_setting_335
+#define calculate_baud_setting_pcie noskip_baud_setting_pcie
+
+#include "../lib/raw/calculate-clock-bits.c"
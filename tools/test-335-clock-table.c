@@ -0,0 +1,95 @@
+/*
+    Checks calculate_clock_bits_335, which looks rates up in
+    lib/raw/clock-table-335.h, against a brute-force search of every
+    output, reference and VCO divider. The search is ClockGenICS30702 from
+    src/clockgen.h, the old GetICS30702Data done in the same 32-bit
+    arithmetic gen-335-clock-table.c builds the table with.
+
+    Tried are the frequency of every stride'th table entry and the rates
+    either side of it, the rates whose 10% window just reaches it, the
+    rates around each output divider's limit and random rates up to
+    200 MHz. A rate neither side has a setting for counts as a match.
+
+        cc -O2 -I../lib/raw -o test-335-clock-table test-335-clock-table.c \
+            ../lib/raw/calculate-clock-bits.c -lm -lpthread
+        ./test-335-clock-table [stride [random rates]]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "calculate-clock-bits.h"
+#include "clock-table-335.h"
+#include "../src/clockgen.h"
+
+/* Highest rate output dividers 2 to 8 and 10 may be used for, 9 never is */
+static const unsigned long od_limits[] = {
+    180000000, 120000000, 90000000, 72000000, 60000000, 50000000,
+    45000000, 36000000
+};
+
+static unsigned long checked, failed;
+
+static void check(unsigned long rate)
+{
+    clock_data_335 table;
+    unsigned int bits = 0;
+    unsigned long actual = 0;
+    int table_ok, search_ok;
+
+    memset(&table, 0, sizeof(table));
+
+    table_ok = calculate_clock_bits_335_r(rate, &table) == CLOCK_BITS_OK;
+    search_ok = ClockGenICS30702(rate, &actual, &bits) == 0;
+
+    checked++;
+
+    if (table_ok != search_ok ||
+        (table_ok && (table.frequency != actual || table.clock_bits != bits))) {
+        if (failed < 20)
+            printf("%lu Hz: table %s %lu Hz %06x, search %s %lu Hz %06x\n", rate,
+                   table_ok ? "ok" : "none", table_ok ? table.frequency : 0UL, table.clock_bits,
+                   search_ok ? "ok" : "none", search_ok ? actual : 0UL, bits);
+        failed++;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned stride = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 97;
+    unsigned random_rates = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 0) : 500;
+    unsigned i;
+
+    if (stride < 1)
+        stride = 1;
+
+    srand(30702);
+
+    for (i = 0; i < CLOCK_TABLE_335_SIZE; i += stride) {
+        unsigned long f = clock_table_335[i].frequency;
+
+        check(f - 1);
+        check(f);
+        check(f + 1);
+
+        /* rate + rate / 10 and rate - rate / 10 land on f */
+        check(f * 10 / 11);
+        check(f * 10 / 11 + 1);
+        check(f * 10 / 9);
+        check(f * 10 / 9 + 1);
+    }
+
+    for (i = 0; i < sizeof(od_limits) / sizeof(od_limits[0]); i++) {
+        check(od_limits[i] - 1);
+        check(od_limits[i]);
+        check(od_limits[i] + 1);
+    }
+
+    for (i = 0; i < random_rates; i++)
+        check((((unsigned long)rand() << 16) ^ (unsigned long)rand()) % 200000001);
+
+    printf("%lu of %lu rates differ\n", failed, checked);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+/*
+    Checks ClockGen335Waveform in src/clockgen.h against the per-bit
+    MPIOLVL writes FastcomSetClockBitsPCI used to make before the waveform
+    was built up front.
+
+    Every saved MPIOLVL value is tried with a spread of clock words. The
+    waveform has to be the same writes in the same order and end with the
+    pins as they were. Clocking it into a model of the ICS307's serial
+    port also has to load the 24 bit word, unless the clock pin was
+    already high, when neither sequence gives the first bit an edge.
+
+        cc -o test-335-waveform test-335-waveform.c
+        ./test-335-waveform
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/clockgen.h"
+
+/* The writes the old loop made, one SerialWriteUChar at a time. */
+static unsigned per_bit_sequence(unsigned char saved, unsigned long clock_bits, unsigned char *writes)
+{
+    unsigned long tempValue = clock_bits & 0x00ffffff;
+    unsigned char data = saved;
+    unsigned count = 0;
+    unsigned long i;
+
+    for (i = 0; i < 24; i++) {
+        // data bit set
+        if ((tempValue & 0x800000) != 0)
+            data |= MPIO_SDTA;
+        else
+            data &= ~MPIO_SDTA;
+
+        writes[count++] = data;
+
+        // clock high, data still there
+        data |= MPIO_SCLK;
+        writes[count++] = data;
+
+        // clock low, data still there
+        data &= MPIO_SDTA;
+        writes[count++] = data;
+
+        tempValue <<= 1;
+    }
+
+    data &= 0xF8;
+    data |= MPIO_SSTB; // strobe on
+    writes[count++] = data;
+
+    data &= ~MPIO_SSTB; // all off
+    writes[count++] = data;
+
+    // Put MPIO pins back to saved state
+    writes[count++] = saved;
+
+    return count;
+}
+
+/* Shifts SDTA in on each rising SCLK and latches on a rising SSTB, the
+   way the ICS307 takes its programming word. Returns the latched word,
+   or -1 if nothing was latched. */
+static long ics307_latch(unsigned char saved, const unsigned char *writes, unsigned count)
+{
+    unsigned long shift = 0;
+    long latched = -1;
+    unsigned char last = saved;
+    unsigned i;
+
+    for (i = 0; i < count; i++) {
+        if ((writes[i] & MPIO_SCLK) && !(last & MPIO_SCLK))
+            shift = ((shift << 1) | (writes[i] & MPIO_SDTA)) & 0x00ffffff;
+
+        if ((writes[i] & MPIO_SSTB) && !(last & MPIO_SSTB))
+            latched = (long)shift;
+
+        last = writes[i];
+    }
+
+    return latched;
+}
+
+int main(void)
+{
+    static const unsigned long fixed_words[] = {
+        0x000000, 0xffffff, 0x800000, 0x000001, 0xaaaaaa, 0x555555,
+        0x5b1622, 0x12345678, 0xff000000
+    };
+    unsigned char expected[CLOCKGEN_335_WAVEFORM_SIZE];
+    unsigned char waveform[CLOCKGEN_335_WAVEFORM_SIZE];
+    unsigned long checked = 0, failed = 0;
+    unsigned saved;
+    unsigned i;
+
+    srand(335);
+
+    for (saved = 0; saved < 256; saved++) {
+        for (i = 0; i < sizeof(fixed_words) / sizeof(fixed_words[0]) + 64; i++) {
+            unsigned long word;
+            unsigned expected_count, count;
+            long latched;
+
+            if (i < sizeof(fixed_words) / sizeof(fixed_words[0]))
+                word = fixed_words[i];
+            else
+                word = ((unsigned long)rand() << 16) ^ (unsigned long)rand();
+
+            expected_count = per_bit_sequence((unsigned char)saved, word, expected);
+            count = ClockGen335Waveform((unsigned char)saved, word, waveform);
+            latched = ics307_latch((unsigned char)saved, waveform, count);
+
+            checked++;
+
+            if (count != CLOCKGEN_335_WAVEFORM_SIZE || count != expected_count ||
+                memcmp(waveform, expected, count) != 0 ||
+                waveform[count - 1] != saved ||
+                (!(saved & MPIO_SCLK) && latched != (long)(word & 0x00ffffff))) {
+                if (failed < 10)
+                    printf("saved %02x word %06lx: %u writes, latched %06lx\n", saved,
+                           word & 0x00ffffff, count, (unsigned long)latched);
+                failed++;
+            }
+        }
+    }
+
+    printf("%lu of %lu waveforms differ\n", failed, checked);
+
+    return failed ? 1 : 0;
+}
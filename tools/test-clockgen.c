@@ -0,0 +1,130 @@
+/*
+    Checks that the driver's integer clock solvers in src/clockgen.h give
+    the same bits and frequency as lib/raw/calculate-clock-bits.c for
+    every rate IOCTL_FASTCOM_SET_CLOCK_RATE takes.
+
+    FSCC rates are tried from FSCC_MIN_CLOCK_RATE to FSCC_MAX_CLOCK_RATE at
+    every ppm up to FSCC_CLOCK_RATE_PPM, and 335 rates from
+    PCI_MIN_CLOCK_RATE to PCI_MAX_CLOCK_RATE. Each range is covered by
+    rates spread evenly on a log scale, the ends of the range and random
+    rates. A rate neither side has a setting for counts as a match.
+
+        cc -O2 -I../lib/raw -o test-clockgen test-clockgen.c \
+            ../lib/raw/calculate-clock-bits.c -lm -lpthread
+        ./test-clockgen [log rates] [random rates]
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "calculate-clock-bits.h"
+#include "../src/clockgen.h"
+
+/* These mirror serial.h, which needs the WDK. */
+#define FSCC_MIN_CLOCK_RATE 200
+#define FSCC_MAX_CLOCK_RATE 270000000
+#define FSCC_CLOCK_RATE_PPM 10
+#define PCI_MIN_CLOCK_RATE 6000000
+#define PCI_MAX_CLOCK_RATE 180000000
+
+static unsigned long checked, failed;
+
+static unsigned long random_rate(unsigned long min, unsigned long max)
+{
+    unsigned long r = ((unsigned long)rand() << 16) ^ (unsigned long)rand();
+
+    return min + r % (max - min + 1);
+}
+
+static unsigned long log_rate(unsigned long min, unsigned long max, unsigned i, unsigned count)
+{
+    double x = count > 1 ? (double)i / (count - 1) : 0.0;
+
+    return (unsigned long)(min * pow((double)max / min, x));
+}
+
+static void check_fscc(unsigned long rate, unsigned long ppm)
+{
+    clock_data_fscc lib;
+    unsigned char bits[CLOCKGEN_ICS30703_BITS];
+    unsigned long actual;
+    int lib_ok, driver_ok;
+
+    memset(&lib, 0, sizeof(lib));
+    memset(bits, 0, sizeof(bits));
+
+    lib_ok = calculate_clock_bits_fscc_r(rate, ppm, 1, &lib) == CLOCK_BITS_OK;
+    driver_ok = ClockGenICS30703(rate, ppm, &actual, bits) == 0;
+
+    checked++;
+
+    if (lib_ok != driver_ok ||
+        (lib_ok && (lib.frequency != actual || memcmp(lib.clock_bits, bits, sizeof(bits)) != 0))) {
+        if (failed < 20)
+            printf("fscc %lu Hz %lu ppm: library %s %lu Hz, driver %s %lu Hz\n", rate, ppm,
+                   lib_ok ? "ok" : "none", lib_ok ? lib.frequency : 0UL,
+                   driver_ok ? "ok" : "none", driver_ok ? actual : 0UL);
+        failed++;
+    }
+}
+
+static void check_335(unsigned long rate)
+{
+    clock_data_335 lib;
+    unsigned int bits = 0;
+    unsigned long actual;
+    int lib_ok, driver_ok;
+
+    memset(&lib, 0, sizeof(lib));
+
+    lib_ok = calculate_clock_bits_335_r(rate, &lib) == CLOCK_BITS_OK;
+    driver_ok = ClockGenICS30702(rate, &actual, &bits) == 0;
+
+    checked++;
+
+    if (lib_ok != driver_ok ||
+        (lib_ok && (lib.frequency != actual || lib.clock_bits != bits))) {
+        if (failed < 20)
+            printf("335 %lu Hz: library %s %lu Hz %06x, driver %s %lu Hz %06x\n", rate,
+                   lib_ok ? "ok" : "none", lib_ok ? lib.frequency : 0UL, lib.clock_bits,
+                   driver_ok ? "ok" : "none", driver_ok ? actual : 0UL, bits);
+        failed++;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned log_rates = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 60;
+    unsigned random_rates = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 0) : 20;
+    unsigned long ppm;
+    unsigned i;
+
+    calculate_clock_bits_set_cache(NULL);
+    srand(30703);
+
+    for (ppm = 0; ppm <= FSCC_CLOCK_RATE_PPM; ppm++) {
+        check_fscc(FSCC_MIN_CLOCK_RATE, ppm);
+        check_fscc(FSCC_MAX_CLOCK_RATE, ppm);
+
+        for (i = 0; i < log_rates; i++)
+            check_fscc(log_rate(FSCC_MIN_CLOCK_RATE, FSCC_MAX_CLOCK_RATE, i, log_rates), ppm);
+
+        for (i = 0; i < random_rates; i++)
+            check_fscc(random_rate(FSCC_MIN_CLOCK_RATE, FSCC_MAX_CLOCK_RATE), ppm);
+    }
+
+    check_335(PCI_MIN_CLOCK_RATE);
+    check_335(PCI_MAX_CLOCK_RATE);
+
+    for (i = 0; i < log_rates * 4; i++)
+        check_335(log_rate(PCI_MIN_CLOCK_RATE, PCI_MAX_CLOCK_RATE, i, log_rates * 4));
+
+    for (i = 0; i < random_rates * 4; i++)
+        check_335(random_rate(PCI_MIN_CLOCK_RATE, PCI_MAX_CLOCK_RATE));
+
+    printf("%lu of %lu rates differ\n", failed, checked);
+
+    return failed ? 1 : 0;
+}
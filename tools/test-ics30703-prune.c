@@ -0,0 +1,83 @@
+/*
+    Checks that the pruned ICS30703 search in lib/raw/calculate-clock-bits.c
+    picks the same clock bits and frequency as the search it replaced,
+    which tried every divider again for each ppm up to the one asked for.
+    That search is kept in ics30703-reference.c.
+
+    Random rates from 1 MHz to 270 MHz are tried at 0 to 100 ppm, along
+    with a few slower ones below 1 MHz and rates the old search found
+    exact settings for. A rate neither search has a setting for counts as
+    a match. The old search takes long enough that the default run is
+    kept short; pass a larger count for a longer one.
+
+        cc -O2 -I../lib/raw -o test-ics30703-prune test-ics30703-prune.c \
+            ics30703-reference.c ../lib/raw/calculate-clock-bits.c -lm -lpthread
+        ./test-ics30703-prune [random rates]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "calculate-clock-bits.h"
+#include "ics30703-reference.h"
+
+static const unsigned long ppms[] = {0, 1, 2, 5, 10, 50, 100};
+
+/* Rates below 1 MHz, where there are the most output dividers to prune */
+static const unsigned long low_rates[] = {100000, 250000, 307200, 460800, 614400, 921600};
+
+static unsigned long checked, failed;
+
+static unsigned long random_number(void)
+{
+    return ((unsigned long)rand() << 16) ^ (unsigned long)rand();
+}
+
+static void check(unsigned long rate, unsigned long ppm)
+{
+    clock_data_fscc reference, pruned;
+    int reference_ok, pruned_ok;
+
+    memset(&reference, 0, sizeof(reference));
+    memset(&pruned, 0, sizeof(pruned));
+
+    reference.frequency = rate;
+    reference_ok = ReferenceICS30703Data(&reference, ppm) == 0;
+    pruned_ok = calculate_clock_bits_fscc_r(rate, ppm, 1, &pruned) == CLOCK_BITS_OK;
+
+    checked++;
+
+    if (reference_ok != pruned_ok ||
+        (reference_ok && (reference.frequency != pruned.frequency ||
+                          memcmp(reference.clock_bits, pruned.clock_bits, sizeof(pruned.clock_bits)) != 0))) {
+        if (failed < 20)
+            printf("%lu Hz %lu ppm: old search %s %lu Hz, pruned %s %lu Hz\n", rate, ppm,
+                   reference_ok ? "ok" : "none", reference_ok ? reference.frequency : 0UL,
+                   pruned_ok ? "ok" : "none", pruned_ok ? pruned.frequency : 0UL);
+        failed++;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned random_rates = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 100;
+    unsigned i;
+
+    calculate_clock_bits_set_cache(NULL);
+    srand(36);
+
+    for (i = 0; i < sizeof(low_rates) / sizeof(low_rates[0]); i++)
+        check(low_rates[i], ppms[i % (sizeof(ppms) / sizeof(ppms[0]))]);
+
+    for (i = 0; i < random_rates; i++) {
+        unsigned long rate = 1000000 + random_number() % 269000001;
+        unsigned long ppm = ppms[random_number() % (sizeof(ppms) / sizeof(ppms[0]))];
+
+        check(rate, ppm);
+    }
+
+    printf("%lu of %lu rates differ\n", failed, checked);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+/*
+    Checks that skipping output dividers with no VCO divider in reach
+    doesn't change what the FSCC clock search finds, and times the search
+    with and without the skip.
+
+    od-skip-reference.c is the library built with CLOCK_BITS_NO_OD_SKIP.
+    Both are asked for their first 8 solutions, which have to be the same
+    settings in the same order. Every integer rate in 200 Hz windows spread
+    over the range is tried at each ppm, then random rates. The time per
+    solve for each is printed at the end.
+
+        cc -O2 -I../lib/raw -o test-od-skip test-od-skip.c od-skip-reference.c \
+            ../lib/raw/calculate-clock-bits.c -lm -lpthread
+        ./test-od-skip [window width [random rates]]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "calculate-clock-bits.h"
+
+#define SOLUTIONS 8
+
+int noskip_clock_solutions_fscc(unsigned long frequency, unsigned long ppm, clock_solution_fscc *solutions, unsigned max_solutions);
+
+static const unsigned long ppms[] = {0, 1, 10, 100, 1000};
+
+/* Where each window of rates starts */
+static const unsigned long windows[] = {
+    1000, 123400, 1843100, 14745500, 99999900, 199999800
+};
+
+static unsigned long checked, failed;
+static double skip_seconds, noskip_seconds;
+
+static double now(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER count, frequency;
+
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+
+    return (double)count.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+static int same_solution(const clock_solution_fscc *a, const clock_solution_fscc *b)
+{
+    return a->frequency == b->frequency && a->ppm == b->ppm &&
+           a->reference_divider == b->reference_divider &&
+           a->vco_divider == b->vco_divider &&
+           a->output_divider == b->output_divider &&
+           a->loop_filter_resistor == b->loop_filter_resistor &&
+           a->charge_pump_current == b->charge_pump_current &&
+           memcmp(a->clock_bits, b->clock_bits, sizeof(a->clock_bits)) == 0;
+}
+
+static void check(unsigned long rate, unsigned long ppm)
+{
+    clock_solution_fscc skip[SOLUTIONS], noskip[SOLUTIONS];
+    int skip_count, noskip_count, i;
+    double start;
+
+    start = now();
+    skip_count = calculate_clock_solutions_fscc(rate, ppm, skip, SOLUTIONS);
+    skip_seconds += now() - start;
+
+    start = now();
+    noskip_count = noskip_clock_solutions_fscc(rate, ppm, noskip, SOLUTIONS);
+    noskip_seconds += now() - start;
+
+    checked++;
+
+    for (i = 0; i < skip_count && i < noskip_count; i++) {
+        if (!same_solution(&skip[i], &noskip[i]))
+            break;
+    }
+
+    if (skip_count != noskip_count || i < skip_count) {
+        if (failed < 20)
+            printf("%lu Hz %lu ppm: %i solutions with the skip, %i without, first difference %i\n",
+                   rate, ppm, skip_count, noskip_count, i);
+        failed++;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned width = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 200;
+    unsigned random_rates = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 0) : 200;
+    unsigned i, w, p;
+
+    srand(43);
+
+    for (w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+        for (p = 0; p < sizeof(ppms) / sizeof(ppms[0]); p++) {
+            for (i = 0; i < width; i++)
+                check(windows[w] + i, ppms[p]);
+        }
+    }
+
+    for (i = 0; i < random_rates; i++) {
+        unsigned long rate = 1000 + ((((unsigned long)rand() << 16) ^ (unsigned long)rand()) % 199999001);
+
+        check(rate, ppms[(unsigned)rand() % (sizeof(ppms) / sizeof(ppms[0]))]);
+    }
+
+    printf("%lu of %lu rates differ\n", failed, checked);
+    printf("per solve: %.1f us with the skip, %.1f us without\n",
+           skip_seconds * 1e6 / checked, noskip_seconds * 1e6 / checked);
+
+    return failed ? 1 : 0;
+}